@@ -22,6 +22,7 @@
 #include <config.h>
 
 #include "gnome-cmd-includes.h"
+#include "gnome-cmd-batch.h"
 #include "cap.h"
 #include "gnome-cmd-xfer.h"
 #include "gnome-cmd-file.h"
@@ -34,7 +35,7 @@ using namespace std;
 #define GNOME_CMD_COPIED 2
 
 static int _type = 0;
-static GList *_files = NULL;
+static GnomeCmd::Batch<GnomeCmdFile *> _files;     // the cut or copied files, ref'ed
 static GnomeCmdFileList *_fl = NULL;
 
 
@@ -47,24 +48,42 @@ static void on_xfer_done (GList *files, gpointer data)
 
 inline void update_refs (GnomeCmdFileList *fl, GList *files)
 {
-    if (_files != NULL)
-        gnome_cmd_file_list_free (_files);
+    for (auto f : _files)
+        f->unref();
+
+    _files = GnomeCmd::Batch<GnomeCmdFile *> (files);
+
+    for (auto f : _files)
+        f->ref();
 
-    _files = gnome_cmd_file_list_copy (files);
     _fl = fl;
 }
 
 
+/**
+ * @returns the cut or copied files as a list owning their refs, and empties the clipboard
+ */
+inline GList *take_files ()
+{
+    GList *files = _files.get_list();
+
+    _files.clear();
+
+    return files;
+}
+
+
 inline void cut_and_paste (GnomeCmdDir *to)
 {
-    gnome_cmd_xfer_start (_files,
+    GList *files = take_files ();
+
+    gnome_cmd_xfer_start (files,
                           gnome_cmd_dir_ref (to),
                           _fl,
                           NULL,
                           GNOME_VFS_XFER_REMOVESOURCE,
                           GNOME_VFS_XFER_OVERWRITE_MODE_QUERY,
-                          GTK_SIGNAL_FUNC (on_xfer_done), _files);
-    _files = NULL;
+                          GTK_SIGNAL_FUNC (on_xfer_done), files);
     _fl = NULL;
     main_win->set_cap_state(FALSE);
 }
@@ -72,14 +91,15 @@ inline void cut_and_paste (GnomeCmdDir *to)
 
 inline void copy_and_paste (GnomeCmdDir *to)
 {
-    gnome_cmd_xfer_start (_files,
+    GList *files = take_files ();
+
+    gnome_cmd_xfer_start (files,
                           gnome_cmd_dir_ref (to),
                           _fl,
                           NULL,
                           GNOME_VFS_XFER_RECURSIVE,
                           GNOME_VFS_XFER_OVERWRITE_MODE_QUERY,
-                          GTK_SIGNAL_FUNC (on_xfer_done), _files);
-    _files = NULL;
+                          GTK_SIGNAL_FUNC (on_xfer_done), files);
     _fl = NULL;
     main_win->set_cap_state(FALSE);
 }
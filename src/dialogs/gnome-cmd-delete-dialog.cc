@@ -22,10 +22,14 @@
 #include <config.h>
 
 #include "gnome-cmd-includes.h"
+#include "gnome-cmd-batch.h"
 #include "gnome-cmd-data.h"
+#include "gnome-cmd-delete-engine.h"
 #include "gnome-cmd-dir.h"
 #include "gnome-cmd-file-list.h"
 #include "gnome-cmd-main-win.h"
+#include "gnome-cmd-trash.h"
+#include "gnome-cmd-xfer-progress-win.h"
 #include "utils.h"
 #include "dialogs/gnome-cmd-delete-dialog.h"
 
@@ -50,21 +54,44 @@ struct DeleteData
     GList *files;                 // the files that should be deleted
     gboolean stop;                // tells the work thread to stop working
     gboolean delete_done;         // tells the main thread that the work thread is done
-    gchar *msg;                   // a message descriping the current status of the delete operation
-    gfloat progress;              // a float values between 0 and 1 representing the progress of the whole operation
-    GMutex mutex;                 // used to sync the main and worker thread
+    gint files_done;              // written by gnome-vfs jobs with g_atomic_int_set, read by the main thread
+    gint files_total;
+    GMutex mutex;                 // used to sync the main and worker thread when there is a problem
+    GnomeCmd::DeleteEngine *engine;   // deletes local files without gnome-vfs, NULL for remote ones
+    GnomeCmd::Trash *trash;           // moves local files to the trash instead of deleting them
+    guint n_items;                    // the number of items passed to the trash
 };
 
 
 inline void cleanup (DeleteData *data)
 {
+    g_mutex_clear (&data->mutex);
     gnome_cmd_file_list_free (data->files);
+    delete data->engine;
+    delete data->trash;
     g_free (data);
 }
 
 
+inline gboolean is_to_be_deleted (GnomeCmdFile *f)
+{
+    return !f->is_dotdot && strcmp (f->info->name, ".") != 0;
+}
+
+
 static gint delete_progress_callback (GnomeVFSXferProgressInfo *info, DeleteData *data)
 {
+    if (info->status == GNOME_VFS_XFER_PROGRESS_STATUS_OK)
+    {
+        if (info->files_total > 0)
+        {
+            g_atomic_int_set (&data->files_total, info->files_total);
+            g_atomic_int_set (&data->files_done, info->file_index);
+        }
+
+        return !data->stop;
+    }
+
     gint ret = 0;
 
     g_mutex_lock (&data->mutex);
@@ -85,25 +112,36 @@ static gint delete_progress_callback (GnomeVFSXferProgressInfo *info, DeleteData
         data->vfs_status = GNOME_VFS_OK;
     }
     else
-        if (info->status == GNOME_VFS_XFER_PROGRESS_STATUS_OK)
-        {
-            if (info->files_total > 0)
-            {
-                gfloat f = (gfloat)info->file_index/(gfloat)info->files_total;
-                g_free (data->msg);
-                data->msg = g_strdup_printf (ngettext("Deleted %ld of %ld file",
-                                                      "Deleted %ld of %ld files",
-                                                      info->files_total),
-                                             info->file_index, info->files_total);
-                if (f < 0.001f) f = 0.001f;
-                if (f > 0.999f) f = 0.999f;
-                data->progress = f;
-            }
+        data->vfs_status = info->vfs_status;
 
-            ret = !data->stop;
-        }
-        else
-            data->vfs_status = info->vfs_status;
+    g_mutex_unlock (&data->mutex);
+
+    return ret;
+}
+
+
+/**
+ * Asks the main thread what to do about @a error. The answer is the index of the
+ * button, which is the same for GnomeCmd::DeleteEngine and GnomeCmd::Trash.
+ */
+static gint on_native_error (DeleteData *data, const string &path, int error)
+{
+    g_mutex_lock (&data->mutex);
+
+    data->problem_file = g_path_get_basename (path.c_str());
+    data->vfs_status = gnome_vfs_result_from_errno_code (error);
+    data->problem = TRUE;
+
+    g_mutex_unlock (&data->mutex);
+    while (data->problem_action == -1)
+        g_thread_yield ();
+    g_mutex_lock (&data->mutex);
+
+    gint ret = data->problem_action;
+    data->problem_action = -1;
+    g_free (data->problem_file);
+    data->problem_file = NULL;
+    data->vfs_status = GNOME_VFS_OK;
 
     g_mutex_unlock (&data->mutex);
 
@@ -133,7 +171,7 @@ inline void create_delete_progress_win (DeleteData *data)
     GtkWidget *button;
 
     data->progwin = gtk_window_new (GTK_WINDOW_TOPLEVEL);
-    gtk_window_set_title (GTK_WINDOW (data->progwin), _("Deleting…"));
+    gtk_window_set_title (GTK_WINDOW (data->progwin), data->trash ? _("Moving to Trash…") : _("Deleting…"));
     gtk_window_set_policy (GTK_WINDOW (data->progwin), FALSE, FALSE, FALSE);
     gtk_window_set_position (GTK_WINDOW (data->progwin), GTK_WIN_POS_CENTER);
     gtk_widget_set_size_request (GTK_WIDGET (data->progwin), 300, -1);
@@ -161,26 +199,66 @@ inline void create_delete_progress_win (DeleteData *data)
 }
 
 
+static void perform_native_delete_operation (DeleteData *data)
+{
+    vector<string> paths;
+
+    for (GList *i=data->files; i; i=i->next)
+    {
+        GnomeCmdFile *f = (GnomeCmdFile *) i->data;
+
+        if (is_to_be_deleted (f))
+            paths.push_back (stringify (f->get_real_path()));
+    }
+
+    data->engine->on_error = [data] (const string &path, int error) { return (GnomeCmd::ErrorAction) on_native_error (data, path, error); };
+    data->engine->run(paths);
+
+    data->delete_done = TRUE;
+}
+
+
+static void perform_trash_operation (DeleteData *data)
+{
+    vector<string> paths;
+
+    for (GList *i=data->files; i; i=i->next)
+    {
+        GnomeCmdFile *f = (GnomeCmdFile *) i->data;
+
+        if (is_to_be_deleted (f))
+            paths.push_back (stringify (f->get_real_path()));
+    }
+
+    data->trash->on_error = [data] (const string &path, int error) { return (GnomeCmd::ErrorAction) on_native_error (data, path, error); };
+    data->trash->run(paths);
+
+    data->delete_done = TRUE;
+}
+
+
 static void perform_delete_operation (DeleteData *data)
 {
-    GList *uri_list = NULL;
+    GnomeCmd::Batch<GnomeVFSURI *> uris;
 
     // go through all files and add the uri of the appropriate ones to a list
     for (GList *i=data->files; i; i=i->next)
     {
         GnomeCmdFile *f = (GnomeCmdFile *) i->data;
 
-        if (f->is_dotdot || strcmp(f->info->name, ".") == 0)
+        if (!is_to_be_deleted (f))
             continue;
 
         GnomeVFSURI *uri = f->get_uri();
         if (!uri) continue;
 
-        uri_list = g_list_append (uri_list, gnome_vfs_uri_ref (uri));
+        uris.add(gnome_vfs_uri_ref (uri));
     }
 
-    if (uri_list)
+    if (!uris.empty())
     {
+        GList *uri_list = uris.get_list();
+
         gnome_vfs_xfer_delete_list (uri_list,
                                     GNOME_VFS_XFER_ERROR_MODE_QUERY,
                                     GNOME_VFS_XFER_DEFAULT,
@@ -197,10 +275,61 @@ static void perform_delete_operation (DeleteData *data)
 
 static gboolean update_delete_status_widgets (DeleteData *data)
 {
-    g_mutex_lock (&data->mutex);
+    gchar *status_msg = NULL;
+    gfloat progress = -1.0f;
+
+    if (data->engine)
+    {
+        if (data->stop)
+            data->engine->cancel();
+
+        guint64 n = data->engine->files_removed;
+
+        status_msg = g_strdup_printf (ngettext("Deleted %llu file", "Deleted %llu files", n), (unsigned long long) n);
+
+        if (data->engine->get_items_total() > 0)
+            progress = (gfloat) data->engine->items_done / data->engine->get_items_total();
+    }
+    else
+        if (data->trash)
+        {
+            if (data->stop)
+                data->trash->cancel();
+
+            guint64 n = data->trash->items_done;
+
+            status_msg = g_strdup_printf (ngettext("Moved %llu of %u file to the trash",
+                                                   "Moved %llu of %u files to the trash",
+                                                   data->n_items),
+                                          (unsigned long long) n, data->n_items);
+
+            if (data->n_items > 0)
+                progress = (gfloat) n / data->n_items;
+        }
+        else
+        {
+            gint total = g_atomic_int_get (&data->files_total);
+            gint n = g_atomic_int_get (&data->files_done);
+
+            if (total > 0)
+            {
+                status_msg = g_strdup_printf (ngettext("Deleted %ld of %ld file",
+                                                       "Deleted %ld of %ld files",
+                                                       total),
+                                              (glong) n, (glong) total);
+                progress = (gfloat) n / total;
+            }
+        }
+
+    if (status_msg)
+        gtk_label_set_text (GTK_LABEL (data->proglabel), status_msg);
 
-    gtk_label_set_text (GTK_LABEL (data->proglabel), data->msg);
-    gtk_progress_set_percentage (GTK_PROGRESS (data->progbar), data->progress);
+    if (progress >= 0.0f)
+        gtk_progress_set_percentage (GTK_PROGRESS (data->progbar), CLAMP (progress, 0.001f, 0.999f));
+
+    g_free (status_msg);
+
+    g_mutex_lock (&data->mutex);
 
     if (data->problem)
     {
@@ -223,21 +352,36 @@ static gboolean update_delete_status_widgets (DeleteData *data)
         if (data->vfs_status != GNOME_VFS_OK)
             gnome_cmd_show_message (*main_win, gnome_vfs_result_to_string (data->vfs_status));
 
-        if (data->files)
+        // the native engine and the trash know what they have removed, no need to look again
+        if (data->engine || data->trash)
+        {
+            const vector<bool> &removed = data->engine ? data->engine->removed : data->trash->trashed;
+            size_t n = 0;
+
             for (GList *i = data->files; i; i = i->next)
             {
                 GnomeCmdFile *f = GNOME_CMD_FILE (i->data);
-                GnomeVFSURI *uri = f->get_uri();
 
-                if (!gnome_vfs_uri_exists (uri))
+                if (is_to_be_deleted (f) && n < removed.size() && removed[n++])
                     f->is_deleted();
             }
+        }
+        else
+            if (data->files)
+                for (GList *i = data->files; i; i = i->next)
+                {
+                    GnomeCmdFile *f = GNOME_CMD_FILE (i->data);
+                    GnomeVFSURI *uri = f->get_uri();
+
+                    if (!gnome_vfs_uri_exists (uri))
+                        f->is_deleted();
+                }
 
         gtk_widget_destroy (data->progwin);
 
         cleanup (data);
 
-        return FALSE;  // returning FALSE here stops the timeout callbacks
+        return FALSE;  // returning FALSE here stops the updates
     }
 
     return TRUE;
@@ -252,9 +396,16 @@ inline void do_delete (DeleteData *data)
     data->problem_action = -1;
     create_delete_progress_win (data);
 
-    data->thread = g_thread_new (NULL, (GThreadFunc) perform_delete_operation, data);
-    g_timeout_add (gnome_cmd_data.gui_update_rate, (GSourceFunc) update_delete_status_widgets, data);
-    g_mutex_clear(&data->mutex);
+    GThreadFunc func = (GThreadFunc) perform_delete_operation;
+
+    if (data->trash)
+        func = (GThreadFunc) perform_trash_operation;
+    else
+        if (data->engine)
+            func = (GThreadFunc) perform_native_delete_operation;
+
+    data->thread = g_thread_new (NULL, func, data);
+    gnome_cmd_progress_add_job ((GSourceFunc) update_delete_status_widgets, data);
 }
 
 
@@ -348,12 +499,20 @@ static GList *remove_items_from_list_to_be_deleted(GList *files)
 }
 
 
-void gnome_cmd_delete_dialog_show (GList *files)
+void gnome_cmd_delete_dialog_show (GList *files, gboolean force_delete)
 {
     g_return_if_fail (files != NULL);
 
     gint response = 1;
 
+    // only local files can go to the trash, the others are deleted as before
+    gboolean all_local = TRUE;
+
+    for (GList *i = files; i && all_local; i = i->next)
+        all_local = GNOME_CMD_FILE (i->data)->is_local();
+
+    gboolean use_trash = all_local && gnome_cmd_data.options.delete_to_trash && !force_delete;
+
     if (gnome_cmd_data.options.confirm_delete)
     {
         gchar *msg = NULL;
@@ -368,18 +527,25 @@ void gnome_cmd_delete_dialog_show (GList *files)
                 return;
 
             gchar *fname = get_utf8 (f->info->name);
-            msg = g_strdup_printf (_("Do you want to delete “%s”?"), fname);
+            msg = g_strdup_printf (use_trash ? _("Do you want to move “%s” to the trash?") : _("Do you want to delete “%s”?"), fname);
             g_free (fname);
         }
         else
-            msg = g_strdup_printf (ngettext("Do you want to delete the selected file?",
-                                            "Do you want to delete the %d selected files?",
-                                            n_files),
-                                   n_files);
+            if (use_trash)
+                msg = g_strdup_printf (ngettext("Do you want to move the selected file to the trash?",
+                                                "Do you want to move the %d selected files to the trash?",
+                                                n_files),
+                                       n_files);
+            else
+                msg = g_strdup_printf (ngettext("Do you want to delete the selected file?",
+                                                "Do you want to delete the %d selected files?",
+                                                n_files),
+                                       n_files);
 
         response = run_simple_dialog (*main_win, FALSE,
-                                      GTK_MESSAGE_QUESTION, msg, _("Delete"),
-                                      gnome_cmd_data.options.confirm_delete_default==GTK_BUTTONS_CANCEL ? 0 : 1, _("Cancel"), _("Delete"), NULL);
+                                      GTK_MESSAGE_QUESTION, msg, use_trash ? _("Move to Trash") : _("Delete"),
+                                      gnome_cmd_data.options.confirm_delete_default==GTK_BUTTONS_CANCEL ? 0 : 1, _("Cancel"),
+                                      use_trash ? _("Move to Trash") : _("Delete"), NULL);
 
         g_free (msg);
     }
@@ -387,8 +553,8 @@ void gnome_cmd_delete_dialog_show (GList *files)
     if (response != 1)
         return;
 
-    // eventually remove non-empty dirs from list
-    files = remove_items_from_list_to_be_deleted(files);
+    // eventually remove non-empty dirs from list, there is no need to ask for the trash
+    files = use_trash ? g_list_copy (files) : remove_items_from_list_to_be_deleted(files);
 
     if (files == nullptr)
         return;
@@ -396,11 +562,23 @@ void gnome_cmd_delete_dialog_show (GList *files)
     DeleteData *data = g_new0 (DeleteData, 1);
 
     data->files = files;
+
+    // local files are deleted by the native engine, in parallel
+    if (use_trash)
+    {
+        data->trash = new GnomeCmd::Trash;
+
+        for (GList *i = files; i; i = i->next)
+            if (is_to_be_deleted (GNOME_CMD_FILE (i->data)))
+                data->n_items++;
+    }
+    else
+        if (all_local)
+            data->engine = new GnomeCmd::DeleteEngine;
     // data->stop = FALSE;
     // data->problem = FALSE;
     // data->delete_done = FALSE;
     // data->mutex = NULL;
-    // data->msg = NULL;
 
     do_delete (data);
 }
@@ -20,4 +20,4 @@
  */
 #pragma once
 
-void gnome_cmd_delete_dialog_show (GList *files);
+void gnome_cmd_delete_dialog_show (GList *files, gboolean force_delete=FALSE);
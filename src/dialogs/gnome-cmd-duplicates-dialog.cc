@@ -0,0 +1,461 @@
+/**
+ * @file gnome-cmd-duplicates-dialog.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <sys/stat.h>
+#include <atomic>
+
+#include "gnome-cmd-includes.h"
+#include "gnome-cmd-duplicate-finder.h"
+#include "gnome-cmd-duplicates-dialog.h"
+#include "gnome-cmd-treeview.h"
+#include "gnome-cmd-xfer-progress-win.h"
+#include "utils.h"
+
+using namespace std;
+using GnomeCmd::DuplicateFinder;
+
+
+enum {COL_MARK, COL_NAME, COL_SIZE, COL_PATH, COL_IS_FILE, NUM_COLS};
+
+// same order as DuplicateFinder::Action
+enum {RESPONSE_HARDLINK=1, RESPONSE_REFLINK, RESPONSE_DELETE};
+
+
+struct DuplicatesData
+{
+    GtkWidget *dialog;
+    GtkWidget *label;
+    GtkWidget *pbar;
+    GtkTreeStore *store;
+
+    vector<string> paths;
+    DuplicateFinder finder;
+    GThread *thread {nullptr};              /**< joined by the progress job, NULL afterwards */
+    atomic<bool> done {false};
+    gboolean closed {FALSE};                /**< the dialog is gone, the progress job frees the data */
+};
+
+
+static gpointer find_duplicates_func (DuplicatesData *data)
+{
+    for (auto &path : data->paths)
+        data->finder.add(path);
+
+    data->finder.run();
+    data->done = true;
+
+    return NULL;
+}
+
+
+inline gchar *group_title (guint n, guint64 size)
+{
+    gchar *s = g_format_size (size);
+    gchar *title = g_strdup_printf (ngettext("%u file of %s", "%u files of %s each", n), n, s);
+
+    g_free (s);
+
+    return title;
+}
+
+
+static void show_groups (DuplicatesData *data)
+{
+    const vector<DuplicateFinder::Group> &groups = data->finder.get_groups();
+    guint64 wasted = 0;
+
+    for (auto &g : groups)
+    {
+        GtkTreeIter parent, child;
+        gchar *title = group_title (g.paths.size(), g.size);
+        gchar *size = g_format_size (g.wasted());
+
+        gtk_tree_store_append (data->store, &parent, NULL);
+        gtk_tree_store_set (data->store, &parent,
+                            COL_MARK, FALSE,
+                            COL_NAME, title,
+                            COL_SIZE, size,
+                            COL_IS_FILE, FALSE,
+                            -1);
+        g_free (title);
+        g_free (size);
+
+        // all but the first file are marked as duplicates
+        for (size_t i=0; i<g.paths.size(); ++i)
+        {
+            gchar *fname = get_utf8 (g.paths[i].c_str());
+
+            gtk_tree_store_append (data->store, &child, &parent);
+            gtk_tree_store_set (data->store, &child,
+                                COL_MARK, i > 0,
+                                COL_NAME, fname,
+                                COL_PATH, g.paths[i].c_str(),
+                                COL_IS_FILE, TRUE,
+                                -1);
+            g_free (fname);
+        }
+
+        wasted += g.wasted();
+    }
+
+    GtkTreeView *view = GTK_TREE_VIEW (lookup_widget (data->dialog, "view"));
+
+    gtk_tree_view_expand_all (view);
+
+    guint64 total = data->finder.bytes_total;
+    guint64 read = data->finder.bytes_read;
+    gchar *wasted_str = g_format_size (wasted);
+    gchar *read_str = g_format_size (read);
+    gchar *total_str = g_format_size (total);
+    gchar *msg = g_strdup_printf (ngettext("%u group of equal files, %s could be freed. Read %s to find it, %.0f%% of the %s a full hash of every file would read.",
+                                           "%u groups of equal files, %s could be freed. Read %s to find them, %.0f%% of the %s a full hash of every file would read.",
+                                           groups.size()),
+                                  (guint) groups.size(), wasted_str, read_str, total ? 100.0 * read / total : 0.0, total_str);
+
+    gtk_label_set_text (GTK_LABEL (data->label), msg);
+    gtk_widget_hide (data->pbar);
+
+    g_free (wasted_str);
+    g_free (read_str);
+    g_free (total_str);
+    g_free (msg);
+
+    gboolean found = !groups.empty();
+
+    gtk_dialog_set_response_sensitive (GTK_DIALOG (data->dialog), RESPONSE_HARDLINK, found);
+    gtk_dialog_set_response_sensitive (GTK_DIALOG (data->dialog), RESPONSE_REFLINK, found);
+    gtk_dialog_set_response_sensitive (GTK_DIALOG (data->dialog), RESPONSE_DELETE, found);
+}
+
+
+static gboolean update_duplicates_status (DuplicatesData *data)
+{
+    if (data->closed)
+    {
+        if (!data->done)
+            return TRUE;                    // stopped, it returns soon
+
+        g_thread_join (data->thread);
+        delete data;
+
+        return FALSE;
+    }
+
+    if (data->done)
+    {
+        g_thread_join (data->thread);
+        data->thread = NULL;
+        show_groups (data);
+
+        return FALSE;
+    }
+
+    gchar *msg = NULL;
+    guint64 n = data->finder.files_hashed;
+    guint64 total = data->finder.files_to_hash;
+
+    switch (data->finder.stage)
+    {
+        case DuplicateFinder::STAGE_SCAN:
+            n = data->finder.files_found;
+            msg = g_strdup_printf (ngettext("Looking for files, %llu found", "Looking for files, %llu found", n), (unsigned long long) n);
+            gtk_progress_bar_pulse (GTK_PROGRESS_BAR (data->pbar));
+            break;
+
+        case DuplicateFinder::STAGE_PARTIAL_HASH:
+            msg = g_strdup_printf (ngettext("Comparing the start and end of %llu of %llu file of the same size",
+                                            "Comparing the start and end of %llu of %llu files of the same size",
+                                            total),
+                                   (unsigned long long) n, (unsigned long long) total);
+            break;
+
+        default:
+            msg = g_strdup_printf (ngettext("Comparing %llu of %llu file in full", "Comparing %llu of %llu files in full", total),
+                                   (unsigned long long) n, (unsigned long long) total);
+            break;
+    }
+
+    if (data->finder.stage != DuplicateFinder::STAGE_SCAN && total > 0)
+        gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (data->pbar), CLAMP ((gdouble) n / total, 0.0, 1.0));
+
+    gtk_label_set_text (GTK_LABEL (data->label), msg);
+    g_free (msg);
+
+    return TRUE;
+}
+
+
+static void on_mark_toggled (GtkCellRendererToggle *renderer, gchar *path, DuplicatesData *data)
+{
+    GtkTreeIter iter;
+
+    if (!gtk_tree_model_get_iter_from_string (GTK_TREE_MODEL (data->store), &iter, path))
+        return;
+
+    gboolean mark;
+
+    gtk_tree_model_get (GTK_TREE_MODEL (data->store), &iter, COL_MARK, &mark, -1);
+    gtk_tree_store_set (data->store, &iter, COL_MARK, !mark, -1);
+}
+
+
+/**
+ * Applies @a action to the marked files of every group, keeping the first
+ * unmarked one. Groups with all their files marked are left alone.
+ */
+static void resolve_marked (DuplicatesData *data, DuplicateFinder::Action action)
+{
+    GtkTreeModel *model = GTK_TREE_MODEL (data->store);
+    GtkTreeIter group;
+    guint64 freed = 0;
+    guint n_done = 0;
+    guint n_failed = 0;
+    guint n_skipped = 0;
+    string first_error;
+
+    if (action == DuplicateFinder::ACTION_DELETE &&
+        run_simple_dialog (data->dialog, FALSE, GTK_MESSAGE_QUESTION, _("Delete all marked files?"), _("Delete"),
+                           -1, _("Cancel"), _("Delete"), NULL) != 1)
+        return;
+
+    for (gboolean valid = gtk_tree_model_get_iter_first (model, &group); valid; )
+    {
+        GtkTreeIter file;
+        gchar *keep = NULL;
+
+        for (gboolean f = gtk_tree_model_iter_children (model, &file, &group); f && !keep; f = gtk_tree_model_iter_next (model, &file))
+        {
+            gboolean mark;
+            gchar *path;
+
+            gtk_tree_model_get (model, &file, COL_MARK, &mark, COL_PATH, &path, -1);
+
+            if (!mark)
+                keep = path;
+            else
+                g_free (path);
+        }
+
+        if (!keep)
+        {
+            ++n_skipped;
+            valid = gtk_tree_model_iter_next (model, &group);
+            continue;
+        }
+
+        for (gboolean f = gtk_tree_model_iter_children (model, &file, &group); f; )
+        {
+            gboolean mark;
+            gchar *path;
+
+            gtk_tree_model_get (model, &file, COL_MARK, &mark, COL_PATH, &path, -1);
+
+            if (!mark)
+            {
+                g_free (path);
+                f = gtk_tree_model_iter_next (model, &file);
+                continue;
+            }
+
+            // the hashes are from a while ago and a link can't be undone
+            int error = DuplicateFinder::same_content(keep, path) ? DuplicateFinder::resolve(keep, path, action) : ESTALE;
+
+            if (error)
+            {
+                if (first_error.empty())
+                {
+                    gchar *fname = get_utf8 (path);
+                    gchar *msg = g_strdup_printf ("“%s”: %s", fname, error == ESTALE ? _("the file has changed since it was compared") : g_strerror (error));
+
+                    first_error = msg;
+                    g_free (fname);
+                    g_free (msg);
+                }
+
+                ++n_failed;
+                f = gtk_tree_model_iter_next (model, &file);
+            }
+            else
+            {
+                struct stat st;
+
+                if (lstat (keep, &st) == 0)
+                    freed += st.st_size;
+
+                ++n_done;
+                f = gtk_tree_store_remove (data->store, &file);
+            }
+
+            g_free (path);
+        }
+
+        g_free (keep);
+
+        gint n = gtk_tree_model_iter_n_children (model, &group);
+
+        if (n < 2)
+            valid = gtk_tree_store_remove (data->store, &group);
+        else
+        {
+            GtkTreeIter first;
+            gchar *path;
+            struct stat st;
+
+            gtk_tree_model_iter_children (model, &first, &group);
+            gtk_tree_model_get (model, &first, COL_PATH, &path, -1);
+
+            if (lstat (path, &st) == 0)
+            {
+                gchar *title = group_title (n, st.st_size);
+                gchar *size = g_format_size ((guint64) st.st_size * (n - 1));
+
+                gtk_tree_store_set (data->store, &group, COL_NAME, title, COL_SIZE, size, -1);
+                g_free (title);
+                g_free (size);
+            }
+
+            g_free (path);
+            valid = gtk_tree_model_iter_next (model, &group);
+        }
+    }
+
+    gchar *freed_str = g_format_size (freed);
+    string msg = stringify (g_strdup_printf (ngettext("%u file resolved, %s freed.", "%u files resolved, %s freed.", n_done), n_done, freed_str));
+
+    g_free (freed_str);
+
+    if (n_skipped)
+        msg += ' ' + stringify (g_strdup_printf (ngettext("%u group with all files marked was left alone.",
+                                                          "%u groups with all files marked were left alone.",
+                                                          n_skipped),
+                                                 n_skipped));
+
+    if (n_failed)
+        msg += ' ' + stringify (g_strdup_printf (ngettext("%u file failed, %s", "%u files failed, first %s", n_failed), n_failed, first_error.c_str()));
+
+    gtk_label_set_text (GTK_LABEL (data->label), msg.c_str());
+}
+
+
+inline GtkWidget *create_group_view (DuplicatesData *data)
+{
+    GtkWidget *view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (data->store));
+
+    g_object_unref (data->store);           // destroy model automatically with view
+
+    g_object_set (view, "rules-hint", TRUE, NULL);
+
+    GtkCellRenderer *renderer = NULL;
+    GtkTreeViewColumn *col;
+
+    col = gnome_cmd_treeview_create_new_toggle_column (GTK_TREE_VIEW (view), renderer, COL_MARK, _("Mark"));
+    gtk_tree_view_column_add_attribute (col, renderer, "visible", COL_IS_FILE);
+    g_signal_connect (renderer, "toggled", G_CALLBACK (on_mark_toggled), data);
+
+    col = gnome_cmd_treeview_create_new_text_column (GTK_TREE_VIEW (view), renderer, COL_NAME, _("File"));
+    gtk_tree_view_column_set_expand (col, TRUE);
+    g_object_set (renderer,
+                  "ellipsize-set", TRUE,
+                  "ellipsize", PANGO_ELLIPSIZE_START,
+                  NULL);
+
+    gnome_cmd_treeview_create_new_text_column (GTK_TREE_VIEW (view), COL_SIZE, _("Wasted"));
+
+    GtkWidget *scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+    gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled_window), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (scrolled_window), GTK_SHADOW_IN);
+    gtk_container_add (GTK_CONTAINER (scrolled_window), view);
+    gtk_widget_set_size_request (scrolled_window, 640, 360);
+
+    g_object_set_data (G_OBJECT (data->dialog), "view", view);
+
+    return scrolled_window;
+}
+
+
+void gnome_cmd_duplicates_dialog (GtkWindow *parent, const vector<string> &paths)
+{
+    DuplicatesData *data = new DuplicatesData;
+
+    data->paths = paths;
+    data->dialog = gtk_dialog_new_with_buttons (_("Find Duplicates"), parent,
+                                                GtkDialogFlags (GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT),
+                                                _("_Hard Link"), RESPONSE_HARDLINK,
+                                                _("_Reflink"), RESPONSE_REFLINK,
+                                                GTK_STOCK_DELETE, RESPONSE_DELETE,
+                                                GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE,
+                                                NULL);
+
+    GtkWidget *content_area = gtk_dialog_get_content_area (GTK_DIALOG (data->dialog));
+
+    gtk_dialog_set_has_separator (GTK_DIALOG (data->dialog), FALSE);
+
+    // HIG defaults
+    gtk_container_set_border_width (GTK_CONTAINER (data->dialog), 5);
+    gtk_container_set_border_width (GTK_CONTAINER (content_area), 5);
+    gtk_box_set_spacing (GTK_BOX (content_area), 6);
+
+    GtkWidget *label = gtk_label_new (_("Marked files are replaced by, or deleted in favour of, the first unmarked file of their group."));
+    gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
+    gtk_box_pack_start (GTK_BOX (content_area), label, FALSE, FALSE, 0);
+
+    data->store = gtk_tree_store_new (NUM_COLS, G_TYPE_BOOLEAN, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_BOOLEAN);
+    gtk_box_pack_start (GTK_BOX (content_area), create_group_view (data), TRUE, TRUE, 0);
+
+    data->label = gtk_label_new (NULL);
+    gtk_label_set_line_wrap (GTK_LABEL (data->label), TRUE);
+    gtk_misc_set_alignment (GTK_MISC (data->label), 0.0, 0.5);
+    gtk_box_pack_start (GTK_BOX (content_area), data->label, FALSE, FALSE, 0);
+
+    data->pbar = gtk_progress_bar_new ();
+    gtk_box_pack_start (GTK_BOX (content_area), data->pbar, FALSE, FALSE, 0);
+
+    gtk_widget_show_all (content_area);
+
+    gtk_dialog_set_response_sensitive (GTK_DIALOG (data->dialog), RESPONSE_HARDLINK, FALSE);
+    gtk_dialog_set_response_sensitive (GTK_DIALOG (data->dialog), RESPONSE_REFLINK, FALSE);
+    gtk_dialog_set_response_sensitive (GTK_DIALOG (data->dialog), RESPONSE_DELETE, FALSE);
+    gtk_dialog_set_default_response (GTK_DIALOG (data->dialog), GTK_RESPONSE_CLOSE);
+
+    data->thread = g_thread_new (NULL, (GThreadFunc) find_duplicates_func, data);
+    gnome_cmd_progress_add_job ((GSourceFunc) update_duplicates_status, data);
+
+    for (;;)
+    {
+        gint response = gtk_dialog_run (GTK_DIALOG (data->dialog));
+
+        if (response < RESPONSE_HARDLINK || response > RESPONSE_DELETE)
+            break;
+
+        resolve_marked (data, (DuplicateFinder::Action) (response - RESPONSE_HARDLINK));
+    }
+
+    gtk_widget_destroy (data->dialog);
+
+    if (data->thread)
+    {
+        data->finder.stop();
+        data->closed = TRUE;
+    }
+    else
+        delete data;
+}
@@ -0,0 +1,31 @@
+/**
+ * @file gnome-cmd-duplicates-dialog.h
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * Looks for files with the same content among the local files @a paths and
+ * in the directories among them, lists them in groups and lets the user
+ * replace the marked duplicates by hard links or reflinks to the first
+ * unmarked file of their group, or delete them.
+ */
+void gnome_cmd_duplicates_dialog (GtkWindow *parent, const std::vector<std::string> &paths);
@@ -213,6 +213,14 @@ static GtkWidget *create_general_tab (GtkWidget *parent, GnomeCmdData::Options &
     gtk_box_pack_start (GTK_BOX (cat_box), check, FALSE, TRUE, 0);
     gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (check), !cfg.search_window_is_transient);
 
+    check = create_check (parent, _("Keep a file name index of searched directories"), "search_index");
+    gtk_box_pack_start (GTK_BOX (cat_box), check, FALSE, TRUE, 0);
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (check), cfg.search_index);
+
+    check = create_check (parent, _("Search inside compressed files and archives"), "search_archives");
+    gtk_box_pack_start (GTK_BOX (cat_box), check, FALSE, TRUE, 0);
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (check), cfg.search_archives);
+
 #ifdef HAVE_UNIQUE
     // Multiple instances
     cat_box = create_vbox (parent, FALSE, 0);
@@ -269,6 +277,8 @@ void store_general_options (GtkWidget *dialog, GnomeCmdData::Options &cfg)
     GtkWidget *qsearch_exact_match_begin = lookup_widget (dialog, "qsearch_exact_match_begin");
     GtkWidget *qsearch_exact_match_end = lookup_widget (dialog, "qsearch_exact_match_end");
     GtkWidget *search_window_transient = lookup_widget (dialog, "search_window_transient");
+    GtkWidget *search_index = lookup_widget (dialog, "search_index");
+    GtkWidget *search_archives = lookup_widget (dialog, "search_archives");
     GtkWidget *save_dirs = lookup_widget (dialog, "save_dirs");
     GtkWidget *save_tabs = lookup_widget (dialog, "save_tabs");
     GtkWidget *save_dir_history = lookup_widget (dialog, "save_dir_history");
@@ -297,6 +307,8 @@ void store_general_options (GtkWidget *dialog, GnomeCmdData::Options &cfg)
     cfg.quick_search_exact_match_begin = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (qsearch_exact_match_begin));
     cfg.quick_search_exact_match_end = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (qsearch_exact_match_end));
     cfg.search_window_is_transient = !gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (search_window_transient));
+    cfg.search_index = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (search_index));
+    cfg.search_archives = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (search_archives));
     cfg.save_dirs_on_exit = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (save_dirs));
     cfg.save_tabs_on_exit = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (save_tabs));
     cfg.save_dir_history_on_exit = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (save_dir_history));
@@ -1049,6 +1061,10 @@ static GtkWidget *create_confirmation_tab (GtkWidget *parent, GnomeCmdData::Opti
     gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (check), cfg.confirm_delete_default!=GTK_BUTTONS_CANCEL);
     gtk_widget_set_sensitive (check, cfg.confirm_delete);
 
+    check = create_check (parent, _("Move local files to the trash"), "delete_to_trash_check");
+    gtk_box_pack_start (GTK_BOX (cat_box), check, FALSE, TRUE, 0);
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (check), cfg.delete_to_trash);
+
 
     /* Copy overwrite options
      */
@@ -1109,6 +1125,7 @@ void store_confirmation_options (GtkWidget *dialog, GnomeCmdData::Options &cfg)
 {
     GtkWidget *confirm_delete_check = lookup_widget (dialog, "confirm_delete_check");
     GtkWidget *delete_default_check = lookup_widget (dialog, "delete_default_check");
+    GtkWidget *delete_to_trash_check = lookup_widget (dialog, "delete_to_trash_check");
     GtkWidget *confirm_copy_silent = lookup_widget (dialog, "copy_overwrite_silently");
     GtkWidget *confirm_copy_query = lookup_widget (dialog, "copy_overwrite_query");
     GtkWidget *confirm_copy_skip_all = lookup_widget (dialog, "copy_overwrite_skip_all");
@@ -1121,6 +1138,8 @@ void store_confirmation_options (GtkWidget *dialog, GnomeCmdData::Options &cfg)
 
     cfg.confirm_delete_default = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (delete_default_check)) ? GTK_BUTTONS_OK : GTK_BUTTONS_CANCEL;
 
+    cfg.delete_to_trash = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (delete_to_trash_check));
+
     if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (confirm_copy_silent)))
         cfg.confirm_copy_overwrite = GNOME_CMD_CONFIRM_OVERWRITE_SILENTLY;
     else if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (confirm_copy_query)))
@@ -42,6 +42,10 @@ typedef struct
     GtkWidget *skip;
 
     GtkWidget *follow_links;
+    GtkWidget *hardlinks;
+    GtkWidget *reflink;
+    GtkWidget *bulk_mode;
+    GtkWidget *fanout;
 
 } PrepareCopyData;
 
@@ -65,6 +69,47 @@ static void on_ok (GtkButton *button, gpointer user_data)
         xferOptions |= GNOME_VFS_XFER_FOLLOW_LINKS;
 
     dlg->xferOptions = (GnomeVFSXferOptions) xferOptions;
+
+    guint xferFlags = GNOME_CMD_XFER_DEFAULT;
+
+    switch (gtk_combo_box_get_active (GTK_COMBO_BOX (data->bulk_mode)))
+    {
+        case 1:
+            xferFlags = GNOME_CMD_XFER_BULK;
+            break;
+
+        case 2:
+            xferFlags = GNOME_CMD_XFER_NO_BULK;
+            break;
+
+        default:
+            break;
+    }
+
+    if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (data->hardlinks)))
+        xferFlags |= GNOME_CMD_XFER_HARDLINKS;
+
+    if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (data->reflink)))
+        xferFlags |= GNOME_CMD_XFER_REFLINK;
+
+    dlg->xferFlags = (GnomeCmdXferFlags) xferFlags;
+
+    // OK may be pressed again after on_ok bailed out, the entry is parsed anew
+    g_list_foreach (dlg->fanout_dirs, (GFunc) g_free, NULL);
+    g_list_free (dlg->fanout_dirs);
+    dlg->fanout_dirs = NULL;
+
+    gchar **dirs = g_strsplit (gtk_entry_get_text (GTK_ENTRY (data->fanout)), ";", -1);
+
+    for (gchar **dir = dirs; *dir; ++dir)
+    {
+        gchar *path = g_strstrip (*dir);
+
+        if (*path)
+            dlg->fanout_dirs = g_list_append (dlg->fanout_dirs, g_strdup (path));
+    }
+
+    g_strfreev (dirs);
 }
 
 
@@ -118,6 +163,54 @@ void gnome_cmd_prepare_copy_dialog_show (GnomeCmdFileSelector *from, GnomeCmdFil
     gtk_widget_show (data->follow_links);
     gtk_box_pack_start (GTK_BOX (data->dialog->right_vbox), data->follow_links, FALSE, FALSE, 0);
 
+    data->hardlinks = gtk_check_button_new_with_label (_("Preserve Hard Links"));
+    gtk_widget_set_tooltip_text (data->hardlinks, _("Files which are hard linked to each other are copied once and linked again in the destination"));
+    gtk_widget_ref (data->hardlinks);
+    g_object_set_data_full (G_OBJECT (data->dialog), "hardlinks", data->hardlinks, g_object_unref);
+    gtk_widget_show (data->hardlinks);
+    gtk_box_pack_start (GTK_BOX (data->dialog->right_vbox), data->hardlinks, FALSE, FALSE, 0);
+
+    data->reflink = gtk_check_button_new_with_label (_("Reflink Where Possible"));
+    gtk_widget_set_tooltip_text (data->reflink, _("On copy-on-write file systems like Btrfs the copies share their data with the originals until either is changed"));
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (data->reflink), TRUE);
+    gtk_widget_ref (data->reflink);
+    g_object_set_data_full (G_OBJECT (data->dialog), "reflink", data->reflink, g_object_unref);
+    gtk_widget_show (data->reflink);
+    gtk_box_pack_start (GTK_BOX (data->dialog->right_vbox), data->reflink, FALSE, FALSE, 0);
+
+    // bulk mode keeps large copies from flushing the page cache
+    GtkWidget *bulk_hbox = gtk_hbox_new (FALSE, 6);
+    gtk_widget_show (bulk_hbox);
+    gtk_box_pack_start (GTK_BOX (data->dialog->right_vbox), bulk_hbox, FALSE, FALSE, 0);
+
+    label = gtk_label_new_with_mnemonic (_("_Bulk mode:"));
+    gtk_widget_show (label);
+    gtk_box_pack_start (GTK_BOX (bulk_hbox), label, FALSE, FALSE, 0);
+
+    data->bulk_mode = gtk_combo_box_new_text ();
+    gtk_combo_box_append_text (GTK_COMBO_BOX (data->bulk_mode), _("Automatic"));
+    gtk_combo_box_append_text (GTK_COMBO_BOX (data->bulk_mode), _("On"));
+    gtk_combo_box_append_text (GTK_COMBO_BOX (data->bulk_mode), _("Off"));
+    gtk_combo_box_set_active (GTK_COMBO_BOX (data->bulk_mode), 0);
+    gtk_widget_set_tooltip_text (data->bulk_mode, _("Bypass the page cache when copying between local file systems, so that copying a lot of data does not slow down everything else. Automatic uses it for large copies only."));
+    gtk_label_set_mnemonic_widget (GTK_LABEL (label), data->bulk_mode);
+    gtk_widget_ref (data->bulk_mode);
+    g_object_set_data_full (G_OBJECT (data->dialog), "bulk_mode", data->bulk_mode, g_object_unref);
+    gtk_widget_show (data->bulk_mode);
+    gtk_box_pack_start (GTK_BOX (bulk_hbox), data->bulk_mode, FALSE, FALSE, 0);
+
+    // further destinations, each file is read once and written to all of them
+    GtkWidget *fanout_vbox = create_vbox (GTK_WIDGET (data->dialog), FALSE, 0);
+    GtkWidget *fanout_frame = create_category (GTK_WIDGET (data->dialog), fanout_vbox, _("Also Copy To"));
+    gnome_cmd_dialog_add_category (GNOME_CMD_DIALOG (data->dialog), fanout_frame);
+
+    data->fanout = gtk_entry_new ();
+    gtk_widget_set_tooltip_text (data->fanout, _("Further local directories, separated by semicolons. Every file is read once and written to all destinations at the same time."));
+    gtk_widget_ref (data->fanout);
+    g_object_set_data_full (G_OBJECT (data->dialog), "fanout", data->fanout, g_object_unref);
+    gtk_widget_show (data->fanout);
+    gtk_box_pack_start (GTK_BOX (fanout_vbox), data->fanout, TRUE, TRUE, 0);
+
 
     // Customize prepare xfer widgets
 
@@ -231,7 +231,9 @@ static void on_ok (GtkButton *button, GnomeCmdPrepareXferDialog *dialog)
                           dest_fn,
                           dialog->xferOptions,
                           dialog->xferOverwriteMode,
-                          NULL, NULL);
+                          NULL, NULL,
+                          dialog->xferFlags,
+                          dialog->fanout_dirs);
 
 bailout:
     g_free (dest_path);
@@ -277,6 +279,10 @@ static void destroy (GtkObject *object)
 
     gnome_cmd_file_list_unref (dialog->src_files);
 
+    g_list_foreach (dialog->fanout_dirs, (GFunc) g_free, NULL);
+    g_list_free (dialog->fanout_dirs);
+    dialog->fanout_dirs = NULL;
+
     if (GTK_OBJECT_CLASS (parent_class)->destroy)
         (*GTK_OBJECT_CLASS (parent_class)->destroy) (object);
 }
@@ -22,6 +22,7 @@
 
 #include "gnome-cmd-dir.h"
 #include "gnome-cmd-file-selector.h"
+#include "gnome-cmd-xfer.h"
 
 #define GNOME_CMD_TYPE_PREPARE_XFER_DIALOG              (gnome_cmd_prepare_xfer_dialog_get_type ())
 #define GNOME_CMD_PREPARE_XFER_DIALOG(obj)              (G_TYPE_CHECK_INSTANCE_CAST((obj), GNOME_CMD_TYPE_PREPARE_XFER_DIALOG, GnomeCmdPrepareXferDialog))
@@ -46,6 +47,8 @@ struct GnomeCmdPrepareXferDialog
 
     GnomeVFSXferOptions xferOptions;
     GnomeVFSXferOverwriteMode xferOverwriteMode;
+    GnomeCmdXferFlags xferFlags;
+    GList *fanout_dirs;         // further local directories to copy to, the files are read only once
 
     GList *src_files;
     GnomeCmdFileSelector *src_fs;
@@ -22,10 +22,14 @@
 #include <config.h>
 #include <sys/types.h>
 #include <regex.h>
+#include <pwd.h>
+#include <unordered_set>
 
 #include "gnome-cmd-includes.h"
+#include "gnome-cmd-batch.h"
 #include "gnome-cmd-data.h"
 #include "gnome-cmd-search-dialog.h"
+#include "gnome-cmd-duplicates-dialog.h"
 #include "gnome-cmd-dir.h"
 #include "gnome-cmd-file-list.h"
 #include "gnome-cmd-file-selector.h"
@@ -33,6 +37,10 @@
 #include "gnome-cmd-con-list.h"
 #include "gnome-cmd-selection-profile-component.h"
 #include "gnome-cmd-manage-profiles-dialog.h"
+#include "gnome-cmd-search-engine.h"
+#include "gnome-cmd-name-index.h"
+#include "gnome-cmd-result-queue.h"
+#include "tags/gnome-cmd-tags.h"
 #include "filter.h"
 #include "utils.h"
 
@@ -46,11 +54,8 @@ static char *msgs[] = {N_("Search local directories only"),
 
 
 #define PBAR_MAX   50 /**< Absolute width of a progress bar */
-
-#define SEARCH_JUMP_SIZE     4096U
-#define SEARCH_BUFFER_SIZE  (SEARCH_JUMP_SIZE * 10U)
-
-#define GNOME_SEARCH_TOOL_REFRESH_DURATION  50000
+#define INDEX_MAX_AGE  300 /**< Seconds after which a name index used by a search is refreshed */
+#define MAX_ROWS_PER_UPDATE  2000 /**< Results added to the list per update, so that the dialog stays responsive */
 
 
 struct GnomeCmdSearchDialogClass
@@ -59,26 +64,14 @@ struct GnomeCmdSearchDialogClass
 };
 
 
-struct SearchFileData
-{
-    GnomeVFSResult  result;
-    gchar          *uri_str;
-    GnomeVFSHandle *handle;
-    gint            offset;
-    guint           len;
-    gchar           mem[SEARCH_BUFFER_SIZE];     /**< memory to search in the content of a file */
-};
-
-
 struct SearchData
 {
     struct ProtectedData
     {
-        GList  *files;
         gchar  *msg;
         GMutex *mutex;
 
-        ProtectedData(): files(0), msg(0), mutex(0)     {}
+        ProtectedData(): msg(0), mutex(0)     {}
     };
 
     GnomeCmdSearchDialog *dialog;
@@ -86,11 +79,26 @@ struct SearchData
     GnomeCmdDir *start_dir {nullptr};                     /**< the directory to start searching from */
 
     Filter *name_filter {nullptr};
-    regex_t *content_regex {nullptr};
     gint context_id {0};                            /**< the context id of the status bar */
-    GList *match_dirs {nullptr};                          /**< the directories which we found matching files in */
+    GnomeCmd::Batch<GnomeCmdDir *> match_dirs;           /**< the directories which we found matching files in */
     GThread *thread {nullptr};
     ProtectedData pdata;
+    GnomeCmd::ResultQueue<GnomeCmdFile *> found;          /**< by the generic search, referenced */
+    GnomeCmd::Batch<GnomeCmdFile *> files;                /**< taken from found, not yet in the list */
+    size_t files_shown {0};
+    std::vector<GnomeCmd::SearchEngine::Result> results;  /**< of the local search, not yet in the list */
+    size_t results_shown {0};
+    std::unordered_set<std::string> archives_shown;       /**< archives with matching members which are in the list */
+    GnomeCmd::NameMatcher *name_matcher {nullptr};        /**< for the local search */
+    GnomeCmd::ContentMatcher *content_matcher {nullptr};  /**< if the content is searched */
+    GnomeCmd::StatFilter stat_filter;                     /**< size, date and attribute criteria, checked before the content */
+    GnomeCmd::TagQuery *tag_query {nullptr};              /**< meta tag criteria, for the local search only */
+    GnomeCmd::IgnoreRules *ignore_rules {nullptr};        /**< entries and subtrees left out */
+    GnomeCmd::IgnoreRules::FramePtr ignore_root;          /**< the rules of the generic search, which reads no ignore files */
+    GnomeCmd::SearchEngine *engine {nullptr};
+    std::string index_root;                               /**< to index once the local search is done */
+    time_t index_built {0};                               /**< if the results are taken from a name index */
+    gboolean index_changed {FALSE};                       /**< files have been reported to change since it was built */
     gint update_gui_timeout_id {0};
 
     gboolean search_done {TRUE};
@@ -100,14 +108,16 @@ struct SearchData
     explicit SearchData(GnomeCmdSearchDialog *dlg);
 
     void set_statusmsg(const gchar *msg=NULL);
-    gchar *build_search_command();
-    void search_dir_r(GnomeCmdDir *dir, long level);  /**< searches a given directory for files that matches the criteria given by data */
+    void search_dir_r(GnomeCmdCon *con, GnomeCmdPath *path, long level);             /**< searches a given directory for files that matches the criteria given by data */
 
     gboolean name_matches(gchar *name)   {  return name_filter->match(name);  }     /**< determines if the name of a file matches an regexp */
-    gboolean content_matches(GnomeCmdFile *f);                                      /**< determines if the content of a file matches an regexp */
-    gboolean read_search_file(SearchFileData *, GnomeCmdFile *f);                   /**< loads a file in chunks and returns the content */
+    gboolean content_matches(GnomeVFSURI *uri);                                     /**< determines if the content of a file matches an regexp */
+    gboolean set_stat_filter();
     gboolean start_generic_search();
     gboolean start_local_search();
+    void free_search();
+    void unref_match_dirs();
+    gboolean add_results();
 
     static gboolean join_thread_func(SearchData *data);
 };
@@ -271,89 +281,39 @@ inline SearchData::SearchData(GnomeCmdSearchDialog *dlg): dialog(dlg)
 G_DEFINE_TYPE (GnomeCmdSearchDialog, gnome_cmd_search_dialog, GTK_TYPE_DIALOG)
 
 
-inline void free_search_file_data (SearchFileData *searchfile_data)
+inline gboolean SearchData::content_matches(GnomeVFSURI *uri)
 {
-    if (searchfile_data->handle)
-        gnome_vfs_close (searchfile_data->handle);
-
-    g_free (searchfile_data->uri_str);
-    g_free (searchfile_data);
-}
-
-
-gboolean SearchData::read_search_file(SearchFileData *searchfile_data, GnomeCmdFile *f)
-{
-    if (stopped)     // if the stop button was pressed, let's abort here
-    {
-        free_search_file_data (searchfile_data);
-        return FALSE;
-    }
-
-    if (searchfile_data->len)
-    {
-      if ((searchfile_data->offset + searchfile_data->len) >= f->info->size)   // end, all has been read
-      {
-          free_search_file_data (searchfile_data);
-          return FALSE;
-      }
-
-      // jump a big step backward to give the regex a chance
-      searchfile_data->offset += searchfile_data->len - SEARCH_JUMP_SIZE;
-      if (f->info->size < (searchfile_data->offset + (SEARCH_BUFFER_SIZE - 1)))
-          searchfile_data->len = f->info->size - searchfile_data->offset;
-      else
-          searchfile_data->len = SEARCH_BUFFER_SIZE - 1;
-    }
-    else   // first time call of this function
-        searchfile_data->len = MIN (f->info->size, SEARCH_BUFFER_SIZE - 1);
+    g_return_val_if_fail (uri != NULL, FALSE);
 
-    searchfile_data->result = gnome_vfs_seek (searchfile_data->handle, GNOME_VFS_SEEK_START, searchfile_data->offset);
-    if (searchfile_data->result != GNOME_VFS_OK)
-    {
-        g_warning (_("Failed to read file %s: %s"), searchfile_data->uri_str, gnome_vfs_result_to_string (searchfile_data->result));
-        free_search_file_data (searchfile_data);
-        return FALSE;
-    }
+    GnomeVFSHandle *handle;
+    GnomeVFSResult result = gnome_vfs_open_uri (&handle, uri, GNOME_VFS_OPEN_READ);
 
-    GnomeVFSFileSize ret;
-    searchfile_data->result = gnome_vfs_read (searchfile_data->handle, searchfile_data->mem, searchfile_data->len, &ret);
-    if (searchfile_data->result != GNOME_VFS_OK)
+    if (result == GNOME_VFS_OK)
     {
-        g_warning (_("Failed to read file %s: %s"), searchfile_data->uri_str, gnome_vfs_result_to_string (searchfile_data->result));
-        free_search_file_data (searchfile_data);
-        return FALSE;
-    }
-
-    searchfile_data->mem[searchfile_data->len] = '\0';
+        gboolean match = content_matcher->match_stream([&] (char *buf, size_t len) -> ssize_t
+                                                       {
+                                                           GnomeVFSFileSize n;
 
-    return TRUE;
-}
+                                                           if (stopped)     // if the stop button was pressed, let's abort here
+                                                               return -1;
 
+                                                           result = gnome_vfs_read (handle, buf, len, &n);
 
-inline gboolean SearchData::content_matches(GnomeCmdFile *f)
-{
-    g_return_val_if_fail (f != NULL, FALSE);
-    g_return_val_if_fail (f->info != NULL, FALSE);
+                                                           if (result == GNOME_VFS_ERROR_EOF)
+                                                               return 0;
 
-    if (f->info->size==0)
-        return FALSE;
+                                                           return result == GNOME_VFS_OK ? (ssize_t) n : -1;
+                                                       });
 
-    SearchFileData *search_file = g_new0 (SearchFileData, 1);
-    search_file->uri_str = f->get_uri_str();
-    search_file->result  = gnome_vfs_open (&search_file->handle, search_file->uri_str, GNOME_VFS_OPEN_READ);
+        gnome_vfs_close (handle);
 
-    if (search_file->result != GNOME_VFS_OK)
-    {
-        g_warning (_("Failed to read file %s: %s"), search_file->uri_str, gnome_vfs_result_to_string (search_file->result));
-        free_search_file_data (search_file);
-        return FALSE;
+        if (match || result == GNOME_VFS_OK || result == GNOME_VFS_ERROR_EOF || stopped)
+            return match;
     }
 
-    regmatch_t match;
-
-    while (read_search_file(search_file, f))
-        if (regexec (content_regex, search_file->mem, 1, &match, 0) != REG_NOMATCH)
-            return TRUE;        // stop on first match
+    gchar *uri_str = gnome_vfs_uri_to_string (uri, GNOME_VFS_URI_HIDE_PASSWORD);
+    g_warning (_("Failed to read file %s: %s"), uri_str, gnome_vfs_result_to_string (result));
+    g_free (uri_str);
 
     return FALSE;
 }
@@ -382,11 +342,45 @@ inline void SearchData::set_statusmsg(const gchar *msg)
 }
 
 
-void SearchData::search_dir_r(GnomeCmdDir *dir, long level)
+/**
+ * Checks the size, date and attribute criteria on the file info, which the directory listing has read anyway.
+ */
+static gboolean stat_matches (const GnomeCmd::StatFilter &filter, GnomeVFSFileInfo *info)
 {
-    if (!dir)
-        return;
+    if (!filter.active())
+        return TRUE;
 
+    struct stat st;
+
+    memset (&st, 0, sizeof(st));
+
+    switch (info->type)
+    {
+        case GNOME_VFS_FILE_TYPE_REGULAR:       st.st_mode = S_IFREG;  break;
+        case GNOME_VFS_FILE_TYPE_DIRECTORY:     st.st_mode = S_IFDIR;  break;
+        case GNOME_VFS_FILE_TYPE_SYMBOLIC_LINK: st.st_mode = S_IFLNK;  break;
+        default:                                break;
+    }
+
+    st.st_mode |= info->permissions & 07777;        // GnomeVFSFilePermissions has the values of the mode bits
+    st.st_size = info->size;
+    st.st_mtime = info->mtime;
+    st.st_atime = info->atime;
+    st.st_uid = info->uid;
+
+    return filter.match(st);
+}
+
+
+/**
+ * Reads the directory entries as plain file infos, one at a time. Only the
+ * matching files become GnomeCmdFiles, with their directory as the parent,
+ * the other entries are not kept. The names of the subdirectories are
+ * collected and searched after the directory has been closed, so one
+ * directory handle is open at a time.
+ */
+void SearchData::search_dir_r(GnomeCmdCon *con, GnomeCmdPath *path, long level)
+{
     if (stopped)     // if the stop button was pressed, let's abort here
         return;
 
@@ -396,53 +390,99 @@ void SearchData::search_dir_r(GnomeCmdDir *dir, long level)
         g_mutex_lock (pdata.mutex);
 
         g_free (pdata.msg);
-        pdata.msg = g_strdup_printf (_("Searching in: %s"), gnome_cmd_dir_get_display_path (dir));
+        pdata.msg = g_strdup_printf (_("Searching in: %s"), path->get_display_path());
 
         g_mutex_unlock (pdata.mutex);
     }
 
-    gnome_cmd_dir_list_files (dir, FALSE);
+    GnomeVFSURI *uri = gnome_cmd_con_create_uri (con, path);
+
+    if (!uri)
+        return;
 
-    // let's iterate through all files
-    for (GList *i=gnome_cmd_dir_get_files (dir); i; i=i->next)
+    GnomeVFSDirectoryHandle *handle;
+    auto infoOpts = (GnomeVFSFileInfoOptions) (GNOME_VFS_FILE_INFO_GET_MIME_TYPE | GNOME_VFS_FILE_INFO_FORCE_FAST_MIME_TYPE);
+
+    if (gnome_vfs_directory_open_from_uri (&handle, uri, infoOpts) != GNOME_VFS_OK)
     {
-        if (stopped)         // if the stop button was pressed, let's abort here
-            return;
+        gnome_vfs_uri_unref (uri);
+        return;
+    }
 
-        GnomeCmdFile *f = (GnomeCmdFile *) i->data;
+    GnomeVFSFileInfo *info = gnome_vfs_file_info_new ();
+    GnomeCmdDir *dir = NULL;                                            // created for the first match only
+    vector<string> subdirs;
+    string dir_path = path->get_path();
 
-        // if the current file is a directory, let's continue our recursion
-        if (GNOME_CMD_IS_DIR (f) && level!=0)
+    while (!stopped && gnome_vfs_directory_read_next (handle, info) == GNOME_VFS_OK)
+    {
+        const gchar *name = info->name;
+
+        if (strcmp (name, ".") == 0 || strcmp (name, "..") == 0)
+        {
+            gnome_vfs_file_info_clear (info);
+            continue;
+        }
+
+        // an excluded directory is not descended into
+        if (ignore_root && ignore_rules->excluded(ignore_root.get(), dir_path, name, info->type == GNOME_VFS_FILE_TYPE_DIRECTORY))
+        {
+            gnome_vfs_file_info_clear (info);
+            continue;
+        }
+
+        // links are not followed, they are not listed as directories here
+        if (info->type == GNOME_VFS_FILE_TYPE_DIRECTORY && level!=0)
+            subdirs.push_back(name);
+
+        if (info->type != GNOME_VFS_FILE_TYPE_DIRECTORY && name_matches(info->name) && stat_matches (stat_filter, info))
         {
-            // we don't want to go backwards or to follow symlinks
-            if (!f->is_dotdot && strcmp (f->info->name, ".") != 0 && !GNOME_VFS_FILE_INFO_SYMLINK (f->info))
+            gboolean match = TRUE;
+
+            if (content_matcher)                                        // if the user wants to we should do some content matching here
             {
-                GnomeCmdDir *new_dir = GNOME_CMD_DIR (f);
+                GnomeVFSURI *file_uri = gnome_vfs_uri_append_file_name (uri, name);
 
-                if (new_dir)
-                {
-                    gnome_cmd_dir_ref (new_dir);
-                    search_dir_r(new_dir, level-1);
-                    gnome_cmd_dir_unref (new_dir);
-                }
+                match = info->size > 0 && content_matches(file_uri);
+                gnome_vfs_uri_unref (file_uri);
             }
-        }
-        else                                                            // if the file is a regular one, it might match the search criteria
-            if (f->GetGfileAttributeUInt32(G_FILE_ATTRIBUTE_STANDARD_TYPE) == G_FILE_TYPE_DIRECTORY)
+
+            if (match && !dir)
             {
-                if (!name_matches(f->info->name))                       // if the name doesn't match, let's go to the next file
-                    continue;
+                dir = gnome_cmd_dir_new (con, path->clone(), TRUE);
 
-                if (dialog->defaults.default_profile.content_search && !content_matches(f))              // if the user wants to we should do some content matching here
-                    continue;
+                if (dir)                                                // also ref each directory that has a matching file
+                    match_dirs.add(gnome_cmd_dir_ref (dir));
+            }
 
-                g_mutex_lock (pdata.mutex);                             // the file matched the search criteria, let's add it to the list
-                pdata.files = g_list_append (pdata.files, f->ref());
-                g_mutex_unlock (pdata.mutex);
+            if (match && dir)
+            {
+                GnomeCmdFile *f = gnome_cmd_file_new (gnome_vfs_file_info_dup (info), dir);
 
-                if (g_list_index (match_dirs, dir) == -1)               // also ref each directory that has a matching file
-                    match_dirs = g_list_append (match_dirs, gnome_cmd_dir_ref (dir));
+                found.push(f->ref());                                   // the file matched the search criteria, let's add it to the list
             }
+        }
+
+        gnome_vfs_file_info_clear (info);
+    }
+
+    gnome_vfs_file_info_unref (info);
+    gnome_vfs_directory_close (handle);
+    gnome_vfs_uri_unref (uri);
+
+    // let's continue our recursion
+    for (auto &subdir : subdirs)
+    {
+        if (stopped)
+            return;
+
+        GnomeCmdPath *child = path->get_child(subdir.c_str());
+
+        if (child)
+        {
+            search_dir_r(con, child, level-1);
+            delete child;
+        }
     }
 }
 
@@ -450,26 +490,14 @@ void SearchData::search_dir_r(GnomeCmdDir *dir, long level)
 static gpointer perform_search_operation (SearchData *data)
 {
     // unref all directories which contained matching files from last search
-    if (data->match_dirs)
-    {
-        g_list_foreach (data->match_dirs, (GFunc) gnome_cmd_dir_unref, NULL);
-        g_list_free (data->match_dirs);
-        data->match_dirs = NULL;
-    }
+    data->unref_match_dirs();
 
-    data->search_dir_r(data->start_dir, data->dialog->defaults.default_profile.max_depth);
+    data->search_dir_r(gnome_cmd_dir_get_connection (data->start_dir), gnome_cmd_dir_get_path (data->start_dir), data->dialog->defaults.default_profile.max_depth);
 
     // free regexps
     delete data->name_filter;
     data->name_filter = NULL;
 
-    if (data->dialog->defaults.default_profile.content_search)
-    {
-        regfree (data->content_regex);
-        g_free (data->content_regex);
-        data->content_regex = NULL;
-    }
-
     gnome_cmd_dir_unref (data->start_dir);      //  FIXME:  ???
     data->start_dir = NULL;
 
@@ -481,30 +509,99 @@ static gpointer perform_search_operation (SearchData *data)
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-nonliteral"
 
-static gboolean update_search_status_widgets (SearchData *data)
+/**
+ * Adds the files found since the last update to the result list, at most
+ * MAX_ROWS_PER_UPDATE of them, the list is redrawn once.
+ *
+ * @returns TRUE if some are left for the next update
+ */
+gboolean SearchData::add_results()
 {
-    progress_bar_update (data->dialog->priv->pbar, PBAR_MAX);        // update the progress bar
+    if (results_shown == results.size())
+    {
+        results.clear();
+        results_shown = 0;
 
-    if (data->pdata.mutex)
+        if (engine)
+            engine->take_results(results);
+    }
+
+    if (files_shown == files.size())
+    {
+        files.clear();
+        files_shown = 0;
+        found.take(files);
+    }
+
+    if (results_shown == results.size() && files_shown == files.size())
+        return FALSE;
+
+    GnomeCmdFileList *fl = dialog->priv->result_list;
+    int rows = MAX_ROWS_PER_UPDATE;
+
+    gtk_clist_freeze (*fl);
+
+    for (; rows > 0 && results_shown < results.size(); --rows)
     {
-        g_mutex_lock (data->pdata.mutex);
+        const GnomeCmd::SearchEngine::Result &r = results[results_shown++];
 
-        GList *files = data->pdata.files;
-        data->pdata.files = NULL;
+        // the list holds files, an archive is listed once for all its matching members
+        if (!r.member.empty() && !archives_shown.insert(r.path).second)
+            continue;
 
-        data->set_statusmsg(data->pdata.msg);                       // update status bar with the latest message
+        gchar *utf8 = g_filename_display_name (r.path.c_str());
+        GnomeCmdFile *f = gnome_cmd_file_new (utf8);                // NULL if deleted since it was found
 
-        g_mutex_unlock (data->pdata.mutex);
+        if (f)
+            fl->append_file(f);
 
-        GnomeCmdFileList *fl = data->dialog->priv->result_list;
+        g_free (utf8);
+    }
 
-        for (GList *i = files; i; i = i->next)                      // add all files found since last update to the list
-            fl->append_file(GNOME_CMD_FILE (i->data));
+    for (; rows > 0 && files_shown < files.size(); --rows)
+    {
+        GnomeCmdFile *f = files[files_shown++];
 
-        gnome_cmd_file_list_free (files);
+        fl->append_file(f);
+        f->unref();
     }
 
-    if ((!data->search_done && !data->stopped) || data->pdata.files)
+    gtk_clist_thaw (*fl);
+
+    return results_shown < results.size() || files_shown < files.size() || !found.empty();
+}
+
+
+static gboolean update_search_status_widgets (SearchData *data)
+{
+    progress_bar_update (data->dialog->priv->pbar, PBAR_MAX);        // update the progress bar
+
+    gboolean done = data->search_done;                              // read before the results, so that none is missed
+    gboolean more = data->add_results();
+
+    if (data->engine)
+    {
+        string current_dir = data->engine->get_current_dir();
+
+        if (!current_dir.empty())
+        {
+            gchar *path = g_filename_display_name (current_dir.c_str());
+            gchar *msg = g_strdup_printf (_("Searching in: %s"), path);
+
+            data->set_statusmsg(msg);
+            g_free (msg);
+            g_free (path);
+        }
+    }
+    else
+        if (data->pdata.mutex)
+        {
+            g_mutex_lock (data->pdata.mutex);
+            data->set_statusmsg(data->pdata.msg);                       // update status bar with the latest message
+            g_mutex_unlock (data->pdata.mutex);
+        }
+
+    if ((!done && !data->stopped) || more)
         return TRUE;
 
     if (!data->dialog_destroyed)
@@ -516,12 +613,24 @@ static gboolean update_search_status_widgets (SearchData *data)
 
         gchar *msg = g_strdup_printf (fmt, matches);
 
+        if (data->index_built)
+        {
+            int minutes = MAX (time (NULL) - data->index_built, 0) / 60;
+            gchar *age = g_strdup_printf (ngettext("from the file name index of %d minute ago", "from the file name index of %d minutes ago", minutes), minutes);
+            gchar *full = data->index_changed ? g_strdup_printf ("%s (%s, %s)", msg, age, _("files have changed since")) :
+                                                g_strdup_printf ("%s (%s)", msg, age);
+            g_free (age);
+            g_free (msg);
+            msg = full;
+        }
+
         data->set_statusmsg(msg);
         g_free (msg);
 
         gtk_widget_hide (data->dialog->priv->pbar);
 
         gtk_dialog_set_response_sensitive (*data->dialog, GnomeCmdSearchDialog::GCMD_RESPONSE_GOTO, matches>0);
+        gtk_dialog_set_response_sensitive (*data->dialog, GnomeCmdSearchDialog::GCMD_RESPONSE_DUPLICATES, matches>1);
         gtk_dialog_set_response_sensitive (*data->dialog, GnomeCmdSearchDialog::GCMD_RESPONSE_STOP, FALSE);
         gtk_dialog_set_response_sensitive (*data->dialog, GnomeCmdSearchDialog::GCMD_RESPONSE_FIND, TRUE);
         gtk_dialog_set_default_response (*data->dialog, GnomeCmdSearchDialog::GCMD_RESPONSE_FIND);
@@ -550,9 +659,14 @@ static gboolean update_search_status_widgets (SearchData *data)
  */
 gboolean SearchData::join_thread_func (SearchData *data)
 {
+    if (data->engine)
+        data->engine->stop();
+
     if (data->thread)
         g_thread_join (data->thread);
 
+    data->free_search();
+
     if (data->pdata.mutex)
         g_mutex_clear (data->pdata.mutex);
 
@@ -560,16 +674,91 @@ gboolean SearchData::join_thread_func (SearchData *data)
 }
 
 
+/**
+ * Translates the size, date and attribute criteria of the profile for the search thread.
+ */
+gboolean SearchData::set_stat_filter()
+{
+    GnomeCmdData::SearchProfile &profile = dialog->defaults.default_profile;
+    const time_t DAY = 24 * 60 * 60;
+    time_t now = time (NULL);
+
+    stat_filter = GnomeCmd::StatFilter();
+
+    stat_filter.size_min = profile.size_min;
+    stat_filter.size_max = profile.size_max;
+
+    // modified at most n days ago means modified after now - n days
+    if (profile.mtime_max_age)
+        stat_filter.mtime_min = now - profile.mtime_max_age * DAY;
+    if (profile.mtime_min_age)
+        stat_filter.mtime_max = now - profile.mtime_min_age * DAY;
+    if (profile.atime_max_age)
+        stat_filter.atime_min = now - profile.atime_max_age * DAY;
+    if (profile.atime_min_age)
+        stat_filter.atime_max = now - profile.atime_min_age * DAY;
+
+    stat_filter.perm_mask = profile.perm_mask;
+    stat_filter.type = (GnomeCmd::StatFilter::Type) profile.file_type;
+
+    if (!profile.owner.empty())
+    {
+        struct passwd *pw = getpwnam (profile.owner.c_str());
+        gchar *end = NULL;
+        gulong uid = strtoul (profile.owner.c_str(), &end, 10);
+
+        if (pw)
+            stat_filter.uid = pw->pw_uid;
+        else
+            if (*end == '\0')
+                stat_filter.uid = uid;
+            else
+            {
+                gnome_cmd_show_message (*dialog, _("Unknown owner."), profile.owner.c_str());
+                return FALSE;
+            }
+    }
+
+    return TRUE;
+}
+
+
 gboolean SearchData::start_generic_search()
 {
+    if (!set_stat_filter())
+        return FALSE;
+
+    if (!dialog->defaults.default_profile.tag_criteria.empty())
+    {
+        gnome_cmd_show_message (*dialog, _("Tag criteria can only be searched on local file systems."));
+        return FALSE;
+    }
+
+    GnomeCmdData::SearchProfile &profile = dialog->defaults.default_profile;
+
+    // the ignore files of remote directories are not read, the globs apply
+    if (!profile.exclude_globs.empty())
+    {
+        ignore_rules = new GnomeCmd::IgnoreRules(profile.exclude_globs, false);
+        ignore_root = ignore_rules->enter_root(gnome_cmd_dir_get_path (start_dir)->get_path());
+    }
+
     // create an re for file name matching
     name_filter = new Filter(dialog->defaults.default_profile.filename_pattern.c_str(), dialog->defaults.default_profile.match_case, dialog->defaults.default_profile.syntax);
 
     // if we're going to search through file content create an re for that too
     if (dialog->defaults.default_profile.content_search)
     {
-        content_regex = g_new0 (regex_t, 1);
-        regcomp (content_regex, dialog->defaults.default_profile.text_pattern.c_str(), dialog->defaults.default_profile.match_case ? 0 : REG_ICASE);
+        content_matcher = new GnomeCmd::ContentMatcher(dialog->defaults.default_profile.text_pattern, dialog->defaults.default_profile.match_case);
+
+        if (!content_matcher->ok())
+        {
+            gnome_cmd_show_message (*dialog, _("Invalid content pattern."), dialog->defaults.default_profile.text_pattern.c_str());
+            free_search();
+            delete name_filter;
+            name_filter = NULL;
+            return FALSE;
+        }
     }
 
     if (!pdata.mutex)
@@ -582,259 +771,188 @@ gboolean SearchData::start_generic_search()
 
 
 /**
- * local search - using findutils
+ * local search - reading the directories in several threads
  */
-gchar *SearchData::build_search_command()
+static gpointer perform_local_search (SearchData *data)
 {
-    gchar *file_pattern_utf8 = g_strdup (dialog->defaults.default_profile.filename_pattern.c_str());
-    GError *error = NULL;
+    data->engine->run();
 
-    switch (dialog->defaults.default_profile.syntax)
-    {
-        case Filter::TYPE_FNMATCH:
-            if (!file_pattern_utf8 || !*file_pattern_utf8)
-            {
-                g_free (file_pattern_utf8);
-                file_pattern_utf8 = g_strdup ("*");
-            }
-            else
-                if (!g_utf8_strchr (file_pattern_utf8, -1, '*') && !g_utf8_strchr (file_pattern_utf8, -1, '?'))
-                {
-                    gchar *tmp = file_pattern_utf8;
-                    file_pattern_utf8 = g_strconcat ("*", file_pattern_utf8, "*", NULL);
-                    g_free (tmp);
-                }
-            break;
-
-        case Filter::TYPE_REGEX:
-            break;
-
-        default:
-            break;
-    }
+    // the tags read by this search are there for the next one, also after a restart
+    if (data->tag_query)
+        GnomeCmd::TagCache::get_default().save();
 
-    gchar *file_pattern_locale = g_locale_from_utf8 (file_pattern_utf8, -1, NULL, NULL, &error);
-
-    if (!file_pattern_locale)
-    {
-        gnome_cmd_error_message (file_pattern_utf8, error);
-        g_free (file_pattern_utf8);
-        return NULL;
-    }
-
-    gchar *file_pattern_quoted = quote_if_needed (file_pattern_locale);
-    gchar *look_in_folder_utf8 = GNOME_CMD_FILE (start_dir)->get_real_path();
-    gchar *look_in_folder_locale = g_locale_from_utf8 (look_in_folder_utf8, -1, NULL, NULL, NULL);
+    if (!data->index_root.empty() && !data->stopped)
+        GnomeCmd::NameIndexSet::get_default().refresh(data->index_root);
 
-    if (!look_in_folder_locale)     // if for some reason a path was not returned, fallback to the user's home directory
-        look_in_folder_locale = g_strconcat (g_get_home_dir (), G_DIR_SEPARATOR_S, NULL);
-
-    gchar *look_in_folder_quoted = quote_if_needed (look_in_folder_locale);
+    data->search_done = TRUE;
 
-    GString *command = g_string_sized_new (512);
+    return NULL;
+}
 
-    g_string_append (command, "find ");
-    g_string_append (command, look_in_folder_quoted);
 
-    if (dialog->defaults.default_profile.max_depth!=-1)
-        g_string_append_printf (command, " -maxdepth %i", dialog->defaults.default_profile.max_depth+1);
+gboolean SearchData::start_local_search()
+{
+    free_search();
 
-    switch (dialog->defaults.default_profile.syntax)
-    {
-        case Filter::TYPE_FNMATCH:
-            g_string_append_printf (command, " -iname '%s'", file_pattern_utf8);
-            break;
+    if (!set_stat_filter())
+        return FALSE;
 
-        case Filter::TYPE_REGEX:
-            g_string_append_printf (command, " -regextype posix-extended -iregex '.*/.*%s.*'", file_pattern_utf8);
-            break;
-        default:
-            ;
-    }
+    GnomeCmdData::SearchProfile &profile = dialog->defaults.default_profile;
+    string pattern = profile.filename_pattern;
 
-    if (dialog->defaults.default_profile.content_search)
+    // a shell pattern without wildcards matches a part of the name
+    if (profile.syntax == Filter::TYPE_FNMATCH)
     {
-        static const gchar GREP_COMMAND[] = "grep";
-
-        if (dialog->defaults.default_profile.match_case)
-            g_string_append_printf (command, " '!' -type p -exec %s -E -q '%s' {} \\;", GREP_COMMAND, dialog->defaults.default_profile.text_pattern.c_str());
+        if (pattern.empty())
+            pattern = "*";
         else
-            g_string_append_printf (command, " '!' -type p -exec %s -E -q -i '%s' {} \\;", GREP_COMMAND, dialog->defaults.default_profile.text_pattern.c_str());
+            if (pattern.find_first_of("*?") == string::npos)
+                pattern = '*' + pattern + '*';
     }
 
-    g_string_append (command, " -print");
+    GError *error = NULL;
+    gchar *pattern_locale = g_locale_from_utf8 (pattern.c_str(), -1, NULL, NULL, &error);
 
-    g_free (file_pattern_utf8);
-    g_free (file_pattern_locale);
-    g_free (file_pattern_quoted);
-    g_free (look_in_folder_utf8);
-    g_free (look_in_folder_locale);
-    g_free (look_in_folder_quoted);
+    if (!pattern_locale)
+    {
+        gnome_cmd_error_message (pattern.c_str(), error);
+        return FALSE;
+    }
 
-    return g_string_free (command, FALSE);
-}
+    name_matcher = new GnomeCmd::NameMatcher(pattern_locale, (GnomeCmd::NameMatcher::Syntax) profile.syntax, profile.match_case);
+    g_free (pattern_locale);
 
+    if (!name_matcher->ok())
+    {
+        gnome_cmd_show_message (*dialog, _("Invalid file name pattern."), pattern.c_str());
+        free_search();
+        return FALSE;
+    }
 
-static void child_command_set_pgid_cb (gpointer unused)
-{
-    if (setpgid (0, 0) < 0)
-        g_print (_("Failed to set process group id of child %d: %s.\n"), getpid (), g_strerror (errno));
-}
+    if (profile.content_search)
+    {
+        content_matcher = new GnomeCmd::ContentMatcher(profile.text_pattern, profile.match_case);
 
+        if (!content_matcher->ok())
+        {
+            gnome_cmd_show_message (*dialog, _("Invalid content pattern."), profile.text_pattern.c_str());
+            free_search();
+            return FALSE;
+        }
+    }
 
-static gboolean handle_search_command_stdout_io (GIOChannel *ioc, GIOCondition condition, SearchData *data)
-{
-    gboolean broken_pipe = FALSE;
+    if (!profile.exclude_globs.empty() || profile.use_ignore_files)
+        ignore_rules = new GnomeCmd::IgnoreRules(profile.exclude_globs, profile.use_ignore_files);
 
-    if (condition & G_IO_IN)
+    if (!profile.tag_criteria.empty())
     {
-        GError *error = NULL;
-
-        GString *string = g_string_new (NULL);
+        string error;
 
-        GTimer *timer = g_timer_new ();
-        g_timer_start (timer);
+        tag_query = new GnomeCmd::TagQuery(gcmd_tags_extract, &GnomeCmd::TagCache::get_default());
 
-        while (!ioc->is_readable);
-
-        do
+        if (!tag_query->parse(profile.tag_criteria, error))
         {
-            gint status;
-
-            if (data->stopped)
-            {
-                broken_pipe = TRUE;
-                break;
-            }
-
-            do
-            {
-                status = g_io_channel_read_line_string (ioc, string, NULL, &error);
-
-                if (status == G_IO_STATUS_EOF)
-                    broken_pipe = TRUE;
-                else
-                    if (status == G_IO_STATUS_AGAIN)
-                        while (gtk_events_pending ())
-                        {
-                            if (data->stopped)
-                                return FALSE;
-
-                            gtk_main_iteration ();
-                        }
-            }
-            while (status == G_IO_STATUS_AGAIN && !broken_pipe);
+            gnome_cmd_show_message (*dialog, _("Invalid tag criteria."), error.c_str());
+            free_search();
+            return FALSE;
+        }
+    }
 
-            if (broken_pipe)
-                break;
+    gchar *look_in_folder_utf8 = GNOME_CMD_FILE (start_dir)->get_real_path();
+    gchar *look_in_folder_locale = g_locale_from_utf8 (look_in_folder_utf8, -1, NULL, NULL, NULL);
 
-            if (status != G_IO_STATUS_NORMAL)
-            {
-                if (error)
-                {
-                    g_warning ("handle_search_command_stdout_io(): %s", error->message);
-                    g_error_free (error);
-                }
-                continue;
-            }
+    if (!look_in_folder_locale)     // if for some reason a path was not returned, fallback to the user's home directory
+        look_in_folder_locale = g_strdup (g_get_home_dir ());
 
-            string = g_string_truncate (string, string->len - 1);
+    GnomeCmd::SearchEngine::Options options;
 
-            if (string->len <= 1)
-                continue;
+    options.root = look_in_folder_locale;
+    options.max_depth = profile.max_depth;
+    options.filter = stat_filter;
+    options.archives = gnome_cmd_data.options.search_archives;
+    options.tags = tag_query;
+    options.ignore = ignore_rules;
 
-            gchar *utf8 = g_filename_display_name (string->str);
+    g_free (look_in_folder_utf8);
+    g_free (look_in_folder_locale);
 
-            GnomeCmdFile *f = gnome_cmd_file_new (utf8);
+    index_root.clear();
 
-            if (f)
-                data->dialog->priv->result_list->append_file(f);
+    if (gnome_cmd_data.options.search_index)
+    {
+        GnomeCmd::NameIndexSet &indexes = GnomeCmd::NameIndexSet::get_default();
 
-            g_free (utf8);
+        // a search by name is answered from the index, which is refreshed in the background if it is outdated
+        if (!profile.content_search && !stat_filter.active() && !tag_query && !ignore_rules)
+        {
+            bool changed = false;
+            auto index = indexes.find(options.root, &changed);
+            vector<GnomeCmd::NameIndex::Match> matches;
 
-            gulong duration;
+            if (index && index->search(options.root, profile.max_depth, *name_matcher, matches))
+            {
+                for (auto &m : matches)                                 // added to the list by the updates
+                    results.push_back({move (m.path), m.is_dir});
 
-            g_timer_elapsed (timer, &duration);
+                index_built = index->get_built();
+                index_changed = changed;
 
-            if (duration > GNOME_SEARCH_TOOL_REFRESH_DURATION)
-            {
-                while (gtk_events_pending ())
-                {
-                    if (data->stopped)
-                        return FALSE;
+                if (changed || time (NULL) - index_built > INDEX_MAX_AGE)
+                    indexes.refresh(options.root);
 
-                    gtk_main_iteration ();
-                }
+                search_done = TRUE;
 
-                g_timer_reset (timer);
+                return TRUE;
             }
         }
-        while (g_io_channel_get_buffer_condition (ioc) & G_IO_IN);
 
-        g_string_free (string, TRUE);
-        g_timer_destroy (timer);
+        index_root = options.root;
     }
 
-    if (!(condition & G_IO_IN) || broken_pipe)
-    {
-        g_io_channel_shutdown (ioc, TRUE, NULL);
-
-        data->search_done = TRUE;
-
-        return FALSE;
-    }
+    engine = new GnomeCmd::SearchEngine(options, *name_matcher, content_matcher);
+    thread = g_thread_new (NULL, (GThreadFunc) perform_local_search, this);
 
     return TRUE;
 }
 
 
-gboolean SearchData::start_local_search()
+/**
+ * Frees the matchers, the engine and the results not shown of the last search, its thread must have been joined.
+ */
+void SearchData::free_search()
 {
-    gchar *command = build_search_command();
-
-    g_return_val_if_fail (command!=NULL, FALSE);
-
-    DEBUG ('g', "running: %s\n", command);
-
-    GError *error = NULL;
-    gchar **argv  = NULL;
-    gint child_stdout;
-
-    if (!g_shell_parse_argv (command, NULL, &argv, &error))
-    {
-        gnome_cmd_error_message (_("Error parsing the search command."), error);
-
-        g_free (command);
-        g_strfreev (argv);
-
-        return FALSE;
-    }
-
-    g_free (command);
-
-    if (!g_spawn_async_with_pipes (NULL, argv, NULL, GSpawnFlags (G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL), child_command_set_pgid_cb, NULL, NULL, NULL, &child_stdout, NULL, &error))
-    {
-        gnome_cmd_error_message (_("Error running the search command."), error);
-
-        g_strfreev (argv);
-
-        return FALSE;
-    }
-
-#ifdef G_OS_WIN32
-    GIOChannel *ioc_stdout = g_io_channel_win32_new_fd (child_stdout);
-#else
-    GIOChannel *ioc_stdout = g_io_channel_unix_new (child_stdout);
-#endif
+    delete engine;
+    delete tag_query;
+    delete ignore_rules;
+    delete content_matcher;
+    delete name_matcher;
+
+    engine = NULL;
+    tag_query = NULL;
+    ignore_rules = NULL;
+    ignore_root.reset();
+    content_matcher = NULL;
+    name_matcher = NULL;
+
+    found.take(files);
+
+    for (; files_shown < files.size(); ++files_shown)
+        files[files_shown]->unref();
+
+    files.clear();
+    files_shown = 0;
+    results.clear();
+    results_shown = 0;
+    archives_shown.clear();
+}
 
-    g_io_channel_set_encoding (ioc_stdout, NULL, NULL);
-    g_io_channel_set_flags (ioc_stdout, G_IO_FLAG_NONBLOCK, NULL);
-    g_io_add_watch (ioc_stdout, GIOCondition (G_IO_IN | G_IO_HUP), (GIOFunc) handle_search_command_stdout_io, this);
 
-    g_io_channel_unref (ioc_stdout);
-    g_strfreev (argv);
+void SearchData::unref_match_dirs()
+{
+    for (auto dir : match_dirs)
+        gnome_cmd_dir_unref (dir);
 
-    return TRUE;
+    match_dirs.clear();
 }
 
 
@@ -891,6 +1009,10 @@ void GnomeCmdSearchDialog::Private::on_dialog_response(GtkDialog *window, int re
         case GCMD_RESPONSE_STOP:
             {
                 dialog->priv->data.stopped = TRUE;
+
+                if (dialog->priv->data.engine)
+                    dialog->priv->data.engine->stop();
+
                 gtk_dialog_set_response_sensitive (*dialog, GCMD_RESPONSE_STOP, FALSE);
                 gtk_dialog_set_default_response (*dialog, GCMD_RESPONSE_FIND);
             }
@@ -906,13 +1028,16 @@ void GnomeCmdSearchDialog::Private::on_dialog_response(GtkDialog *window, int re
                     data.thread = NULL;
                 }
 
+                data.free_search();
+
                 data.search_done = TRUE;
                 data.stopped = TRUE;
                 data.dialog_destroyed = FALSE;
+                data.index_built = 0;
+                data.index_changed = FALSE;
 
                 data.context_id = gtk_statusbar_get_context_id (GTK_STATUSBAR (dialog->priv->statusbar), "info");
-                data.content_regex = NULL;
-                data.match_dirs = NULL;
+                data.unref_match_dirs();
 
                 gchar *dir_str = gtk_file_chooser_get_uri (GTK_FILE_CHOOSER (dialog->priv->dir_browser));
                 GnomeVFSURI *uri = gnome_vfs_uri_new (dir_str);
@@ -976,6 +1101,7 @@ void GnomeCmdSearchDialog::Private::on_dialog_response(GtkDialog *window, int re
                     data.update_gui_timeout_id = g_timeout_add (gnome_cmd_data.gui_update_rate, (GSourceFunc) update_search_status_widgets, &data);
 
                     gtk_dialog_set_response_sensitive (*dialog, GCMD_RESPONSE_GOTO, FALSE);
+                    gtk_dialog_set_response_sensitive (*dialog, GCMD_RESPONSE_DUPLICATES, FALSE);
                     gtk_dialog_set_response_sensitive (*dialog, GCMD_RESPONSE_STOP, TRUE);
                     gtk_dialog_set_response_sensitive (*dialog, GCMD_RESPONSE_FIND, FALSE);
                     gtk_dialog_set_default_response (*dialog, GCMD_RESPONSE_STOP);
@@ -983,6 +1109,30 @@ void GnomeCmdSearchDialog::Private::on_dialog_response(GtkDialog *window, int re
             }
             break;
 
+        case GCMD_RESPONSE_DUPLICATES:
+            {
+                GList *files = dialog->priv->result_list->get_visible_files();
+                vector<string> paths;
+
+                for (GList *i = files; i; i = i->next)
+                {
+                    GnomeCmdFile *f = GNOME_CMD_FILE (i->data);
+
+                    if (f->is_local())
+                        paths.push_back(stringify (f->get_real_path()));
+                }
+
+                g_list_free (files);
+
+                if (paths.empty())
+                    gnome_cmd_show_message (*dialog, _("Operation not supported on remote file systems"));
+                else
+                    gnome_cmd_duplicates_dialog (*dialog, paths);
+
+                g_signal_stop_emission_by_name (dialog, "response");
+            }
+            break;
+
         case GCMD_RESPONSE_GOTO:
             {
                 GnomeCmdFile *f = dialog->priv->result_list->get_selected_file();
@@ -1102,12 +1252,7 @@ static void gnome_cmd_search_dialog_finalize (GObject *object)
     if (data.pdata.mutex)
     {
         g_mutex_lock (data.pdata.mutex);
-        if (data.match_dirs)
-        {
-            g_list_foreach (data.match_dirs, (GFunc) gnome_cmd_dir_unref, NULL);
-            g_list_free (data.match_dirs);
-            data.match_dirs = NULL;
-        }
+        data.unref_match_dirs();
         g_mutex_unlock (data.pdata.mutex);
     }
 
@@ -1150,12 +1295,14 @@ GnomeCmdSearchDialog::GnomeCmdSearchDialog(GnomeCmdData::SearchConfig &cfg): def
     gtk_dialog_add_buttons (*this,
                             GTK_STOCK_HELP, GTK_RESPONSE_HELP,
                             GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE,
+                            _("D_uplicates"), GCMD_RESPONSE_DUPLICATES,
                             GTK_STOCK_JUMP_TO, GCMD_RESPONSE_GOTO,
                             GTK_STOCK_STOP, GCMD_RESPONSE_STOP,
                             GTK_STOCK_FIND, GCMD_RESPONSE_FIND,
                             NULL);
 
     gtk_dialog_set_response_sensitive (*this, GCMD_RESPONSE_GOTO, FALSE);
+    gtk_dialog_set_response_sensitive (*this, GCMD_RESPONSE_DUPLICATES, FALSE);
     gtk_dialog_set_response_sensitive (*this, GCMD_RESPONSE_STOP, FALSE);
 
     gtk_dialog_set_default_response (*this, GCMD_RESPONSE_FIND);
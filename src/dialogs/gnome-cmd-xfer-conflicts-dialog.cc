@@ -0,0 +1,272 @@
+/**
+ * @file gnome-cmd-xfer-conflicts-dialog.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include "gnome-cmd-includes.h"
+#include "gnome-cmd-data.h"
+#include "gnome-cmd-treeview.h"
+#include "gnome-cmd-xfer-conflicts-dialog.h"
+#include "utils.h"
+
+using namespace std;
+using GnomeCmd::XferConflictRules;
+
+
+// same order as XferConflictRules::Policy
+static const gchar *policy_names[XferConflictRules::NUM_POLICIES] = {N_("Replace"),
+                                                                     N_("Skip"),
+                                                                     N_("Replace if newer"),
+                                                                     N_("Replace if larger"),
+                                                                     N_("Skip identical files"),
+                                                                     N_("Keep both, rename new file")};
+
+enum {COL_FILE, COL_EXISTING, COL_NEW, NUM_FILE_COLS};
+
+enum {COL_PATTERN, COL_POLICY_NAME, COL_POLICY, NUM_RULE_COLS};
+
+
+inline GtkWidget *create_policy_combo (XferConflictRules::Policy policy)
+{
+    GtkWidget *combo = gtk_combo_box_new_text ();
+
+    for (gint i=0; i<XferConflictRules::NUM_POLICIES; ++i)
+        gtk_combo_box_append_text (GTK_COMBO_BOX (combo), _(policy_names[i]));
+
+    gtk_combo_box_set_active (GTK_COMBO_BOX (combo), policy);
+
+    return combo;
+}
+
+
+inline gchar *file_details (guint64 size, time_t mtime)
+{
+    gchar *s = create_nice_size_str (size);
+    gchar *details = g_strdup_printf ("%s, %s", s, time2string (mtime, gnome_cmd_data.options.date_format));
+
+    g_free (s);
+
+    return details;
+}
+
+
+inline GtkWidget *create_scrolled_view (GtkTreeModel *model)
+{
+    GtkWidget *view = gtk_tree_view_new_with_model (model);
+
+    g_object_unref (model);          // destroy model automatically with view
+
+    g_object_set (view, "rules-hint", TRUE, NULL);
+
+    GtkWidget *scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+    gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scrolled_window), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gtk_scrolled_window_set_shadow_type (GTK_SCROLLED_WINDOW (scrolled_window), GTK_SHADOW_IN);
+    gtk_container_add (GTK_CONTAINER (scrolled_window), view);
+
+    return scrolled_window;
+}
+
+
+inline GtkWidget *create_file_list (const vector<GnomeCmd::XferConflict> &conflicts)
+{
+    GtkListStore *store = gtk_list_store_new (NUM_FILE_COLS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+
+    for (auto &c : conflicts)
+    {
+        GtkTreeIter iter;
+        gchar *fname = get_utf8 (c.dest.c_str());
+        gchar *existing = file_details (c.dest_size, c.dest_mtime);
+        gchar *new_file = file_details (c.src_size, c.src_mtime);
+
+        gtk_list_store_append (store, &iter);
+        gtk_list_store_set (store, &iter,
+                            COL_FILE, fname,
+                            COL_EXISTING, existing,
+                            COL_NEW, new_file,
+                            -1);
+        g_free (fname);
+        g_free (existing);
+        g_free (new_file);
+    }
+
+    GtkWidget *scrolled_window = create_scrolled_view (GTK_TREE_MODEL (store));
+    GtkTreeView *view = GTK_TREE_VIEW (gtk_bin_get_child (GTK_BIN (scrolled_window)));
+    GtkCellRenderer *renderer = NULL;
+
+    GtkTreeViewColumn *col = gnome_cmd_treeview_create_new_text_column (view, renderer, COL_FILE, _("File"));
+    gtk_tree_view_column_set_expand (col, TRUE);
+    g_object_set (renderer,
+                  "ellipsize-set", TRUE,
+                  "ellipsize", PANGO_ELLIPSIZE_START,
+                  NULL);
+
+    gnome_cmd_treeview_create_new_text_column (view, COL_EXISTING, _("Existing file"));
+    gnome_cmd_treeview_create_new_text_column (view, COL_NEW, _("New file"));
+
+    gtk_widget_set_size_request (scrolled_window, 560, 200);
+
+    return scrolled_window;
+}
+
+
+static void on_add_rule (GtkButton *button, GtkWidget *dialog)
+{
+    GtkEntry *entry = GTK_ENTRY (lookup_widget (dialog, "pattern"));
+    GtkWidget *combo = lookup_widget (dialog, "rule_policy");
+    GtkTreeView *view = GTK_TREE_VIEW (lookup_widget (dialog, "rules_view"));
+    const gchar *pattern = gtk_entry_get_text (entry);
+
+    if (!pattern || !*pattern)
+        return;
+
+    gint policy = gtk_combo_box_get_active (GTK_COMBO_BOX (combo));
+    GtkTreeIter iter;
+
+    gtk_list_store_append (GTK_LIST_STORE (gtk_tree_view_get_model (view)), &iter);
+    gtk_list_store_set (GTK_LIST_STORE (gtk_tree_view_get_model (view)), &iter,
+                        COL_PATTERN, pattern,
+                        COL_POLICY_NAME, _(policy_names[policy]),
+                        COL_POLICY, policy,
+                        -1);
+
+    gtk_entry_set_text (entry, "");
+}
+
+
+static void on_remove_rule (GtkButton *button, GtkWidget *dialog)
+{
+    GtkTreeView *view = GTK_TREE_VIEW (lookup_widget (dialog, "rules_view"));
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+
+    if (gtk_tree_selection_get_selected (gtk_tree_view_get_selection (view), &model, &iter))
+        gtk_list_store_remove (GTK_LIST_STORE (model), &iter);
+}
+
+
+gboolean gnome_cmd_xfer_conflicts_dialog (GtkWindow *parent, const vector<GnomeCmd::XferConflict> &conflicts, XferConflictRules &rules)
+{
+    GtkWidget *dialog = gtk_dialog_new_with_buttons (_("Files Already Exist"), parent,
+                                                     GtkDialogFlags (GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT),
+                                                     GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+                                                     _("C_ontinue"), GTK_RESPONSE_OK,
+                                                     NULL);
+
+    GtkWidget *content_area = gtk_dialog_get_content_area (GTK_DIALOG (dialog));
+
+    gtk_dialog_set_has_separator (GTK_DIALOG (dialog), FALSE);
+
+    // HIG defaults
+    gtk_container_set_border_width (GTK_CONTAINER (dialog), 5);
+    gtk_container_set_border_width (GTK_CONTAINER (content_area), 5);
+    gtk_box_set_spacing (GTK_BOX (content_area), 6);
+
+    GtkWidget *label, *hbox, *button;
+
+    gchar *msg = g_strdup_printf (ngettext("%u file already exists in the destination.",
+                                           "%u files already exist in the destination.",
+                                           conflicts.size()),
+                                  (guint) conflicts.size());
+    label = gtk_label_new (msg);
+    g_free (msg);
+    gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
+    gtk_box_pack_start (GTK_BOX (content_area), label, FALSE, FALSE, 0);
+
+    gtk_box_pack_start (GTK_BOX (content_area), create_file_list (conflicts), TRUE, TRUE, 0);
+
+    // rules for file name patterns, the first matching one is applied
+    label = gtk_label_new (_("Rules for file names, the first matching rule is applied:"));
+    gtk_misc_set_alignment (GTK_MISC (label), 0.0, 0.5);
+    gtk_box_pack_start (GTK_BOX (content_area), label, FALSE, FALSE, 0);
+
+    GtkListStore *store = gtk_list_store_new (NUM_RULE_COLS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT);
+    GtkWidget *scrolled_window = create_scrolled_view (GTK_TREE_MODEL (store));
+    GtkWidget *view = gtk_bin_get_child (GTK_BIN (scrolled_window));
+
+    gnome_cmd_treeview_create_new_text_column (GTK_TREE_VIEW (view), COL_PATTERN, _("Pattern"));
+    gnome_cmd_treeview_create_new_text_column (GTK_TREE_VIEW (view), COL_POLICY_NAME, _("Action"));
+    g_object_set_data (G_OBJECT (dialog), "rules_view", view);
+    gtk_widget_set_size_request (scrolled_window, -1, 90);
+    gtk_box_pack_start (GTK_BOX (content_area), scrolled_window, FALSE, FALSE, 0);
+
+    hbox = gtk_hbox_new (FALSE, 6);
+    gtk_box_pack_start (GTK_BOX (content_area), hbox, FALSE, FALSE, 0);
+
+    label = gtk_label_new_with_mnemonic (_("_Pattern:"));
+    gtk_box_pack_start (GTK_BOX (hbox), label, FALSE, FALSE, 0);
+
+    GtkWidget *entry = gtk_entry_new ();
+    gtk_widget_set_tooltip_text (entry, _("Shell pattern matched against the file name, e.g. *.jpg"));
+    gtk_label_set_mnemonic_widget (GTK_LABEL (label), entry);
+    g_object_set_data (G_OBJECT (dialog), "pattern", entry);
+    gtk_box_pack_start (GTK_BOX (hbox), entry, TRUE, TRUE, 0);
+
+    GtkWidget *combo = create_policy_combo (XferConflictRules::POLICY_REPLACE);
+    g_object_set_data (G_OBJECT (dialog), "rule_policy", combo);
+    gtk_box_pack_start (GTK_BOX (hbox), combo, FALSE, FALSE, 0);
+
+    button = gtk_button_new_from_stock (GTK_STOCK_ADD);
+    g_signal_connect (button, "clicked", G_CALLBACK (on_add_rule), dialog);
+    gtk_box_pack_start (GTK_BOX (hbox), button, FALSE, FALSE, 0);
+
+    button = gtk_button_new_from_stock (GTK_STOCK_REMOVE);
+    g_signal_connect (button, "clicked", G_CALLBACK (on_remove_rule), dialog);
+    gtk_box_pack_start (GTK_BOX (hbox), button, FALSE, FALSE, 0);
+
+    // what happens with all other files
+    hbox = gtk_hbox_new (FALSE, 6);
+    gtk_box_pack_start (GTK_BOX (content_area), hbox, FALSE, FALSE, 0);
+
+    label = gtk_label_new_with_mnemonic (_("_All other files:"));
+    gtk_box_pack_start (GTK_BOX (hbox), label, FALSE, FALSE, 0);
+
+    GtkWidget *default_combo = create_policy_combo (rules.default_policy);
+    gtk_label_set_mnemonic_widget (GTK_LABEL (label), default_combo);
+    gtk_box_pack_start (GTK_BOX (hbox), default_combo, FALSE, FALSE, 0);
+
+    gtk_widget_show_all (content_area);
+
+    gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_OK);
+
+    gint result = gtk_dialog_run (GTK_DIALOG (dialog));
+
+    if (result==GTK_RESPONSE_OK)
+    {
+        GtkTreeModel *model = GTK_TREE_MODEL (store);
+        GtkTreeIter iter;
+
+        rules.rules.clear();
+
+        for (gboolean valid = gtk_tree_model_get_iter_first (model, &iter); valid; valid = gtk_tree_model_iter_next (model, &iter))
+        {
+            gchar *pattern;
+            gint policy;
+
+            gtk_tree_model_get (model, &iter, COL_PATTERN, &pattern, COL_POLICY, &policy, -1);
+            rules.rules.push_back ({pattern, (XferConflictRules::Policy) policy});
+            g_free (pattern);
+        }
+
+        rules.default_policy = (XferConflictRules::Policy) gtk_combo_box_get_active (GTK_COMBO_BOX (default_combo));
+    }
+
+    gtk_widget_destroy (dialog);
+
+    return result==GTK_RESPONSE_OK;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file gnome-cmd-xfer-conflicts-dialog.h
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "gnome-cmd-xfer-conflicts.h"
+
+/**
+ * Lists all files which already exist in the destination of a transfer and
+ * lets the user set up the rules resolving these conflicts, once for the
+ * whole job.
+ *
+ * @returns FALSE if the transfer was cancelled
+ */
+gboolean gnome_cmd_xfer_conflicts_dialog (GtkWindow *parent, const std::vector<GnomeCmd::XferConflict> &conflicts, GnomeCmd::XferConflictRules &rules);
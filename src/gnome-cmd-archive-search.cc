@@ -0,0 +1,950 @@
+/**
+ * @file gnome-cmd-archive-search.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_BZIP2
+#include <bzlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "gnome-cmd-archive-search.h"
+
+using namespace std;
+
+
+namespace
+{
+    const size_t BLOCK = 512;                       // of tar
+    const size_t INPUT_SIZE = 64 * 1024;            // compressed data read at once
+    const size_t MAX_ZIP_DIRECTORY = 64 * 1024 * 1024;
+    const size_t MAX_NAME = 64 * 1024;              // long tar names
+
+
+    /**
+     * A stream of bytes: the file, a part of it or what a decoder makes of it.
+     */
+    struct Source
+    {
+        virtual ~Source()   {}
+
+        /**
+         * @returns the number of bytes read, 0 at the end and -1 on errors
+         */
+        virtual ssize_t read(char *buf, size_t len) = 0;
+    };
+
+
+    struct FdSource: Source
+    {
+        int fd;
+
+        explicit FdSource(int f): fd(f)     {}
+
+        ssize_t read(char *buf, size_t len) override
+        {
+            ssize_t n;
+
+            do
+                n = ::read (fd, buf, len);
+            while (n < 0 && errno == EINTR);
+
+            return n;
+        }
+    };
+
+
+    /**
+     * A part of a file, read with pread.
+     */
+    struct RangeSource: Source
+    {
+        int fd;
+        uint64_t offset;
+        uint64_t left;
+
+        RangeSource(int f, uint64_t o, uint64_t len): fd(f), offset(o), left(len)   {}
+
+        ssize_t read(char *buf, size_t len) override
+        {
+            len = min<uint64_t> (len, left);
+
+            if (!len)
+                return 0;
+
+            ssize_t n;
+
+            do
+                n = pread (fd, buf, len, offset);
+            while (n < 0 && errno == EINTR);
+
+            if (n > 0)
+            {
+                offset += n;
+                left -= n;
+            }
+
+            return n;
+        }
+    };
+
+
+    /**
+     * Reads ahead to tell the format, what was read is returned again.
+     */
+    struct PeekSource: Source
+    {
+        Source &src;
+        vector<char> head;
+        size_t pos {0};
+
+        explicit PeekSource(Source &s): src(s)      {}
+
+        const vector<char> &peek(size_t len)
+        {
+            while (head.size() < len)
+            {
+                size_t have = head.size();
+
+                head.resize(len);
+
+                ssize_t n = src.read(head.data() + have, len - have);
+
+                head.resize(have + max<ssize_t> (n, 0));
+
+                if (n <= 0)
+                    break;
+            }
+
+            return head;
+        }
+
+        ssize_t read(char *buf, size_t len) override
+        {
+            if (pos < head.size())
+            {
+                size_t n = min (len, head.size() - pos);
+
+                memcpy (buf, head.data() + pos, n);
+                pos += n;
+
+                return n;
+            }
+
+            return src.read(buf, len);
+        }
+    };
+
+
+    /**
+     * The next @a len bytes of a stream, a member of a tar archive.
+     */
+    struct LimitSource: Source
+    {
+        Source &src;
+        uint64_t left;
+
+        LimitSource(Source &s, uint64_t len): src(s), left(len)     {}
+
+        ssize_t read(char *buf, size_t len) override
+        {
+            len = min<uint64_t> (len, left);
+
+            if (!len)
+                return 0;
+
+            ssize_t n = src.read(buf, len);
+
+            if (n > 0)
+                left -= n;
+
+            return n;
+        }
+
+        /**
+         * Reads what the matcher has left, so that the stream is at the end of the member.
+         */
+        bool skip()
+        {
+            char buf[16 * 1024];
+
+            while (left)
+                if (read(buf, sizeof(buf)) <= 0)
+                    return false;
+
+            return true;
+        }
+    };
+
+
+    /**
+     * The compressed input of a decoder.
+     */
+    struct Decoder: Source
+    {
+        Source &src;
+        vector<char> in;
+        bool eof {false};
+        bool done {false};
+        bool failed {false};
+
+        explicit Decoder(Source &s): src(s), in(INPUT_SIZE)     {}
+
+        /**
+         * @returns the number of bytes read into in, 0 at the end
+         */
+        size_t fill()
+        {
+            if (eof)
+                return 0;
+
+            ssize_t n = src.read(in.data(), in.size());
+
+            if (n <= 0)
+            {
+                eof = true;
+                failed = n < 0;
+                return 0;
+            }
+
+            return n;
+        }
+    };
+
+
+#ifdef HAVE_ZLIB
+    /**
+     * gzip, with any number of members, or the raw deflate data of zip.
+     */
+    struct ZlibDecoder: Decoder
+    {
+        z_stream zs;
+        bool raw;
+        bool ok;
+
+        ZlibDecoder(Source &s, bool r): Decoder(s), raw(r)
+        {
+            memset (&zs, 0, sizeof(zs));
+            ok = inflateInit2 (&zs, raw ? -MAX_WBITS : MAX_WBITS + 16) == Z_OK;
+        }
+
+        ~ZlibDecoder()
+        {
+            if (ok)
+                inflateEnd (&zs);
+        }
+
+        ssize_t read(char *buf, size_t len) override
+        {
+            if (!ok || failed)
+                return -1;
+
+            zs.next_out = (Bytef *) buf;
+            zs.avail_out = len;
+
+            while (!done && zs.avail_out == len)
+            {
+                if (!zs.avail_in)
+                {
+                    zs.next_in = (Bytef *) in.data();
+                    zs.avail_in = fill();
+
+                    if (!zs.avail_in)
+                        return failed ? -1 : 0;         // truncated, what there was has been returned
+                }
+
+                int ret = inflate (&zs, Z_NO_FLUSH);
+
+                if (ret == Z_STREAM_END)
+                {
+                    // another gzip member may follow
+                    if (!raw && !zs.avail_in)
+                    {
+                        zs.next_in = (Bytef *) in.data();
+                        zs.avail_in = fill();
+                    }
+
+                    if (!raw && zs.avail_in)
+                        inflateReset (&zs);
+                    else
+                        done = true;
+                }
+                else
+                    if (ret != Z_OK)
+                        return -1;
+            }
+
+            return len - zs.avail_out;
+        }
+    };
+#endif
+
+
+#ifdef HAVE_BZIP2
+    struct Bzip2Decoder: Decoder
+    {
+        bz_stream bz;
+        bool ok;
+
+        explicit Bzip2Decoder(Source &s): Decoder(s)
+        {
+            memset (&bz, 0, sizeof(bz));
+            ok = BZ2_bzDecompressInit (&bz, 0, 0) == BZ_OK;
+        }
+
+        ~Bzip2Decoder()
+        {
+            if (ok)
+                BZ2_bzDecompressEnd (&bz);
+        }
+
+        ssize_t read(char *buf, size_t len) override
+        {
+            if (!ok || failed)
+                return -1;
+
+            bz.next_out = buf;
+            bz.avail_out = len;
+
+            while (!done && bz.avail_out == len)
+            {
+                if (!bz.avail_in)
+                {
+                    bz.next_in = in.data();
+                    bz.avail_in = fill();
+
+                    if (!bz.avail_in)
+                        return failed ? -1 : 0;
+                }
+
+                int ret = BZ2_bzDecompress (&bz);
+
+                if (ret == BZ_STREAM_END)
+                {
+                    // streams of parallel compressors follow each other
+                    if (!bz.avail_in)
+                    {
+                        bz.next_in = in.data();
+                        bz.avail_in = fill();
+                    }
+
+                    if (bz.avail_in)
+                    {
+                        char *next_in = bz.next_in;
+                        unsigned avail_in = bz.avail_in;
+
+                        BZ2_bzDecompressEnd (&bz);
+                        ok = BZ2_bzDecompressInit (&bz, 0, 0) == BZ_OK;
+
+                        if (!ok)
+                            return -1;
+
+                        bz.next_in = next_in;
+                        bz.avail_in = avail_in;
+                    }
+                    else
+                        done = true;
+                }
+                else
+                    if (ret != BZ_OK)
+                        return -1;
+            }
+
+            return len - bz.avail_out;
+        }
+    };
+#endif
+
+
+#ifdef HAVE_LZMA
+    struct XzDecoder: Decoder
+    {
+        lzma_stream xz;
+        bool ok;
+
+        explicit XzDecoder(Source &s): Decoder(s)
+        {
+            memset (&xz, 0, sizeof(xz));
+            ok = lzma_stream_decoder (&xz, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK;
+        }
+
+        ~XzDecoder()
+        {
+            lzma_end (&xz);
+        }
+
+        ssize_t read(char *buf, size_t len) override
+        {
+            if (!ok || failed)
+                return -1;
+
+            xz.next_out = (uint8_t *) buf;
+            xz.avail_out = len;
+
+            while (!done && xz.avail_out == len)
+            {
+                if (!xz.avail_in && !eof)
+                {
+                    xz.next_in = (const uint8_t *) in.data();
+                    xz.avail_in = fill();
+                }
+
+                lzma_ret ret = lzma_code (&xz, eof ? LZMA_FINISH : LZMA_RUN);
+
+                if (ret == LZMA_STREAM_END)
+                    done = true;
+                else
+                    if (ret != LZMA_OK || failed)
+                        return -1;
+                    else
+                        if (eof && xz.avail_out == len)
+                            return 0;                   // truncated
+            }
+
+            return len - xz.avail_out;
+        }
+    };
+#endif
+
+
+#ifdef HAVE_ZSTD
+    struct ZstdDecoder: Decoder
+    {
+        ZSTD_DStream *zs;
+        ZSTD_inBuffer input {nullptr, 0, 0};
+
+        explicit ZstdDecoder(Source &s): Decoder(s)
+        {
+            zs = ZSTD_createDStream ();
+
+            if (zs)
+                ZSTD_initDStream (zs);
+        }
+
+        ~ZstdDecoder()
+        {
+            ZSTD_freeDStream (zs);
+        }
+
+        ssize_t read(char *buf, size_t len) override
+        {
+            if (!zs || failed)
+                return -1;
+
+            ZSTD_outBuffer output {buf, len, 0};
+
+            while (output.pos == 0)
+            {
+                if (input.pos == input.size)
+                {
+                    input.src = in.data();
+                    input.size = fill();
+                    input.pos = 0;
+
+                    if (!input.size)
+                        return failed ? -1 : 0;     // frames follow each other until the end
+                }
+
+                size_t ret = ZSTD_decompressStream (zs, &output, &input);
+
+                if (ZSTD_isError (ret))
+                    return -1;
+            }
+
+            return output.pos;
+        }
+    };
+#endif
+
+
+    unique_ptr<Source> create_decoder(GnomeCmd::ArchiveSearch::Format format, Source &src)
+    {
+        switch (format)
+        {
+#ifdef HAVE_ZLIB
+            case GnomeCmd::ArchiveSearch::FORMAT_GZIP:
+                return unique_ptr<Source> (new ZlibDecoder(src, false));
+#endif
+#ifdef HAVE_BZIP2
+            case GnomeCmd::ArchiveSearch::FORMAT_BZIP2:
+                return unique_ptr<Source> (new Bzip2Decoder(src));
+#endif
+#ifdef HAVE_LZMA
+            case GnomeCmd::ArchiveSearch::FORMAT_XZ:
+                return unique_ptr<Source> (new XzDecoder(src));
+#endif
+#ifdef HAVE_ZSTD
+            case GnomeCmd::ArchiveSearch::FORMAT_ZSTD:
+                return unique_ptr<Source> (new ZstdDecoder(src));
+#endif
+            default:
+                return nullptr;
+        }
+    }
+
+
+    bool match(const GnomeCmd::ContentMatcher &matcher, Source &src)
+    {
+        return matcher.match_stream([&src] (char *buf, size_t len) { return src.read(buf, len); });
+    }
+
+
+    bool read_full(Source &src, char *buf, size_t len)
+    {
+        while (len)
+        {
+            ssize_t n = src.read(buf, len);
+
+            if (n <= 0)
+                return false;
+
+            buf += n;
+            len -= n;
+        }
+
+        return true;
+    }
+
+
+    inline uint16_t le16(const unsigned char *p)    {  return p[0] | p[1] << 8;  }
+    inline uint32_t le32(const unsigned char *p)    {  return le16(p) | (uint32_t) le16(p + 2) << 16;  }
+    inline uint64_t le64(const unsigned char *p)    {  return le32(p) | (uint64_t) le32(p + 4) << 32;  }
+
+
+    /**
+     * A number field of a tar header, octal or, for large values, base-256.
+     */
+    uint64_t tar_number(const char *field, size_t len)
+    {
+        uint64_t n = 0;
+
+        if (field[0] & 0x80)
+        {
+            for (size_t i=1; i<len; ++i)
+                n = n << 8 | (unsigned char) field[i];
+
+            return n;
+        }
+
+        for (size_t i=0; i<len && field[i]; ++i)
+            if (field[i] >= '0' && field[i] <= '7')
+                n = n * 8 + field[i] - '0';
+            else
+                if (field[i] != ' ')
+                    break;
+
+        return n;
+    }
+
+
+    bool tar_header_ok(const char *block)
+    {
+        if (memcmp (block + 257, "ustar", 5) != 0)
+            return false;
+
+        // the checksum is taken with its own field as blanks, some old tars summed signed bytes
+        uint64_t sum = 8 * ' ';
+        int64_t signed_sum = 8 * ' ';
+
+        for (size_t i=0; i<BLOCK; ++i)
+            if (i < 148 || i >= 156)
+            {
+                sum += (unsigned char) block[i];
+                signed_sum += (signed char) block[i];
+            }
+
+        uint64_t checksum = tar_number(block + 148, 8);
+
+        return checksum == sum || (int64_t) checksum == signed_sum;
+    }
+
+
+    string tar_field(const char *field, size_t len)
+    {
+        return string(field, strnlen (field, len));
+    }
+
+
+    /**
+     * @returns the value of the path record of a pax extended header, or an empty string
+     */
+    string pax_path(const string &records)
+    {
+        for (size_t pos=0; pos<records.size(); )
+        {
+            size_t len = strtoul (records.c_str() + pos, nullptr, 10);
+            size_t space = records.find(' ', pos);
+
+            if (!len || space == string::npos || pos + len > records.size())
+                break;
+
+            size_t key = space + 1;
+            size_t end = pos + len - 1;         // the newline
+
+            if (records.compare(key, 5, "path=") == 0 && end > key + 5)
+                return records.substr(key + 5, end - key - 5);
+
+            pos += len;
+        }
+
+        return string();
+    }
+
+
+    bool search_tar(const GnomeCmd::ContentMatcher &matcher, Source &src, const GnomeCmd::ArchiveSearch::FoundFunc &found, const atomic<bool> *stop)
+    {
+        char block[BLOCK];
+        string long_name;
+        bool matched = false;
+
+        while (!(stop && *stop) && read_full(src, block, BLOCK))
+        {
+            if (block[0] == '\0' || !tar_header_ok(block))
+                break;                                  // the end, or not a tar archive any more
+
+            uint64_t size = tar_number(block + 124, 12);
+            char type = block[156];
+            LimitSource data(src, size);
+
+            switch (type)
+            {
+                case 'L':                               // GNU long name of the next member
+                case 'x':                               // pax header of the next member
+                    if (size <= MAX_NAME)
+                    {
+                        string value(size, '\0');
+
+                        if (!read_full(data, &value[0], size))
+                            return matched;
+
+                        long_name = type == 'L' ? tar_field(value.data(), value.size()) : pax_path(value);
+                    }
+                    break;
+
+                case '0':
+                case '\0':
+                case '7':
+                    {
+                        string name = long_name;
+
+                        if (name.empty())
+                        {
+                            name = tar_field(block, 100);
+
+                            // POSIX splits long names, GNU uses these bytes otherwise
+                            if (memcmp (block + 257, "ustar\0", 6) == 0 && block[345])
+                                name = tar_field(block + 345, 155) + '/' + name;
+                        }
+
+                        if (match(matcher, data))
+                        {
+                            matched = true;
+                            found(name);
+                        }
+
+                        long_name.clear();
+                    }
+                    break;
+
+                default:
+                    long_name.clear();
+                    break;
+            }
+
+            if (!data.skip())
+                break;
+
+            // members are padded to whole blocks
+            size_t padding = (BLOCK - size % BLOCK) % BLOCK;
+
+            if (padding && !read_full(src, block, padding))
+                break;
+        }
+
+        return matched;
+    }
+
+
+    bool search_zip(const GnomeCmd::ContentMatcher &matcher, int fd, const GnomeCmd::ArchiveSearch::FoundFunc &found, const atomic<bool> *stop)
+    {
+        struct stat st;
+
+        if (fstat (fd, &st) != 0 || st.st_size < 22)
+            return false;
+
+        // the end of central directory record, followed by a comment of up to 64 KiB
+        size_t tail_size = min<uint64_t> (st.st_size, 22 + 65535 + 20);
+        vector<unsigned char> tail(tail_size);
+
+        if (pread (fd, tail.data(), tail_size, st.st_size - tail_size) != (ssize_t) tail_size)
+            return false;
+
+        ssize_t eocd = tail_size - 22;
+
+        while (eocd >= 0 && le32(&tail[eocd]) != 0x06054b50)
+            --eocd;
+
+        if (eocd < 0)
+            return false;
+
+        uint64_t entries = le16(&tail[eocd + 10]);
+        uint64_t dir_size = le32(&tail[eocd + 12]);
+        uint64_t dir_offset = le32(&tail[eocd + 16]);
+
+        // zip64: the locator right before points at a larger record
+        if (eocd >= 20 && le32(&tail[eocd - 20]) == 0x07064b50)
+        {
+            unsigned char rec[56];
+            uint64_t rec_offset = le64(&tail[eocd - 20 + 8]);
+
+            if (pread (fd, rec, sizeof(rec), rec_offset) != sizeof(rec) || le32(rec) != 0x06064b50)
+                return false;
+
+            entries = le64(rec + 32);
+            dir_size = le64(rec + 40);
+            dir_offset = le64(rec + 48);
+        }
+
+        if (dir_size > MAX_ZIP_DIRECTORY || dir_offset + dir_size > (uint64_t) st.st_size)
+            return false;
+
+        vector<unsigned char> dir(dir_size);
+
+        if (pread (fd, dir.data(), dir_size, dir_offset) != (ssize_t) dir_size)
+            return false;
+
+        bool matched = false;
+        size_t pos = 0;
+
+        for (uint64_t i=0; i<entries && pos + 46 <= dir_size && !(stop && *stop); ++i)
+        {
+            const unsigned char *e = &dir[pos];
+
+            if (le32(e) != 0x02014b50)
+                break;
+
+            uint16_t flags = le16(e + 8);
+            uint16_t method = le16(e + 10);
+            uint64_t compressed = le32(e + 20);
+            uint64_t size = le32(e + 24);
+            size_t name_len = le16(e + 28);
+            size_t extra_len = le16(e + 30);
+            size_t comment_len = le16(e + 32);
+            uint64_t offset = le32(e + 42);
+
+            if (pos + 46 + name_len + extra_len + comment_len > dir_size)
+                break;
+
+            string name((const char *) e + 46, name_len);
+
+            // zip64 sizes and offset, in this order and only those which did not fit
+            for (const unsigned char *x=e+46+name_len, *end=x+extra_len; x+4 <= end; x += 4 + le16(x + 2))
+                if (le16(x) == 0x0001)
+                {
+                    const unsigned char *v = x + 4;
+                    const unsigned char *v_end = min (v + le16(x + 2), end);
+
+                    if (size == 0xffffffff && v + 8 <= v_end)
+                        size = le64(v), v += 8;
+                    if (compressed == 0xffffffff && v + 8 <= v_end)
+                        compressed = le64(v), v += 8;
+                    if (offset == 0xffffffff && v + 8 <= v_end)
+                        offset = le64(v);
+                    break;
+                }
+
+            pos += 46 + name_len + extra_len + comment_len;
+
+            // directories, encrypted members and methods other than store and deflate are left out
+            if (name.empty() || name.back() == '/' || (flags & 1) || (method != 0 && method != 8))
+                continue;
+
+            unsigned char local[30];
+
+            if (pread (fd, local, sizeof(local), offset) != sizeof(local) || le32(local) != 0x04034b50)
+                continue;
+
+            uint64_t data_offset = offset + 30 + le16(local + 26) + le16(local + 28);
+            RangeSource data(fd, data_offset, compressed);
+            bool member_matched;
+
+            if (method == 0)
+                member_matched = match(matcher, data);
+            else
+            {
+#ifdef HAVE_ZLIB
+                ZlibDecoder inflater(data, true);
+                member_matched = match(matcher, inflater);
+#else
+                member_matched = false;
+#endif
+            }
+
+            if (member_matched)
+            {
+                matched = true;
+                found(name);
+            }
+        }
+
+        return matched;
+    }
+}
+
+
+GnomeCmd::ArchiveSearch::Format GnomeCmd::ArchiveSearch::detect(const char *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *) data;
+
+    if (len >= 2 && p[0] == 0x1f && p[1] == 0x8b)
+        return FORMAT_GZIP;
+
+    if (len >= 4 && memcmp (p, "BZh", 3) == 0 && p[3] >= '1' && p[3] <= '9')
+        return FORMAT_BZIP2;
+
+    if (len >= 6 && memcmp (p, "\xfd" "7zXZ\0", 6) == 0)
+        return FORMAT_XZ;
+
+    if (len >= 4 && memcmp (p, "\x28\xb5\x2f\xfd", 4) == 0)
+        return FORMAT_ZSTD;
+
+    if (len >= 4 && memcmp (p, "PK\3\4", 4) == 0)
+        return FORMAT_ZIP;
+
+    if (len >= BLOCK && tar_header_ok(data))
+        return FORMAT_TAR;
+
+    return FORMAT_PLAIN;
+}
+
+
+bool GnomeCmd::ArchiveSearch::supported(Format format)
+{
+    switch (format)
+    {
+        case FORMAT_GZIP:
+#ifdef HAVE_ZLIB
+            return true;
+#else
+            return false;
+#endif
+        case FORMAT_BZIP2:
+#ifdef HAVE_BZIP2
+            return true;
+#else
+            return false;
+#endif
+        case FORMAT_XZ:
+#ifdef HAVE_LZMA
+            return true;
+#else
+            return false;
+#endif
+        case FORMAT_ZSTD:
+#ifdef HAVE_ZSTD
+            return true;
+#else
+            return false;
+#endif
+        default:
+            return true;
+    }
+}
+
+
+bool GnomeCmd::ArchiveSearch::search(const ContentMatcher &matcher, int dir_fd, const char *name, const FoundFunc &found, const atomic<bool> *stop)
+{
+    if (!matcher.ok())
+        return false;
+
+    int fd = openat (dir_fd, name, O_RDONLY|O_NOFOLLOW|O_CLOEXEC|O_NOCTTY|O_NONBLOCK);
+
+    if (fd < 0)
+        return false;
+
+    posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    FdSource file(fd);
+    PeekSource head(file);
+    const vector<char> &start = head.peek(BLOCK);
+    Format format = detect(start.data(), start.size());
+    bool matched = false;
+
+    switch (format)
+    {
+        case FORMAT_ZIP:
+            matched = search_zip(matcher, fd, found, stop);
+            break;
+
+        case FORMAT_TAR:
+            matched = search_tar(matcher, head, found, stop);
+            break;
+
+        case FORMAT_PLAIN:
+            if (match(matcher, head))
+            {
+                matched = true;
+                found(string());
+            }
+            break;
+
+        default:
+            {
+                unique_ptr<Source> decoder = create_decoder(format, head);
+
+                // as it is, which skips it as binary, if it can't be decompressed here
+                Source &src = decoder ? *decoder : head;
+                PeekSource content(src);
+                const vector<char> &content_start = content.peek(BLOCK);
+
+                if (decoder && detect(content_start.data(), content_start.size()) == FORMAT_TAR)
+                    matched = search_tar(matcher, content, found, stop);
+                else
+                    if (match(matcher, content))
+                    {
+                        matched = true;
+                        found(string());
+                    }
+            }
+            break;
+    }
+
+    close (fd);
+
+    return matched;
+}
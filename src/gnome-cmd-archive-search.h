@@ -0,0 +1,88 @@
+/**
+ * @file gnome-cmd-archive-search.h
+ * @brief Content search in compressed files and in the members of archives.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+#include "gnome-cmd-content-matcher.h"
+
+namespace GnomeCmd
+{
+    /**
+     * Searches the content of a file which may be compressed with gzip,
+     * bzip2, xz or zstd, or be a zip or tar archive, compressed as a whole
+     * or not. The format is told by the magic bytes at the start, not by
+     * the name.
+     *
+     * Compressed data is decompressed while it is read and passed to the
+     * matcher chunk by chunk, nothing is written to disk. Every regular
+     * member of an archive is searched on its own. Archives in archives
+     * are not opened.
+     *
+     * Formats whose library was missing at build time are searched as
+     * they are, which skips them as binary.
+     */
+    class ArchiveSearch
+    {
+      public:
+
+        enum Format
+        {
+            FORMAT_PLAIN,
+            FORMAT_GZIP,
+            FORMAT_BZIP2,
+            FORMAT_XZ,
+            FORMAT_ZSTD,
+            FORMAT_ZIP,
+            FORMAT_TAR
+        };
+
+        /**
+         * Called with the name of every matching member, or an empty one
+         * if the file itself matches.
+         */
+        typedef std::function<void (const std::string &member)> FoundFunc;
+
+        /**
+         * @returns the format of the data starting with @a data, at least
+         * 512 bytes of it are needed to tell a tar archive
+         */
+        static Format detect(const char *data, size_t len);
+
+        /**
+         * @returns false if the library for @a format was not available at build time
+         */
+        static bool supported(Format format);
+
+        /**
+         * Searches the file @a name in the directory @a dir_fd, which may
+         * be AT_FDCWD for a path, until @a stop is set between members.
+         *
+         * @returns true if anything matched
+         */
+        static bool search(const ContentMatcher &matcher, int dir_fd, const char *name, const FoundFunc &found,
+                           const std::atomic<bool> *stop=nullptr);
+    };
+}
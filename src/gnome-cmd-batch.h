@@ -0,0 +1,72 @@
+/**
+ * @file gnome-cmd-batch.h
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include <vector>
+
+namespace GnomeCmd
+{
+    /**
+     * Files or URIs collected in a loop, e.g. the selection passed to a copy.
+     *
+     * g_list_append() walks the whole list for every item, which makes
+     * building a list of a large selection quadratic. A batch appends in
+     * constant time and is turned into a GList in one pass where an API
+     * needs one.
+     */
+    template <typename T>
+    struct Batch: std::vector<T>
+    {
+    };
+
+    template <typename T>
+    struct Batch<T *>: std::vector<T *>
+    {
+        Batch()                   {}
+        explicit Batch(GList *list);
+
+        void add(T *t)            {  this->push_back(t);  }
+
+        GList *get_list() const;
+    };
+
+    template <typename T>
+    inline Batch<T *>::Batch(GList *list)
+    {
+        for (; list; list=list->next)
+            this->push_back(static_cast<T *> (list->data));
+    }
+
+    /**
+     * @returns a new list of the items in their order, to be freed with g_list_free()
+     */
+    template <typename T>
+    inline GList *Batch<T *>::get_list() const
+    {
+        GList *list = NULL;
+
+        for (typename Batch::const_reverse_iterator i=Batch::rbegin(); i!=Batch::rend(); ++i)
+            list = g_list_prepend (list, *i);
+
+        return list;
+    }
+}
@@ -0,0 +1,555 @@
+/**
+ * @file gnome-cmd-content-matcher.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define GCMD_HAVE_AVX2
+#endif
+
+#include <algorithm>
+
+#include "gnome-cmd-content-matcher.h"
+
+using namespace std;
+
+
+GnomeCmd::ContentMatcher::ContentMatcher(const string &pattern, bool match_case, bool skip_bin): icase(!match_case), skip_binary(skip_bin)
+{
+    valid = regcomp (&re, pattern.c_str(), REG_EXTENDED|REG_NOSUB|REG_NEWLINE|(match_case ? 0 : REG_ICASE)) == 0;
+
+    if (!valid)
+        return;
+
+    literals = required_literals(pattern);
+
+    for (auto &l : literals)
+    {
+        // the case of multibyte characters is left to the regex
+        if (icase && find_if (l.begin(), l.end(), [] (char c) { return c & 0x80; }) != l.end())
+        {
+            literals.clear();
+            break;
+        }
+
+        if (icase)
+            transform (l.begin(), l.end(), l.begin(), [] (char c) { return (char) tolower ((unsigned char) c); });
+    }
+}
+
+
+GnomeCmd::ContentMatcher::~ContentMatcher()
+{
+    if (valid)
+        regfree (&re);
+}
+
+
+/**
+ * @returns the index after the bracket expression starting at @a i
+ */
+static size_t skip_bracket(const string &p, size_t i)
+{
+    size_t j = i + 1;
+
+    if (j < p.size() && p[j] == '^')
+        ++j;
+    if (j < p.size() && p[j] == ']')
+        ++j;
+
+    while (j < p.size() && p[j] != ']')
+        if (p[j] == '[' && j + 1 < p.size() && strchr (":.=", p[j+1]))
+        {
+            size_t end = p.find(string(1, p[j+1]) + ']', j + 2);
+
+            if (end == string::npos)
+                return p.size();
+
+            j = end + 2;
+        }
+        else
+            ++j;
+
+    return min (j + 1, p.size());
+}
+
+
+/**
+ * @returns the index after the group starting at @a i
+ */
+static size_t skip_group(const string &p, size_t i)
+{
+    int depth = 0;
+
+    for (size_t j=i; j<p.size(); )
+        switch (p[j])
+        {
+            case '\\':
+                j += 2;
+                break;
+
+            case '[':
+                j = skip_bracket(p, j);
+                break;
+
+            case '(':
+                ++depth, ++j;
+                break;
+
+            case ')':
+                if (--depth == 0)
+                    return j + 1;
+                ++j;
+                break;
+
+            default:
+                ++j;
+        }
+
+    return p.size();
+}
+
+
+vector<string> GnomeCmd::ContentMatcher::required_literals(const string &p)
+{
+    vector<string> result;
+    string best, run;
+
+    auto end_run = [&] ()
+    {
+        if (run.size() > best.size())
+            best = run;
+        run.clear();
+    };
+
+    // every branch needs a literal, otherwise a match may have none
+    auto end_branch = [&] () -> bool
+    {
+        end_run();
+
+        if (best.empty())
+            return false;
+
+        result.push_back(best);
+        best.clear();
+
+        return true;
+    };
+
+    for (size_t i=0; i<p.size(); )
+    {
+        string atom;                        // a literal character, may be multibyte
+        size_t next;
+
+        switch (p[i])
+        {
+            case '|':
+                if (!end_branch())
+                    return {};
+                ++i;
+                continue;
+
+            case '(':
+                next = skip_group(p, i);
+                break;
+
+            case '[':
+                next = skip_bracket(p, i);
+                break;
+
+            case '\\':
+                // \w, \b, \1 and the like are no literals
+                if (i + 1 >= p.size())
+                    return {};
+                if (!isalnum ((unsigned char) p[i+1]))
+                    atom = p[i+1];
+                next = i + 2;
+                break;
+
+            case '.':
+            case '^':
+            case '$':
+                next = i + 1;
+                break;
+
+            case '*':
+            case '+':
+            case '?':
+            case '{':
+            case ')':
+                return {};
+
+            default:
+                next = i + 1;
+                if ((unsigned char) p[i] >= 0xC0)
+                    while (next < p.size() && ((unsigned char) p[next] & 0xC0) == 0x80)
+                        ++next;
+                atom = p.substr(i, next - i);
+        }
+
+        // an atom which may be missing ends the literal before it, a repeated one the literal with it
+        char q = next < p.size() ? p[next] : '\0';
+        bool optional = q == '*' || q == '?' || (q == '{' && atoi (p.c_str() + next + 1) == 0);
+        bool repeated = optional || q == '+' || q == '{';
+
+        if (!atom.empty() && !optional)
+            run += atom;
+
+        if (atom.empty() || repeated)
+            end_run();
+
+        for (i=next; i<p.size(); )
+            if (p[i] == '*' || p[i] == '+' || p[i] == '?')
+                ++i;
+            else
+                if (p[i] == '{')
+                {
+                    size_t end = p.find('}', i);
+
+                    if (end == string::npos)
+                        return {};
+
+                    i = end + 1;
+                }
+                else
+                    break;
+    }
+
+    if (!end_branch())
+        return {};
+
+    return result;
+}
+
+
+inline bool equal_at(const char *data, const string &literal, bool icase)
+{
+    if (!icase)
+        return memcmp (data, literal.data(), literal.size()) == 0;
+
+    for (size_t i=0; i<literal.size(); ++i)
+        if ((data[i] >= 'A' && data[i] <= 'Z' ? data[i] | 0x20 : data[i]) != literal[i])
+            return false;
+
+    return true;
+}
+
+
+static size_t find_literal_scalar(const char *data, size_t len, const string &literal, bool icase)
+{
+    size_t m = literal.size();
+
+    if (!icase)
+    {
+        const void *found = memmem (data, len, literal.data(), m);
+        return found ? (const char *) found - data : len;
+    }
+
+    for (size_t i=0; i+m<=len; ++i)
+        if (equal_at(data + i, literal, true))
+            return i;
+
+    return len;
+}
+
+
+/**
+ * The first and the last byte of the literal are compared with a block of
+ * positions at once, only the positions where both are equal are compared
+ * in full. For icase a lower case letter is compared with the byte ORed
+ * with 0x20, which is the same letter in either case.
+ */
+#if defined(__SSE2__)
+static size_t find_literal_sse2(const char *data, size_t len, const string &literal, bool icase)
+{
+    size_t m = literal.size();
+    char first = literal[0];
+    char last = literal[m-1];
+
+    const __m128i first_v = _mm_set1_epi8 (first);
+    const __m128i last_v = _mm_set1_epi8 (last);
+    const __m128i first_fold = _mm_set1_epi8 (icase && islower ((unsigned char) first) ? 0x20 : 0);
+    const __m128i last_fold = _mm_set1_epi8 (icase && islower ((unsigned char) last) ? 0x20 : 0);
+
+    size_t i = 0;
+
+    for (; i + m - 1 + 16 <= len; i += 16)
+    {
+        __m128i f = _mm_loadu_si128 ((const __m128i *) (data + i));
+        __m128i l = _mm_loadu_si128 ((const __m128i *) (data + i + m - 1));
+        __m128i eq = _mm_and_si128 (_mm_cmpeq_epi8 (_mm_or_si128 (f, first_fold), first_v),
+                                    _mm_cmpeq_epi8 (_mm_or_si128 (l, last_fold), last_v));
+
+        for (unsigned mask = _mm_movemask_epi8 (eq); mask; mask &= mask - 1)
+        {
+            size_t pos = i + __builtin_ctz (mask);
+
+            if (equal_at(data + pos, literal, icase))
+                return pos;
+        }
+    }
+
+    return i + find_literal_scalar(data + i, len - i, literal, icase);
+}
+#endif
+
+
+#if defined(GCMD_HAVE_AVX2)
+__attribute__((target("avx2")))
+static size_t find_literal_avx2(const char *data, size_t len, const string &literal, bool icase)
+{
+    size_t m = literal.size();
+    char first = literal[0];
+    char last = literal[m-1];
+
+    const __m256i first_v = _mm256_set1_epi8 (first);
+    const __m256i last_v = _mm256_set1_epi8 (last);
+    const __m256i first_fold = _mm256_set1_epi8 (icase && islower ((unsigned char) first) ? 0x20 : 0);
+    const __m256i last_fold = _mm256_set1_epi8 (icase && islower ((unsigned char) last) ? 0x20 : 0);
+
+    size_t i = 0;
+
+    for (; i + m - 1 + 32 <= len; i += 32)
+    {
+        __m256i f = _mm256_loadu_si256 ((const __m256i *) (data + i));
+        __m256i l = _mm256_loadu_si256 ((const __m256i *) (data + i + m - 1));
+        __m256i eq = _mm256_and_si256 (_mm256_cmpeq_epi8 (_mm256_or_si256 (f, first_fold), first_v),
+                                       _mm256_cmpeq_epi8 (_mm256_or_si256 (l, last_fold), last_v));
+
+        for (unsigned mask = _mm256_movemask_epi8 (eq); mask; mask &= mask - 1)
+        {
+            size_t pos = i + __builtin_ctz (mask);
+
+            if (equal_at(data + pos, literal, icase))
+                return pos;
+        }
+    }
+
+    return i + find_literal_scalar(data + i, len - i, literal, icase);
+}
+#endif
+
+
+size_t GnomeCmd::ContentMatcher::find_literal(const char *data, size_t len, const string &literal, bool icase)
+{
+    if (literal.empty())
+        return 0;
+
+    if (literal.size() > len)
+        return len;
+
+#if defined(GCMD_HAVE_AVX2)
+    static const bool avx2 = __builtin_cpu_supports ("avx2");
+
+    if (avx2)
+        return find_literal_avx2(data, len, literal, icase);
+#endif
+#if defined(__SSE2__)
+    return find_literal_sse2(data, len, literal, icase);
+#else
+    return find_literal_scalar(data, len, literal, icase);
+#endif
+}
+
+
+bool GnomeCmd::ContentMatcher::match_regex(const char *data, size_t len) const
+{
+#ifdef REG_STARTEND
+    regmatch_t range;
+
+    range.rm_so = 0;
+    range.rm_eo = len;
+
+    return regexec (&re, data, 1, &range, REG_STARTEND) == 0;
+#else
+    // without REG_STARTEND every line has to be terminated, and a NUL ends it early
+    string line;
+
+    for (const char *end = data + len; data < end; )
+    {
+        const char *nl = (const char *) memchr (data, '\n', end - data);
+
+        line.assign(data, nl ? nl : end);
+
+        if (regexec (&re, line.c_str(), 0, nullptr, 0) == 0)
+            return true;
+
+        data = nl ? nl + 1 : end;
+    }
+
+    return false;
+#endif
+}
+
+
+bool GnomeCmd::ContentMatcher::match_lines(const char *data, size_t len) const
+{
+    if (!valid)
+        return false;
+
+    if (literals.empty())
+        return match_regex(data, len);
+
+    // the next occurrence of each literal, searched again when passed
+    vector<size_t> next(literals.size(), SIZE_MAX);
+
+    for (size_t pos=0; pos<len; )
+    {
+        size_t candidate = len;
+
+        for (size_t i=0; i<literals.size(); ++i)
+        {
+            if (next[i] == SIZE_MAX || next[i] < pos)
+                next[i] = pos + find_literal(data + pos, len - pos, literals[i], icase);
+
+            candidate = min (candidate, next[i]);
+        }
+
+        if (candidate >= len)
+            return false;
+
+        // pos is always at the start of a line
+        const char *nl = (const char *) memrchr (data + pos, '\n', candidate - pos);
+        size_t start = nl ? nl - data + 1 : pos;
+
+        nl = (const char *) memchr (data + candidate, '\n', len - candidate);
+        size_t end = nl ? nl - data : len;
+
+        if (match_regex(data + start, end - start))
+            return true;
+
+        pos = end + 1;
+    }
+
+    return false;
+}
+
+
+bool GnomeCmd::ContentMatcher::match_stream(const ReadFunc &read) const
+{
+    if (!valid)
+        return false;
+
+    // reused by the files searched in a thread, small files need no allocation then
+    static thread_local vector<char> buf;
+
+    if (buf.size() < CHUNK_SIZE)
+        buf.resize(CHUNK_SIZE);
+
+    size_t filled = 0;
+    uint64_t offset = 0;
+    bool found = false;
+
+    for (;;)
+    {
+        ssize_t n = read (buf.data() + filled, buf.size() - filled);
+
+        if (n <= 0)
+        {
+            // the last line, without a line break
+            found = n == 0 && filled && match_lines(buf.data(), filled);
+            break;
+        }
+
+        if (skip_binary && offset < BINARY_PROBE &&
+            memchr (buf.data() + filled, '\0', min<uint64_t> (n, BINARY_PROBE - offset)))
+            break;
+
+        filled += n;
+        offset += n;
+
+        // only complete lines are matched, the rest is kept for the next read
+        const char *nl = (const char *) memrchr (buf.data(), '\n', filled);
+
+        if (!nl)
+        {
+            if (filled < buf.size())
+                continue;
+
+            if (buf.size() < MAX_LINE)
+            {
+                buf.resize(buf.size() * 2);
+                continue;
+            }
+
+            nl = buf.data() + filled - 1;
+        }
+
+        size_t lines = nl - buf.data() + 1;
+
+        if (match_lines(buf.data(), lines))
+        {
+            found = true;
+            break;
+        }
+
+        memmove (buf.data(), buf.data() + lines, filled - lines);
+        filled -= lines;
+    }
+
+    // a very long line does not keep its buffer
+    if (buf.size() > CHUNK_SIZE)
+    {
+        buf.resize(CHUNK_SIZE);
+        buf.shrink_to_fit();
+    }
+
+    return found;
+}
+
+
+bool GnomeCmd::ContentMatcher::match_file(int dir_fd, const char *name) const
+{
+    if (!valid)
+        return false;
+
+    int fd = openat (dir_fd, name, O_RDONLY|O_NOFOLLOW|O_CLOEXEC|O_NOCTTY|O_NONBLOCK);
+
+    if (fd < 0)
+        return false;
+
+    posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    bool found = match_stream([fd] (char *buf, size_t len) -> ssize_t
+                              {
+                                  ssize_t n;
+
+                                  do
+                                      n = ::read (fd, buf, len);
+                                  while (n < 0 && errno == EINTR);
+
+                                  return n;
+                              });
+
+    close (fd);
+
+    return found;
+}
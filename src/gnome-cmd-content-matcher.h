@@ -0,0 +1,113 @@
+/**
+ * @file gnome-cmd-content-matcher.h
+ * @brief Searching the content of local files for a regular expression.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <regex.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace GnomeCmd
+{
+    /**
+     * Matches the content of files line by line against an extended regular
+     * expression, like grep -E. Files are read in chunks which end at a line
+     * break, so that no line is split and nothing is scanned twice.
+     *
+     * The literals which every match has to contain are taken from the
+     * pattern. A chunk is searched for them first, with SSE2 or AVX2 where
+     * available, and the regular expression only runs on the lines where
+     * one has been found. Files with a NUL byte near their start are
+     * skipped as binary.
+     *
+     * One matcher is shared by all search threads, it is not changed after
+     * it has been compiled.
+     */
+    class ContentMatcher
+    {
+        regex_t re;
+        bool valid {false};
+        bool icase;
+        bool skip_binary;
+        std::vector<std::string> literals;  /**< one of them is in every match, lower case for icase */
+
+        bool match_regex(const char *data, size_t len) const;
+
+      public:
+
+        enum
+        {
+            CHUNK_SIZE = 256 * 1024,        /**< read at once, grown for longer lines */
+            MAX_LINE = 16 * 1024 * 1024,    /**< longer lines are split */
+            BINARY_PROBE = 32 * 1024        /**< bytes looked at for a NUL */
+        };
+
+        /**
+         * Reads up to @a len bytes into @a buf.
+         *
+         * @returns the number of bytes read, 0 at the end and -1 on errors
+         */
+        typedef std::function<ssize_t (char *buf, size_t len)> ReadFunc;
+
+        ContentMatcher(const std::string &pattern, bool match_case, bool skip_binary=true);
+        ~ContentMatcher();
+
+        ContentMatcher(const ContentMatcher &) = delete;
+        ContentMatcher &operator = (const ContentMatcher &) = delete;
+
+        bool ok() const                     {  return valid;  }
+
+        /**
+         * Matches whole lines in @a data, which may contain NUL bytes.
+         */
+        bool match_lines(const char *data, size_t len) const;
+
+        /**
+         * Matches the data returned by @a read until it ends or fails.
+         */
+        bool match_stream(const ReadFunc &read) const;
+
+        /**
+         * Reads the file @a name in the directory @a dir_fd, which may be
+         * AT_FDCWD for a path.
+         *
+         * @returns false if it does not match or can't be read
+         */
+        bool match_file(int dir_fd, const char *name) const;
+
+        /**
+         * @returns literals of which every match of the extended regular
+         * expression @a pattern contains one, or nothing if that can't be
+         * told
+         */
+        static std::vector<std::string> required_literals(const std::string &pattern);
+
+        /**
+         * @returns the offset of the first occurrence of @a literal in
+         * @a data, or @a len. For @a icase the literal has to be in lower
+         * case, only ASCII letters are folded.
+         */
+        static size_t find_literal(const char *data, size_t len, const std::string &literal, bool icase);
+    };
+}
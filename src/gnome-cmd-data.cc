@@ -1400,6 +1400,16 @@ GnomeCmdData::Options::Options(const Options &cfg)
     save_dir_history_on_exit = cfg.save_dir_history_on_exit;
     save_cmdline_history_on_exit = cfg.save_cmdline_history_on_exit;
     save_search_history_on_exit = cfg.save_search_history_on_exit;
+    search_index = cfg.search_index;
+    search_archives = cfg.search_archives;
+    sparse_copy = cfg.sparse_copy;
+    use_io_uring = cfg.use_io_uring;
+    io_uring_queue_depth = cfg.io_uring_queue_depth;
+    bulk_copy_threshold = cfg.bulk_copy_threshold;
+    delete_to_trash = cfg.delete_to_trash;
+    tar_upload = cfg.tar_upload;
+    download_segments = cfg.download_segments;
+    download_min_segment_size = cfg.download_min_segment_size;
     symlink_prefix = g_strdup (cfg.symlink_prefix);
     main_win_pos[0] = cfg.main_win_pos[0];
     main_win_pos[1] = cfg.main_win_pos[1];
@@ -1463,6 +1473,16 @@ GnomeCmdData::Options &GnomeCmdData::Options::operator = (const Options &cfg)
         save_dir_history_on_exit = cfg.save_dir_history_on_exit;
         save_cmdline_history_on_exit = cfg.save_cmdline_history_on_exit;
         save_search_history_on_exit = cfg.save_search_history_on_exit;
+        search_index = cfg.search_index;
+        search_archives = cfg.search_archives;
+        sparse_copy = cfg.sparse_copy;
+        use_io_uring = cfg.use_io_uring;
+        io_uring_queue_depth = cfg.io_uring_queue_depth;
+        bulk_copy_threshold = cfg.bulk_copy_threshold;
+        delete_to_trash = cfg.delete_to_trash;
+        tar_upload = cfg.tar_upload;
+        download_segments = cfg.download_segments;
+        download_min_segment_size = cfg.download_min_segment_size;
         symlink_prefix = g_strdup (cfg.symlink_prefix);
         main_win_pos[0] = cfg.main_win_pos[0];
         main_win_pos[1] = cfg.main_win_pos[1];
@@ -1539,6 +1559,21 @@ void GnomeCmdData::SearchProfile::reset()
     text_pattern.clear();
     content_search = FALSE;
     match_case = FALSE;
+    size_min = size_max = 0;
+    mtime_min_age = mtime_max_age = 0;
+    atime_min_age = atime_max_age = 0;
+    owner.clear();
+    perm_mask = 0;
+    file_type = 0;
+    tag_criteria.clear();
+    exclude_globs.clear();
+    use_ignore_files = FALSE;
+}
+
+
+gboolean GnomeCmdData::SearchProfile::has_attribute_criteria() const
+{
+    return size_min || size_max || mtime_min_age || mtime_max_age || atime_min_age || atime_max_age || !owner.empty() || perm_mask || file_type || !tag_criteria.empty() || !exclude_globs.empty() || use_ignore_files;
 }
 
 
@@ -1655,7 +1690,19 @@ void GnomeCmdData::add_search_profile_to_gvariant_builder(GVariantBuilder *build
         searchProfile.filename_pattern.c_str(),
         searchProfile.content_search,
         searchProfile.match_case,
-        searchProfile.text_pattern.c_str()
+        searchProfile.text_pattern.c_str(),
+        searchProfile.size_min,
+        searchProfile.size_max,
+        searchProfile.mtime_min_age,
+        searchProfile.mtime_max_age,
+        searchProfile.atime_min_age,
+        searchProfile.atime_max_age,
+        searchProfile.owner.c_str(),
+        searchProfile.perm_mask,
+        searchProfile.file_type,
+        searchProfile.tag_criteria.c_str(),
+        searchProfile.exclude_globs.c_str(),
+        searchProfile.use_ignore_files
     );
 }
 
@@ -2366,6 +2413,15 @@ void GnomeCmdData::load_advrename_profiles ()
  */
 void GnomeCmdData::load_search_profiles ()
 {
+    // the profiles have not been saved since the upgrade, take them from the old key
+    if (GVariant *userValue = g_settings_get_user_value (options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_PROFILES))
+        g_variant_unref (userValue);
+    else
+    {
+        load_search_profiles_v1 ();
+        return;
+    }
+
     auto *gVariantProfiles = g_settings_get_value (options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_PROFILES);
 
     g_autoptr(GVariantIter) iter1 {nullptr};
@@ -2380,6 +2436,18 @@ void GnomeCmdData::load_search_profiles ()
     guint profileNumber {0};
     gboolean contentSearch {false};
     gboolean matchCase {false};
+    guint64 sizeMin {0};
+    guint64 sizeMax {0};
+    guint mtimeMinAge {0};
+    guint mtimeMaxAge {0};
+    guint atimeMinAge {0};
+    guint atimeMaxAge {0};
+    gchar *owner {nullptr};
+    guint permMask {0};
+    gint fileType {0};
+    gchar *tagCriteria {nullptr};
+    gchar *excludeGlobs {nullptr};
+    gboolean useIgnoreFiles {false};
 
     while (g_variant_iter_loop (iter1,
             GCMD_SETTINGS_SEARCH_PROFILE_FORMAT_STRING,
@@ -2389,6 +2457,84 @@ void GnomeCmdData::load_search_profiles ()
             &filenamePattern,
             &contentSearch,
             &matchCase,
+            &textPattern,
+            &sizeMin,
+            &sizeMax,
+            &mtimeMinAge,
+            &mtimeMaxAge,
+            &atimeMinAge,
+            &atimeMaxAge,
+            &owner,
+            &permMask,
+            &fileType,
+            &tagCriteria,
+            &excludeGlobs,
+            &useIgnoreFiles))
+    {
+        SearchProfile searchProfile;
+
+        searchProfile.name             = name;
+        searchProfile.max_depth        = maxDepth;
+        searchProfile.syntax           = syntax == 0 ? Filter::TYPE_REGEX : Filter::TYPE_FNMATCH;
+        searchProfile.filename_pattern = filenamePattern;
+        searchProfile.content_search   = contentSearch;
+        searchProfile.match_case       = matchCase;
+        searchProfile.text_pattern     = textPattern;
+        searchProfile.size_min         = sizeMin;
+        searchProfile.size_max         = sizeMax;
+        searchProfile.mtime_min_age    = mtimeMinAge;
+        searchProfile.mtime_max_age    = mtimeMaxAge;
+        searchProfile.atime_min_age    = atimeMinAge;
+        searchProfile.atime_max_age    = atimeMaxAge;
+        searchProfile.owner            = owner;
+        searchProfile.perm_mask        = permMask;
+        searchProfile.file_type        = fileType;
+        searchProfile.tag_criteria     = tagCriteria;
+        searchProfile.exclude_globs    = excludeGlobs;
+        searchProfile.use_ignore_files = useIgnoreFiles;
+
+        if (profileNumber == 0)
+            search_defaults.default_profile = searchProfile;
+        else
+            profiles.push_back(searchProfile);
+
+        ++profileNumber;
+    }
+
+    g_variant_unref(gVariantProfiles);
+}
+
+
+/**
+ * Reads the search tool profiles stored by earlier versions, whose criteria
+ * are a part of the current ones. Once the profiles are saved again, they
+ * are written to GCMD_SETTINGS_SEARCH_PROFILES only and this is not used anymore.
+ */
+void GnomeCmdData::load_search_profiles_v1 ()
+{
+    auto *gVariantProfiles = g_settings_get_value (options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_PROFILES_V1);
+
+    g_autoptr(GVariantIter) iter1 {nullptr};
+
+    g_variant_get (gVariantProfiles, GCMD_SETTINGS_SEARCH_PROFILES_V1_FORMAT_STRING, &iter1);
+
+    gchar *name {nullptr};
+    gchar *filenamePattern {nullptr};
+    gchar *textPattern {nullptr};
+    gint maxDepth {0};
+    gint syntax {0};
+    guint profileNumber {0};
+    gboolean contentSearch {false};
+    gboolean matchCase {false};
+
+    while (g_variant_iter_loop (iter1,
+            GCMD_SETTINGS_SEARCH_PROFILE_V1_FORMAT_STRING,
+            &name,
+            &maxDepth,
+            &syntax,
+            &filenamePattern,
+            &contentSearch,
+            &matchCase,
             &textPattern))
     {
         SearchProfile searchProfile;
@@ -3180,6 +3326,16 @@ void GnomeCmdData::load()
     options.save_cmdline_history_on_exit = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_SAVE_CMDLINE_HISTORY_ON_EXIT);
     options.save_search_history_on_exit = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_SAVE_SEARCH_HISTORY_ON_EXIT);
     options.search_window_is_transient = g_settings_get_boolean(options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_WIN_IS_TRANSIENT);
+    options.search_index = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_INDEX);
+    options.search_archives = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_ARCHIVES);
+    options.sparse_copy = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_SPARSE_COPY);
+    options.use_io_uring = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_USE_IO_URING);
+    options.io_uring_queue_depth = g_settings_get_uint (options.gcmd_settings->general, GCMD_SETTINGS_IO_URING_QUEUE_DEPTH);
+    options.bulk_copy_threshold = g_settings_get_uint (options.gcmd_settings->general, GCMD_SETTINGS_BULK_COPY_THRESHOLD);
+    options.delete_to_trash = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_DELETE_TO_TRASH);
+    options.tar_upload = g_settings_get_boolean (options.gcmd_settings->general, GCMD_SETTINGS_TAR_UPLOAD);
+    options.download_segments = g_settings_get_uint (options.gcmd_settings->general, GCMD_SETTINGS_DOWNLOAD_SEGMENTS);
+    options.download_min_segment_size = g_settings_get_uint (options.gcmd_settings->general, GCMD_SETTINGS_DOWNLOAD_MIN_SEGMENT_SIZE);
     search_defaults.height = g_settings_get_uint(options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_WIN_HEIGHT);
     search_defaults.width = g_settings_get_uint(options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_WIN_WIDTH);
     search_defaults.content_patterns.ents = get_list_from_gsettings_string_array (options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_TEXT_HISTORY);
@@ -3581,6 +3737,16 @@ void GnomeCmdData::save()
     set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_WIN_WIDTH, &(search_defaults.width));
     set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_WIN_HEIGHT, &(search_defaults.height));
     set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_WIN_IS_TRANSIENT , &(options.search_window_is_transient));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_INDEX, &(options.search_index));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_SEARCH_ARCHIVES, &(options.search_archives));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_SPARSE_COPY, &(options.sparse_copy));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_USE_IO_URING, &(options.use_io_uring));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_IO_URING_QUEUE_DEPTH, &(options.io_uring_queue_depth));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_BULK_COPY_THRESHOLD, &(options.bulk_copy_threshold));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_DELETE_TO_TRASH, &(options.delete_to_trash));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_TAR_UPLOAD, &(options.tar_upload));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_DOWNLOAD_SEGMENTS, &(options.download_segments));
+    set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_DOWNLOAD_MIN_SEGMENT_SIZE, &(options.download_min_segment_size));
     set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_BOOKMARKS_WINDOW_WIDTH, &(bookmarks_defaults.width));
     set_gsettings_when_changed      (options.gcmd_settings->general, GCMD_SETTINGS_BOOKMARKS_WINDOW_HEIGHT, &(bookmarks_defaults.height));
 
@@ -128,11 +128,24 @@ GcmdSettings *gcmd_settings_new (void);
 #define GCMD_SETTINGS_SEARCH_WIN_WIDTH                "search-win-width"
 #define GCMD_SETTINGS_SEARCH_WIN_HEIGHT               "search-win-height"
 #define GCMD_SETTINGS_SEARCH_WIN_IS_TRANSIENT         "search-win-is-transient"
+#define GCMD_SETTINGS_SEARCH_INDEX                    "search-index"
+#define GCMD_SETTINGS_SEARCH_ARCHIVES                 "search-archives"
+#define GCMD_SETTINGS_SPARSE_COPY                     "sparse-copy"
+#define GCMD_SETTINGS_USE_IO_URING                    "use-io-uring"
+#define GCMD_SETTINGS_IO_URING_QUEUE_DEPTH            "io-uring-queue-depth"
+#define GCMD_SETTINGS_BULK_COPY_THRESHOLD             "bulk-copy-threshold"
+#define GCMD_SETTINGS_DELETE_TO_TRASH                 "delete-to-trash"
+#define GCMD_SETTINGS_TAR_UPLOAD                      "tar-upload"
+#define GCMD_SETTINGS_DOWNLOAD_SEGMENTS               "download-segments"
+#define GCMD_SETTINGS_DOWNLOAD_MIN_SEGMENT_SIZE       "download-min-segment-size"
 #define GCMD_SETTINGS_SEARCH_PATTERN_HISTORY          "search-pattern-history"
 #define GCMD_SETTINGS_SEARCH_TEXT_HISTORY             "search-text-history"
-#define GCMD_SETTINGS_SEARCH_PROFILES                 "search-profiles"
-#define GCMD_SETTINGS_SEARCH_PROFILE_FORMAT_STRING    "(siisbbs)"
-#define GCMD_SETTINGS_SEARCH_PROFILES_FORMAT_STRING   "a(siisbbs)"
+#define GCMD_SETTINGS_SEARCH_PROFILES_V1              "search-profiles"
+#define GCMD_SETTINGS_SEARCH_PROFILE_V1_FORMAT_STRING "(siisbbs)"
+#define GCMD_SETTINGS_SEARCH_PROFILES_V1_FORMAT_STRING "a(siisbbs)"
+#define GCMD_SETTINGS_SEARCH_PROFILES                 "search-profiles-v2"
+#define GCMD_SETTINGS_SEARCH_PROFILE_FORMAT_STRING    "(siisbbsttuuuusuissb)"
+#define GCMD_SETTINGS_SEARCH_PROFILES_FORMAT_STRING   "a(siisbbsttuuuusuissb)"
 #define GCMD_SETTINGS_BOOKMARKS                       "bookmarks"
 #define GCMD_SETTINGS_BOOKMARK_FORMAT_STRING          "(bsss)"
 #define GCMD_SETTINGS_BOOKMARKS_FORMAT_STRING         "a(bsss)"
@@ -330,6 +343,17 @@ struct GnomeCmdData
         gboolean                     save_cmdline_history_on_exit;
         gboolean                     save_search_history_on_exit;
         gboolean                     search_window_is_transient {true};
+        gboolean                     search_index {FALSE};
+        gboolean                     search_archives {FALSE};
+        //  Transfers
+        gboolean                     sparse_copy {TRUE};
+        gboolean                     use_io_uring {FALSE};
+        guint                        io_uring_queue_depth {32};
+        guint                        bulk_copy_threshold {16384};      // MiB
+        gboolean                     delete_to_trash {FALSE};
+        gboolean                     tar_upload {FALSE};
+        guint                        download_segments {4};
+        guint                        download_min_segment_size {8};    // MiB
         gchar                       *symlink_prefix;
         gint                         main_win_pos[2];
         // Format
@@ -552,8 +576,21 @@ struct GnomeCmdData
         std::string text_pattern;
         gboolean content_search {FALSE};
         gboolean match_case {FALSE};
+        guint64 size_min {0};                       // bytes, 0 for no limit, as for the others
+        guint64 size_max {0};
+        guint mtime_min_age {0};                    // days
+        guint mtime_max_age {0};
+        guint atime_min_age {0};
+        guint atime_max_age {0};
+        std::string owner;                          // user name or id, empty for any
+        guint perm_mask {0};                        // permission bits which must all be set
+        gint file_type {0};                         // GnomeCmd::StatFilter::Type
+        std::string tag_criteria;                   // GnomeCmd::TagQuery, empty for none
+        std::string exclude_globs;                  // GnomeCmd::IgnoreRules, empty for none
+        gboolean use_ignore_files {FALSE};          // honour .gitignore and .ignore files
 
         const std::string &description() const    {  return filename_pattern;  }
+        gboolean has_attribute_criteria() const;
         void reset();
 
         ~SearchProfile();
@@ -725,6 +762,7 @@ struct GnomeCmdData
     void load_advrename_profiles ();
     void save_advrename_profiles ();
     void load_search_profiles ();
+    void load_search_profiles_v1 ();
     void save_search_profiles ();
     void save_bookmarks();
     void load_bookmarks();
@@ -0,0 +1,369 @@
+/**
+ * @file gnome-cmd-delete-engine.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <thread>
+
+#include "gnome-cmd-delete-engine.h"
+
+using namespace std;
+
+
+/**
+ * A directory being emptied. It stays open until it is removed, so that its
+ * subdirectories are opened and removed relative to it and a directory
+ * renamed or replaced by a symlink meanwhile can't redirect the walk.
+ */
+struct GnomeCmd::DeleteEngine::Dir
+{
+    string path;                            /**< for error messages and the top level items */
+    string name;                            /**< in the parent */
+    Dir *parent;
+    int fd {-1};
+    ssize_t top_index;                      /**< index in the items of run(), -1 for nested directories */
+    atomic<unsigned> pending {1};           /**< the listing itself plus the subdirectories not finished yet */
+    atomic<bool> incomplete {false};        /**< something inside was skipped, the directory stays */
+
+    Dir(const string &p, const char *n, Dir *parent_dir, ssize_t index): path(p), name(n), parent(parent_dir), top_index(index)   {}
+};
+
+
+#ifdef __linux__
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+
+/**
+ * Calls @a f for all entries of the directory open as @a fd, until @a f returns false.
+ *
+ * @returns 0 or an errno value
+ */
+static int for_each_entry (int fd, const function<bool (const char *name, unsigned char type)> &f)
+{
+#ifdef __linux__
+    alignas(linux_dirent64) char buf[32768];
+
+    for (;;)
+    {
+        long n = syscall (SYS_getdents64, fd, buf, sizeof(buf));
+
+        if (n < 0)
+            return errno;
+
+        if (n == 0)
+            return 0;
+
+        for (long pos=0; pos<n; )
+        {
+            auto entry = (linux_dirent64 *) (buf + pos);
+
+            pos += entry->d_reclen;
+
+            if (!GnomeCmd::is_dot_or_dotdot (entry->d_name) && !f (entry->d_name, entry->d_type))
+                return 0;
+        }
+    }
+#else
+    int dir_fd = dup (fd);
+    DIR *dir = dir_fd < 0 ? nullptr : fdopendir (dir_fd);
+
+    if (!dir)
+    {
+        int error = errno;
+        if (dir_fd >= 0)
+            close (dir_fd);
+        return error;
+    }
+
+    errno = 0;
+
+    while (struct dirent *entry = readdir (dir))
+    {
+        if (!GnomeCmd::is_dot_or_dotdot (entry->d_name) && !f (entry->d_name, entry->d_type))
+            break;
+        errno = 0;
+    }
+
+    int error = errno;
+
+    closedir (dir);
+
+    return error;
+#endif
+}
+
+
+GnomeCmd::DeleteEngine::DeleteEngine(unsigned n_threads): threads(n_threads)
+{
+    if (threads == 0)
+        threads = min<unsigned> (max (thread::hardware_concurrency(), 1u), MAX_THREADS);
+}
+
+
+GnomeCmd::ErrorAction GnomeCmd::DeleteEngine::report(const string &path, int error)
+{
+    lock_guard<std::mutex> lock(error_mutex);
+
+    // another worker has already been told to abort, don't ask again
+    if (aborted)
+        return ERROR_ACTION_ABORT;
+
+    ErrorAction action = on_error ? on_error (path, error) : ERROR_ACTION_ABORT;
+
+    if (action == ERROR_ACTION_ABORT)
+    {
+        aborted = true;
+        queue_cond.notify_all();
+    }
+
+    return action;
+}
+
+
+/**
+ * Removes @a name in the directory open as @a dir_fd.
+ *
+ * @returns false if the entry is still there
+ */
+bool GnomeCmd::DeleteEngine::remove_entry(int dir_fd, const string &dir_path, const char *name, bool is_dir, Dir *parent)
+{
+    for (;;)
+    {
+        if (unlinkat (dir_fd, name, is_dir ? AT_REMOVEDIR : 0) == 0)
+        {
+            files_removed++;
+            return true;
+        }
+
+        // gone already, which is all that was asked for
+        if (errno == ENOENT)
+            return true;
+
+        if (report(dir_path.empty() ? string(name) : dir_path + "/" + name, errno) != ERROR_ACTION_RETRY)
+        {
+            if (parent)
+                parent->incomplete = true;
+            return false;
+        }
+    }
+}
+
+
+void GnomeCmd::DeleteEngine::push(Dir *dir)
+{
+    lock_guard<std::mutex> lock(queue_mutex);
+
+    queue.push_back(dir);
+    queue_cond.notify_one();
+}
+
+
+/**
+ * Drops one reference to @a dir. The last one removes the directory itself
+ * and drops the reference it holds to its parent.
+ */
+void GnomeCmd::DeleteEngine::finish_directory(Dir *dir)
+{
+    while (dir && --dir->pending == 0)
+    {
+        Dir *parent = dir->parent;
+
+        if (dir->fd >= 0)
+            close (dir->fd);
+
+        bool ok = !dir->incomplete && !cancelled && !aborted &&
+                  (parent ? remove_entry(parent->fd, parent->path, dir->name.c_str(), true, nullptr) :
+                            remove_entry(AT_FDCWD, string(), dir->path.c_str(), true, nullptr));
+
+        if (!ok && parent)
+            parent->incomplete = true;
+
+        if (dir->top_index >= 0)
+        {
+            lock_guard<std::mutex> lock(queue_mutex);
+            removed[dir->top_index] = ok;
+            items_done++;
+        }
+
+        delete dir;
+        dir = parent;
+    }
+}
+
+
+void GnomeCmd::DeleteEngine::list_directory(Dir *dir)
+{
+    int fd;
+
+    while ((fd = openat (dir->parent ? dir->parent->fd : AT_FDCWD, dir->parent ? dir->name.c_str() : dir->path.c_str(), O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC)) < 0)
+        if (report(dir->path, errno) != ERROR_ACTION_RETRY)
+        {
+            dir->incomplete = true;
+            finish_directory(dir);
+            return;
+        }
+
+    // the subdirectories are opened relative to it by other workers, closed by finish_directory() once they are gone
+    dir->fd = fd;
+
+    for (;;)
+    {
+        int error = for_each_entry (fd, [&] (const char *name, unsigned char type) -> bool
+        {
+            if (cancelled || aborted)
+                return false;
+
+            bool is_dir = type == DT_DIR;
+
+            if (type == DT_UNKNOWN)
+            {
+                struct stat st;
+                is_dir = fstatat (fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR (st.st_mode);
+            }
+
+            if (is_dir)
+            {
+                dir->pending++;
+                push(new Dir(dir->path + "/" + name, name, dir, -1));
+            }
+            else
+                remove_entry(fd, dir->path, name, false, dir);
+
+            return true;
+        });
+
+        if (!error || report(dir->path, error) != ERROR_ACTION_RETRY)
+        {
+            if (error)
+                dir->incomplete = true;
+            break;
+        }
+
+        lseek (fd, 0, SEEK_SET);
+    }
+
+    finish_directory(dir);
+}
+
+
+void GnomeCmd::DeleteEngine::worker()
+{
+    unique_lock<std::mutex> lock(queue_mutex);
+
+    for (;;)
+    {
+        queue_cond.wait(lock, [this] { return !queue.empty() || busy == 0 || cancelled || aborted; });
+
+        if (cancelled || aborted || queue.empty())
+            break;
+
+        Dir *dir = queue.back();
+        queue.pop_back();
+        busy++;
+
+        lock.unlock();
+        list_directory(dir);
+        lock.lock();
+
+        busy--;
+    }
+
+    // wake up the others, they may be waiting for work which is not going to come
+    queue_cond.notify_all();
+}
+
+
+void GnomeCmd::DeleteEngine::remove_top_item(size_t index)
+{
+    const string &path = paths[index];
+    struct stat st;
+
+    while (lstat (path.c_str(), &st) != 0)
+    {
+        if (errno == ENOENT)
+        {
+            removed[index] = true;
+            items_done++;
+            return;
+        }
+
+        if (report(path, errno) != ERROR_ACTION_RETRY)
+        {
+            items_done++;
+            return;
+        }
+    }
+
+    if (S_ISDIR (st.st_mode))
+        push(new Dir(path, "", nullptr, index));
+    else
+    {
+        removed[index] = remove_entry(AT_FDCWD, string(), path.c_str(), false, nullptr);
+        items_done++;
+    }
+}
+
+
+bool GnomeCmd::DeleteEngine::run(const vector<string> &items)
+{
+    paths = items;
+    removed.assign(paths.size(), false);
+
+    for (size_t i=0; i<paths.size() && !cancelled && !aborted; ++i)
+        remove_top_item(i);
+
+    vector<thread> workers;
+
+    for (unsigned i=0; i<threads; ++i)
+        workers.emplace_back(&DeleteEngine::worker, this);
+
+    for (auto &t : workers)
+        t.join();
+
+    // directories never listed because the job was stopped, this also frees their parents
+    for (Dir *dir : queue)
+    {
+        dir->incomplete = true;
+        finish_directory(dir);
+    }
+
+    queue.clear();
+
+    return !cancelled && !aborted;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file gnome-cmd-delete-engine.h
+ * @brief Deleting of local file trees without gnome-vfs.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gnome-cmd-file-io.h"
+
+namespace GnomeCmd
+{
+    /**
+     * Deletes local files and directory trees.
+     *
+     * Every directory is a task of its own: a worker lists it with getdents64,
+     * removes all non-directories with unlinkat relative to the directory fd
+     * and queues the subdirectories, which are opened and removed relative to
+     * it as well. A directory is removed as soon as its last
+     * subdirectory is gone, so several workers can clear different subtrees at
+     * the same time.
+     *
+     * Symbolic links are removed, never followed.
+     */
+    class DeleteEngine
+    {
+      public:
+
+        typedef std::function<ErrorAction (const std::string &path, int error)> ErrorFunc;
+
+        enum
+        {
+            MAX_THREADS = 8
+        };
+
+      private:
+
+        struct Dir;
+
+        std::vector<std::string> paths;
+        std::vector<Dir *> queue;           /**< directories waiting to be listed, used as a stack */
+        std::mutex queue_mutex;
+        std::condition_variable queue_cond;
+        unsigned busy {0};                  /**< workers processing a directory */
+
+        std::mutex error_mutex;             /**< errors are reported one at a time */
+
+        std::atomic<bool> cancelled {false};
+        std::atomic<bool> aborted {false};
+
+        void worker();
+        void push(Dir *dir);
+        void list_directory(Dir *dir);
+        void finish_directory(Dir *dir);
+        bool remove_entry(int dir_fd, const std::string &dir_path, const char *name, bool is_dir, Dir *parent);
+        void remove_top_item(size_t index);
+        ErrorAction report(const std::string &path, int error);
+
+      public:
+
+        std::atomic<uint64_t> files_removed {0};    /**< all removed items, directories included */
+        std::atomic<uint64_t> items_done {0};       /**< top level items finished, removed or not */
+
+        std::vector<bool> removed;          /**< per top level item, valid after run() */
+
+        ErrorFunc on_error;                 /**< asked on errors, the job is aborted if not set; may be called by any worker */
+
+        unsigned threads;
+
+        explicit DeleteEngine(unsigned n_threads=0);
+
+        /**
+         * Deletes all @a items, recursing into directories.
+         *
+         * @returns false if the job was aborted or cancelled
+         */
+        bool run(const std::vector<std::string> &items);
+
+        size_t get_items_total() const      {  return paths.size();  }
+
+        void cancel()                       {  cancelled = true;  queue_cond.notify_all();  }
+        bool is_cancelled() const           {  return cancelled;  }
+    };
+}
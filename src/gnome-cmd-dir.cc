@@ -30,6 +30,7 @@
 #include "gnome-cmd-data.h"
 #include "gnome-cmd-con.h"
 #include "gnome-cmd-file-collection.h"
+#include "gnome-cmd-name-index.h"
 #include "dirlist.h"
 #include "utils.h"
 
@@ -78,6 +79,25 @@ G_DEFINE_TYPE (GnomeCmdDir, gnome_cmd_dir, GNOME_CMD_TYPE_FILE)
 static guint signals[LAST_SIGNAL] = { 0 };
 
 
+/**
+ * Tells the name indexes of the search that files have been created or deleted in @a dir.
+ */
+static void mark_names_changed (GnomeCmdDir *dir)
+{
+    if (!gnome_cmd_data.options.search_index || !gnome_cmd_dir_is_local (dir))
+        return;
+
+    gchar *path_utf8 = GNOME_CMD_FILE (dir)->get_real_path();
+    gchar *path = g_locale_from_utf8 (path_utf8, -1, NULL, NULL, NULL);
+
+    if (path)
+        GnomeCmd::NameIndexSet::get_default().mark_changed(path);
+
+    g_free (path);
+    g_free (path_utf8);
+}
+
+
 static void monitor_callback (GnomeVFSMonitorHandle *handle, const gchar *monitor_uri, const gchar *info_uri, GnomeVFSMonitorEventType event_type, GnomeCmdDir *dir)
 {
     switch (event_type)
@@ -89,10 +109,12 @@ static void monitor_callback (GnomeVFSMonitorHandle *handle, const gchar *monito
         case GNOME_VFS_MONITOR_EVENT_DELETED:
             DEBUG('n', "GNOME_VFS_MONITOR_EVENT_DELETED for %s\n", info_uri);
             gnome_cmd_dir_file_deleted (dir, info_uri);
+            mark_names_changed (dir);
             break;
         case GNOME_VFS_MONITOR_EVENT_CREATED:
             DEBUG('n', "GNOME_VFS_MONITOR_EVENT_CREATED for %s\n", info_uri);
             gnome_cmd_dir_file_created (dir, info_uri);
+            mark_names_changed (dir);
             break;
         case GNOME_VFS_MONITOR_EVENT_METADATA_CHANGED:
         case GNOME_VFS_MONITOR_EVENT_STARTEXECUTING:
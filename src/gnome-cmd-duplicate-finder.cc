@@ -0,0 +1,571 @@
+/**
+ * @file gnome-cmd-duplicate-finder.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_FS_H
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+#include <algorithm>
+#include <set>
+#include <thread>
+#include <utility>
+
+#include "gnome-cmd-duplicate-finder.h"
+#include "gnome-cmd-file-io.h"
+
+using namespace std;
+
+
+#define READ_SIZE  (256 * 1024)
+
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+
+inline uint64_t rotl (uint64_t x, int r)
+{
+    return x << r | x >> (64 - r);
+}
+
+
+inline uint64_t read64 (const unsigned char *p)
+{
+    uint64_t v;
+    memcpy (&v, p, sizeof(v));
+    return v;
+}
+
+
+inline uint32_t read32 (const unsigned char *p)
+{
+    uint32_t v;
+    memcpy (&v, p, sizeof(v));
+    return v;
+}
+
+
+inline uint64_t mix (uint64_t acc, uint64_t input)
+{
+    return rotl (acc + input * PRIME2, 31) * PRIME1;
+}
+
+
+inline uint64_t merge (uint64_t h, uint64_t lane)
+{
+    return (h ^ mix (0, lane)) * PRIME1 + PRIME4;
+}
+
+
+GnomeCmd::ContentHash::ContentHash(uint64_t seed)
+{
+    lanes[0] = seed + PRIME1 + PRIME2;
+    lanes[1] = seed + PRIME2;
+    lanes[2] = seed;
+    lanes[3] = seed - PRIME1;
+}
+
+
+inline void GnomeCmd::ContentHash::round(const unsigned char *stripe)
+{
+    lanes[0] = mix (lanes[0], read64 (stripe));
+    lanes[1] = mix (lanes[1], read64 (stripe + 8));
+    lanes[2] = mix (lanes[2], read64 (stripe + 16));
+    lanes[3] = mix (lanes[3], read64 (stripe + 24));
+}
+
+
+void GnomeCmd::ContentHash::update(const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *) data;
+    const unsigned char *end = p + len;
+
+    total += len;
+
+    if (buffered)
+    {
+        size_t n = min (len, sizeof(buf) - buffered);
+
+        memcpy (buf + buffered, p, n);
+        buffered += n;
+        p += n;
+
+        if (buffered < sizeof(buf))
+            return;
+
+        round(buf);
+        buffered = 0;
+    }
+
+    for (; end - p >= 32; p += 32)
+        round(p);
+
+    memcpy (buf, p, end - p);
+    buffered = end - p;
+}
+
+
+uint64_t GnomeCmd::ContentHash::digest() const
+{
+    uint64_t h;
+
+    if (total >= 32)
+    {
+        h = rotl (lanes[0], 1) + rotl (lanes[1], 7) + rotl (lanes[2], 12) + rotl (lanes[3], 18);
+
+        for (uint64_t lane : lanes)
+            h = merge (h, lane);
+    }
+    else
+        h = lanes[2] + PRIME5;                  // the seed
+
+    h += total;
+
+    const unsigned char *p = buf;
+    const unsigned char *end = buf + buffered;
+
+    for (; end - p >= 8; p += 8)
+        h = rotl (h ^ mix (0, read64 (p)), 27) * PRIME1 + PRIME4;
+
+    if (end - p >= 4)
+    {
+        h = rotl (h ^ read32 (p) * PRIME1, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+
+    for (; p < end; ++p)
+        h = rotl (h ^ *p * PRIME5, 11) * PRIME1;
+
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+
+void GnomeCmd::DuplicateFinder::add_file(const string &path, const struct stat &st)
+{
+    if ((uint64_t) st.st_size < options.min_size)
+        return;
+
+    files.push_back({path, (uint64_t) st.st_size, st.st_dev, st.st_ino, 0, false});
+    files_found++;
+    bytes_total += st.st_size;
+}
+
+
+void GnomeCmd::DuplicateFinder::add(const string &path)
+{
+    struct stat st;
+
+    if (lstat (path.c_str(), &st) != 0)
+        return;
+
+    if (S_ISREG (st.st_mode))
+        add_file(path, st);
+    else
+        if (S_ISDIR (st.st_mode))
+            scan(path);
+}
+
+
+void GnomeCmd::DuplicateFinder::scan(const string &path)
+{
+    const IgnoreRules *ignore = options.ignore;
+    vector<pair<string,IgnoreRules::FramePtr>> dirs;
+
+    dirs.emplace_back(path, ignore ? ignore->enter_root(path) : nullptr);
+
+    while (!dirs.empty() && !stopped)
+    {
+        string dir_path = move (dirs.back().first);
+        IgnoreRules::FramePtr frame = move (dirs.back().second);
+        dirs.pop_back();
+
+        int fd = open (dir_path.c_str(), O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC);
+
+        if (fd < 0)
+            continue;
+
+        DIR *dir = fdopendir (fd);
+
+        if (!dir)
+        {
+            close (fd);
+            continue;
+        }
+
+        if (ignore)
+            frame = ignore->enter(frame, fd, dir_path);
+
+        string prefix = dir_path == "/" ? dir_path : dir_path + '/';
+
+        while (dirent *entry = readdir (dir))
+        {
+            if (is_dot_or_dotdot (entry->d_name))
+                continue;
+
+            // the size is needed for every file anyway
+            struct stat st;
+
+            if (entry->d_type != DT_DIR && entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN)
+                continue;
+
+            if (fstatat (fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+
+            if (ignore && ignore->excluded(frame.get(), dir_path, entry->d_name, S_ISDIR (st.st_mode)))
+                continue;
+
+            if (S_ISDIR (st.st_mode))
+                dirs.emplace_back(prefix + entry->d_name, frame);
+            else
+                if (S_ISREG (st.st_mode))
+                    add_file(prefix + entry->d_name, st);
+        }
+
+        closedir (dir);
+    }
+}
+
+
+bool GnomeCmd::DuplicateFinder::hash_file(File &f, bool partial)
+{
+    static thread_local vector<char> buf(READ_SIZE);
+
+    int fd = open (f.path.c_str(), O_RDONLY|O_NOFOLLOW|O_CLOEXEC|O_NOCTTY|O_NONBLOCK);
+
+    if (fd < 0)
+        return false;
+
+    ContentHash hash;
+    uint64_t expected;
+    uint64_t got = 0;
+
+    if (partial && f.size > 2 * PARTIAL_SIZE)
+    {
+        // the head and the tail tell most files of the same size apart, e.g. by headers and indexes
+        expected = 2 * PARTIAL_SIZE;
+
+        ssize_t n = pread_all (fd, buf.data(), PARTIAL_SIZE, 0);
+
+        if (n > 0)
+        {
+            hash.update(buf.data(), n);
+            got += n;
+
+            n = pread_all (fd, buf.data(), PARTIAL_SIZE, f.size - PARTIAL_SIZE);
+
+            if (n > 0)
+            {
+                hash.update(buf.data(), n);
+                got += n;
+            }
+        }
+    }
+    else
+    {
+        expected = f.size;
+
+        if (f.size > READ_SIZE)
+            posix_fadvise (fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        while (got <= expected && !stopped)
+        {
+            ssize_t n = pread_all (fd, buf.data(), buf.size(), got);
+
+            if (n <= 0)
+                break;
+
+            hash.update(buf.data(), n);
+            got += n;
+        }
+    }
+
+    close (fd);
+
+    bytes_read += got;
+
+    f.digest = hash.digest();
+
+    return got == expected;                     // else it has changed since the scan
+}
+
+
+void GnomeCmd::DuplicateFinder::hash_files(vector<File *> &todo, bool partial)
+{
+    unsigned n_threads = options.threads ? options.threads : thread::hardware_concurrency();
+
+    n_threads = max (1u, min<unsigned> (min<unsigned> (n_threads, MAX_THREADS), todo.size()));
+
+    // neighbours on disk are read one after the other
+    sort (todo.begin(), todo.end(), [] (const File *a, const File *b) { return a->dev != b->dev ? a->dev < b->dev : a->ino < b->ino; });
+
+    atomic<size_t> next {0};
+
+    auto work = [&] ()
+    {
+        for (size_t i; !stopped && (i = next++) < todo.size(); )
+        {
+            todo[i]->failed = !hash_file(*todo[i], partial);
+            files_hashed++;
+        }
+    };
+
+    vector<thread> threads;
+
+    for (unsigned i=1; i<n_threads; ++i)
+        threads.emplace_back(work);
+
+    work();
+
+    for (auto &t : threads)
+        t.join();
+}
+
+
+/**
+ * Sorts @a files by size and hash and calls @a group with every run of at
+ * least two files equal in both.
+ */
+template <typename F, typename GroupFunc>
+inline void for_each_collision (vector<F *> &files, GroupFunc group)
+{
+    sort (files.begin(), files.end(), [] (const F *a, const F *b) { return a->size != b->size ? a->size < b->size : a->digest < b->digest; });
+
+    for (auto i=files.begin(); i!=files.end(); )
+    {
+        auto j = i + 1;
+
+        while (j != files.end() && (*j)->size == (*i)->size && (*j)->digest == (*i)->digest)
+            ++j;
+
+        if (j - i > 1)
+            group(i, j);
+
+        i = j;
+    }
+}
+
+
+void GnomeCmd::DuplicateFinder::run()
+{
+    // sizes no other file has, and further links to a file already seen, are left out
+    set<pair<dev_t, ino_t>> inodes;
+    vector<File *> todo;
+
+    sort (files.begin(), files.end(), [] (const File &a, const File &b) { return a.size != b.size ? a.size < b.size : a.path < b.path; });
+
+    for (auto i=files.begin(); i!=files.end(); )
+    {
+        auto j = i;
+        size_t first = todo.size();
+
+        for (; j!=files.end() && j->size==i->size; ++j)
+            if (inodes.insert(make_pair(j->dev, j->ino)).second)
+                todo.push_back(&*j);
+
+        if (todo.size() - first < 2)
+            todo.resize(first);
+
+        i = j;
+    }
+
+    stage = STAGE_PARTIAL_HASH;
+    files_to_hash = todo.size();
+    hash_files(todo, true);
+
+    vector<File *> full;
+
+    auto add_group = [this] (vector<File *>::iterator begin, vector<File *>::iterator end)
+    {
+        Group g {(*begin)->size, {}};
+
+        for (auto f=begin; f!=end; ++f)
+            if (!(*f)->failed)
+                g.paths.push_back((*f)->path);
+
+        if (g.paths.size() > 1)
+        {
+            sort (g.paths.begin(), g.paths.end());
+            groups.push_back(move (g));
+        }
+    };
+
+    for_each_collision (todo, [&] (vector<File *>::iterator begin, vector<File *>::iterator end)
+    {
+        if ((*begin)->size <= 2 * PARTIAL_SIZE)
+            add_group(begin, end);              // hashed in full already
+        else
+            for (auto f=begin; f!=end; ++f)
+                if (!(*f)->failed)
+                    full.push_back(*f);
+    });
+
+    if (!stopped)
+    {
+        stage = STAGE_FULL_HASH;
+        files_to_hash += full.size();
+        hash_files(full, false);
+
+        for_each_collision (full, add_group);
+    }
+
+    sort (groups.begin(), groups.end(), [] (const Group &a, const Group &b)
+    {
+        return a.wasted() != b.wasted() ? a.wasted() > b.wasted() : a.paths[0] < b.paths[0];
+    });
+
+    stage = STAGE_DONE;
+}
+
+
+bool GnomeCmd::DuplicateFinder::same_content(const string &a, const string &b)
+{
+    int fd_a = open (a.c_str(), O_RDONLY|O_NOFOLLOW|O_CLOEXEC|O_NOCTTY|O_NONBLOCK);
+    int fd_b = open (b.c_str(), O_RDONLY|O_NOFOLLOW|O_CLOEXEC|O_NOCTTY|O_NONBLOCK);
+    bool same = fd_a >= 0 && fd_b >= 0;
+
+    if (same)
+    {
+        vector<char> buf_a(READ_SIZE), buf_b(READ_SIZE);
+
+        for (off_t offset=0; same; )
+        {
+            ssize_t n_a = pread_all (fd_a, buf_a.data(), READ_SIZE, offset);
+            ssize_t n_b = pread_all (fd_b, buf_b.data(), READ_SIZE, offset);
+
+            same = n_a >= 0 && n_a == n_b && memcmp (buf_a.data(), buf_b.data(), n_a) == 0;
+
+            if (n_a <= 0)
+                break;
+
+            offset += n_a;
+        }
+    }
+
+    if (fd_a >= 0)
+        close (fd_a);
+    if (fd_b >= 0)
+        close (fd_b);
+
+    return same;
+}
+
+
+/**
+ * Gives the file @a tmp the name @a dest, or removes it.
+ */
+static int rename_over (const string &tmp, const string &dest)
+{
+    if (rename (tmp.c_str(), dest.c_str()) == 0)
+        return 0;
+
+    int error = errno;
+
+    unlink (tmp.c_str());
+
+    return error;
+}
+
+
+int GnomeCmd::DuplicateFinder::resolve(const string &keep, const string &dup, Action action)
+{
+    struct stat keep_st, dup_st;
+
+    if (lstat (keep.c_str(), &keep_st) != 0 || lstat (dup.c_str(), &dup_st) != 0)
+        return errno;
+
+    if (!S_ISREG (keep_st.st_mode) || !S_ISREG (dup_st.st_mode))
+        return EINVAL;
+
+    if (action == ACTION_DELETE)
+        return unlink (dup.c_str()) == 0 ? 0 : errno;
+
+    if (keep_st.st_dev != dup_st.st_dev)
+        return EXDEV;
+
+    if (keep_st.st_ino == dup_st.st_ino)
+        return 0;                               // linked already
+
+    string tmp = dup + ".gcmd-dup-" + to_string (getpid ());
+
+    if (action == ACTION_HARDLINK)
+    {
+        if (link (keep.c_str(), tmp.c_str()) != 0)
+            return errno;
+
+        return rename_over (tmp, dup);
+    }
+
+#ifdef FICLONE
+    int src_fd = open (keep.c_str(), O_RDONLY|O_NOFOLLOW|O_CLOEXEC);
+
+    if (src_fd < 0)
+        return errno;
+
+    int dest_fd = open (tmp.c_str(), O_WRONLY|O_CREAT|O_EXCL|O_CLOEXEC, dup_st.st_mode & 07777);
+
+    if (dest_fd < 0)
+    {
+        int error = errno;
+        close (src_fd);
+        return error;
+    }
+
+    int error = ioctl (dest_fd, FICLONE, src_fd) == 0 ? 0 : errno;
+
+    // the copy takes the place of dup, so it gets its owner where allowed, its times and its mode,
+    // which is set after the owner since chown clears the set-id bits, and undoes the umask as well
+    if (!error && fchown (dest_fd, dup_st.st_uid, dup_st.st_gid) != 0 && errno != EPERM)
+        error = errno;
+
+    if (!error && (fchmod (dest_fd, dup_st.st_mode & 07777) != 0 || !copy_times (dest_fd, dup_st)))
+        error = errno;
+
+    close (src_fd);
+    close (dest_fd);
+
+    if (error)
+    {
+        unlink (tmp.c_str());
+        return error;
+    }
+
+    return rename_over (tmp, dup);
+#else
+    return EOPNOTSUPP;
+#endif
+}
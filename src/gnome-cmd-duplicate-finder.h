@@ -0,0 +1,188 @@
+/**
+ * @file gnome-cmd-duplicate-finder.h
+ * @brief Finding local files with the same content.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "gnome-cmd-ignore-rules.h"
+
+namespace GnomeCmd
+{
+    /**
+     * A 64 bit hash of a stream of bytes, computed in four independent
+     * lanes of 8 bytes each in the manner of xxHash64, so that a round
+     * keeps up with reading from the page cache.
+     */
+    class ContentHash
+    {
+        uint64_t lanes[4];
+        unsigned char buf[32];
+        size_t buffered {0};
+        uint64_t total {0};
+
+        void round(const unsigned char *stripe);
+
+      public:
+
+        explicit ContentHash(uint64_t seed=0);
+
+        void update(const void *data, size_t len);
+        uint64_t digest() const;
+
+        static uint64_t of(const void *data, size_t len)
+        {
+            ContentHash h;
+            h.update(data, len);
+            return h.digest();
+        }
+    };
+
+
+    /**
+     * Finds groups of local files with the same content in three steps,
+     * each of which only looks at the files the previous one has left:
+     *
+     *  - files are grouped by size, files of a size no other file has are dropped;
+     *  - the first and last PARTIAL_SIZE bytes of the rest are hashed, in parallel;
+     *  - files which still collide are hashed in full, in parallel.
+     *
+     * Files no larger than twice PARTIAL_SIZE are hashed in full in the
+     * second step already. Symlinks are not followed and several hard links
+     * to one file are counted as that file once.
+     */
+    class DuplicateFinder
+    {
+      public:
+
+        enum
+        {
+            PARTIAL_SIZE = 64 * 1024,
+            MAX_THREADS = 8
+        };
+
+        enum Stage
+        {
+            STAGE_SCAN,
+            STAGE_PARTIAL_HASH,
+            STAGE_FULL_HASH,
+            STAGE_DONE
+        };
+
+        /** Same order as the action buttons of the duplicates dialog */
+        enum Action
+        {
+            ACTION_HARDLINK,
+            ACTION_REFLINK,
+            ACTION_DELETE
+        };
+
+        struct Options
+        {
+            uint64_t min_size {1};          /**< smaller files are ignored, empty ones are all equal */
+            unsigned threads {0};           /**< 0 for one per CPU, at most MAX_THREADS */
+            const IgnoreRules *ignore {nullptr};    /**< entries of the directories added which are left out */
+        };
+
+        struct Group
+        {
+            uint64_t size;
+            std::vector<std::string> paths; /**< sorted */
+
+            /** The bytes taken by all but one of the files */
+            uint64_t wasted() const         {  return size * (paths.size() - 1);  }
+        };
+
+      private:
+
+        struct File
+        {
+            std::string path;
+            uint64_t size;
+            dev_t dev;
+            ino_t ino;
+            uint64_t digest;
+            bool failed;
+        };
+
+        Options options;
+        std::vector<File> files;
+        std::vector<Group> groups;
+        std::atomic<bool> stopped {false};
+
+        void scan(const std::string &path);
+        void add_file(const std::string &path, const struct stat &st);
+        void hash_files(std::vector<File *> &todo, bool partial);
+        bool hash_file(File &f, bool partial);
+
+      public:
+
+        std::atomic<int> stage {STAGE_SCAN};
+        std::atomic<uint64_t> files_found {0};
+        std::atomic<uint64_t> files_hashed {0};
+        std::atomic<uint64_t> files_to_hash {0};
+        std::atomic<uint64_t> bytes_total {0};      /**< of all files found, what hashing them all in full would read */
+        std::atomic<uint64_t> bytes_read {0};
+
+        DuplicateFinder()                   {}
+        explicit DuplicateFinder(const Options &opts): options(opts)     {}
+
+        /**
+         * Adds a file or, with all files below it, a directory. Called
+         * before run() only.
+         */
+        void add(const std::string &path);
+
+        /**
+         * Finds the duplicates, returns when done or stopped.
+         */
+        void run();
+
+        void stop()                         {  stopped = true;  }
+        bool is_stopped() const             {  return stopped;  }
+
+        /**
+         * @returns the groups of equal files, those wasting the most space
+         * first, once run() has returned
+         */
+        const std::vector<Group> &get_groups() const    {  return groups;  }
+
+        /**
+         * Compares two files byte by byte, to make sure that none of them
+         * has changed since it was hashed.
+         */
+        static bool same_content(const std::string &a, const std::string &b);
+
+        /**
+         * Replaces @a dup by a hard link to @a keep or a reflinked copy of it,
+         * or deletes it. Links are made under a temporary name and renamed
+         * over @a dup, so it is never missing.
+         *
+         * @returns 0 or an errno value
+         */
+        static int resolve(const std::string &keep, const std::string &dup, Action action);
+    };
+}
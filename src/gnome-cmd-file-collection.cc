@@ -31,7 +31,18 @@ void GnomeCmdFileCollection::add(GnomeCmdFile *f)
 {
     g_return_if_fail (GNOME_CMD_IS_FILE (f));
 
-    list = g_list_append (list, f);
+    GList *link = g_list_alloc ();
+
+    link->data = f;
+    link->prev = last;
+
+    if (last)
+        last->next = link;
+    else
+        list = link;
+
+    last = link;
+    count++;
 
     gchar *uri_str = f->get_uri_str();
     g_hash_table_insert (map, uri_str, f);
@@ -43,7 +54,7 @@ gboolean GnomeCmdFileCollection::remove(GnomeCmdFile *f)
 {
     g_return_val_if_fail (GNOME_CMD_IS_FILE (f), FALSE);
 
-    list = g_list_remove (list, f);
+    remove_link (f);
 
     gchar *uri_str = f->get_uri_str();
     gboolean retval = g_hash_table_remove (map, uri_str);
@@ -62,7 +73,7 @@ gboolean GnomeCmdFileCollection::remove(const gchar *uri_str)
     if (!file)
         return FALSE;
 
-    list = g_list_remove (list, file);
+    remove_link (file);
     return g_hash_table_remove (map, uri_str);
 }
 
@@ -75,10 +86,27 @@ GnomeCmdFile *GnomeCmdFileCollection::find(const gchar *uri_str)
 }
 
 
+void GnomeCmdFileCollection::remove_link(GnomeCmdFile *f)
+{
+    GList *link = g_list_find (list, f);
+
+    if (!link)
+        return;
+
+    if (link == last)
+        last = link->prev;
+
+    list = g_list_delete_link (list, link);
+    count--;
+}
+
+
 void GnomeCmdFileCollection::clear()
 {
     g_list_free (list);
     list = NULL;
+    last = NULL;
+    count = 0;
     g_hash_table_destroy (map);
     map = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) gnome_cmd_file_unref);
 }
@@ -87,6 +115,7 @@ void GnomeCmdFileCollection::clear()
 GList *GnomeCmdFileCollection::sort(GCompareDataFunc compare_func, gpointer user_data)
 {
     list = g_list_sort_with_data (list, compare_func, user_data);
+    last = g_list_last (list);
 
     return list;
 }
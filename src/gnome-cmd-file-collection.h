@@ -28,13 +28,17 @@ class GnomeCmdFileCollection
 {
     GHashTable *map;
     GList *list;
+    GList *last;                        // so that appending doesn't walk the list
+    guint count;
+
+    void remove_link(GnomeCmdFile *f);
 
   public:
 
     GnomeCmdFileCollection();
     ~GnomeCmdFileCollection();
 
-    guint size()        {  return g_list_length (list);  }
+    guint size()        {  return count;  }
     gboolean empty()    {  return list==NULL;            }
     void clear();
 
@@ -55,6 +59,8 @@ inline GnomeCmdFileCollection::GnomeCmdFileCollection()
 {
     map = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) gnome_cmd_file_unref);
     list = NULL;
+    last = NULL;
+    count = 0;
 }
 
 
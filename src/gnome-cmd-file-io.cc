@@ -0,0 +1,141 @@
+/**
+ * @file gnome-cmd-file-io.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "gnome-cmd-file-io.h"
+
+using namespace std;
+
+
+bool GnomeCmd::list_directory (const string &path, vector<string> &names, int &error)
+{
+    DIR *dir = opendir (path.c_str());
+
+    if (!dir)
+    {
+        error = errno;
+        return false;
+    }
+
+    while (struct dirent *entry = readdir (dir))
+        if (!is_dot_or_dotdot (entry->d_name))
+            names.push_back(entry->d_name);
+
+    closedir (dir);
+
+    sort(names.begin(), names.end());
+
+    return true;
+}
+
+
+ssize_t GnomeCmd::pread_all (int fd, char *buf, size_t len, off_t offset)
+{
+    size_t done = 0;
+
+    while (done < len)
+    {
+        ssize_t n = pread (fd, buf+done, len-done, offset+done);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        if (n == 0)
+            break;
+
+        done += n;
+    }
+
+    return done;
+}
+
+
+bool GnomeCmd::pwrite_all (int fd, const char *buf, size_t len, off_t offset)
+{
+    while (len > 0)
+    {
+        ssize_t n = pwrite (fd, buf, len, offset);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+
+    return true;
+}
+
+
+bool GnomeCmd::write_all (int fd, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write (fd, buf, len);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        buf += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+
+bool GnomeCmd::copy_times (int fd, const struct stat &st)
+{
+    struct timespec times[2] = {st.st_atim, st.st_mtim};
+
+    return futimens (fd, times) == 0;
+}
+
+
+int GnomeCmd::open_replacing (const char *path, int flags, mode_t mode)
+{
+    int fd = open (path, flags | O_NOFOLLOW, mode);
+
+    // O_EXCL fails with EEXIST on a symlink, without O_EXCL O_NOFOLLOW fails with ELOOP
+    if (fd < 0 && errno == ELOOP && unlink (path) == 0)
+        fd = open (path, flags | O_EXCL | O_NOFOLLOW, mode);
+
+    return fd;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file gnome-cmd-file-io.h
+ * @brief Helpers for local file I/O shared by the copy, move, delete and
+ * upload engines.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+namespace GnomeCmd
+{
+    /** What to do about a failed item, same order as GnomeVFSXferErrorAction and the buttons of the error dialog */
+    enum ErrorAction
+    {
+        ERROR_ACTION_ABORT,
+        ERROR_ACTION_RETRY,
+        ERROR_ACTION_SKIP
+    };
+
+    inline bool is_dot_or_dotdot (const char *name)
+    {
+        return name[0]=='.' && (name[1]=='\0' || (name[1]=='.' && name[2]=='\0'));
+    }
+
+    /**
+     * Appends the entries of the directory @a path to @a names, sorted and
+     * without "." and "..".
+     *
+     * @returns false with @a error set to an errno value if it can't be read
+     */
+    bool list_directory (const std::string &path, std::vector<std::string> &names, int &error);
+
+    /**
+     * Reads @a len bytes at @a offset, less only at the end of the file.
+     *
+     * @returns the number of bytes read or -1
+     */
+    ssize_t pread_all (int fd, char *buf, size_t len, off_t offset);
+
+    /** @returns false if not all of @a buf could be written, with errno set */
+    bool pwrite_all (int fd, const char *buf, size_t len, off_t offset);
+
+    /** Writes all of @a buf at the current position, @returns false with errno set if it fails */
+    bool write_all (int fd, const char *buf, size_t len);
+
+    /** Gives the open file @a fd the access and modification times of @a st */
+    bool copy_times (int fd, const struct stat &st);
+
+    /**
+     * Opens @a path for writing with @a flags, which include O_CREAT. A
+     * symlink in the way is replaced itself, not the file it points to,
+     * unless O_EXCL asks to keep what exists.
+     *
+     * @returns the fd or -1 with errno set
+     */
+    int open_replacing (const char *path, int flags, mode_t mode);
+}
@@ -23,7 +23,10 @@
 #include <stdio.h>
 #include <glib-object.h>
 
+#include <algorithm>
+
 #include "gnome-cmd-includes.h"
+#include "gnome-cmd-batch.h"
 #include "gnome-cmd-file-selector.h"
 #include "gnome-cmd-file-list.h"
 #include "gnome-cmd-file.h"
@@ -743,7 +746,7 @@ static char *build_selected_file_list (GnomeCmdFileList *fl, int *file_list_len)
     if (listlen > 1)
     {
         int total_len = 0;
-        GList *uri_str_list = nullptr;
+        GnomeCmd::Batch<gchar *> uri_strs;
 
         // create a list with the uri's of the selected files and calculate the total_length needed
         for (auto i = sel_files; i; i = i->next)
@@ -762,10 +765,12 @@ static char *build_selected_file_list (GnomeCmdFileList *fl, int *file_list_len)
                 fn = f->get_uri_str();
 
             gchar *uri_str = g_strconcat (fn, "\r\n", nullptr);
-            uri_str_list = g_list_append (uri_str_list, uri_str);
+            uri_strs.add(uri_str);
             total_len += strlen (uri_str);
         }
 
+        g_list_free (sel_files);
+
         // allocate memory
         total_len++;
 
@@ -773,18 +778,14 @@ static char *build_selected_file_list (GnomeCmdFileList *fl, int *file_list_len)
 
         data = copy = (gchar *) g_malloc (total_len+1);
 
-        // put the uri_str_list in the allocated memory
-        for (auto i = uri_str_list; i; i = i->next)
+        // put the uri strings in the allocated memory
+        for (auto uri_str : uri_strs)
         {
-            gchar *uri_str = (gchar *) i->data;
-
             strcpy (copy, uri_str);
             copy += strlen (uri_str);
+            g_free (uri_str);
         }
 
-        g_list_foreach (uri_str_list, (GFunc) g_free, nullptr);
-        g_list_free (uri_str_list);
-
         data [total_len] = '\0';
         *file_list_len = total_len;
         return data;
@@ -1969,7 +1970,7 @@ void GnomeCmdFileList::show_files(GnomeCmdDir *dir)
 {
     remove_all_files();
 
-    GList *files = nullptr;
+    GnomeCmd::Batch<GnomeCmdFile *> files;
 
     // select the files to show
     for (auto i = gnome_cmd_dir_get_files (dir); i; i = i->next)
@@ -1977,27 +1978,25 @@ void GnomeCmdFileList::show_files(GnomeCmdDir *dir)
         GnomeCmdFile *f = GNOME_CMD_FILE (i->data);
 
         if (file_is_wanted (f))
-            files = g_list_append (files, f);
+            files.add(f);
     }
 
     // Create a parent dir file (..) if appropriate
     gchar *path = GNOME_CMD_FILE (dir)->get_path();
     if (path && strcmp (path, G_DIR_SEPARATOR_S) != 0)
-        files = g_list_append (files, gnome_cmd_dir_new_parent_dir_file (dir));
+        files.add(gnome_cmd_dir_new_parent_dir_file (dir));
     g_free (path);
 
-    if (!files)
+    if (files.empty())
         return;
 
-    files = g_list_sort_with_data (files, (GCompareDataFunc) priv->sort_func, this);
+    // stable, as g_list_sort_with_data() was
+    stable_sort (files.begin(), files.end(), [this] (GnomeCmdFile *a, GnomeCmdFile *b) { return priv->sort_func (a, b, this) < 0; });
 
     gtk_clist_freeze (*this);
-    for (auto i = files; i; i = i->next)
-        append_file(GNOME_CMD_FILE (i->data));
+    for (auto f : files)
+        append_file(f);
     gtk_clist_thaw (*this);
-
-    if (files)
-        g_list_free (files);
 }
 
 
@@ -2121,6 +2120,12 @@ GList *GnomeCmdFileList::get_visible_files()
 }
 
 
+guint GnomeCmdFileList::size()
+{
+    return priv->visible_files.size();
+}
+
+
 GnomeCmdFile *GnomeCmdFileList::get_first_selected_file()
 {
     if (priv->selected_files.empty())
@@ -2323,7 +2328,7 @@ void gnome_cmd_file_list_show_rename_dialog (GnomeCmdFileList *fl)
 }
 
 
-void gnome_cmd_file_list_show_delete_dialog (GnomeCmdFileList *fl)
+void gnome_cmd_file_list_show_delete_dialog (GnomeCmdFileList *fl, gboolean force_delete)
 {
     g_return_if_fail (GNOME_CMD_IS_FILE_LIST (fl));
 
@@ -2331,7 +2336,7 @@ void gnome_cmd_file_list_show_delete_dialog (GnomeCmdFileList *fl)
 
     if (files)
     {
-        gnome_cmd_delete_dialog_show (files);
+        gnome_cmd_delete_dialog_show (files, force_delete);
         g_list_free (files);
     }
 }
@@ -2500,6 +2505,12 @@ gboolean GnomeCmdFileList::key_pressed(GdkEventKey *event)
                 show_file_popup (this, nullptr);
                 return TRUE;
 
+            // deletes even if files are moved to the trash otherwise
+            case GDK_Delete:
+            case GDK_KP_Delete:
+                gnome_cmd_file_list_show_delete_dialog (this, TRUE);
+                return TRUE;
+
             case GDK_Left:
             case GDK_KP_Left:
             case GDK_Right:
@@ -2669,7 +2680,7 @@ gboolean GnomeCmdFileList::key_pressed(GdkEventKey *event)
 
             case GDK_Delete:
             case GDK_KP_Delete:
-                gnome_cmd_file_list_show_delete_dialog (this);
+                gnome_cmd_file_list_show_delete_dialog (this, FALSE);
                 return TRUE;
 
             case GDK_Shift_L:
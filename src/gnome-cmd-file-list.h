@@ -107,7 +107,7 @@ struct GnomeCmdFileList
     GnomeCmdFileList(ColumnID sort_col, GtkSortType sort_order);
     ~GnomeCmdFileList();
 
-    guint size()                          {  return g_list_length (get_visible_files());  }
+    guint size();
     bool empty()                          {  return get_visible_files() == nullptr;            }    // FIXME should be: size()==0
     void clear();
 
@@ -249,7 +249,7 @@ inline GnomeCmdFile *GnomeCmdFileList::get_selected_file()
     return !f || f->is_dotdot ? nullptr : f;
 }
 
-void gnome_cmd_file_list_show_delete_dialog (GnomeCmdFileList *fl);
+void gnome_cmd_file_list_show_delete_dialog (GnomeCmdFileList *fl, gboolean force_delete=FALSE);
 void gnome_cmd_file_list_show_properties_dialog (GnomeCmdFileList *fl);
 void gnome_cmd_file_list_show_rename_dialog (GnomeCmdFileList *fl);
 void gnome_cmd_file_list_show_selpat_dialog (GnomeCmdFileList *fl, gboolean mode);
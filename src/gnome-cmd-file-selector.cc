@@ -33,6 +33,7 @@
 #include "gnome-cmd-main-win.h"
 #include "gnome-cmd-style.h"
 #include "gnome-cmd-dir-indicator.h"
+#include "gnome-cmd-free-space.h"
 #include "gnome-cmd-list-popmenu.h"
 #include "gnome-cmd-user-actions.h"
 #include "history.h"
@@ -225,7 +226,19 @@ inline void GnomeCmdFileSelector::update_direntry()
 }
 
 
-inline void GnomeCmdFileSelector::update_vol_label()
+static gboolean update_vol_labels (gpointer)
+{
+    if (main_win)
+    {
+        main_win->fs(LEFT)->update_vol_label();
+        main_win->fs(RIGHT)->update_vol_label();
+    }
+
+    return FALSE;
+}
+
+
+void GnomeCmdFileSelector::update_vol_label()
 {
     GnomeCmdCon *con = get_connection();
 
@@ -234,6 +247,38 @@ inline void GnomeCmdFileSelector::update_vol_label()
 
     g_return_if_fail (GNOME_CMD_IS_CON (con));
 
+    // local volumes are asked in the background, so that a slow mount does not block the GUI;
+    // the label is filled in when the result is there
+    if (gnome_cmd_con_is_local (con) && gnome_cmd_con_can_show_free_space (con) && get_directory())
+    {
+        static gboolean watching = FALSE;
+        GnomeCmd::FreeSpace &free_space = GnomeCmd::FreeSpace::get_default();
+
+        // set before the first get(), which starts the thread calling it
+        if (!watching)
+        {
+            free_space.on_updated = [] (const string &) { g_idle_add (update_vol_labels, nullptr); };
+            watching = TRUE;
+        }
+
+        gchar *path = GNOME_CMD_FILE (get_directory())->get_real_path();
+        GnomeCmd::FreeSpace::Space space;
+        gchar *s = nullptr;
+
+        if (path && free_space.get(path, space))
+        {
+            gchar *size = gnome_vfs_format_file_size_for_display (space.avail);
+            s = g_strdup_printf (_("%s free"), size);
+            g_free (size);
+        }
+
+        gtk_label_set_text (GTK_LABEL (vol_label), s ? s : "");
+        g_free (s);
+        g_free (path);
+
+        return;
+    }
+
     gchar *s = gnome_cmd_con_get_free_space (con, get_directory(), _("%s free"));
     gtk_label_set_text (GTK_LABEL (vol_label), s ? s : "");
     g_free (s);
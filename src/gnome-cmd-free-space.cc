@@ -0,0 +1,379 @@
+/**
+ * @file gnome-cmd-free-space.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_QUOTA_H
+#include <sys/quota.h>
+#endif
+
+#include <algorithm>
+#include <sstream>
+
+#include "gnome-cmd-free-space.h"
+
+using namespace std;
+
+
+/**
+ * Decodes the octal escapes of spaces, tabs, newlines and backslashes in mountinfo.
+ */
+static string unescape (const string &s)
+{
+    string result;
+
+    for (size_t i=0; i<s.size(); ++i)
+        if (s[i] == '\\' && i+3 < s.size() && isdigit (s[i+1]) && isdigit (s[i+2]) && isdigit (s[i+3]))
+        {
+            result += (char) ((s[i+1]-'0')*64 + (s[i+2]-'0')*8 + (s[i+3]-'0'));
+            i += 3;
+        }
+        else
+            result += s[i];
+
+    return result;
+}
+
+
+static bool is_below (const string &path, const string &dir)
+{
+    if (dir == "/")
+        return path[0] == '/';
+
+    return path.compare(0, dir.size(), dir) == 0 && (path.size() == dir.size() || path[dir.size()] == '/');
+}
+
+
+bool GnomeCmd::FreeSpace::parse_mountinfo(istream &in, vector<Mount> &mounts)
+{
+    string line;
+
+    mounts.clear();
+
+    while (getline (in, line))
+    {
+        // 36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+        istringstream fields(line);
+        string id, parent, dev, root, mount_point, options, field;
+        Mount mount;
+
+        if (!(fields >> id >> parent >> dev >> root >> mount_point >> options))
+            continue;
+
+        // optional fields up to the separator
+        while (fields >> field && field != "-")
+            ;
+
+        if (field != "-" || !(fields >> mount.fs_type >> mount.source))
+            continue;
+
+        if (sscanf (dev.c_str(), "%u:%u", &mount.dev_major, &mount.dev_minor) != 2)
+            continue;
+
+        mount.mount_point = unescape (mount_point);
+        mount.source = unescape (mount.source);
+        mounts.push_back(mount);
+    }
+
+    return !mounts.empty();
+}
+
+
+GnomeCmd::FreeSpace::FreeSpace(chrono::milliseconds t, const string &mountinfo): ttl(t), mountinfo_path(mountinfo)
+{
+}
+
+
+GnomeCmd::FreeSpace::~FreeSpace()
+{
+    {
+        lock_guard<mutex> lock(cache_mutex);
+        stopping = true;
+    }
+
+    refresh_cond.notify_all();
+
+    if (refresher.joinable())
+        refresher.join();
+
+    if (mountinfo_fd >= 0)
+        close (mountinfo_fd);
+}
+
+
+GnomeCmd::FreeSpace &GnomeCmd::FreeSpace::get_default()
+{
+    static FreeSpace *instance = new FreeSpace;
+
+    return *instance;
+}
+
+
+/**
+ * Reads the mount table through mountinfo_fd, which also resets the change notification.
+ */
+bool GnomeCmd::FreeSpace::load_mounts()
+{
+    if (mountinfo_fd < 0)
+        mountinfo_fd = open (mountinfo_path.c_str(), O_RDONLY|O_CLOEXEC);
+
+    if (mountinfo_fd < 0 || lseek (mountinfo_fd, 0, SEEK_SET) != 0)
+        return false;
+
+    string text;
+    char buf[8192];
+    ssize_t n;
+
+    while ((n = read (mountinfo_fd, buf, sizeof(buf))) > 0)
+        text.append(buf, n);
+
+    istringstream in(text);
+
+    return parse_mountinfo(in, mounts);
+}
+
+
+bool GnomeCmd::FreeSpace::find_mount(const string &path, Mount &mount)
+{
+    struct stat st;
+    bool have_dev = stat (path.c_str(), &st) == 0;
+
+    lock_guard<mutex> lock(mounts_mutex);
+
+    // the kernel flags mountinfo when something is mounted or unmounted
+    struct pollfd p = {mountinfo_fd, POLLPRI, 0};
+
+    if (mountinfo_fd < 0 || (poll (&p, 1, 0) > 0 && (p.revents & (POLLPRI|POLLERR))))
+        load_mounts();
+
+    // a mount of the device the path is on wins over one which only is a prefix
+    // of the path, e.g. for symlinks; then the longest prefix and the later mount
+    const Mount *best = nullptr;
+    pair<bool,size_t> best_rank;
+
+    for (auto &m : mounts)
+    {
+        bool on_dev = have_dev && major (st.st_dev) == m.dev_major && minor (st.st_dev) == m.dev_minor;
+        bool below = is_below (path, m.mount_point);
+
+        if (!on_dev && !below)
+            continue;
+
+        pair<bool,size_t> rank = make_pair(on_dev, below ? m.mount_point.size() : 0);
+
+        if (!best || rank >= best_rank)
+        {
+            best = &m;
+            best_rank = rank;
+        }
+    }
+
+    if (!best)
+        return false;
+
+    mount = *best;
+
+    return true;
+}
+
+
+bool GnomeCmd::FreeSpace::lookup(const string &path, Mount &mount)
+{
+    return find_mount(path, mount);
+}
+
+
+bool GnomeCmd::FreeSpace::query(const string &path, const Mount *mount, Space &space)
+{
+    struct statvfs sv;
+
+    if (statvfs (path.c_str(), &sv) != 0)
+        return false;
+
+    space.block_size = sv.f_frsize ? sv.f_frsize : sv.f_bsize;
+    space.size = (uint64_t) sv.f_blocks * space.block_size;
+    space.free = (uint64_t) sv.f_bfree * space.block_size;
+    space.avail = (uint64_t) sv.f_bavail * space.block_size;
+    space.files = sv.f_files;
+    space.files_avail = sv.f_favail;
+    space.read_only = (sv.f_flag & ST_RDONLY) != 0;
+
+#ifdef HAVE_SYS_QUOTA_H
+    struct dqblk dq;
+
+    // no quota, no quota support and no block device all end up here as errors
+    if (mount && mount->source[0] == '/' &&
+        quotactl (QCMD (Q_GETQUOTA, USRQUOTA), mount->source.c_str(), getuid (), (caddr_t) &dq) == 0)
+    {
+        if ((dq.dqb_valid & QIF_BLIMITS) && dq.dqb_bhardlimit)
+        {
+            uint64_t limit = (uint64_t) dq.dqb_bhardlimit * QIF_DQBLKSIZE;
+            space.avail = min (space.avail, limit > dq.dqb_curspace ? limit - dq.dqb_curspace : 0);
+        }
+
+        if ((dq.dqb_valid & QIF_ILIMITS) && dq.dqb_ihardlimit)
+            space.files_avail = min<uint64_t> (space.files_avail, dq.dqb_ihardlimit > dq.dqb_curinodes ? dq.dqb_ihardlimit - dq.dqb_curinodes : 0);
+    }
+#else
+    (void) mount;
+#endif
+
+    return true;
+}
+
+
+bool GnomeCmd::FreeSpace::get(const string &path, Space &space, bool wait)
+{
+    Mount mount;
+    bool known = find_mount(path, mount);
+    string key = known ? mount.mount_point : path;
+
+    unique_lock<mutex> lock(cache_mutex);
+
+    Entry &entry = cache[key];
+
+    if (entry.valid && chrono::steady_clock::now() - entry.fetched < ttl)
+    {
+        space = entry.space;
+        return true;
+    }
+
+    if (wait)
+    {
+        lock.unlock();
+
+        Space fresh;
+
+        if (!query(path, known ? &mount : nullptr, fresh))
+            return false;
+
+        lock.lock();
+
+        Entry &e = cache[key];
+
+        e.space = fresh;
+        e.probe = path;
+        e.fetched = chrono::steady_clock::now();
+        e.valid = true;
+        space = fresh;
+
+        return true;
+    }
+
+    entry.probe = path;
+
+    if (!entry.pending)
+    {
+        entry.pending = true;
+        to_refresh.insert(key);
+
+        if (!refresher.joinable())
+            refresher = thread(&FreeSpace::refresh_loop, this);
+
+        refresh_cond.notify_one();
+    }
+
+    if (entry.valid)
+        space = entry.space;
+
+    return entry.valid;
+}
+
+
+void GnomeCmd::FreeSpace::invalidate(const string &path)
+{
+    Mount mount;
+    string key = find_mount(path, mount) ? mount.mount_point : path;
+
+    lock_guard<mutex> lock(cache_mutex);
+
+    auto i = cache.find(key);
+
+    if (i != cache.end())
+        i->second.fetched = chrono::steady_clock::time_point();
+}
+
+
+void GnomeCmd::FreeSpace::refresh_loop()
+{
+    unique_lock<mutex> lock(cache_mutex);
+
+    for (;;)
+    {
+        refresh_cond.wait(lock, [this] { return stopping || !to_refresh.empty(); });
+
+        if (stopping)
+            return;
+
+        string key = *to_refresh.begin();
+        string probe = cache[key].probe;
+
+        to_refresh.erase(to_refresh.begin());
+
+        lock.unlock();
+
+        Mount mount;
+        Space space;
+        bool known = find_mount(probe, mount);
+        bool ok = query(probe, known ? &mount : nullptr, space);
+
+        lock.lock();
+
+        Entry &entry = cache[key];
+
+        entry.pending = false;
+
+        if (!ok)
+            continue;
+
+        entry.space = space;
+        entry.fetched = chrono::steady_clock::now();
+        entry.valid = true;
+
+        if (on_updated)
+        {
+            lock.unlock();
+            on_updated(key);
+            lock.lock();
+        }
+    }
+}
+
+
+GnomeCmd::FreeSpace::Verdict GnomeCmd::FreeSpace::check(const Space &space, uint64_t bytes, uint64_t files)
+{
+    if (space.read_only)
+        return READ_ONLY;
+
+    if (bytes + files * space.block_size > space.avail)
+        return TOO_LITTLE_SPACE;
+
+    if (space.files && files > space.files_avail)
+        return TOO_FEW_INODES;
+
+    return FITS;
+}
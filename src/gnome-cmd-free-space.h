@@ -0,0 +1,160 @@
+/**
+ * @file gnome-cmd-free-space.h
+ * @brief Free space of local volumes, cached per mount.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace GnomeCmd
+{
+    /**
+     * Tells how much space is left on the volume of a local path.
+     *
+     * Paths are mapped to their mount with /proc/self/mountinfo, which is
+     * read again only when the kernel reports a change of the mount table.
+     * The statvfs results are cached per mount for a short time. get()
+     * returns a stale result at once and refreshes it in a background
+     * thread, so that a slow or hanging network mount does not block the
+     * caller; on_updated is called from that thread when the result is
+     * there.
+     *
+     * Where a user quota is set, the space and number of files left are
+     * limited to what the quota allows.
+     */
+    class FreeSpace
+    {
+      public:
+
+        struct Mount
+        {
+            unsigned dev_major {0};
+            unsigned dev_minor {0};
+            std::string mount_point;
+            std::string fs_type;
+            std::string source;
+        };
+
+        struct Space
+        {
+            uint64_t size {0};
+            uint64_t free {0};              /**< including the blocks reserved for root */
+            uint64_t avail {0};             /**< usable by the user, within the quota */
+            uint64_t files {0};             /**< inodes of the volume, 0 if it has no fixed number */
+            uint64_t files_avail {0};       /**< inodes usable by the user, within the quota */
+            uint64_t block_size {0};
+            bool read_only {false};
+        };
+
+        enum Verdict
+        {
+            FITS,
+            TOO_LITTLE_SPACE,
+            TOO_FEW_INODES,
+            READ_ONLY
+        };
+
+        typedef std::function<void (const std::string &mount_point)> UpdatedFunc;
+
+      private:
+
+        struct Entry
+        {
+            Space space;
+            std::string probe;              /**< path passed to statvfs, the mount point may not be accessible */
+            std::chrono::steady_clock::time_point fetched;
+            bool valid {false};
+            bool pending {false};
+        };
+
+        std::chrono::milliseconds ttl;
+        std::string mountinfo_path;
+
+        std::mutex mounts_mutex;
+        std::vector<Mount> mounts;
+        int mountinfo_fd {-1};              /**< polled for changes of the mount table */
+
+        std::mutex cache_mutex;
+        std::condition_variable refresh_cond;
+        std::map<std::string,Entry> cache;
+        std::set<std::string> to_refresh;
+        std::thread refresher;
+        bool stopping {false};
+
+        bool load_mounts();
+        bool find_mount(const std::string &path, Mount &mount);
+        void refresh_loop();
+        static bool query(const std::string &path, const Mount *mount, Space &space);
+
+      public:
+
+        UpdatedFunc on_updated;             /**< called by the background thread */
+
+        explicit FreeSpace(std::chrono::milliseconds ttl=std::chrono::milliseconds(2000), const std::string &mountinfo="/proc/self/mountinfo");
+        ~FreeSpace();
+
+        /**
+         * The instance shared by the volume labels and transfers. It is never
+         * destroyed, so that a statvfs hanging on a network mount can't
+         * block the exit.
+         */
+        static FreeSpace &get_default();
+
+        /**
+         * @returns false if @a path is on no known mount
+         */
+        bool lookup(const std::string &path, Mount &mount);
+
+        /**
+         * Fills @a space for the volume of @a path. Without @a wait a result
+         * older than the TTL is returned as it is and refreshed in the
+         * background.
+         *
+         * @returns false if nothing is known about the volume yet, or if it
+         * can't be queried
+         */
+        bool get(const std::string &path, Space &space, bool wait=false);
+
+        /**
+         * Marks the cached result for the volume of @a path as outdated, e.g.
+         * after a transfer to it.
+         */
+        void invalidate(const std::string &path);
+
+        /**
+         * Checks whether @a bytes in @a files fit into @a space. Every file
+         * is assumed to take a block more than its size, for its metadata
+         * and its last partial block.
+         */
+        static Verdict check(const Space &space, uint64_t bytes, uint64_t files);
+
+        static bool parse_mountinfo(std::istream &in, std::vector<Mount> &mounts);
+    };
+}
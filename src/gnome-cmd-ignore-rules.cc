@@ -0,0 +1,460 @@
+/**
+ * @file gnome-cmd-ignore-rules.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gnome-cmd-ignore-rules.h"
+
+using namespace std;
+
+
+static const char *IGNORE_FILES[] = {".gitignore", ".ignore"};     // in the order of their precedence, lowest first
+
+
+// .git is a directory, or a file in linked work trees and submodules
+inline bool is_work_tree(const string &dir)
+{
+    struct stat st;
+
+    string git = dir == "/" ? "/.git" : dir + "/.git";
+
+    return lstat (git.c_str(), &st) == 0;
+}
+
+
+/**
+ * Matches the character @a c against the class starting at @a p.
+ *
+ * @returns the closing ']' or NULL if there is none, then '[' is no class
+ */
+static const char *match_class(const char *p, char c, bool &matched)
+{
+    bool negate = *++p == '!' || *p == '^';
+
+    if (negate)
+        ++p;
+
+    const char *start = p;
+
+    matched = false;
+
+    for (; *p && (*p != ']' || p == start); ++p)
+    {
+        char lo = *p;
+
+        if (lo == '\\' && p[1])
+            lo = *++p;
+
+        if (p[1] == '-' && p[2] && p[2] != ']')
+        {
+            p += 2;
+
+            char hi = *p;
+
+            if (hi == '\\' && p[1])
+                hi = *++p;
+
+            if (lo <= c && c <= hi)
+                matched = true;
+        }
+        else
+            if (c == lo)
+                matched = true;
+    }
+
+    if (*p != ']')
+        return NULL;
+
+    matched = matched != negate && c != '/';
+
+    return p;
+}
+
+
+bool GnomeCmd::IgnoreRules::glob_match(const char *p, const char *s)
+{
+    for (; *p; ++p, ++s)
+    {
+        if (*p == '*')
+        {
+            if (p[1] != '*')
+            {
+                for (++p;; ++s)
+                {
+                    if (glob_match(p, s))
+                        return true;
+
+                    if (!*s || *s == '/')
+                        return false;
+                }
+            }
+
+            p += 2;
+
+            // "**/" matches no directory or any number of them
+            if (*p == '/')
+            {
+                for (++p;; ++s)
+                {
+                    if (glob_match(p, s))
+                        return true;
+
+                    s = strchr (s, '/');
+
+                    if (!s)
+                        return false;
+                }
+            }
+
+            for (;; ++s)
+            {
+                if (glob_match(p, s))
+                    return true;
+
+                if (!*s)
+                    return false;
+            }
+        }
+
+        if (!*s)
+            return false;
+
+        if (*p == '?')
+        {
+            if (*s == '/')
+                return false;
+
+            continue;
+        }
+
+        if (*p == '[')
+        {
+            bool matched;
+
+            if (const char *end = match_class(p, *s, matched))
+            {
+                if (!matched)
+                    return false;
+
+                p = end;
+                continue;
+            }
+        }
+        else
+            if (*p == '\\' && p[1])
+                ++p;
+
+        if (*p != *s)
+            return false;
+    }
+
+    return !*s;
+}
+
+
+inline bool GnomeCmd::IgnoreRules::Rule::match(const char *subject, size_t len) const
+{
+    switch (kind)
+    {
+        case KIND_LITERAL:
+            return len == pattern.size() && memcmp (subject, pattern.data(), len) == 0;
+
+        case KIND_PREFIX:
+            return len >= pattern.size() && memcmp (subject, pattern.data(), pattern.size()) == 0;
+
+        case KIND_SUFFIX:
+            return len >= pattern.size() && memcmp (subject + len - pattern.size(), pattern.data(), pattern.size()) == 0;
+
+        default:
+            return glob_match(pattern.c_str(), subject);
+    }
+}
+
+
+/**
+ * Adds the rule of one line of an ignore file or one exclude glob, if it
+ * is not empty or a comment.
+ */
+void GnomeCmd::IgnoreRules::add_rule(vector<Rule> &rules, string line)
+{
+    if (line.empty() || line[0] == '#')
+        return;
+
+    Rule rule;
+
+    rule.negate = line[0] == '!';
+
+    if (rule.negate)
+        line.erase(0, 1);
+    else
+        if (line[0] == '\\' && (line[1] == '!' || line[1] == '#'))
+            line.erase(0, 1);
+
+    rule.dir_only = !line.empty() && line.back() == '/';
+
+    if (rule.dir_only)
+        line.pop_back();
+
+    // a slash at the start or in the middle anchors the pattern to the directory of the rule
+    rule.anchored = line.find('/') != string::npos;
+
+    if (rule.anchored && line[0] == '/')
+        line.erase(0, 1);
+
+    if (line.empty())
+        return;
+
+    size_t special = line.find_first_of("*?[\\");
+
+    // the plain forms are compared without the glob matcher, '*' does not match a '/' in a name anyway
+    if (special == string::npos)
+    {
+        rule.kind = Rule::KIND_LITERAL;
+        rule.pattern = line;
+    }
+    else
+        if (!rule.anchored && line.size() > 1 && special == 0 && line.find_first_of("*?[\\", 1) == string::npos)
+        {
+            rule.kind = Rule::KIND_SUFFIX;
+            rule.pattern = line.substr(1);
+        }
+        else
+            if (!rule.anchored && special == line.size() - 1 && line.back() == '*')
+            {
+                rule.kind = Rule::KIND_PREFIX;
+                rule.pattern = line.substr(0, special);
+            }
+            else
+            {
+                rule.kind = Rule::KIND_GLOB;
+                rule.pattern = line;
+            }
+
+    rules.push_back(move (rule));
+}
+
+
+bool GnomeCmd::IgnoreRules::read_ignore_file(int dir_fd, const char *name, vector<Rule> &rules)
+{
+    int fd = openat (dir_fd, name, O_RDONLY|O_NOFOLLOW|O_CLOEXEC|O_NOCTTY|O_NONBLOCK);
+
+    if (fd < 0)
+        return false;
+
+    string text;
+    char buf[8192];
+    ssize_t n;
+
+    while (text.size() < MAX_FILE_SIZE && (n = read (fd, buf, sizeof(buf))) > 0)
+        text.append(buf, n);
+
+    close (fd);
+
+    for (size_t pos = 0; pos < text.size();)
+    {
+        size_t end = text.find('\n', pos);
+
+        if (end == string::npos)
+            end = text.size();
+
+        string line = text.substr(pos, end - pos);
+
+        pos = end + 1;
+
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        // trailing blanks do not count unless escaped
+        while (!line.empty() && line.back() == ' ' && (line.size() < 2 || line[line.size() - 2] != '\\'))
+            line.pop_back();
+
+        add_rule(rules, move (line));
+    }
+
+    return true;
+}
+
+
+GnomeCmd::IgnoreRules::IgnoreRules(const string &exclude_globs, bool use_ignore_files): use_ignore_files(use_ignore_files)
+{
+    vector<Rule> rules;
+
+    for (size_t pos = 0; pos < exclude_globs.size();)
+    {
+        size_t end = exclude_globs.find_first_of(";\n", pos);
+
+        if (end == string::npos)
+            end = exclude_globs.size();
+
+        size_t first = exclude_globs.find_first_not_of(" \t\r", pos);
+        size_t last = exclude_globs.find_last_not_of(" \t\r", end - 1);
+
+        if (first < end && last != string::npos && last >= first)
+            add_rule(rules, exclude_globs.substr(first, last - first + 1));
+
+        pos = end + 1;
+    }
+
+    if (!rules.empty())
+    {
+        auto frame = make_shared<Frame>();
+
+        frame->rules = move (rules);
+        globs = move (frame);
+    }
+}
+
+
+GnomeCmd::IgnoreRules::FramePtr GnomeCmd::IgnoreRules::load(const FramePtr &parent, int dir_fd, const string &dir) const
+{
+    vector<Rule> rules;
+
+    for (auto name : IGNORE_FILES)
+        read_ignore_file(dir_fd, name, rules);
+
+    if (rules.empty())
+        return parent;
+
+    auto frame = make_shared<Frame>();
+
+    frame->parent = parent;
+    frame->dir = dir;
+    frame->rules = move (rules);
+
+    return frame;
+}
+
+
+GnomeCmd::IgnoreRules::FramePtr GnomeCmd::IgnoreRules::enter_root(const string &path) const
+{
+    string root = path.size() > 1 && path.back() == '/' ? path.substr(0, path.size() - 1) : path;
+    FramePtr frame;
+
+    // the anchored globs are relative to the root of the walk
+    if (globs)
+    {
+        auto f = make_shared<Frame>(*globs);
+
+        f->dir = root;
+        frame = move (f);
+    }
+
+    if (!use_ignore_files || root.empty() || root[0] != '/')
+        return frame;
+
+    // inside a git work tree, the ignore files of the directories above the root apply as well
+    if (root == "/" || is_work_tree(root))
+        return frame;
+
+    vector<string> above;
+
+    for (string dir = root; dir != "/";)
+    {
+        size_t slash = dir.rfind('/');
+
+        dir = slash == 0 ? "/" : dir.substr(0, slash);
+        above.push_back(dir);
+
+        if (is_work_tree(dir))
+            break;
+
+        if (dir == "/")
+            return frame;
+    }
+
+    for (auto dir = above.rbegin(); dir != above.rend(); ++dir)
+    {
+        int fd = open (dir->c_str(), O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+
+        if (fd < 0)
+            continue;
+
+        frame = load(frame, fd, *dir);
+        close (fd);
+    }
+
+    return frame;
+}
+
+
+GnomeCmd::IgnoreRules::FramePtr GnomeCmd::IgnoreRules::enter(const FramePtr &parent, int fd, const string &path) const
+{
+    if (!use_ignore_files)
+        return parent;
+
+    return load(parent, fd, path.size() > 1 && path.back() == '/' ? path.substr(0, path.size() - 1) : path);
+}
+
+
+bool GnomeCmd::IgnoreRules::excluded(const Frame *frame, const string &dir, const char *name, bool is_dir) const
+{
+    if (use_ignore_files && strcmp (name, ".git") == 0)
+        return true;
+
+    size_t name_len = strlen (name);
+    size_t dir_len = dir.size() > 1 && dir.back() == '/' ? dir.size() - 1 : dir.size();
+    string path;                                            // below the directory of a frame, made for anchored rules only
+
+    // the innermost frame and the last rule of a frame decide
+    for (; frame; frame = frame->parent.get())
+    {
+        bool have_path = false;
+
+        for (auto rule = frame->rules.rbegin(); rule != frame->rules.rend(); ++rule)
+        {
+            if (rule->dir_only && !is_dir)
+                continue;
+
+            bool matched;
+
+            if (rule->anchored)
+            {
+                if (!have_path)
+                {
+                    size_t skip = frame->dir == "/" ? 1 : frame->dir.size() + 1;
+
+                    path.clear();
+
+                    if (skip < dir_len)
+                    {
+                        path.append(dir, skip, dir_len - skip);
+                        path += '/';
+                    }
+
+                    path += name;
+                    have_path = true;
+                }
+
+                matched = rule->match(path.c_str(), path.size());
+            }
+            else
+                matched = rule->match(name, name_len);
+
+            if (matched)
+                return !rule->negate;
+        }
+    }
+
+    return false;
+}
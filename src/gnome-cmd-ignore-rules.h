@@ -0,0 +1,138 @@
+/**
+ * @file gnome-cmd-ignore-rules.h
+ * @brief Pruning directory walks by exclude globs and .gitignore files.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace GnomeCmd
+{
+    /**
+     * Decides which entries a directory walk leaves out, so that whole
+     * subtrees like .git, node_modules or build directories are pruned
+     * before they are listed.
+     *
+     * The rules are exclude globs, one per line or separated by ';', and
+     * optionally the .gitignore and .ignore files of the directories
+     * walked through, all in the syntax of .gitignore:
+     *
+     *   *.o            a name at any depth
+     *   build/         a directory only
+     *   /TODO          relative to the directory of the rules
+     *   !keep.o        includes again what an earlier rule excludes
+     *
+     * Unlike '*' and '?', a "**" also matches the slashes between directories.
+     * Rules of a deeper directory win over those above it, the .ignore file
+     * of a directory over its .gitignore and both over the exclude globs.
+     * With the ignore files, .git is left out as git does and, if the walk
+     * starts inside a git work tree, the ignore files of the directories
+     * above it up to the top of the work tree apply as well.
+     *
+     * The rules of a directory are kept in a Frame which points to the one
+     * of the directory above it. Frames are shared by the threads of a walk
+     * and a directory without ignore files shares that of its parent.
+     */
+    class IgnoreRules
+    {
+      public:
+
+        enum
+        {
+            MAX_FILE_SIZE = 1024 * 1024     /**< of an ignore file, the rest is not read */
+        };
+
+        struct Frame;
+        typedef std::shared_ptr<const Frame> FramePtr;
+
+      private:
+
+        struct Rule
+        {
+            enum Kind
+            {
+                KIND_LITERAL,
+                KIND_PREFIX,
+                KIND_SUFFIX,
+                KIND_GLOB
+            };
+
+            Kind kind;
+            std::string pattern;            /**< the literal part for the plain kinds */
+            bool negate;
+            bool dir_only;
+            bool anchored;                  /**< matched against the path below the directory of the rule, else the name */
+
+            bool match(const char *subject, size_t len) const;
+        };
+
+      public:
+
+        struct Frame
+        {
+            FramePtr parent;
+            std::string dir;                /**< whose rules these are, without a trailing '/' */
+            std::vector<Rule> rules;
+        };
+
+      private:
+
+        FramePtr globs;
+        bool use_ignore_files;
+
+        static void add_rule(std::vector<Rule> &rules, std::string line);
+        static bool read_ignore_file(int dir_fd, const char *name, std::vector<Rule> &rules);
+        FramePtr load(const FramePtr &parent, int dir_fd, const std::string &dir) const;
+
+      public:
+
+        IgnoreRules(const std::string &exclude_globs, bool use_ignore_files);
+
+        /**
+         * @returns false if nothing is ever excluded
+         */
+        bool active() const                 {  return globs || use_ignore_files;  }
+
+        /**
+         * @returns the rules which apply above the root @a path of a walk,
+         * to be passed to enter() for the root itself
+         */
+        FramePtr enter_root(const std::string &path) const;
+
+        /**
+         * @returns the rules for the directory @a path, open as @a fd,
+         * which is below the one of @a parent
+         */
+        FramePtr enter(const FramePtr &parent, int fd, const std::string &path) const;
+
+        /**
+         * @param frame the rules returned by enter() for @a dir
+         * @returns true if the entry @a name of @a dir is to be left out
+         */
+        bool excluded(const Frame *frame, const std::string &dir, const char *name, bool is_dir) const;
+
+        /**
+         * Matches @a s against the glob @a p, whose '*' and '?' do not match
+         * a '/', unlike its '**'.
+         */
+        static bool glob_match(const char *p, const char *s);
+    };
+}
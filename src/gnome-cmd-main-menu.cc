@@ -223,6 +223,7 @@ static GtkUIManager *get_file_menu_ui_manager()
     "      <separator/>"
     "      <menuitem action='Diff'/>"
     "      <menuitem action='SyncDirs'/>"
+    "      <menuitem action='FindDuplicates'/>"
     "      <separator/>"
     "      <menuitem action='StartAsRoot'/>"
     "      <separator/>"
@@ -310,6 +311,7 @@ static GtkUIManager *get_file_menu_ui_manager()
         { "EnableFilter",       GTK_STOCK_CLEAR, _("_Enable Filter…"),    nullptr, nullptr, (GCallback) edit_filter },
         { "Diff",               nullptr, _("_Diff"),                      nullptr, nullptr, (GCallback) file_diff },
         { "SyncDirs",           nullptr, _("S_ynchronize Directories"),   nullptr, nullptr, (GCallback) file_sync_dirs },
+        { "FindDuplicates",     nullptr, _("Find D_uplicates…"),          nullptr, nullptr, (GCallback) file_find_duplicates },
         { "StartAsRoot",        GTK_STOCK_DIALOG_AUTHENTICATION,          _("Start _GNOME Commander as root"), nullptr, nullptr, (GCallback) command_root_mode },
         { "Quit",               GTK_STOCK_QUIT, _("_Quit"), "<Control>Q", nullptr, (GCallback) file_exit }
     };
@@ -0,0 +1,721 @@
+/**
+ * @file gnome-cmd-name-index.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+
+#include "gnome-cmd-name-index.h"
+
+using namespace std;
+
+
+static const char MAGIC[8] = {'G', 'C', 'M', 'D', 'N', 'I', 'X', '\n'};
+static const uint32_t VERSION = 1;
+
+
+inline size_t padded(size_t n)
+{
+    return (n + 7) & ~(size_t) 7;
+}
+
+
+/**
+ * @returns @a path without trailing slashes
+ */
+static string normalize(string path)
+{
+    while (path.size() > 1 && path.back() == '/')
+        path.pop_back();
+
+    return path;
+}
+
+
+GnomeCmd::NameIndex::NameIndex(const string &f): file(f)
+{
+}
+
+
+GnomeCmd::NameIndex::~NameIndex()
+{
+    unmap();
+}
+
+
+void GnomeCmd::NameIndex::unmap()
+{
+    if (map)
+        munmap (map, map_size);
+
+    map = nullptr;
+    map_size = 0;
+    header = nullptr;
+    dirs = nullptr;
+    entries = nullptr;
+    names = nullptr;
+    root.clear();
+}
+
+
+bool GnomeCmd::NameIndex::load()
+{
+    unmap();
+
+    int fd = open (file.c_str(), O_RDONLY|O_CLOEXEC);
+
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+
+    if (fstat (fd, &st) != 0 || (size_t) st.st_size < sizeof(Header))
+    {
+        close (fd);
+        return false;
+    }
+
+    void *p = mmap (nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+
+    if (p == MAP_FAILED)
+        return false;
+
+    map = p;
+    map_size = st.st_size;
+
+    const Header *h = (const Header *) map;
+    const char *base = (const char *) map;
+    uint64_t dirs_offset = sizeof(Header) + padded(h->root_size);
+    uint64_t entries_offset = dirs_offset + (uint64_t) h->dirs * sizeof(Dir);
+    uint64_t names_offset = entries_offset + (uint64_t) h->entries * sizeof(Entry);
+
+    if (memcmp (h->magic, MAGIC, sizeof(MAGIC)) != 0 || h->version != VERSION ||
+        h->root_size == 0 || h->dirs == 0 || h->names_size == 0 ||
+        names_offset > map_size || h->names_size != map_size - names_offset)
+    {
+        unmap();
+        return false;
+    }
+
+    const Dir *d = (const Dir *) (base + dirs_offset);
+    const Entry *e = (const Entry *) (base + entries_offset);
+    const char *n = base + names_offset;
+
+    if (n[h->names_size - 1] != '\0')
+    {
+        unmap();
+        return false;
+    }
+
+    // nothing in the file is trusted, every offset is checked once here
+    for (uint32_t i=0; i<h->dirs; ++i)
+        if ((i == 0 ? d[i].parent != NONE : d[i].parent >= i) || d[i].name >= h->names_size ||
+            (uint64_t) d[i].first + d[i].count > h->entries || d[i].end <= i || d[i].end > h->dirs)
+        {
+            unmap();
+            return false;
+        }
+
+    for (uint32_t i=0; i<h->entries; ++i)
+        if (e[i].name >= h->names_size || (e[i].child != NONE && e[i].child >= h->dirs))
+        {
+            unmap();
+            return false;
+        }
+
+    header = h;
+    dirs = d;
+    entries = e;
+    names = n;
+    root.assign(base + sizeof(Header), strnlen (base + sizeof(Header), h->root_size));
+
+    return true;
+}
+
+
+struct GnomeCmd::NameIndex::Builder
+{
+    const NameIndex *prev;
+    const atomic<bool> *stop;
+
+    vector<Dir> dirs;
+    vector<Entry> entries;
+    string names;
+    string path;                            /**< of the directory being read */
+
+    uint32_t read {0};
+    uint32_t reused {0};
+
+    uint32_t add_name(const char *name)
+    {
+        uint32_t offset = names.size();
+        names.append(name);
+        names.push_back('\0');
+        return offset;
+    }
+
+    static uint8_t type_of(unsigned char d_type, int dir_fd, const char *name);
+    bool walk(uint32_t parent, uint32_t name, uint32_t depth, uint32_t prev_dir);
+};
+
+
+uint8_t GnomeCmd::NameIndex::Builder::type_of(unsigned char d_type, int dir_fd, const char *name)
+{
+    if (d_type == DT_UNKNOWN)
+    {
+        struct stat st;
+
+        if (fstatat (dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+            return TYPE_OTHER;
+
+        return S_ISDIR (st.st_mode) ? TYPE_DIR : S_ISREG (st.st_mode) ? TYPE_FILE : S_ISLNK (st.st_mode) ? TYPE_LINK : TYPE_OTHER;
+    }
+
+    return d_type == DT_DIR ? TYPE_DIR : d_type == DT_REG ? TYPE_FILE : d_type == DT_LNK ? TYPE_LINK : TYPE_OTHER;
+}
+
+
+/**
+ * Adds the directory at path, then all its entries and then, one after
+ * the other, the subtrees of its subdirectories.
+ *
+ * @returns false if stopped
+ */
+bool GnomeCmd::NameIndex::Builder::walk(uint32_t parent, uint32_t name, uint32_t depth, uint32_t prev_dir)
+{
+    if (stop && *stop)
+        return false;
+
+    uint32_t d = dirs.size();
+    uint32_t first = entries.size();
+
+    dirs.push_back({parent, name, first, 0, 0, depth, 0, 0, 0});
+
+    int fd = open (path.c_str(), O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC);
+    struct stat st;
+
+    if (fd >= 0 && fstat (fd, &st) != 0)
+    {
+        close (fd);
+        fd = -1;
+    }
+
+    // an unreadable directory is kept empty, with no mtime it is read again next time
+    if (fd < 0)
+    {
+        dirs[d].end = d + 1;
+        return true;
+    }
+
+    dirs[d].mtime_sec = st.st_mtim.tv_sec;
+    dirs[d].mtime_nsec = st.st_mtim.tv_nsec;
+    dirs[d].ino = st.st_ino;
+
+    const Dir *old = prev && prev_dir != NONE ? &prev->dirs[prev_dir] : nullptr;
+    vector<uint32_t> prev_children;         // per entry, the directory in prev
+
+    if (old && old->mtime_sec && old->mtime_sec == dirs[d].mtime_sec && old->mtime_nsec == dirs[d].mtime_nsec && old->ino == dirs[d].ino)
+    {
+        close (fd);
+        reused++;
+
+        for (uint32_t i=old->first; i<old->first+old->count; ++i)
+        {
+            const Entry &e = prev->entries[i];
+
+            entries.push_back({add_name(prev->names + e.name), NONE, e.type, {0, 0, 0}});
+            prev_children.push_back(e.child);
+        }
+    }
+    else
+    {
+        DIR *dir = fdopendir (fd);
+
+        if (!dir)
+        {
+            close (fd);
+            dirs[d].end = d + 1;
+            return true;
+        }
+
+        read++;
+
+        unordered_map<string, uint32_t> old_children;
+
+        if (old)
+            for (uint32_t i=old->first; i<old->first+old->count; ++i)
+                if (prev->entries[i].child != NONE)
+                    old_children[prev->names + prev->entries[i].name] = prev->entries[i].child;
+
+        while (dirent *entry = readdir (dir))
+        {
+            const char *n = entry->d_name;
+
+            if (n[0] == '.' && (n[1] == '\0' || (n[1] == '.' && n[2] == '\0')))
+                continue;
+
+            uint8_t type = type_of(entry->d_type, fd, n);
+            uint32_t prev_child = NONE;
+
+            if (type == TYPE_DIR && !old_children.empty())
+            {
+                auto i = old_children.find(n);
+
+                if (i != old_children.end())
+                    prev_child = i->second;
+            }
+
+            entries.push_back({add_name(n), NONE, type, {0, 0, 0}});
+            prev_children.push_back(prev_child);
+        }
+
+        closedir (dir);
+    }
+
+    uint32_t count = entries.size() - first;
+    size_t path_size = path.size();
+
+    dirs[d].count = count;
+
+    for (uint32_t i=0; i<count; ++i)
+    {
+        if (entries[first + i].type != TYPE_DIR)
+            continue;
+
+        entries[first + i].child = dirs.size();
+
+        if (path.back() != '/')
+            path += '/';
+        path += names.c_str() + entries[first + i].name;
+
+        bool ok = walk(d, entries[first + i].name, depth + 1, prev_children[i]);
+
+        path.resize(path_size);
+
+        if (!ok)
+            return false;
+    }
+
+    dirs[d].end = dirs.size();
+
+    return true;
+}
+
+
+bool GnomeCmd::NameIndex::build(const string &root_path, const NameIndex *previous, const atomic<bool> *stop)
+{
+    string r = normalize(root_path);
+
+    if (r.empty() || r[0] != '/')
+        return false;
+
+    // the root itself has to be readable
+    int fd = open (r.c_str(), O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+
+    if (fd < 0)
+        return false;
+
+    close (fd);
+
+    Builder builder;
+
+    builder.prev = previous && previous->loaded() && previous->root == r ? previous : nullptr;
+    builder.stop = stop;
+    builder.path = r;
+    builder.names.push_back('\0');          // the name of the root
+
+    if (!builder.walk(NONE, 0, 0, builder.prev ? 0 : NONE))
+        return false;
+
+    if (builder.names.size() > UINT32_MAX || builder.entries.size() >= NONE || builder.dirs.size() >= NONE)
+        return false;
+
+    Header h;
+
+    memset (&h, 0, sizeof(h));
+    memcpy (h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.root_size = r.size();
+    h.built = time (nullptr);
+    h.dirs = builder.dirs.size();
+    h.entries = builder.entries.size();
+    h.names_size = builder.names.size();
+
+    // written next to the file and renamed over it, a search may still map the old one
+    string tmp = file + ".XXXXXX";
+    fd = mkstemp (&tmp[0]);
+
+    if (fd < 0)
+        return false;
+
+    string root_field(padded(r.size()), '\0');
+    root_field.replace(0, r.size(), r);
+
+    FILE *f = fdopen (fd, "wb");
+
+    if (!f)
+    {
+        close (fd);
+        unlink (tmp.c_str());
+        return false;
+    }
+
+    bool ok = fwrite (&h, sizeof(h), 1, f) == 1 &&
+              fwrite (root_field.data(), 1, root_field.size(), f) == root_field.size() &&
+              fwrite (builder.dirs.data(), sizeof(Dir), builder.dirs.size(), f) == builder.dirs.size() &&
+              fwrite (builder.entries.data(), sizeof(Entry), builder.entries.size(), f) == builder.entries.size() &&
+              fwrite (builder.names.data(), 1, builder.names.size(), f) == builder.names.size();
+
+    ok = fclose (f) == 0 && ok;
+
+    if (!ok || rename (tmp.c_str(), file.c_str()) != 0)
+    {
+        unlink (tmp.c_str());
+        return false;
+    }
+
+    dirs_read = builder.read;
+    dirs_reused = builder.reused;
+
+    return load();
+}
+
+
+/**
+ * @returns true if @a path is @a root or below it, both normalized
+ */
+static bool is_below(const string &root, const string &path)
+{
+    if (root == "/")
+        return !path.empty() && path[0] == '/';
+
+    return path.compare(0, root.size(), root) == 0 && (path.size() == root.size() || path[root.size()] == '/');
+}
+
+
+bool GnomeCmd::NameIndex::covers(const string &path) const
+{
+    return loaded() && is_below(root, normalize(path));
+}
+
+
+uint32_t GnomeCmd::NameIndex::find_dir(const string &path) const
+{
+    if (!covers(path))
+        return NONE;
+
+    string p = normalize(path);
+    uint32_t d = 0;
+
+    for (size_t pos=root.size(); pos<p.size(); )
+    {
+        size_t start = p.find_first_not_of('/', pos);
+
+        if (start == string::npos)
+            break;
+
+        size_t end = min (p.find('/', start), p.size());
+        string component = p.substr(start, end - start);
+        uint32_t child = NONE;
+
+        for (uint32_t i=dirs[d].first; i<dirs[d].first+dirs[d].count; ++i)
+            if (entries[i].child != NONE && component == names + entries[i].name)
+            {
+                child = entries[i].child;
+                break;
+            }
+
+        if (child == NONE)
+            return NONE;
+
+        d = child;
+        pos = end;
+    }
+
+    return d;
+}
+
+
+bool GnomeCmd::NameIndex::search(const string &path, int max_depth, const NameMatcher &matcher, vector<Match> &results) const
+{
+    uint32_t top = find_dir(path);
+
+    if (top == NONE)
+        return false;
+
+    uint32_t cached = NONE;
+    string cached_path;
+    vector<const char *> parts;
+
+    for (uint32_t d=top; d<dirs[top].end; ++d)
+    {
+        // a subtree which is too deep is skipped as a whole
+        if (max_depth >= 0 && dirs[d].depth - dirs[top].depth > (uint32_t) max_depth)
+        {
+            d = dirs[d].end - 1;
+            continue;
+        }
+
+        for (uint32_t i=dirs[d].first; i<dirs[d].first+dirs[d].count; ++i)
+        {
+            if (!matcher.match(names + entries[i].name))
+                continue;
+
+            if (cached != d)
+            {
+                parts.clear();
+
+                for (uint32_t p=d; p!=0; p=dirs[p].parent)
+                    parts.push_back(names + dirs[p].name);
+
+                cached_path = root;
+
+                for (auto part=parts.rbegin(); part!=parts.rend(); ++part)
+                {
+                    if (cached_path.back() != '/')
+                        cached_path += '/';
+                    cached_path += *part;
+                }
+
+                if (cached_path.back() != '/')
+                    cached_path += '/';
+
+                cached = d;
+            }
+
+            results.push_back({cached_path + (names + entries[i].name), entries[i].type == TYPE_DIR});
+        }
+    }
+
+    return true;
+}
+
+
+GnomeCmd::NameIndexSet::NameIndexSet(const string &d, size_t max): dir(normalize(d)), max_indexes(max)
+{
+    DIR *dp = opendir (dir.c_str());
+
+    if (!dp)
+        return;
+
+    while (dirent *entry = readdir (dp))
+    {
+        string name = entry->d_name;
+
+        if (name[0] == '.')
+            continue;
+
+        string path = dir + '/' + name;
+
+        // left over by an interrupted build, or from an older version
+        if (name.size() < 4 || name.compare(name.size() - 4, 4, ".idx") != 0)
+        {
+            unlink (path.c_str());
+            continue;
+        }
+
+        auto index = make_shared<NameIndex>(path);
+
+        if (index->load() && path == file_for(index->get_root()))
+            slots[index->get_root()].index = index;
+        else
+            unlink (path.c_str());
+    }
+
+    closedir (dp);
+}
+
+
+GnomeCmd::NameIndexSet::~NameIndexSet()
+{
+    stopped = true;
+    wait();
+}
+
+
+GnomeCmd::NameIndexSet &GnomeCmd::NameIndexSet::get_default()
+{
+    static NameIndexSet *set = nullptr;
+    static once_flag once;
+
+    call_once(once, [] ()
+              {
+                  const char *cache = getenv ("XDG_CACHE_HOME");
+                  string path;
+
+                  if (cache && cache[0] == '/')
+                      path = cache;
+                  else
+                      path = string(getenv ("HOME") ? getenv ("HOME") : "/tmp") + "/.cache";
+
+                  set = new NameIndexSet(path + "/gnome-commander/name-index");
+              });
+
+    return *set;
+}
+
+
+string GnomeCmd::NameIndexSet::file_for(const string &root) const
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (unsigned char c : root)
+        hash = (hash ^ c) * 1099511628211ULL;
+
+    char name[32];
+    snprintf (name, sizeof(name), "%016llx.idx", (unsigned long long) hash);
+
+    return dir + '/' + name;
+}
+
+
+shared_ptr<GnomeCmd::NameIndex> GnomeCmd::NameIndexSet::find(const string &path, bool *changed)
+{
+    lock_guard<mutex> lock(slots_mutex);
+
+    const Slot *best = nullptr;
+
+    for (auto &s : slots)
+        if (s.second.index && s.second.index->covers(path) && (!best || s.first.size() > best->index->get_root().size()))
+            best = &s.second;
+
+    if (changed)
+        *changed = best && best->changed;
+
+    return best ? best->index : nullptr;
+}
+
+
+void GnomeCmd::NameIndexSet::refresh(const string &path)
+{
+    string root = normalize(path);
+
+    lock_guard<mutex> lock(slots_mutex);
+
+    if (stopped)
+        return;
+
+    // an index above, or being built above, is refreshed instead
+    for (auto &s : slots)
+        if (is_below(s.first, root) && s.first.size() < root.size())
+            root = s.first;
+
+    Slot &slot = slots[root];
+
+    if (slot.refreshing)
+        return;
+
+    slot.refreshing = true;
+    slot.changed = false;
+
+    thread(&NameIndexSet::refresh_thread, this, root, slot.index).detach();
+}
+
+
+void GnomeCmd::NameIndexSet::refresh_thread(string root, shared_ptr<NameIndex> previous)
+{
+    for (size_t slash=dir.find('/', 1); slash!=string::npos; slash=dir.find('/', slash + 1))
+        mkdir (dir.substr(0, slash).c_str(), 0700);
+    mkdir (dir.c_str(), 0700);
+
+    auto index = make_shared<NameIndex>(file_for(root));
+    bool ok = index->build(root, previous.get(), &stopped);
+
+    lock_guard<mutex> lock(slots_mutex);
+
+    Slot &slot = slots[root];
+
+    slot.refreshing = false;
+
+    if (ok)
+    {
+        slot.index = index;
+
+        // the indexes below this one and, if there are too many, the oldest ones are dropped
+        for (;;)
+        {
+            auto drop = slots.end();
+            size_t count = 0;
+
+            for (auto i=slots.begin(); i!=slots.end(); ++i)
+            {
+                if (!i->second.index || i->second.refreshing || i->first == root)
+                    continue;
+
+                if (index->covers(i->first))
+                {
+                    drop = i;
+                    break;
+                }
+
+                if (drop == slots.end() || i->second.index->get_built() < drop->second.index->get_built())
+                    drop = i;
+                ++count;
+            }
+
+            if (drop == slots.end() || (!index->covers(drop->first) && count < max_indexes))
+                break;
+
+            unlink (drop->second.index->get_file().c_str());
+            slots.erase(drop);
+        }
+    }
+    else
+        if (!slot.index)
+            slots.erase(root);
+
+    refreshed.notify_all();
+}
+
+
+void GnomeCmd::NameIndexSet::mark_changed(const string &path)
+{
+    lock_guard<mutex> lock(slots_mutex);
+
+    for (auto &s : slots)
+        if (s.second.index && s.second.index->covers(path))
+            s.second.changed = true;
+}
+
+
+void GnomeCmd::NameIndexSet::wait()
+{
+    unique_lock<mutex> lock(slots_mutex);
+
+    refreshed.wait(lock, [this] ()
+                   {
+                       for (auto &s : slots)
+                           if (s.second.refreshing)
+                               return false;
+                       return true;
+                   });
+}
@@ -0,0 +1,226 @@
+/**
+ * @file gnome-cmd-name-index.h
+ * @brief Persistent index of the file names below a directory.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gnome-cmd-search-engine.h"
+
+namespace GnomeCmd
+{
+    /**
+     * The names of all entries below a root directory, in a file which is
+     * memory mapped for searching.
+     *
+     * The file holds a table of directories in depth-first order, so that
+     * a subtree is a contiguous range of it, a table of entries, which are
+     * contiguous per directory, and the names. Every directory keeps its
+     * mtime: when the index is rebuilt, a directory whose mtime has not
+     * changed takes its entries from the previous index instead of being
+     * read again, only its subdirectories are visited.
+     */
+    class NameIndex
+    {
+      public:
+
+        struct Match
+        {
+            std::string path;
+            bool is_dir;
+        };
+
+      private:
+
+        static const uint32_t NONE = UINT32_MAX;
+
+        struct Header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t root_size;
+            int64_t built;
+            uint32_t dirs;
+            uint32_t entries;
+            uint64_t names_size;
+        };
+
+        struct Dir
+        {
+            uint32_t parent;
+            uint32_t name;
+            uint32_t first;                 /**< the first of its entries */
+            uint32_t count;
+            uint32_t end;                   /**< the directory after its subtree */
+            uint32_t depth;
+            int64_t mtime_sec;
+            int64_t mtime_nsec;
+            uint64_t ino;
+        };
+
+        struct Entry
+        {
+            uint32_t name;
+            uint32_t child;                 /**< the directory, NONE for other entries */
+            uint8_t type;
+            uint8_t pad[3];
+        };
+
+        struct Builder;
+
+        std::string file;
+
+        void *map {nullptr};
+        size_t map_size {0};
+        const Header *header {nullptr};
+        const Dir *dirs {nullptr};
+        const Entry *entries {nullptr};
+        const char *names {nullptr};
+        std::string root;
+
+        void unmap();
+        uint32_t find_dir(const std::string &path) const;
+
+      public:
+
+        enum Type
+        {
+            TYPE_FILE,
+            TYPE_DIR,
+            TYPE_LINK,
+            TYPE_OTHER
+        };
+
+        uint32_t dirs_read {0};             /**< by the last build */
+        uint32_t dirs_reused {0};
+
+        explicit NameIndex(const std::string &file);
+        ~NameIndex();
+
+        NameIndex(const NameIndex &) = delete;
+        NameIndex &operator = (const NameIndex &) = delete;
+
+        /**
+         * Maps the index file.
+         *
+         * @returns false if there is none or it is damaged
+         */
+        bool load();
+
+        /**
+         * Indexes the tree below @a root, reusing the unchanged directories
+         * of @a previous, writes the file and maps it. The file is replaced
+         * only if the build completes.
+         *
+         * @returns false if the root can't be read, the file can't be written or @a stop was set
+         */
+        bool build(const std::string &root, const NameIndex *previous=nullptr, const std::atomic<bool> *stop=nullptr);
+
+        bool loaded() const                     {  return header != nullptr;  }
+        const std::string &get_file() const     {  return file;  }
+        const std::string &get_root() const     {  return root;  }
+        time_t get_built() const                {  return header ? header->built : 0;  }
+        uint32_t get_entries() const            {  return header ? header->entries : 0;  }
+
+        /**
+         * @returns true if @a path is the root or below it
+         */
+        bool covers(const std::string &path) const;
+
+        /**
+         * Appends the entries below @a path, down to @a max_depth levels
+         * of subdirectories or all for -1, whose name matches to @a results.
+         *
+         * @returns false if @a path is not in the index
+         */
+        bool search(const std::string &path, int max_depth, const NameMatcher &matcher, std::vector<Match> &results) const;
+    };
+
+
+    /**
+     * The name indexes in a directory, one per root. Indexes are built and
+     * refreshed in the background, a search uses the index whose root is
+     * the closest above the searched directory.
+     */
+    class NameIndexSet
+    {
+        struct Slot
+        {
+            std::shared_ptr<NameIndex> index;
+            bool changed {false};           /**< since the index was built */
+            bool refreshing {false};
+        };
+
+        std::string dir;
+        size_t max_indexes;
+
+        std::mutex slots_mutex;
+        std::condition_variable refreshed;
+        std::map<std::string, Slot> slots;
+        std::atomic<bool> stopped {false};
+
+        void refresh_thread(std::string root, std::shared_ptr<NameIndex> previous);
+        std::string file_for(const std::string &root) const;
+
+      public:
+
+        explicit NameIndexSet(const std::string &dir, size_t max_indexes=16);
+        ~NameIndexSet();
+
+        /**
+         * The set in $XDG_CACHE_HOME/gnome-commander/name-index, which lives
+         * as long as the process.
+         */
+        static NameIndexSet &get_default();
+
+        /**
+         * @returns the index to search @a path in, or nullptr, @a changed
+         * tells whether changes below its root have been reported since it
+         * was built
+         */
+        std::shared_ptr<NameIndex> find(const std::string &path, bool *changed=nullptr);
+
+        /**
+         * Builds or refreshes the index of @a root in the background. An
+         * index which covers @a root is refreshed instead, indexes below it
+         * are replaced.
+         */
+        void refresh(const std::string &root);
+
+        /**
+         * Notes that entries in the directory @a path have changed.
+         */
+        void mark_changed(const std::string &path);
+
+        /**
+         * Waits until no index is being refreshed.
+         */
+        void wait();
+    };
+}
@@ -0,0 +1,156 @@
+/**
+ * @file gnome-cmd-progress.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <algorithm>
+
+#include "gnome-cmd-progress.h"
+
+using namespace std;
+
+
+bool GnomeCmd::ProgressEvents::push(const string &path, uint64_t size)
+{
+    uint64_t h = head.load(memory_order_relaxed);
+
+    if (h - tail.load(memory_order_acquire) >= SLOTS)
+    {
+        n_dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    Event &event = slots[h % SLOTS];
+
+    event.path = path;
+    event.size = size;
+
+    // publishes the slot, the consumer doesn't look at it before
+    head.store(h + 1, memory_order_release);
+
+    return true;
+}
+
+
+bool GnomeCmd::ProgressEvents::pop(Event &event)
+{
+    uint64_t t = tail.load(memory_order_relaxed);
+
+    if (t == head.load(memory_order_acquire))
+        return false;
+
+    event = move (slots[t % SLOTS]);
+
+    // hands the slot back to the producer
+    tail.store(t + 1, memory_order_release);
+
+    return true;
+}
+
+
+bool GnomeCmd::ProgressEvents::pop_latest(Event &event)
+{
+    bool found = false;
+
+    while (pop (event))
+        found = true;
+
+    return found;
+}
+
+
+void GnomeCmd::Throughput::add(double time, uint64_t bytes, uint64_t files)
+{
+    Sample sample {time, bytes, files};
+
+    if (samples.empty())
+    {
+        first = sample;
+        next_tick = time + 1;
+    }
+
+    samples.push_back(sample);
+
+    // keep one sample at least WINDOW seconds old to measure against
+    while (samples.size() > 2 && samples[1].time <= time - WINDOW)
+        samples.pop_front();
+
+    for (; next_tick <= time; next_tick += 1)
+    {
+        history.push_back(bytes_per_second ());
+
+        if (history.size() > HISTORY)
+            history.pop_front();
+    }
+}
+
+
+double GnomeCmd::Throughput::bytes_per_second() const
+{
+    if (samples.size() < 2 || samples.back().time <= samples.front().time)
+        return 0;
+
+    // the counters go back when a failed file is retried
+    if (samples.back().bytes < samples.front().bytes)
+        return 0;
+
+    return (samples.back().bytes - samples.front().bytes) / (samples.back().time - samples.front().time);
+}
+
+
+double GnomeCmd::Throughput::files_per_second() const
+{
+    if (samples.size() < 2 || samples.back().time <= samples.front().time)
+        return 0;
+
+    if (samples.back().files < samples.front().files)
+        return 0;
+
+    return (samples.back().files - samples.front().files) / (samples.back().time - samples.front().time);
+}
+
+
+double GnomeCmd::Throughput::average_bytes_per_second() const
+{
+    if (samples.empty() || samples.back().time <= first.time)
+        return 0;
+
+    if (samples.back().bytes < first.bytes)
+        return 0;
+
+    return (samples.back().bytes - first.bytes) / (samples.back().time - first.time);
+}
+
+
+double GnomeCmd::Throughput::average_files_per_second() const
+{
+    if (samples.empty() || samples.back().time <= first.time)
+        return 0;
+
+    if (samples.back().files < first.files)
+        return 0;
+
+    return (samples.back().files - first.files) / (samples.back().time - first.time);
+}
+
+
+double GnomeCmd::Throughput::get_history_max() const
+{
+    return history.empty() ? 0 : *max_element (history.begin(), history.end());
+}
@@ -0,0 +1,122 @@
+/**
+ * @file gnome-cmd-progress.h
+ * @brief Progress reporting from worker threads to the GUI without locks.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <string>
+
+namespace GnomeCmd
+{
+    /**
+     * Hands per-file events from one worker thread to the GUI thread through a
+     * ring buffer, without locking.
+     *
+     * The worker never waits for the GUI: if the ring is full the event is
+     * dropped, which costs nothing but a stale file name for one frame, as the
+     * GUI only shows the newest one anyway.
+     */
+    class ProgressEvents
+    {
+      public:
+
+        enum
+        {
+            SLOTS = 64
+        };
+
+        struct Event
+        {
+            std::string path;
+            uint64_t size {0};
+        };
+
+      private:
+
+        Event slots[SLOTS];
+        std::atomic<uint64_t> head {0};     /**< next event written by the producer */
+        std::atomic<uint64_t> tail {0};     /**< next event read by the consumer */
+        std::atomic<uint64_t> n_dropped {0};
+
+      public:
+
+        /**
+         * Called by the worker thread only.
+         *
+         * @returns false if the ring is full and the event was dropped
+         */
+        bool push(const std::string &path, uint64_t size=0);
+
+        /** Called by the GUI thread only. */
+        bool pop(Event &event);
+
+        /** Skips to the newest event, called by the GUI thread only. */
+        bool pop_latest(Event &event);
+
+        uint64_t dropped() const            {  return n_dropped;  }
+    };
+
+
+    /**
+     * Turns the counters of a job, sampled once per frame, into rates: the
+     * current one over the last WINDOW seconds, the average since the first
+     * sample and a history of one value per second for a graph.
+     */
+    class Throughput
+    {
+      public:
+
+        enum
+        {
+            WINDOW = 2,                     /**< seconds the current rate is averaged over */
+            HISTORY = 120                   /**< seconds kept for the graph */
+        };
+
+        struct Sample
+        {
+            double time;
+            uint64_t bytes;
+            uint64_t files;
+        };
+
+      private:
+
+        std::deque<Sample> samples;         /**< the last WINDOW seconds */
+        Sample first {0, 0, 0};
+        double next_tick {0};
+        std::deque<double> history;         /**< bytes per second, the newest last */
+
+      public:
+
+        /** Adds the counters of the job at @a time seconds, which never goes back */
+        void add(double time, uint64_t bytes, uint64_t files);
+
+        double bytes_per_second() const;
+        double files_per_second() const;
+        double average_bytes_per_second() const;
+        double average_files_per_second() const;
+
+        const std::deque<double> &get_history() const       {  return history;  }
+        double get_history_max() const;
+    };
+}
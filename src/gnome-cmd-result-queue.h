@@ -0,0 +1,111 @@
+/**
+ * @file gnome-cmd-result-queue.h
+ * @brief Queue of search results, filled by several threads and emptied by one.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace GnomeCmd
+{
+    /**
+     * A queue without locks for many producers and one consumer.
+     *
+     * Producers push onto a linked stack with a compare-and-swap, the
+     * consumer takes the whole stack with one exchange and reverses it, so
+     * the items of every producer come out in the order they were pushed.
+     * As only the consumer ever removes nodes and it takes all of them at
+     * once, a node can't be reused while a producer still looks at it.
+     */
+    template <typename T>
+    class ResultQueue
+    {
+        struct Node
+        {
+            T item;
+            Node *next;
+        };
+
+        std::atomic<Node *> head {nullptr};
+
+      public:
+
+        ResultQueue()   {}
+        ~ResultQueue();
+
+        ResultQueue(const ResultQueue &) = delete;
+        ResultQueue &operator = (const ResultQueue &) = delete;
+
+        void push(T &&item);
+        void push(const T &item)            {  push(T(item));  }
+
+        /**
+         * Appends all items pushed since the last call to @a batch. Must be
+         * called by one thread at a time only.
+         */
+        void take(std::vector<T> &batch);
+
+        bool empty() const                  {  return head.load(std::memory_order_relaxed) == nullptr;  }
+    };
+
+    template <typename T>
+    inline ResultQueue<T>::~ResultQueue()
+    {
+        for (Node *n=head.load(); n; )
+        {
+            Node *next = n->next;
+            delete n;
+            n = next;
+        }
+    }
+
+    template <typename T>
+    inline void ResultQueue<T>::push(T &&item)
+    {
+        Node *node = new Node {std::move (item), head.load(std::memory_order_relaxed)};
+
+        while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+            ;
+    }
+
+    template <typename T>
+    inline void ResultQueue<T>::take(std::vector<T> &batch)
+    {
+        Node *n = head.exchange(nullptr, std::memory_order_acquire);
+        Node *oldest = nullptr;
+
+        for (; n; )                         // newest first on the stack
+        {
+            Node *next = n->next;
+            n->next = oldest;
+            oldest = n;
+            n = next;
+        }
+
+        for (n=oldest; n; )
+        {
+            Node *next = n->next;
+            batch.push_back(std::move (n->item));
+            delete n;
+            n = next;
+        }
+    }
+}
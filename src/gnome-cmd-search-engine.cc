@@ -0,0 +1,483 @@
+/**
+ * @file gnome-cmd-search-engine.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+
+#include "gnome-cmd-archive-search.h"
+#include "gnome-cmd-search-engine.h"
+
+using namespace std;
+
+
+bool GnomeCmd::StatFilter::needs_stat() const
+{
+    return size_min || size_max || mtime_min || mtime_max || atime_min || atime_max || uid != (uid_t) -1 || perm_mask;
+}
+
+
+bool GnomeCmd::StatFilter::match_type(mode_t mode) const
+{
+    switch (type)
+    {
+        case TYPE_REGULAR:
+            return S_ISREG (mode);
+
+        case TYPE_DIRECTORY:
+            return S_ISDIR (mode);
+
+        case TYPE_SYMLINK:
+            return S_ISLNK (mode);
+
+        default:
+            return true;
+    }
+}
+
+
+bool GnomeCmd::StatFilter::match(const struct stat &st) const
+{
+    uint64_t size = st.st_size;
+
+    return match_type(st.st_mode & S_IFMT) &&
+           (!size_min || size >= size_min) && (!size_max || size <= size_max) &&
+           (!mtime_min || st.st_mtime >= mtime_min) && (!mtime_max || st.st_mtime <= mtime_max) &&
+           (!atime_min || st.st_atime >= atime_min) && (!atime_max || st.st_atime <= atime_max) &&
+           (uid == (uid_t) -1 || st.st_uid == uid) &&
+           (st.st_mode & perm_mask) == perm_mask;
+}
+
+
+GnomeCmd::NameMatcher::NameMatcher(const string &p, Syntax syntax, bool mc): pattern(p), match_case(mc)
+{
+    if (syntax == SYNTAX_REGEX)
+    {
+        kind = KIND_REGEX;
+        valid = regcomp (&re, p.c_str(), REG_EXTENDED|REG_NOSUB|(match_case ? 0 : REG_ICASE)) == 0;
+        return;
+    }
+
+    fn_flags = FNM_NOESCAPE;
+#ifdef FNM_CASEFOLD
+    if (!match_case)
+        fn_flags |= FNM_CASEFOLD;
+#endif
+
+    // a literal between the stars is compared as it is
+    size_t first = p.find_first_not_of('*');
+    size_t last = p.find_last_not_of('*');
+
+    if (first == string::npos)
+    {
+        kind = KIND_ANY;
+        return;
+    }
+
+    string literal = p.substr(first, last - first + 1);
+
+    // strncasecmp knows no case of multibyte characters, fnmatch does
+    bool multibyte = !match_case && find_if (literal.begin(), literal.end(), [] (char c) { return c & 0x80; }) != literal.end();
+
+    if (literal.find_first_of("*?[") != string::npos || multibyte)
+    {
+        kind = KIND_FNMATCH;
+        return;
+    }
+
+    bool star_before = first > 0;
+    bool star_after = last + 1 < p.size();
+
+    pattern = literal;
+
+    if (star_before && star_after)
+        kind = KIND_CONTAINS;
+    else
+        if (star_after)
+            kind = KIND_PREFIX;
+        else
+            if (star_before)
+                kind = KIND_SUFFIX;
+            else
+                kind = KIND_FNMATCH, pattern = p;
+}
+
+
+GnomeCmd::NameMatcher::~NameMatcher()
+{
+    if (kind == KIND_REGEX && valid)
+        regfree (&re);
+}
+
+
+inline bool GnomeCmd::NameMatcher::equal(const char *a, const char *b, size_t len) const
+{
+    return match_case ? memcmp (a, b, len) == 0 : strncasecmp (a, b, len) == 0;
+}
+
+
+bool GnomeCmd::NameMatcher::match(const char *name) const
+{
+    size_t len;
+
+    switch (kind)
+    {
+        case KIND_REGEX:
+            return valid && regexec (&re, name, 0, nullptr, 0) == 0;
+
+        case KIND_FNMATCH:
+            return fnmatch (pattern.c_str(), name, fn_flags) == 0;
+
+        case KIND_ANY:
+            return true;
+
+        case KIND_PREFIX:
+            return strlen (name) >= pattern.size() && equal(name, pattern.c_str(), pattern.size());
+
+        case KIND_SUFFIX:
+            len = strlen (name);
+            return len >= pattern.size() && equal(name + len - pattern.size(), pattern.c_str(), pattern.size());
+
+        case KIND_CONTAINS:
+            if (match_case)
+                return strstr (name, pattern.c_str()) != nullptr;
+            return strcasestr (name, pattern.c_str()) != nullptr;
+
+        default:
+            return false;
+    }
+}
+
+
+GnomeCmd::SearchEngine::SearchEngine(const Options &opts, const NameMatcher &name, const ContentMatcher *content):
+    options(opts), name_matcher(name), content_matcher(content)
+{
+    unsigned n = options.threads ? options.threads : thread::hardware_concurrency();
+
+    for (unsigned i=0; i<max (n, 1u); ++i)
+        workers.push_back(unique_ptr<Worker>(new Worker));
+
+    // a trailing slash would double in the result paths
+    while (options.root.size() > 1 && options.root.back() == '/')
+        options.root.pop_back();
+}
+
+
+struct GnomeCmd::SearchEngine::OpenDir
+{
+    DIR *dir;
+
+    explicit OpenDir(DIR *d): dir(d)    {}
+    ~OpenDir()                          {  closedir (dir);  }
+
+    int fd() const                      {  return dirfd (dir);  }
+};
+
+
+inline int GnomeCmd::SearchEngine::Task::at(const char *&name) const
+{
+    if (!parent)
+    {
+        name = path.c_str();
+        return AT_FDCWD;
+    }
+
+    name = path.c_str() + path.rfind('/') + 1;
+
+    return parent->fd();
+}
+
+
+void GnomeCmd::SearchEngine::push(unsigned worker, Task &&task)
+{
+    pending++;
+
+    {
+        lock_guard<mutex> lock(workers[worker]->mutex);
+        workers[worker]->tasks.push_back(move (task));
+    }
+
+    // a worker going to sleep either sees the new count, or is waiting already when notified
+    pushed++;
+
+    if (idle)
+    {
+        lock_guard<mutex> lock(idle_mutex);
+        idle_cond.notify_one();
+    }
+}
+
+
+bool GnomeCmd::SearchEngine::pop(unsigned worker, Task &task)
+{
+    {
+        Worker &own = *workers[worker];
+        lock_guard<mutex> lock(own.mutex);
+
+        if (!own.tasks.empty())
+        {
+            task = move (own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i=1; i<workers.size(); ++i)
+    {
+        Worker &victim = *workers[(worker + i) % workers.size()];
+        lock_guard<mutex> lock(victim.mutex);
+
+        if (!victim.tasks.empty())
+        {
+            task = move (victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void GnomeCmd::SearchEngine::add_result(string &&path, bool is_dir, string &&member)
+{
+    matches++;
+    results.push({move (path), is_dir, move (member)});
+}
+
+
+void GnomeCmd::SearchEngine::list_directory(unsigned worker, const Task &task)
+{
+    const char *dir_name;
+    int at = task.at(dir_name);
+    int fd = openat (at, dir_name, O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC);
+
+    if (fd < 0)
+        return;
+
+    DIR *dir = fdopendir (fd);
+
+    if (!dir)
+    {
+        close (fd);
+        return;
+    }
+
+    // closed with the last task below it
+    OpenDirPtr self = make_shared<OpenDir>(dir);
+
+    {
+        unique_lock<mutex> lock(current_mutex, try_to_lock);
+
+        if (lock)
+            current_dir = task.path;
+    }
+
+    bool descend = options.max_depth < 0 || task.depth < options.max_depth;
+    IgnoreRules::FramePtr ignore;
+
+    if (options.ignore)
+        ignore = options.ignore->enter(task.ignore, fd, task.path);
+
+    bool filtered = options.filter.active();
+    bool needs_stat = options.filter.needs_stat();
+    string prefix = task.path == "/" ? task.path : task.path + '/';
+
+    while (dirent *entry = readdir (dir))
+    {
+        if (stopped)
+            break;
+
+        const char *name = entry->d_name;
+
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            continue;
+
+        bool is_dir = entry->d_type == DT_DIR;
+        bool is_reg = entry->d_type == DT_REG;
+        struct stat st;
+        bool have_stat = false;
+
+        if (entry->d_type == DT_UNKNOWN)
+        {
+            if (fstatat (fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+
+            is_dir = S_ISDIR (st.st_mode);
+            is_reg = S_ISREG (st.st_mode);
+            have_stat = true;
+        }
+
+        // an excluded directory is pruned with all below it
+        if (options.ignore && options.ignore->excluded(ignore.get(), task.path, name, is_dir))
+            continue;
+
+        files_searched++;
+
+        if (is_dir && descend)
+            push(worker, {prefix + name, task.depth + 1, true, ignore, self});
+
+        if (!name_matcher.match(name))
+            continue;
+
+        // the cheap criteria first, the type from readdir does without a stat call
+        if (filtered)
+        {
+            if (needs_stat)
+            {
+                if (!have_stat && fstatat (fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                    continue;
+
+                if (!options.filter.match(st))
+                    continue;
+            }
+            else
+                if (!options.filter.match_type(have_stat ? st.st_mode & S_IFMT : DTTOIF (entry->d_type)))
+                    continue;
+        }
+
+        if (!content_matcher && !options.tags)
+            add_result(prefix + name, is_dir);
+        else
+            if (is_reg)
+                push(worker, {prefix + name, task.depth, false, nullptr, self});
+    }
+
+    dirs_searched++;
+}
+
+
+void GnomeCmd::SearchEngine::search_file(Task &task)
+{
+    const char *name;
+    int at = task.at(name);
+
+    // the tags mostly come from the cache, so they are checked before the content is read
+    if (options.tags)
+    {
+        struct stat st;
+
+        if (fstatat (at, name, &st, AT_SYMLINK_NOFOLLOW) != 0 || !options.tags->match(task.path.c_str(), st))
+            return;
+    }
+
+    if (!content_matcher)
+        add_result(move (task.path), false);
+    else
+        if (options.archives)
+            ArchiveSearch::search(*content_matcher, at, name,
+                                  [&] (const string &member) { add_result(string(task.path), false, string(member)); },
+                                  &stopped);
+        else
+            if (content_matcher->match_file(at, name))
+                add_result(move (task.path), false);
+}
+
+
+void GnomeCmd::SearchEngine::work(unsigned worker)
+{
+    Task task;
+
+    for (;;)
+    {
+        if (stopped)
+            return;
+
+        // read before looking for work, whatever is pushed after it wakes the worker
+        uint64_t seen = pushed;
+
+        if (pop(worker, task))
+        {
+            if (task.is_dir)
+                list_directory(worker, task);
+            else
+                search_file(task);
+
+            // don't keep the directory open while waiting for more work
+            task.parent.reset();
+
+            // the last task wakes the others, which are done then
+            if (--pending == 0)
+            {
+                lock_guard<mutex> lock(idle_mutex);
+                idle_cond.notify_all();
+            }
+
+            continue;
+        }
+
+        unique_lock<mutex> lock(idle_mutex);
+
+        if (pending == 0)
+            return;
+
+        // woken by push, or when the search is over
+        idle++;
+        idle_cond.wait(lock, [this, seen] { return pushed != seen || pending == 0 || stopped; });
+        idle--;
+    }
+}
+
+
+void GnomeCmd::SearchEngine::stop()
+{
+    stopped = true;
+
+    lock_guard<mutex> lock(idle_mutex);
+    idle_cond.notify_all();
+}
+
+
+void GnomeCmd::SearchEngine::run()
+{
+    push(0, {options.root, 0, true, options.ignore ? options.ignore->enter_root(options.root) : nullptr, nullptr});
+
+    vector<thread> threads;
+
+    for (unsigned i=1; i<workers.size(); ++i)
+        threads.push_back(thread(&SearchEngine::work, this, i));
+
+    work(0);
+
+    for (auto &t : threads)
+        t.join();
+}
+
+
+void GnomeCmd::SearchEngine::take_results(vector<Result> &batch)
+{
+    results.take(batch);
+}
+
+
+string GnomeCmd::SearchEngine::get_current_dir()
+{
+    lock_guard<mutex> lock(current_mutex);
+
+    return current_dir;
+}
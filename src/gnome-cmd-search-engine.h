@@ -0,0 +1,255 @@
+/**
+ * @file gnome-cmd-search-engine.h
+ * @brief Searching local directories with several threads.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <regex.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gnome-cmd-content-matcher.h"
+#include "gnome-cmd-ignore-rules.h"
+#include "gnome-cmd-result-queue.h"
+#include "gnome-cmd-tag-query.h"
+
+namespace GnomeCmd
+{
+    /**
+     * Matches file names against a regular expression or a shell pattern,
+     * compiled once and shared by all search threads. Shell patterns of the
+     * form "*text*", "text*" and "*text" are compared without fnmatch.
+     */
+    class NameMatcher
+    {
+      public:
+
+        /** Same values as Filter::Type */
+        enum Syntax
+        {
+            SYNTAX_REGEX,
+            SYNTAX_FNMATCH
+        };
+
+      private:
+
+        enum Kind
+        {
+            KIND_REGEX,
+            KIND_FNMATCH,
+            KIND_ANY,
+            KIND_CONTAINS,
+            KIND_PREFIX,
+            KIND_SUFFIX
+        };
+
+        Kind kind;
+        regex_t re;
+        std::string pattern;                /**< the literal part for the plain kinds */
+        int fn_flags {0};
+        bool match_case;
+        bool valid {true};
+
+        bool equal(const char *a, const char *b, size_t len) const;
+
+      public:
+
+        NameMatcher(const std::string &pattern, Syntax syntax, bool match_case);
+        ~NameMatcher();
+
+        NameMatcher(const NameMatcher &) = delete;
+        NameMatcher &operator = (const NameMatcher &) = delete;
+
+        bool ok() const                     {  return valid;  }
+        bool match(const char *name) const;
+    };
+
+
+    /**
+     * Criteria on the size, times, owner, permissions and type of an entry.
+     * They are checked on its lstat record, so before its content is read.
+     * A limit of 0 means no limit.
+     */
+    struct StatFilter
+    {
+        /** Same values as GnomeCmdData::SearchProfile::file_type */
+        enum Type
+        {
+            TYPE_ANY,
+            TYPE_REGULAR,
+            TYPE_DIRECTORY,
+            TYPE_SYMLINK
+        };
+
+        uint64_t size_min {0};
+        uint64_t size_max {0};
+        time_t mtime_min {0};
+        time_t mtime_max {0};
+        time_t atime_min {0};
+        time_t atime_max {0};
+        uid_t uid {(uid_t) -1};             /**< -1 for any owner */
+        mode_t perm_mask {0};               /**< permission bits which must all be set */
+        Type type {TYPE_ANY};
+
+        /**
+         * @returns true if more than the type is checked, which takes a stat call
+         */
+        bool needs_stat() const;
+        bool active() const                 {  return type != TYPE_ANY || needs_stat();  }
+
+        /**
+         * @param mode the file type bits only, or 0 if unknown
+         */
+        bool match_type(mode_t mode) const;
+        bool match(const struct stat &st) const;
+    };
+
+
+    /**
+     * Searches a local directory tree for entries whose name matches and,
+     * optionally, regular files whose content matches.
+     *
+     * Every thread has a deque of work: directories to list and files
+     * whose content is to be read. A thread takes from the back of its own
+     * deque and, when that is empty, steals from the front of the others,
+     * where the largest subtrees wait. Directories are read through their
+     * file descriptors and entries are only stat'ed when readdir does not
+     * tell their type. Symlinks are not followed. Entries excluded by the
+     * ignore rules are skipped, excluded directories are not listed at all.
+     */
+    class SearchEngine
+    {
+      public:
+
+        struct Options
+        {
+            std::string root;
+            int max_depth {-1};             /**< levels below root to descend into, -1 for all */
+            unsigned threads {0};           /**< 0 for one per CPU */
+            StatFilter filter;              /**< checked after the name, before the content */
+            bool archives {false};          /**< search the content of compressed files and archive members */
+            const TagQuery *tags {nullptr}; /**< meta tag criteria of regular files, checked before the content */
+            const IgnoreRules *ignore {nullptr};    /**< entries left out, subtrees pruned before they are listed */
+        };
+
+        struct Result
+        {
+            std::string path;
+            bool is_dir;
+            std::string member;             /**< the matching member if path is an archive, or empty */
+
+            std::string full_path() const   {  return member.empty() ? path : path + '#' + member;  }
+        };
+
+      private:
+
+        /**
+         * A listed directory, kept open as long as tasks below it are queued.
+         * They are opened relative to it, so that a directory renamed or
+         * replaced by a symlink meanwhile can't redirect the search.
+         */
+        struct OpenDir;
+        typedef std::shared_ptr<const OpenDir> OpenDirPtr;
+
+        struct Task
+        {
+            std::string path;
+            int depth;                      /**< of the directory, or of the file's directory */
+            bool is_dir;
+            IgnoreRules::FramePtr ignore;   /**< the rules of the directory above, for directories only */
+            OpenDirPtr parent;              /**< nullptr for the root */
+
+            /** @returns the directory to open the task relative to, and its name there */
+            int at(const char *&name) const;
+        };
+
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        Options options;
+        const NameMatcher &name_matcher;
+        const ContentMatcher *content_matcher;
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<uint64_t> pending {0};  /**< tasks queued or being worked on */
+        std::atomic<bool> stopped {false};
+
+        std::mutex idle_mutex;
+        std::condition_variable idle_cond;
+        std::atomic<unsigned> idle {0};
+        std::atomic<uint64_t> pushed {0};   /**< tasks ever queued, an idle worker sleeps until it changes */
+
+        ResultQueue<Result> results;
+
+        std::mutex current_mutex;
+        std::string current_dir;
+
+        void push(unsigned worker, Task &&task);
+        bool pop(unsigned worker, Task &task);
+        void work(unsigned worker);
+        void list_directory(unsigned worker, const Task &task);
+        void search_file(Task &task);
+        void add_result(std::string &&path, bool is_dir, std::string &&member=std::string());
+
+      public:
+
+        std::atomic<uint64_t> dirs_searched {0};
+        std::atomic<uint64_t> files_searched {0};
+        std::atomic<uint64_t> matches {0};
+
+        /**
+         * @a content is optional, with it or with tag criteria only regular
+         * files can match.
+         */
+        SearchEngine(const Options &opts, const NameMatcher &name, const ContentMatcher *content);
+
+        /**
+         * Searches the tree, returns when all threads are done or the search
+         * has been stopped.
+         */
+        void run();
+
+        void stop();
+        bool is_stopped() const             {  return stopped;  }
+
+        /**
+         * Moves the results found since the last call to @a batch. Called by
+         * the GUI thread while the search is running.
+         */
+        void take_results(std::vector<Result> &batch);
+
+        /**
+         * @returns a directory which is being searched, for the status bar
+         */
+        std::string get_current_dir();
+    };
+}
@@ -21,6 +21,8 @@
 
 #include <config.h>
 
+#include <stdlib.h>
+
 #include <vector>
 
 #include "gnome-cmd-includes.h"
@@ -46,6 +48,21 @@ struct GnomeCmdSelectionProfileComponent::Private
     GtkWidget *find_text_combo;
     GtkWidget *find_text_check;
     GtkWidget *case_check;
+    GtkWidget *criteria_expander;
+    GtkWidget *size_min_spin;
+    GtkWidget *size_max_spin;
+    GtkWidget *mtime_min_spin;
+    GtkWidget *mtime_max_spin;
+    GtkWidget *atime_min_spin;
+    GtkWidget *atime_max_spin;
+    GtkWidget *owner_entry;
+    GtkWidget *perm_entry;
+    GtkWidget *file_type_combo;
+    GtkWidget *tags_entry;
+    GtkWidget *exclude_entry;
+    GtkWidget *ignore_files_check;
+
+    void copy_criteria(GnomeCmdData::SearchProfile &profile);
 
     static void on_filter_type_changed (GtkComboBox *combo, GnomeCmdSelectionProfileComponent *component);
     static void on_find_text_toggled (GtkToggleButton *togglebutton, GnomeCmdSelectionProfileComponent *component);
@@ -64,6 +81,16 @@ inline GnomeCmdSelectionProfileComponent::Private::Private()
     find_text_combo = NULL;
     find_text_check = NULL;
     case_check = NULL;
+    criteria_expander = NULL;
+    size_min_spin = size_max_spin = NULL;
+    mtime_min_spin = mtime_max_spin = NULL;
+    atime_min_spin = atime_max_spin = NULL;
+    owner_entry = NULL;
+    perm_entry = NULL;
+    file_type_combo = NULL;
+    tags_entry = NULL;
+    exclude_entry = NULL;
+    ignore_files_check = NULL;
 }
 
 
@@ -107,6 +134,42 @@ static void combo_box_insert_text (const gchar *text, GtkComboBox *widget)
 }
 
 
+/**
+ * A row of the criteria table: "[from] to [to] unit", where 0 means no limit.
+ */
+static GtkWidget *create_range (GtkWidget *parent, GtkWidget *from, GtkWidget *to, const gchar *unit)
+{
+    GtkWidget *hbox = create_hbox (parent, FALSE, 6);
+
+    gtk_widget_set_tooltip_text (from, _("0 for no limit"));
+    gtk_widget_set_tooltip_text (to, _("0 for no limit"));
+
+    gtk_box_pack_start (GTK_BOX (hbox), from, FALSE, FALSE, 0);
+    gtk_box_pack_start (GTK_BOX (hbox), create_label (parent, _("to")), FALSE, FALSE, 0);
+    gtk_box_pack_start (GTK_BOX (hbox), to, FALSE, FALSE, 0);
+    gtk_box_pack_start (GTK_BOX (hbox), create_label (parent, unit), FALSE, FALSE, 0);
+
+    return hbox;
+}
+
+
+void GnomeCmdSelectionProfileComponent::Private::copy_criteria(GnomeCmdData::SearchProfile &p)
+{
+    p.size_min = (guint64) gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (size_min_spin)) * 1024;
+    p.size_max = (guint64) gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (size_max_spin)) * 1024;
+    p.mtime_min_age = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (mtime_min_spin));
+    p.mtime_max_age = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (mtime_max_spin));
+    p.atime_min_age = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (atime_min_spin));
+    p.atime_max_age = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (atime_max_spin));
+    stringify(p.owner, g_strstrip (g_strdup (gtk_entry_get_text (GTK_ENTRY (owner_entry)))));
+    p.perm_mask = strtoul (gtk_entry_get_text (GTK_ENTRY (perm_entry)), NULL, 8) & 07777;
+    p.file_type = gtk_combo_box_get_active (GTK_COMBO_BOX (file_type_combo));
+    stringify(p.tag_criteria, g_strstrip (g_strdup (gtk_entry_get_text (GTK_ENTRY (tags_entry)))));
+    stringify(p.exclude_globs, g_strstrip (g_strdup (gtk_entry_get_text (GTK_ENTRY (exclude_entry)))));
+    p.use_ignore_files = gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (ignore_files_check));
+}
+
+
 G_DEFINE_TYPE (GnomeCmdSelectionProfileComponent, gnome_cmd_selection_profile_component, GTK_TYPE_VBOX)
 
 
@@ -114,7 +177,7 @@ static void gnome_cmd_selection_profile_component_init (GnomeCmdSelectionProfile
 {
     component->priv = new GnomeCmdSelectionProfileComponent::Private;
 
-    component->priv->table = gtk_table_new (5, 2, FALSE);
+    component->priv->table = gtk_table_new (6, 2, FALSE);
     gtk_table_set_row_spacings (GTK_TABLE (component->priv->table), 6);
     gtk_table_set_col_spacings (GTK_TABLE (component->priv->table), 6);
     gtk_box_pack_start (GTK_BOX (component), component->priv->table, FALSE, TRUE, 0);
@@ -160,6 +223,67 @@ static void gnome_cmd_selection_profile_component_init (GnomeCmdSelectionProfile
     component->priv->case_check = create_check_with_mnemonic (*component, _("Case sensiti_ve"), "case_check");
     gtk_table_attach (GTK_TABLE (component->priv->table), component->priv->case_check, 1, 2, 4, 5, (GtkAttachOptions) (GTK_FILL), (GtkAttachOptions) (0), 0, 0);
     gtk_widget_set_sensitive (component->priv->case_check, FALSE);
+
+
+    // size, date and attribute criteria
+    component->priv->criteria_expander = gtk_expander_new_with_mnemonic (_("_More criteria"));
+    gtk_table_attach (GTK_TABLE (component->priv->table), component->priv->criteria_expander, 0, 2, 5, 6, (GtkAttachOptions) (GTK_FILL), (GtkAttachOptions) (0), 0, 0);
+
+    GtkWidget *criteria = gtk_table_new (9, 2, FALSE);
+    gtk_table_set_row_spacings (GTK_TABLE (criteria), 6);
+    gtk_table_set_col_spacings (GTK_TABLE (criteria), 6);
+    gtk_container_set_border_width (GTK_CONTAINER (criteria), 6);
+    gtk_container_add (GTK_CONTAINER (component->priv->criteria_expander), criteria);
+
+    component->priv->size_min_spin = create_spin (*component, "size_min_spin", 0, G_MAXINT, 0);
+    component->priv->size_max_spin = create_spin (*component, "size_max_spin", 0, G_MAXINT, 0);
+    table_add (criteria, create_label_with_mnemonic (*component, _("_Size:"), component->priv->size_min_spin), 0, 0, GTK_FILL);
+    table_add (criteria, create_range (*component, component->priv->size_min_spin, component->priv->size_max_spin, _("KiB")), 1, 0, GTK_FILL);
+
+    component->priv->mtime_min_spin = create_spin (*component, "mtime_min_spin", 0, 100000, 0);
+    component->priv->mtime_max_spin = create_spin (*component, "mtime_max_spin", 0, 100000, 0);
+    table_add (criteria, create_label_with_mnemonic (*component, _("Mo_dified:"), component->priv->mtime_min_spin), 0, 1, GTK_FILL);
+    table_add (criteria, create_range (*component, component->priv->mtime_min_spin, component->priv->mtime_max_spin, _("days ago")), 1, 1, GTK_FILL);
+
+    component->priv->atime_min_spin = create_spin (*component, "atime_min_spin", 0, 100000, 0);
+    component->priv->atime_max_spin = create_spin (*component, "atime_max_spin", 0, 100000, 0);
+    table_add (criteria, create_label_with_mnemonic (*component, _("_Accessed:"), component->priv->atime_min_spin), 0, 2, GTK_FILL);
+    table_add (criteria, create_range (*component, component->priv->atime_min_spin, component->priv->atime_max_spin, _("days ago")), 1, 2, GTK_FILL);
+
+    component->priv->owner_entry = create_entry (*component, "owner_entry", NULL);
+    gtk_widget_set_tooltip_text (component->priv->owner_entry, _("User name or id, empty for any"));
+    table_add (criteria, create_label_with_mnemonic (*component, _("_Owner:"), component->priv->owner_entry), 0, 3, GTK_FILL);
+    table_add (criteria, component->priv->owner_entry, 1, 3, (GtkAttachOptions) (GTK_EXPAND|GTK_FILL));
+
+    component->priv->perm_entry = create_entry (*component, "perm_entry", NULL);
+    gtk_widget_set_tooltip_text (component->priv->perm_entry, _("Octal permission bits which must all be set, e.g. 111 for executable files"));
+    table_add (criteria, create_label_with_mnemonic (*component, _("_Permissions:"), component->priv->perm_entry), 0, 4, GTK_FILL);
+    table_add (criteria, component->priv->perm_entry, 1, 4, (GtkAttachOptions) (GTK_EXPAND|GTK_FILL));
+
+    component->priv->file_type_combo = gtk_combo_box_new_text ();
+    gtk_combo_box_append_text (GTK_COMBO_BOX (component->priv->file_type_combo), _("Any"));
+    gtk_combo_box_append_text (GTK_COMBO_BOX (component->priv->file_type_combo), _("Regular files"));
+    gtk_combo_box_append_text (GTK_COMBO_BOX (component->priv->file_type_combo), _("Directories"));
+    gtk_combo_box_append_text (GTK_COMBO_BOX (component->priv->file_type_combo), _("Symbolic links"));
+    gtk_combo_box_set_active (GTK_COMBO_BOX (component->priv->file_type_combo), 0);
+    table_add (criteria, create_label_with_mnemonic (*component, _("T_ype:"), component->priv->file_type_combo), 0, 5, GTK_FILL);
+    table_add (criteria, component->priv->file_type_combo, 1, 5, (GtkAttachOptions) (GTK_EXPAND|GTK_FILL));
+
+    component->priv->tags_entry = create_entry (*component, "tags_entry", NULL);
+    gtk_widget_set_tooltip_text (component->priv->tags_entry, _("Meta tag criteria separated by ';', all of which must hold, e.g. Exif.DateTimeOriginal >= 2024; ID3.Artist ~ foo\n"
+                                                                "Operators: = != < <= > >= and ~ for 'contains'"));
+    table_add (criteria, create_label_with_mnemonic (*component, _("Ta_gs:"), component->priv->tags_entry), 0, 6, GTK_FILL);
+    table_add (criteria, component->priv->tags_entry, 1, 6, (GtkAttachOptions) (GTK_EXPAND|GTK_FILL));
+
+    component->priv->exclude_entry = create_entry (*component, "exclude_entry", NULL);
+    gtk_widget_set_tooltip_text (component->priv->exclude_entry, _("Names or paths to leave out, with the directories below them, separated by ';', e.g. node_modules; build/; *.o\n"
+                                                                   "A trailing '/' matches directories only, a leading '/' the folder searched in"));
+    table_add (criteria, create_label_with_mnemonic (*component, _("E_xclude:"), component->priv->exclude_entry), 0, 7, GTK_FILL);
+    table_add (criteria, component->priv->exclude_entry, 1, 7, (GtkAttachOptions) (GTK_EXPAND|GTK_FILL));
+
+    component->priv->ignore_files_check = create_check_with_mnemonic (*component, _("Skip files _ignored by .gitignore and .ignore"), "ignore_files_check");
+    gtk_widget_set_tooltip_text (component->priv->ignore_files_check, _("Also leaves out .git, on local file systems only"));
+    gtk_table_attach (GTK_TABLE (criteria), component->priv->ignore_files_check, 1, 2, 8, 9, (GtkAttachOptions) (GTK_FILL), (GtkAttachOptions) (0), 0, 0);
 }
 
 
@@ -220,6 +344,24 @@ void GnomeCmdSelectionProfileComponent::update()
     gtk_combo_box_set_active (GTK_COMBO_BOX (priv->recurse_combo), profile.max_depth+1);
     gtk_entry_set_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->find_text_combo))), profile.text_pattern.c_str());
     gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (priv->find_text_check), profile.content_search);
+
+    gtk_spin_button_set_value (GTK_SPIN_BUTTON (priv->size_min_spin), profile.size_min / 1024);
+    gtk_spin_button_set_value (GTK_SPIN_BUTTON (priv->size_max_spin), profile.size_max / 1024);
+    gtk_spin_button_set_value (GTK_SPIN_BUTTON (priv->mtime_min_spin), profile.mtime_min_age);
+    gtk_spin_button_set_value (GTK_SPIN_BUTTON (priv->mtime_max_spin), profile.mtime_max_age);
+    gtk_spin_button_set_value (GTK_SPIN_BUTTON (priv->atime_min_spin), profile.atime_min_age);
+    gtk_spin_button_set_value (GTK_SPIN_BUTTON (priv->atime_max_spin), profile.atime_max_age);
+    gtk_entry_set_text (GTK_ENTRY (priv->owner_entry), profile.owner.c_str());
+
+    gchar *perm = profile.perm_mask ? g_strdup_printf ("%03o", profile.perm_mask) : g_strdup ("");
+    gtk_entry_set_text (GTK_ENTRY (priv->perm_entry), perm);
+    g_free (perm);
+
+    gtk_combo_box_set_active (GTK_COMBO_BOX (priv->file_type_combo), profile.file_type);
+    gtk_entry_set_text (GTK_ENTRY (priv->tags_entry), profile.tag_criteria.c_str());
+    gtk_entry_set_text (GTK_ENTRY (priv->exclude_entry), profile.exclude_globs.c_str());
+    gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (priv->ignore_files_check), profile.use_ignore_files);
+    gtk_expander_set_expanded (GTK_EXPANDER (priv->criteria_expander), profile.has_attribute_criteria());
 }
 
 
@@ -231,6 +373,7 @@ void GnomeCmdSelectionProfileComponent::copy()
     stringify(profile.text_pattern, gtk_combo_box_get_active_text (GTK_COMBO_BOX (priv->find_text_combo)));
     profile.content_search = !profile.text_pattern.empty() && gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->find_text_check));
     profile.match_case = profile.content_search && gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->case_check));
+    priv->copy_criteria(profile);
 }
 
 
@@ -242,6 +385,7 @@ void GnomeCmdSelectionProfileComponent::copy(GnomeCmdData::SearchProfile &profil
     stringify(profile_in.text_pattern, gtk_combo_box_get_active_text (GTK_COMBO_BOX (priv->find_text_combo)));
     profile_in.content_search = !profile_in.text_pattern.empty() && gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->find_text_check));
     profile_in.match_case = profile_in.content_search && gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->case_check));
+    priv->copy_criteria(profile_in);
 }
 
 void GnomeCmdSelectionProfileComponent::set_focus()
@@ -0,0 +1,545 @@
+/**
+ * @file gnome-cmd-tag-query.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gnome-cmd-tag-query.h"
+
+using namespace std;
+
+
+static const char MAGIC[8] = {'G', 'C', 'M', 'D', 'T', 'A', 'G', '\n'};
+static const uint32_t VERSION = 1;
+static const uint32_t MAX_STRING = 1 << 20;     // longer strings mean a damaged file
+
+
+static string lower(string s)
+{
+    for (auto &c : s)
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+
+    return s;
+}
+
+
+static string trim(const string &s)
+{
+    size_t begin = s.find_first_not_of(" \t\r");
+
+    if (begin == string::npos)
+        return string();
+
+    return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+
+// -------------------------------------------------------------------------- TagCache
+
+GnomeCmd::TagCache::TagCache(const string &f): file(f)
+{
+}
+
+
+GnomeCmd::TagCache &GnomeCmd::TagCache::get_default()
+{
+    static TagCache *cache = nullptr;
+    static once_flag once;
+
+    call_once(once, [] ()
+              {
+                  const char *dir = getenv ("XDG_CACHE_HOME");
+                  string path;
+
+                  if (dir && dir[0] == '/')
+                      path = dir;
+                  else
+                      path = string(getenv ("HOME") ? getenv ("HOME") : "/tmp") + "/.cache";
+
+                  cache = new TagCache(path + "/gnome-commander/tags");
+                  cache->load();
+              });
+
+    return *cache;
+}
+
+
+static bool read_u32(FILE *f, uint32_t &n)
+{
+    return fread (&n, sizeof(n), 1, f) == 1;
+}
+
+
+static bool read_i64(FILE *f, int64_t &n)
+{
+    return fread (&n, sizeof(n), 1, f) == 1;
+}
+
+
+static bool read_string(FILE *f, string &s)
+{
+    uint32_t len;
+
+    if (!read_u32(f, len) || len > MAX_STRING)
+        return false;
+
+    s.resize(len);
+
+    return len == 0 || fread (&s[0], 1, len, f) == len;
+}
+
+
+static bool write_u32(FILE *f, uint32_t n)
+{
+    return fwrite (&n, sizeof(n), 1, f) == 1;
+}
+
+
+static bool write_i64(FILE *f, int64_t n)
+{
+    return fwrite (&n, sizeof(n), 1, f) == 1;
+}
+
+
+static bool write_string(FILE *f, const string &s)
+{
+    return write_u32(f, s.size()) && fwrite (s.data(), 1, s.size(), f) == s.size();
+}
+
+
+bool GnomeCmd::TagCache::load()
+{
+    FILE *f = fopen (file.c_str(), "rb");
+
+    if (!f)
+        return false;
+
+    char magic[sizeof(MAGIC)];
+    uint32_t version;
+    uint32_t count;
+    unordered_map<string, Entry> loaded;
+
+    bool ok = fread (magic, sizeof(magic), 1, f) == 1 && memcmp (magic, MAGIC, sizeof(MAGIC)) == 0 &&
+              read_u32(f, version) && version == VERSION &&
+              read_u32(f, count) && count <= MAX_ENTRIES;
+
+    for (uint32_t i=0; ok && i<count; ++i)
+    {
+        string path;
+        Entry e;
+        uint32_t n;
+
+        ok = read_string(f, path) &&
+             read_i64(f, e.size) && read_i64(f, e.mtime_sec) && read_i64(f, e.mtime_nsec) &&
+             read_u32(f, e.backends) && read_u32(f, n);
+
+        for (uint32_t j=0; ok && j<n; ++j)
+        {
+            string name, value;
+
+            ok = read_string(f, name) && read_string(f, value);
+
+            if (ok)
+                e.values[move (name)] = move (value);
+        }
+
+        if (ok)
+            loaded[move (path)] = move (e);
+    }
+
+    fclose (f);
+
+    if (!ok)
+        return false;
+
+    lock_guard<mutex> lock(entries_mutex);
+
+    entries = move (loaded);
+    dirty = false;
+
+    return true;
+}
+
+
+bool GnomeCmd::TagCache::save()
+{
+    lock_guard<mutex> lock(entries_mutex);
+
+    if (!dirty)
+        return true;
+
+    string dir = file.substr(0, file.rfind('/'));
+
+    for (size_t slash=dir.find('/', 1); slash!=string::npos; slash=dir.find('/', slash + 1))
+        mkdir (dir.substr(0, slash).c_str(), 0700);
+    mkdir (dir.c_str(), 0700);
+
+    string tmp = file + ".XXXXXX";
+    int fd = mkstemp (&tmp[0]);
+
+    if (fd < 0)
+        return false;
+
+    FILE *f = fdopen (fd, "wb");
+
+    if (!f)
+    {
+        close (fd);
+        unlink (tmp.c_str());
+        return false;
+    }
+
+    // when full, the entries used in this session are kept first
+    uint32_t count = min (entries.size(), (size_t) MAX_ENTRIES);
+    uint32_t written = 0;
+
+    bool ok = fwrite (MAGIC, sizeof(MAGIC), 1, f) == 1 && write_u32(f, VERSION) && write_u32(f, count);
+
+    for (int pass=0; pass<2 && ok; ++pass)
+        for (auto &i : entries)
+        {
+            if (!ok || written == count)
+                break;
+
+            const Entry &e = i.second;
+
+            if (e.used != (pass == 0))
+                continue;
+
+            ok = write_string(f, i.first) &&
+                 write_i64(f, e.size) && write_i64(f, e.mtime_sec) && write_i64(f, e.mtime_nsec) &&
+                 write_u32(f, e.backends) && write_u32(f, e.values.size());
+
+            for (auto &v : e.values)
+                ok = ok && write_string(f, v.first) && write_string(f, v.second);
+
+            written++;
+        }
+
+    ok = fclose (f) == 0 && ok;
+
+    if (!ok || rename (tmp.c_str(), file.c_str()) != 0)
+    {
+        unlink (tmp.c_str());
+        return false;
+    }
+
+    dirty = false;
+
+    return true;
+}
+
+
+bool GnomeCmd::TagCache::lookup(const string &path, const struct stat &st, unsigned backends, TagValues &values)
+{
+    lock_guard<mutex> lock(entries_mutex);
+
+    auto i = entries.find(path);
+
+    if (i == entries.end())
+        return false;
+
+    Entry &e = i->second;
+
+    if (e.size != st.st_size || e.mtime_sec != st.st_mtim.tv_sec || e.mtime_nsec != st.st_mtim.tv_nsec || (e.backends & backends) != backends)
+        return false;
+
+    e.used = true;
+    values.insert(e.values.begin(), e.values.end());
+
+    return true;
+}
+
+
+void GnomeCmd::TagCache::store(const string &path, const struct stat &st, unsigned backends, const TagValues &values)
+{
+    lock_guard<mutex> lock(entries_mutex);
+
+    Entry &e = entries[path];
+
+    if (e.size != st.st_size || e.mtime_sec != st.st_mtim.tv_sec || e.mtime_nsec != st.st_mtim.tv_nsec)
+    {
+        e.size = st.st_size;
+        e.mtime_sec = st.st_mtim.tv_sec;
+        e.mtime_nsec = st.st_mtim.tv_nsec;
+        e.backends = 0;
+        e.values.clear();
+    }
+
+    e.backends |= backends;
+    e.values.insert(values.begin(), values.end());
+    e.used = true;
+
+    dirty = true;
+}
+
+
+size_t GnomeCmd::TagCache::size()
+{
+    lock_guard<mutex> lock(entries_mutex);
+
+    return entries.size();
+}
+
+
+// -------------------------------------------------------------------------- TagQuery
+
+GnomeCmd::TagQuery::TagQuery(const Extractor &e, TagCache *c): extractor(e), cache(c)
+{
+}
+
+
+unsigned GnomeCmd::TagQuery::backends_for_class(const string &tag_class)
+{
+    static const unordered_map<string, unsigned> classes = {
+        {"exif", BACKEND_IMAGE}, {"iptc", BACKEND_IMAGE}, {"icc", BACKEND_IMAGE}, {"image", BACKEND_IMAGE},
+        {"audio", BACKEND_AUDIO}, {"ape", BACKEND_AUDIO}, {"flac", BACKEND_AUDIO}, {"id3", BACKEND_AUDIO}, {"vorbis", BACKEND_AUDIO},
+        {"doc", BACKEND_DOC | BACKEND_PDF},
+        {"pdf", BACKEND_PDF}
+    };
+
+    auto i = classes.find(lower(tag_class));
+
+    return i == classes.end() ? 0 : i->second;
+}
+
+
+unsigned GnomeCmd::TagQuery::backends_for_name(const char *name)
+{
+    static const unordered_map<string, unsigned> extensions = {
+        {"jpg", BACKEND_IMAGE}, {"jpeg", BACKEND_IMAGE}, {"jpe", BACKEND_IMAGE}, {"tif", BACKEND_IMAGE}, {"tiff", BACKEND_IMAGE},
+        {"png", BACKEND_IMAGE}, {"webp", BACKEND_IMAGE}, {"heic", BACKEND_IMAGE}, {"heif", BACKEND_IMAGE}, {"avif", BACKEND_IMAGE},
+        {"jp2", BACKEND_IMAGE}, {"psd", BACKEND_IMAGE}, {"exv", BACKEND_IMAGE}, {"gif", BACKEND_IMAGE}, {"bmp", BACKEND_IMAGE},
+        {"cr2", BACKEND_IMAGE}, {"cr3", BACKEND_IMAGE}, {"crw", BACKEND_IMAGE}, {"nef", BACKEND_IMAGE}, {"nrw", BACKEND_IMAGE},
+        {"arw", BACKEND_IMAGE}, {"sr2", BACKEND_IMAGE}, {"srf", BACKEND_IMAGE}, {"dng", BACKEND_IMAGE}, {"orf", BACKEND_IMAGE},
+        {"rw2", BACKEND_IMAGE}, {"pef", BACKEND_IMAGE}, {"raf", BACKEND_IMAGE}, {"srw", BACKEND_IMAGE}, {"mrw", BACKEND_IMAGE},
+        {"x3f", BACKEND_IMAGE},
+        {"mp3", BACKEND_AUDIO}, {"mp2", BACKEND_AUDIO}, {"flac", BACKEND_AUDIO}, {"ogg", BACKEND_AUDIO}, {"oga", BACKEND_AUDIO},
+        {"opus", BACKEND_AUDIO}, {"spx", BACKEND_AUDIO}, {"mpc", BACKEND_AUDIO}, {"ape", BACKEND_AUDIO}, {"wv", BACKEND_AUDIO},
+        {"tta", BACKEND_AUDIO}, {"m4a", BACKEND_AUDIO}, {"m4b", BACKEND_AUDIO}, {"aac", BACKEND_AUDIO}, {"mp4", BACKEND_AUDIO},
+        {"wma", BACKEND_AUDIO}, {"asf", BACKEND_AUDIO}, {"aif", BACKEND_AUDIO}, {"aiff", BACKEND_AUDIO}, {"wav", BACKEND_AUDIO},
+        {"doc", BACKEND_DOC}, {"dot", BACKEND_DOC}, {"xls", BACKEND_DOC}, {"xlt", BACKEND_DOC}, {"ppt", BACKEND_DOC},
+        {"pps", BACKEND_DOC}, {"pot", BACKEND_DOC}, {"msg", BACKEND_DOC}, {"pub", BACKEND_DOC}, {"vsd", BACKEND_DOC},
+        {"odt", BACKEND_DOC}, {"ott", BACKEND_DOC}, {"ods", BACKEND_DOC}, {"ots", BACKEND_DOC}, {"odp", BACKEND_DOC},
+        {"otp", BACKEND_DOC}, {"odg", BACKEND_DOC}, {"otg", BACKEND_DOC},
+        {"pdf", BACKEND_PDF}
+    };
+
+    const char *base = strrchr (name, '/');
+    const char *dot = strrchr (base ? base + 1 : name, '.');
+
+    if (!dot || !dot[1])
+        return 0;
+
+    auto i = extensions.find(lower(dot + 1));
+
+    return i == extensions.end() ? 0 : i->second;
+}
+
+
+bool GnomeCmd::TagQuery::parse(const string &text, string &error)
+{
+    vector<Predicate> parsed;
+    size_t begin = 0;
+
+    while (begin <= text.size())
+    {
+        size_t end = text.find_first_of(";\n", begin);
+
+        if (end == string::npos)
+            end = text.size();
+
+        string criterion = trim(text.substr(begin, end - begin));
+
+        begin = end + 1;
+
+        if (criterion.empty())
+            continue;
+
+        error = criterion;
+
+        size_t name_end = criterion.find_first_of(" \t=!<>~");
+
+        if (name_end == 0 || name_end == string::npos)
+            return false;
+
+        Predicate p;
+
+        p.tag = lower(criterion.substr(0, name_end));
+
+        size_t dot = p.tag.find('.');
+        size_t last_dot = p.tag.rfind('.');
+
+        if (dot == string::npos || dot == 0 || last_dot + 1 == p.tag.size())
+            return false;
+
+        p.backends = backends_for_class(p.tag.substr(0, dot));
+
+        if (!p.backends)
+            return false;
+
+        if (last_dot != dot)
+            p.alias = p.tag.substr(0, dot) + p.tag.substr(last_dot);
+
+        static const struct
+        {
+            const char *text;
+            Op op;
+        }
+        ops[] = {{"==", OP_EQUAL}, {"!=", OP_NOT_EQUAL}, {"<=", OP_LESS_EQUAL}, {">=", OP_GREATER_EQUAL},
+                 {"=", OP_EQUAL}, {"<", OP_LESS}, {">", OP_GREATER}, {"~", OP_CONTAINS}};
+
+        string rest = trim(criterion.substr(name_end));
+        bool found = false;
+
+        for (auto &o : ops)
+            if (rest.compare(0, strlen (o.text), o.text) == 0)
+            {
+                p.op = o.op;
+                p.value = trim(rest.substr(strlen (o.text)));
+                found = true;
+                break;
+            }
+
+        if (p.value.size() >= 2 && p.value.front() == '"' && p.value.back() == '"')
+            p.value = p.value.substr(1, p.value.size() - 2);
+
+        if (!found || p.value.empty())
+            return false;
+
+        parsed.push_back(move (p));
+    }
+
+    predicates = move (parsed);
+    error.clear();
+
+    return true;
+}
+
+
+/**
+ * @returns true if all of @a s is a number
+ */
+static bool to_number(const string &s, double &n)
+{
+    char *end;
+
+    n = strtod (s.c_str(), &end);
+
+    return !s.empty() && end != s.c_str() && *end == '\0';
+}
+
+
+bool GnomeCmd::TagQuery::compare(const Predicate &p, const string &tag_value) const
+{
+    double a, b;
+    int cmp;
+
+    if (p.op == OP_CONTAINS)
+        return lower(tag_value).find(lower(p.value)) != string::npos;
+
+    if (to_number(tag_value, a) && to_number(p.value, b))
+        cmp = a < b ? -1 : a > b ? 1 : 0;
+    else
+        cmp = strcasecmp (tag_value.c_str(), p.value.c_str());
+
+    switch (p.op)
+    {
+        case OP_EQUAL:          return cmp == 0;
+        case OP_NOT_EQUAL:      return cmp != 0;
+        case OP_LESS:           return cmp < 0;
+        case OP_LESS_EQUAL:     return cmp <= 0;
+        case OP_GREATER:        return cmp > 0;
+        case OP_GREATER_EQUAL:  return cmp >= 0;
+        default:                return false;
+    }
+}
+
+
+void GnomeCmd::TagQuery::read(const char *path, const struct stat &st, unsigned backends, TagValues &values) const
+{
+    if (cache && cache->lookup(path, st, backends, values))
+    {
+        files_cached++;
+        return;
+    }
+
+    TagValues read_values;
+
+    for (unsigned b=BACKEND_IMAGE; b<=BACKEND_PDF; b<<=1)
+        if (backends & b)
+            extractor((Backend) b, path, read_values);
+
+    files_read++;
+
+    TagValues found;
+
+    for (auto &v : read_values)
+        found[lower(v.first)] = v.second;
+
+    if (cache)
+        cache->store(path, st, backends, found);
+
+    values.insert(found.begin(), found.end());
+}
+
+
+bool GnomeCmd::TagQuery::match(const char *path, const struct stat &st) const
+{
+    unsigned available = backends_for_name(path);
+    unsigned needed = 0;
+
+    // a file no backend of a criterion can read is not opened at all
+    for (auto &p : predicates)
+    {
+        unsigned b = p.backends & available;
+
+        if (!b)
+            return false;
+
+        needed |= b;
+    }
+
+    if (!needed)
+        return true;
+
+    TagValues values;
+
+    read(path, st, needed, values);
+
+    for (auto &p : predicates)
+    {
+        auto i = values.find(p.tag);
+
+        if (i == values.end() && !p.alias.empty())
+            i = values.find(p.alias);
+
+        if (i == values.end() || !compare(p, i->second))
+            return false;
+    }
+
+    return true;
+}
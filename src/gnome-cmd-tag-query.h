@@ -0,0 +1,208 @@
+/**
+ * @file gnome-cmd-tag-query.h
+ * @brief Searching by the meta tags of local files.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace GnomeCmd
+{
+    /**
+     * The tag values of a file by their lower case names, e.g. "id3.artist".
+     * Several values of one tag are joined by ", ".
+     */
+    typedef std::map<std::string, std::string> TagValues;
+
+
+    /**
+     * The tags of local files already read, keyed by path and checked
+     * against the size and mtime of the file. It is kept in a file between
+     * sessions, so that searching the same photos or music again reads
+     * no file but the cache.
+     */
+    class TagCache
+    {
+        struct Entry
+        {
+            int64_t size {-1};
+            int64_t mtime_sec {0};
+            int64_t mtime_nsec {0};
+            unsigned backends {0};          /**< whose tags have been read */
+            TagValues values;
+            bool used {false};              /**< in this session, unused ones go first when the cache is full */
+        };
+
+        std::string file;
+        std::mutex entries_mutex;
+        std::unordered_map<std::string, Entry> entries;
+        bool dirty {false};
+
+      public:
+
+        enum
+        {
+            MAX_ENTRIES = 200000
+        };
+
+        explicit TagCache(const std::string &file);
+
+        TagCache(const TagCache &) = delete;
+        TagCache &operator = (const TagCache &) = delete;
+
+        /**
+         * The cache in $XDG_CACHE_HOME/gnome-commander/tags, loaded on first use.
+         */
+        static TagCache &get_default();
+
+        /**
+         * Reads the file, replacing the entries.
+         *
+         * @returns false if there is none or it is damaged
+         */
+        bool load();
+
+        /**
+         * Writes the file if an entry has been added since it was loaded.
+         */
+        bool save();
+
+        /**
+         * Adds the values of the file to @a values if those of all @a backends are known.
+         */
+        bool lookup(const std::string &path, const struct stat &st, unsigned backends, TagValues &values);
+
+        /**
+         * Adds @a values as the tags of @a backends, the entry is dropped first if the file has changed.
+         */
+        void store(const std::string &path, const struct stat &st, unsigned backends, const TagValues &values);
+
+        size_t size();
+    };
+
+
+    /**
+     * Criteria on meta tags, one per line or separated by ';', all of which
+     * must hold:
+     *
+     *   Exif.DateTimeOriginal >= 2024
+     *   ID3.Artist ~ foo
+     *
+     * The operators are = != < <= > >= and ~ for "contains". A value is
+     * compared as a number if it and the tag both are numbers, as text
+     * ignoring case otherwise, so that a date in Exif's "YYYY:MM:DD hh:mm:ss"
+     * form compares to a year or a date by its prefix. A missing tag
+     * matches nothing. Exiv2's three part names like Exif.Photo.DateTimeOriginal
+     * are accepted as well.
+     *
+     * The class before the first '.' tells which backend reads the tag and
+     * the extension of a file which backends can read it, so only files of
+     * a fitting type are opened at all, by those backends only.
+     */
+    class TagQuery
+    {
+      public:
+
+        enum Backend
+        {
+            BACKEND_IMAGE = 1,              /**< Exif, IPTC, ICC and Image */
+            BACKEND_AUDIO = 2,              /**< Audio, APE, FLAC, ID3 and Vorbis */
+            BACKEND_DOC = 4,                /**< Doc, of OLE2 and ODF documents */
+            BACKEND_PDF = 8                 /**< PDF and Doc, of PDF documents */
+        };
+
+        /**
+         * Reads the tags of one backend of a local file, called by the
+         * search threads.
+         */
+        typedef std::function<void (Backend backend, const char *path, TagValues &values)> Extractor;
+
+      private:
+
+        enum Op
+        {
+            OP_EQUAL,
+            OP_NOT_EQUAL,
+            OP_CONTAINS,
+            OP_LESS,
+            OP_LESS_EQUAL,
+            OP_GREATER,
+            OP_GREATER_EQUAL
+        };
+
+        struct Predicate
+        {
+            std::string tag;                /**< lower case */
+            std::string alias;              /**< the class and the last part of a three part name, or empty */
+            Op op;
+            std::string value;
+            unsigned backends;
+        };
+
+        std::vector<Predicate> predicates;
+        Extractor extractor;
+        TagCache *cache;
+
+        bool compare(const Predicate &p, const std::string &tag_value) const;
+        void read(const char *path, const struct stat &st, unsigned backends, TagValues &values) const;
+
+      public:
+
+        mutable std::atomic<uint64_t> files_read {0};       /**< by the extractor */
+        mutable std::atomic<uint64_t> files_cached {0};     /**< answered by the cache */
+
+        /**
+         * @a cache is optional.
+         */
+        TagQuery(const Extractor &extractor, TagCache *cache);
+
+        /**
+         * Replaces the criteria by those in @a text.
+         *
+         * @returns false with the offending criterion in @a error if @a text can't be parsed
+         */
+        bool parse(const std::string &text, std::string &error);
+
+        bool empty() const                  {  return predicates.empty();  }
+
+        /**
+         * @returns the backends which can read tags of the class, 0 for an unknown one
+         */
+        static unsigned backends_for_class(const std::string &tag_class);
+
+        /**
+         * @returns the backends which can read a file of this name, by its extension
+         */
+        static unsigned backends_for_name(const char *name);
+
+        /**
+         * @param st the lstat record of the regular file @a path
+         */
+        bool match(const char *path, const struct stat &st) const;
+    };
+}
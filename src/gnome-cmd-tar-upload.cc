@@ -0,0 +1,664 @@
+/**
+ * @file gnome-cmd-tar-upload.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+
+#include "gnome-cmd-tar-upload.h"
+
+using namespace std;
+
+extern char **environ;
+
+
+/** The remote shell and the threads collecting what it prints */
+struct GnomeCmd::TarUpload::Child
+{
+    pid_t pid {0};
+    int in {-1};                            /**< the stdin of the shell, -1 if it reads /dev/null */
+    string out;
+    string err;
+    thread out_reader;
+    thread err_reader;
+};
+
+
+static void read_all (int fd, string &text)
+{
+    char buf[4096];
+
+    for (;;)
+    {
+        ssize_t n = read (fd, buf, sizeof(buf));
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n <= 0)
+            break;
+
+        text.append(buf, n);
+    }
+
+    close (fd);
+}
+
+
+/** @returns the last line the remote side printed to stderr, which usually names the problem */
+static string last_line (const string &text)
+{
+    size_t end = text.find_last_not_of("\n ");
+
+    if (end == string::npos)
+        return "";
+
+    size_t start = text.rfind('\n', end);
+
+    return text.substr(start == string::npos ? 0 : start + 1, end + 1 - (start == string::npos ? 0 : start + 1));
+}
+
+
+/** Writes @a value as a NUL terminated octal number, or base-256 as GNU tar does if it doesn't fit */
+static void put_number (char *field, size_t len, uint64_t value)
+{
+    if (value < (1ULL << (3 * (len - 1))))
+    {
+        snprintf (field, len, "%0*llo", (int) len - 1, (unsigned long long) value);
+        return;
+    }
+
+    memset (field, 0, len);
+    field[0] = (char) 0x80;
+
+    for (size_t i=len-1; i>0 && value; --i, value>>=8)
+        field[i] = (char) (value & 0xff);
+}
+
+
+GnomeCmd::TarUpload::TarUpload(const Options &opts, const vector<string> &remote_shell, const string &dir):
+    options(opts), shell(remote_shell), dest_dir(dir)
+{
+}
+
+
+string GnomeCmd::TarUpload::shell_quote(const string &s)
+{
+    string quoted = "'";
+
+    for (char c : s)
+        if (c == '\'')
+            quoted += "'\\''";
+        else
+            quoted += c;
+
+    return quoted + "'";
+}
+
+
+vector<string> GnomeCmd::TarUpload::ssh_command(const string &host, unsigned port, const string &user)
+{
+    vector<string> argv {"ssh", "-o", "BatchMode=yes", "-o", "ConnectTimeout=15"};
+
+    if (port)
+    {
+        argv.push_back("-p");
+        argv.push_back(to_string(port));
+    }
+
+    if (!user.empty())
+    {
+        argv.push_back("-l");
+        argv.push_back(user);
+    }
+
+    argv.push_back("--");
+    argv.push_back(host);
+
+    return argv;
+}
+
+
+string GnomeCmd::TarUpload::get_current_file()
+{
+    ProgressEvents::Event event;
+
+    if (file_events.pop_latest(event))
+        shown_file = move (event.path);
+
+    return shown_file;
+}
+
+
+void GnomeCmd::TarUpload::cancel()
+{
+    cancelled = true;
+
+    // the pid can't be reused before finish() has reaped it, which clears it first
+    lock_guard<std::mutex> lock(child_mutex);
+
+    if (child_pid > 0)
+        kill (child_pid, SIGTERM);
+}
+
+
+GnomeCmd::ErrorAction GnomeCmd::TarUpload::report(const string &path, int error)
+{
+    ErrorAction action = on_error ? on_error (path, error) : ERROR_ACTION_ABORT;
+
+    if (action == ERROR_ACTION_ABORT)
+        aborted = true;
+
+    return action;
+}
+
+
+bool GnomeCmd::TarUpload::start(Child &child, const string &script, bool with_input)
+{
+    int in[2] = {-1, -1};
+    int out[2] = {-1, -1};
+    int err[2] = {-1, -1};
+
+    if ((with_input && pipe2 (in, O_CLOEXEC) != 0) || pipe2 (out, O_CLOEXEC) != 0 || pipe2 (err, O_CLOEXEC) != 0)
+    {
+        remote_error = strerror (errno);
+
+        for (int fd : {in[0], in[1], out[0], out[1], err[0], err[1]})
+            if (fd >= 0)
+                close (fd);
+
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+
+    posix_spawn_file_actions_init (&actions);
+
+    if (with_input)
+        posix_spawn_file_actions_adddup2 (&actions, in[0], STDIN_FILENO);
+    else
+        posix_spawn_file_actions_addopen (&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+
+    posix_spawn_file_actions_adddup2 (&actions, out[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2 (&actions, err[1], STDERR_FILENO);
+
+    vector<char *> argv;
+
+    for (auto &arg : shell)
+        argv.push_back(const_cast<char *> (arg.c_str()));
+
+    argv.push_back(const_cast<char *> (script.c_str()));
+    argv.push_back(nullptr);
+
+    int ret = shell.empty() ? EINVAL : posix_spawnp (&child.pid, argv[0], &actions, nullptr, argv.data(), environ);
+
+    posix_spawn_file_actions_destroy (&actions);
+
+    for (int fd : {in[0], out[1], err[1]})
+        if (fd >= 0)
+            close (fd);
+
+    if (ret != 0)
+    {
+        remote_error = strerror (ret);
+
+        for (int fd : {in[1], out[0], err[0]})
+            if (fd >= 0)
+                close (fd);
+
+        return false;
+    }
+
+    {
+        lock_guard<std::mutex> lock(child_mutex);
+        child_pid = child.pid;
+
+        if (cancelled)
+            kill (child_pid, SIGTERM);
+    }
+
+    child.in = in[1];
+    child.out_reader = thread(read_all, out[0], ref(child.out));
+    child.err_reader = thread(read_all, err[0], ref(child.err));
+
+    return true;
+}
+
+
+/**
+ * Waits for the remote shell to exit.
+ *
+ * @returns its exit status, or 128 plus the signal which killed it
+ */
+int GnomeCmd::TarUpload::finish(Child &child)
+{
+    if (child.in >= 0)
+    {
+        close (child.in);
+        child.in = -1;
+    }
+
+    child.out_reader.join();
+    child.err_reader.join();
+
+    {
+        lock_guard<std::mutex> lock(child_mutex);
+        child_pid = 0;
+    }
+
+    int status;
+
+    while (waitpid (child.pid, &status, 0) < 0)
+        if (errno != EINTR)
+            return 127;
+
+    return WIFEXITED (status) ? WEXITSTATUS (status) : 128 + WTERMSIG (status);
+}
+
+
+bool GnomeCmd::TarUpload::probe(vector<string> &existing)
+{
+    remote_error.clear();
+
+    Child child;
+    string script = "command -v tar >/dev/null 2>&1 || exit 127; cd " + shell_quote (dest_dir) + " 2>/dev/null && ls -1A; exit 0";
+
+    if (!start (child, script, false))
+        return false;
+
+    int status = finish (child);
+
+    if (status != 0)
+    {
+        remote_error = last_line (child.err);
+
+        if (remote_error.empty())
+            remote_error = status == 127 ? "tar is not available" : "exit status " + to_string(status);
+
+        return false;
+    }
+
+    size_t pos = 0;
+
+    for (size_t end; (end = child.out.find('\n', pos)) != string::npos; pos = end + 1)
+        if (end > pos)
+            existing.push_back(child.out.substr(pos, end - pos));
+
+    return true;
+}
+
+
+void GnomeCmd::TarUpload::scan(const string &path)
+{
+    struct stat st;
+
+    if ((options.follow_links ? stat (path.c_str(), &st) : lstat (path.c_str(), &st)) != 0)
+        return;
+
+    if (S_ISDIR (st.st_mode))
+    {
+        vector<string> names;
+        int error;
+
+        if (list_directory (path, names, error))
+            for (auto &name : names)
+                scan(path + "/" + name);
+
+        return;
+    }
+
+    files_total++;
+
+    if (S_ISREG (st.st_mode))
+        bytes_total += st.st_size;
+}
+
+
+bool GnomeCmd::TarUpload::run(const vector<Item> &items)
+{
+    aborted = false;
+    remote_error.clear();
+    files_total = files_done = 0;
+    bytes_total = bytes_done = 0;
+
+    for (auto &item : items)
+        scan(item.first);
+
+    // a remote side quitting early must show up as EPIPE instead of killing the process
+    sigset_t sigpipe, old_mask;
+
+    sigemptyset (&sigpipe);
+    sigaddset (&sigpipe, SIGPIPE);
+    pthread_sigmask (SIG_BLOCK, &sigpipe, &old_mask);
+
+    Child child;
+    string dir = shell_quote (dest_dir);
+    string script = "mkdir -p -- " + dir + " && exec tar -x -f - --no-same-owner -C " + dir;
+
+    if (!options.replace)
+        script += " --skip-old-files";
+
+    if (!start (child, script, true))
+    {
+        pthread_sigmask (SIG_SETMASK, &old_mask, nullptr);
+        return false;
+    }
+
+    out_fd = child.in;
+    write_error = 0;
+    buffer.clear();
+    buffer.reserve(BUFFER_SIZE);
+
+    for (auto &item : items)
+        if (!add_item (item.first, item.second))
+            break;
+
+    bool complete = !aborted && !cancelled && !write_error;
+
+    // the end of the archive, two empty records
+    if (complete)
+    {
+        buffer.insert(buffer.end(), 2 * BLOCK_SIZE, '\0');
+        complete = flush ();
+    }
+    else
+        if (!write_error)
+        {
+            // don't let the remote side unpack a truncated archive
+            lock_guard<std::mutex> lock(child_mutex);
+            kill (child_pid, SIGTERM);
+        }
+
+    out_fd = -1;
+    buffer = vector<char>();
+
+    int status = finish (child);
+
+    struct timespec no_wait = {0, 0};
+
+    if (write_error == EPIPE)
+        sigtimedwait (&sigpipe, nullptr, &no_wait);
+
+    pthread_sigmask (SIG_SETMASK, &old_mask, nullptr);
+
+    if (cancelled || aborted)
+        return false;
+
+    if (!complete || status != 0)
+    {
+        remote_error = last_line (child.err);
+
+        if (remote_error.empty())
+            remote_error = write_error ? strerror (write_error) : "exit status " + to_string(status);
+
+        return false;
+    }
+
+    return true;
+}
+
+
+bool GnomeCmd::TarUpload::add_item(const string &path, const string &name)
+{
+    if (cancelled || write_error)
+        return false;
+
+    struct stat st;
+
+    while ((options.follow_links ? stat (path.c_str(), &st) : lstat (path.c_str(), &st)) != 0)
+        switch (report (path, errno))
+        {
+            case ERROR_ACTION_RETRY:
+                continue;
+            case ERROR_ACTION_SKIP:
+                return true;
+            default:
+                return false;
+        }
+
+    file_events.push(path);
+
+    if (S_ISDIR (st.st_mode))
+        return add_directory (path, name, st);
+
+    if (S_ISREG (st.st_mode))
+        return add_regular (path, name);
+
+    if (S_ISLNK (st.st_mode))
+    {
+        char target[PATH_MAX];
+        ssize_t len;
+
+        while ((len = readlink (path.c_str(), target, sizeof(target))) < 0)
+            switch (report (path, errno))
+            {
+                case ERROR_ACTION_RETRY:
+                    continue;
+                case ERROR_ACTION_SKIP:
+                    return true;
+                default:
+                    return false;
+            }
+
+        add_header (name, st, '2', 0, string(target, len));
+        files_done++;
+
+        return !write_error;
+    }
+
+    // devices, fifos and sockets are not uploaded
+    return report (path, ENOTSUP) != ERROR_ACTION_ABORT;
+}
+
+
+bool GnomeCmd::TarUpload::add_directory(const string &path, const string &name, const struct stat &st)
+{
+    vector<string> names;
+    int error;
+
+    while (!list_directory (path, names, error))
+        switch (report (path, error))
+        {
+            case ERROR_ACTION_RETRY:
+                continue;
+            case ERROR_ACTION_SKIP:
+                return true;
+            default:
+                return false;
+        }
+
+    add_header (name + "/", st, '5', 0);
+
+    for (auto &child : names)
+        if (!add_item (path + "/" + child, name + "/" + child))
+            return false;
+
+    return !write_error;
+}
+
+
+bool GnomeCmd::TarUpload::add_regular(const string &path, const string &name)
+{
+    int fd;
+
+    while ((fd = open (path.c_str(), O_RDONLY | O_CLOEXEC)) < 0)
+        switch (report (path, errno))
+        {
+            case ERROR_ACTION_RETRY:
+                continue;
+            case ERROR_ACTION_SKIP:
+                return true;
+            default:
+                return false;
+        }
+
+    // the header needs the size of what is actually read, not of what was scanned
+    struct stat st;
+
+    if (fstat (fd, &st) != 0)
+    {
+        int error = errno;
+        close (fd);
+        return report (path, error) != ERROR_ACTION_ABORT;
+    }
+
+    uint64_t size = st.st_size;
+    uint64_t left = size;
+    int error = 0;
+
+    add_header (name, st, '0', size);
+
+    while (left > 0 && !write_error && !cancelled)
+    {
+        if (buffer.size() >= BUFFER_SIZE)
+        {
+            flush ();
+            continue;
+        }
+
+        size_t used = buffer.size();
+        size_t want = min<uint64_t> (BUFFER_SIZE - used, left);
+
+        buffer.resize(used + want);
+
+        ssize_t n = read (fd, &buffer[used], want);
+
+        if (n < 0 && errno == EINTR)
+        {
+            buffer.resize(used);
+            continue;
+        }
+
+        if (n <= 0)
+        {
+            // the file shrank or can't be read, the archive still needs the announced size
+            error = n < 0 ? errno : EIO;
+            buffer.resize(used);
+            break;
+        }
+
+        buffer.resize(used + n);
+        left -= n;
+        bytes_done += n;
+    }
+
+    close (fd);
+
+    if (cancelled || write_error)
+        return false;
+
+    if (left > 0)
+    {
+        buffer.insert(buffer.end(), left, '\0');
+        bytes_done += left;
+    }
+
+    pad (size);
+    files_done++;
+
+    return !error || report (path, error) != ERROR_ACTION_ABORT;
+}
+
+
+void GnomeCmd::TarUpload::add_header(const string &name, const struct stat &st, char type, uint64_t size, const string &link)
+{
+    // names and link targets longer than the header fields are sent ahead as GNU long name records
+    struct stat none = {};
+
+    if (name.size() > 100)
+    {
+        add_header ("././@LongLink", none, 'L', name.size() + 1);
+        put (name.c_str(), name.size() + 1);
+        pad (name.size() + 1);
+    }
+
+    if (link.size() > 100)
+    {
+        add_header ("././@LongLink", none, 'K', link.size() + 1);
+        put (link.c_str(), link.size() + 1);
+        pad (link.size() + 1);
+    }
+
+    char h[BLOCK_SIZE] = {};
+
+    memcpy (h, name.data(), min<size_t> (name.size(), 100));
+    put_number (h + 100, 8, st.st_mode & 07777);
+    put_number (h + 108, 8, st.st_uid);
+    put_number (h + 116, 8, st.st_gid);
+    put_number (h + 124, 12, size);
+    put_number (h + 136, 12, st.st_mtime > 0 ? st.st_mtime : 0);
+    h[156] = type;
+    memcpy (h + 157, link.data(), min<size_t> (link.size(), 100));
+    memcpy (h + 257, "ustar  ", 8);
+
+    // the checksum is computed with the checksum field set to spaces
+    memset (h + 148, ' ', 8);
+
+    unsigned sum = 0;
+
+    for (unsigned char c : h)
+        sum += c;
+
+    snprintf (h + 148, 7, "%06o", sum);
+    h[155] = ' ';
+
+    put (h, sizeof(h));
+}
+
+
+void GnomeCmd::TarUpload::put(const char *data, size_t len)
+{
+    buffer.insert(buffer.end(), data, data + len);
+
+    if (buffer.size() >= BUFFER_SIZE)
+        flush ();
+}
+
+
+/** Fills the last record of an entry of @a size bytes with zeros */
+void GnomeCmd::TarUpload::pad(uint64_t size)
+{
+    size_t rest = size % BLOCK_SIZE;
+
+    if (rest)
+        buffer.insert(buffer.end(), BLOCK_SIZE - rest, '\0');
+}
+
+
+bool GnomeCmd::TarUpload::flush()
+{
+    if (!write_error && !write_all (out_fd, buffer.data(), buffer.size()))
+        write_error = errno;
+
+    buffer.clear();
+
+    return !write_error;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file gnome-cmd-tar-upload.h
+ * @brief Uploading local files to a remote shell as a single tar stream.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gnome-cmd-file-io.h"
+#include "gnome-cmd-progress.h"
+
+namespace GnomeCmd
+{
+    /**
+     * Uploads files and directory trees by packing them into a tar archive
+     * which is piped into `tar -x` on the remote side.
+     *
+     * Copying many small files over SFTP costs a round trip per file, while
+     * the tar stream keeps the connection busy with a single channel. The
+     * remote side is reached by a shell command line, e.g. the one returned
+     * by ssh_command(), which gets the script to run as its last argument.
+     * probe() tells whether the remote side can unpack the stream at all, so
+     * that the caller can fall back to a per file transfer otherwise.
+     */
+    class TarUpload
+    {
+      public:
+
+        typedef std::function<ErrorAction (const std::string &path, int error)> ErrorFunc;
+
+        typedef std::pair<std::string,std::string> Item;        /**< local path and the name in the remote directory */
+
+        enum
+        {
+            BLOCK_SIZE = 512,                   /**< tar record size */
+            BUFFER_SIZE = 1 << 20               /**< data collected before it is written to the pipe */
+        };
+
+        struct Options
+        {
+            bool replace {true};                /**< existing remote files are replaced, otherwise they are kept */
+            bool follow_links {false};
+        };
+
+      private:
+
+        struct Child;
+
+        std::atomic<bool> cancelled {false};
+        bool aborted {false};
+
+        std::mutex child_mutex;
+        pid_t child_pid {0};                /**< the running remote shell, killed on cancel() */
+
+        ProgressEvents file_events;
+        std::string shown_file;             /**< belongs to the GUI thread */
+
+        std::vector<char> buffer;
+        int out_fd {-1};
+        int write_error {0};
+
+        bool start(Child &child, const std::string &script, bool with_input);
+        int finish(Child &child);
+
+        void scan(const std::string &path);
+        bool add_item(const std::string &path, const std::string &name);
+        bool add_directory(const std::string &path, const std::string &name, const struct stat &st);
+        bool add_regular(const std::string &path, const std::string &name);
+        void add_header(const std::string &name, const struct stat &st, char type, uint64_t size, const std::string &link="");
+        void put(const char *data, size_t len);
+        void pad(uint64_t size);
+        bool flush();
+        ErrorAction report(const std::string &path, int error);
+
+      public:
+
+        Options options;
+        std::vector<std::string> shell;     /**< the command line reaching the remote shell, without the script */
+        std::string dest_dir;               /**< remote directory the items are unpacked into */
+
+        std::atomic<uint64_t> files_total {0};
+        std::atomic<uint64_t> files_done {0};
+        std::atomic<uint64_t> bytes_total {0};
+        std::atomic<uint64_t> bytes_done {0};
+
+        std::string remote_error;           /**< set when the remote side failed, the job can be retried another way */
+
+        ErrorFunc on_error;                 /**< asked on local errors, the job is aborted if not set */
+
+        TarUpload(const Options &opts, const std::vector<std::string> &remote_shell, const std::string &dir);
+
+        /**
+         * Checks that the remote side has a shell and tar, and lists the
+         * names already present in dest_dir.
+         *
+         * @returns false if the stream can't be unpacked remotely
+         */
+        bool probe(std::vector<std::string> &existing);
+
+        /**
+         * Streams all items into dest_dir, recursing into directories.
+         *
+         * @returns false if the job was aborted or cancelled, or the remote side failed
+         */
+        bool run(const std::vector<Item> &items);
+
+        /** Called by the GUI thread */
+        std::string get_current_file();
+
+        void cancel();
+        bool is_cancelled() const           {  return cancelled;  }
+
+        /**
+         * @returns the command line running ssh in batch mode, so that it
+         * fails instead of asking for a password
+         */
+        static std::vector<std::string> ssh_command(const std::string &host, unsigned port=0, const std::string &user="");
+
+        /** @returns @a s quoted for a POSIX shell */
+        static std::string shell_quote(const std::string &s);
+    };
+}
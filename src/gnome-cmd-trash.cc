@@ -0,0 +1,623 @@
+/**
+ * @file gnome-cmd-trash.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "gnome-cmd-trash.h"
+#include "gnome-cmd-xfer-engine.h"
+#include "gnome-cmd-delete-engine.h"
+
+using namespace std;
+
+
+inline string dirname_of (const string &path)
+{
+    string::size_type slash = path.rfind('/');
+
+    return slash==0 || slash==string::npos ? "/" : path.substr(0, slash);
+}
+
+
+inline string basename_of (const string &path)
+{
+    string::size_type slash = path.rfind('/');
+
+    return slash==string::npos ? path : path.substr(slash+1);
+}
+
+
+/** Creates @a path with mode 0700 unless it is a directory already */
+static bool make_dir (const string &path)
+{
+    struct stat st;
+
+    if (mkdir (path.c_str(), 0700) == 0)
+        return true;
+
+    return errno == EEXIST && lstat (path.c_str(), &st) == 0 && S_ISDIR (st.st_mode);
+}
+
+
+static bool make_dirs (const string &path)
+{
+    if (path.empty() || path == "/")
+        return true;
+
+    return make_dir (path) || (make_dirs (dirname_of (path)) && make_dir (path));
+}
+
+
+/** @returns the disk space used by @a path, including everything below it */
+static uint64_t disk_usage (const string &path)
+{
+    struct stat st;
+
+    if (lstat (path.c_str(), &st) != 0)
+        return 0;
+
+    uint64_t size = (uint64_t) st.st_blocks * 512;
+
+    if (!S_ISDIR (st.st_mode))
+        return size;
+
+    if (DIR *dir = opendir (path.c_str()))
+    {
+        while (struct dirent *entry = readdir (dir))
+            if (strcmp (entry->d_name, ".") != 0 && strcmp (entry->d_name, "..") != 0)
+                size += disk_usage (path + "/" + entry->d_name);
+
+        closedir (dir);
+    }
+
+    return size;
+}
+
+
+static void sync_dir (const string &path)
+{
+    int fd = open (path.c_str(), O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+
+    if (fd >= 0)
+    {
+        fsync (fd);
+        close (fd);
+    }
+}
+
+
+GnomeCmd::Trash::Trash(const string &home): home_trash(home)
+{
+}
+
+
+string GnomeCmd::Trash::default_home_trash()
+{
+    const char *data_home = getenv ("XDG_DATA_HOME");
+
+    if (data_home && *data_home == '/')
+        return string(data_home) + "/Trash";
+
+    const char *home = getenv ("HOME");
+
+    return string(home ? home : "") + "/.local/share/Trash";
+}
+
+
+string GnomeCmd::Trash::encode_path(const string &path)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    string s;
+
+    for (unsigned char c : path)
+        if (isalnum (c) || strchr ("/-._~", c))
+            s += c;
+        else
+        {
+            s += '%';
+            s += hex[c >> 4];
+            s += hex[c & 15];
+        }
+
+    return s;
+}
+
+
+GnomeCmd::ErrorAction GnomeCmd::Trash::report(const string &path, int error)
+{
+    ErrorAction action = on_error ? on_error (path, error) : ERROR_ACTION_ABORT;
+
+    if (action == ERROR_ACTION_ABORT)
+        aborted = true;
+
+    return action;
+}
+
+
+GnomeCmd::Trash::Dir *GnomeCmd::Trash::get_home_dir()
+{
+    struct stat st;
+
+    if (home_dir)
+        return home_dir;
+
+    if (!make_dirs (home_trash + "/files") || !make_dir (home_trash + "/info") || stat (home_trash.c_str(), &st) != 0)
+        return nullptr;
+
+    home_dir = new Dir;
+    home_dir->path = home_trash;
+    home_dir->dev = st.st_dev;
+
+    dirs.emplace_back(home_dir);
+    dev_dirs[st.st_dev] = home_dir;
+
+    return home_dir;
+}
+
+
+/**
+ * Sets up the trash directory of the volume mounted at @a topdir, either
+ * $topdir/.Trash/$uid if the administrator has prepared $topdir/.Trash or
+ * $topdir/.Trash-$uid otherwise.
+ */
+GnomeCmd::Trash::Dir *GnomeCmd::Trash::get_volume_dir(const string &topdir, dev_t dev)
+{
+    string uid = to_string (getuid ());
+    string base = topdir == "/" ? "" : topdir;
+    string shared = base + "/.Trash";
+    vector<string> candidates;
+    struct stat st;
+
+    // the shared directory must not be a symbolic link and must have the sticky bit
+    if (lstat (shared.c_str(), &st) == 0 && S_ISDIR (st.st_mode) && (st.st_mode & S_ISVTX))
+        candidates.push_back(shared + "/" + uid);
+
+    candidates.push_back(base + "/.Trash-" + uid);
+
+    for (auto &path : candidates)
+        if (make_dir (path) && make_dir (path + "/files") && make_dir (path + "/info") &&
+            stat (path.c_str(), &st) == 0 && st.st_dev == dev)
+        {
+            Dir *dir = new Dir;
+
+            dir->path = path;
+            dir->topdir = topdir;
+            dir->dev = dev;
+            dirs.emplace_back(dir);
+
+            return dir;
+        }
+
+    return nullptr;
+}
+
+
+/**
+ * @returns the trash directory for @a path on device @a dev. This is the home
+ * trash if the volume has no usable one, files are copied there then.
+ */
+GnomeCmd::Trash::Dir *GnomeCmd::Trash::get_dir(const string &path, dev_t dev)
+{
+    Dir *home = get_home_dir();
+    auto i = dev_dirs.find(dev);
+
+    if (i != dev_dirs.end())
+        return i->second;
+
+    // the mount point is the topmost directory on the same device
+    string topdir = dirname_of (path);
+    struct stat st;
+
+    while (topdir != "/")
+    {
+        string parent = dirname_of (topdir);
+
+        if (stat (parent.c_str(), &st) != 0 || st.st_dev != dev)
+            break;
+
+        topdir = parent;
+    }
+
+    Dir *dir = get_volume_dir(topdir, dev);
+
+    if (!dir)
+        dir = home;
+
+    dev_dirs[dev] = dir;
+
+    return dir;
+}
+
+
+/**
+ * Creates the info file for @a path under a name which is neither used in
+ * "info" nor in "files" yet.
+ *
+ * @returns 0 or an errno value
+ */
+int GnomeCmd::Trash::reserve_name(Dir *dir, const string &path, string &name)
+{
+    string base = basename_of (path);
+
+    for (unsigned n=1; ; ++n)
+    {
+        if (n == 1)
+            name = base;
+        else
+        {
+            // "name.2.ext", like other implementations do
+            string::size_type dot = base.rfind('.');
+
+            if (dot == string::npos || dot == 0)
+                dot = base.size();
+
+            name = base.substr(0, dot) + "." + to_string(n) + base.substr(dot);
+        }
+
+        string info_path = dir->path + "/info/" + name + ".trashinfo";
+        int fd = open (info_path.c_str(), O_WRONLY|O_CREAT|O_EXCL|O_CLOEXEC, 0600);
+
+        if (fd < 0)
+        {
+            if (errno == EEXIST)
+                continue;
+            return errno;
+        }
+
+        struct stat st;
+
+        // a leftover without info file
+        if (lstat ((dir->path + "/files/" + name).c_str(), &st) == 0)
+        {
+            close (fd);
+            unlink (info_path.c_str());
+            continue;
+        }
+
+        char date[32];
+        time_t now = time (nullptr);
+        struct tm tm;
+
+        strftime (date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime_r (&now, &tm));
+
+        // volume trashes store the path relative to the mount point
+        string stored = dir->topdir.empty() ? path :
+                        dir->topdir == "/" ? path.substr(1) : path.substr(dir->topdir.size()+1);
+        string info = "[Trash Info]\nPath=" + encode_path(stored) + "\nDeletionDate=" + date + "\n";
+
+        int error = write (fd, info.data(), info.size()) == (ssize_t) info.size() ? 0 : errno ? errno : EIO;
+
+        if (close (fd) != 0 && !error)
+            error = errno;
+
+        if (error)
+            unlink (info_path.c_str());
+
+        return error;
+    }
+}
+
+
+/**
+ * Moves @a path to @a dest, by renaming it or, across file systems, by copying and deleting it.
+ *
+ * @returns false if nothing of @a path has been removed, then nothing is left at @a dest
+ */
+bool GnomeCmd::Trash::move_item(const string &path, const string &dest)
+{
+    for (;;)
+    {
+        if (rename (path.c_str(), dest.c_str()) == 0)
+            return true;
+
+        if (errno != EXDEV)
+        {
+            if (report(path, errno) == ERROR_ACTION_RETRY)
+                continue;
+            return false;
+        }
+
+        XferEngine::Options options;
+
+        options.overwrite_mode = XferEngine::OVERWRITE_MODE_ABORT;
+
+        XferEngine copy(options);
+        DeleteEngine del;
+
+        copy.on_error = [this] (const string &p, int e) { return report(p, e); };
+        del.on_error = [this] (const string &p, int e) { return report(p, e); };
+
+        if (!copy.run({{path, dest}}))
+        {
+            // the source is complete, don't leave a partial copy in the trash
+            DeleteEngine cleanup;
+            cleanup.run({dest});
+
+            return false;
+        }
+
+        if (del.run({path}) && del.removed[0])
+            return true;
+
+        // what has been removed of the source is only in the trash now, so the copy and its
+        // info are kept, the errors have been reported by del
+        if (del.files_removed > 0)
+            return true;
+
+        DeleteEngine cleanup;
+        cleanup.run({dest});
+
+        return false;
+    }
+}
+
+
+void GnomeCmd::Trash::trash_batch(Dir *dir, const vector<size_t> &batch, const vector<string> &paths)
+{
+    for (size_t index : batch)
+    {
+        if (cancelled || aborted)
+            break;
+
+        const string &path = paths[index];
+        string name;
+        int error;
+
+        while ((error = reserve_name(dir, path, name)) != 0)
+            if (report(dir->path + "/info", error) != ERROR_ACTION_RETRY)
+                break;
+
+        if (!error)
+        {
+            string dest = dir->path + "/files/" + name;
+            string info_path = dir->path + "/info/" + name + ".trashinfo";
+
+            trashed[index] = move_item(path, dest);
+
+            if (!trashed[index])
+                unlink (info_path.c_str());
+            else
+                // measured by get_size(), trashing does not wait for it
+                if (dir->size_valid)
+                    dir->unsized.push_back(name);
+        }
+
+        items_done++;
+    }
+
+    // one sync for the whole batch, the info files are tiny
+    sync_dir (dir->path + "/info");
+    sync_dir (dir->path + "/files");
+}
+
+
+bool GnomeCmd::Trash::run(const vector<string> &paths)
+{
+    trashed.assign(paths.size(), false);
+
+    vector<size_t> batch;
+    Dir *batch_dir = nullptr;
+
+    for (size_t i=0; i<paths.size() && !cancelled && !aborted; ++i)
+    {
+        struct stat st;
+        Dir *dir = nullptr;
+
+        for (;;)
+        {
+            if (lstat (paths[i].c_str(), &st) != 0)
+            {
+                if (report(paths[i], errno) == ERROR_ACTION_RETRY)
+                    continue;
+                break;
+            }
+
+            if ((dir = get_dir(paths[i], st.st_dev)))
+                break;
+
+            // not even the home trash could be set up
+            if (report(home_trash, errno ? errno : EACCES) != ERROR_ACTION_RETRY)
+                break;
+        }
+
+        if (!dir)
+        {
+            items_done++;
+            continue;
+        }
+
+        if (dir != batch_dir || batch.size() >= BATCH_SIZE)
+        {
+            if (!batch.empty())
+                trash_batch(batch_dir, batch, paths);
+            batch.clear();
+            batch_dir = dir;
+        }
+
+        batch.push_back(i);
+    }
+
+    if (!batch.empty())
+        trash_batch(batch_dir, batch, paths);
+
+    return !cancelled && !aborted;
+}
+
+
+/**
+ * Computes the size of the trash directory @a dir. Subdirectories are taken from
+ * the "directorysizes" cache if their info file has not changed since, and the
+ * cache is rewritten with the current contents.
+ */
+void GnomeCmd::Trash::load_size(Dir *dir)
+{
+    map<string,pair<uint64_t,long long>> cache;
+    ifstream in((dir->path + "/directorysizes").c_str());
+    string line;
+
+    while (getline (in, line))
+    {
+        istringstream s(line);
+        uint64_t size;
+        long long mtime;
+        string name;
+
+        if (s >> size >> mtime >> name)
+            cache[name] = make_pair(size, mtime);
+    }
+
+    in.close();
+
+    string files_dir = dir->path + "/files";
+    string sizes;
+    DIR *d = opendir (files_dir.c_str());
+
+    dir->size = 0;
+
+    if (d)
+    {
+        while (struct dirent *entry = readdir (d))
+        {
+            if (strcmp (entry->d_name, ".") == 0 || strcmp (entry->d_name, "..") == 0)
+                continue;
+
+            string path = files_dir + "/" + entry->d_name;
+            struct stat st, info_st;
+
+            if (lstat (path.c_str(), &st) != 0)
+                continue;
+
+            if (!S_ISDIR (st.st_mode))
+            {
+                dir->size += (uint64_t) st.st_blocks * 512;
+                continue;
+            }
+
+            string encoded = encode_path(entry->d_name);
+            long long mtime = stat ((dir->path + "/info/" + entry->d_name + ".trashinfo").c_str(), &info_st) == 0 ? info_st.st_mtime : 0;
+            auto i = cache.find(encoded);
+            uint64_t size = i != cache.end() && i->second.second == mtime ? i->second.first : disk_usage (path);
+
+            dir->size += size;
+            sizes += to_string(size) + " " + to_string(mtime) + " " + encoded + "\n";
+        }
+
+        closedir (d);
+    }
+
+    // replace the cache atomically, entries of emptied items are dropped
+    string tmp = dir->path + "/directorysizes.tmp";
+    FILE *out = fopen (tmp.c_str(), "w");
+
+    if (out)
+    {
+        bool ok = fwrite (sizes.data(), 1, sizes.size(), out) == sizes.size();
+
+        if (fclose (out) == 0 && ok)
+            rename (tmp.c_str(), (dir->path + "/directorysizes").c_str());
+        else
+            unlink (tmp.c_str());
+    }
+
+    dir->size_valid = true;
+    dir->unsized.clear();
+}
+
+
+/**
+ * Adds the items trashed into @a dir since its size was computed, the
+ * directories among them are appended to the "directorysizes" cache.
+ */
+void GnomeCmd::Trash::add_sizes(Dir *dir)
+{
+    string sizes;
+
+    for (auto &name : dir->unsized)
+    {
+        string path = dir->path + "/files/" + name;
+        struct stat st, info_st;
+
+        if (lstat (path.c_str(), &st) != 0)
+            continue;
+
+        if (!S_ISDIR (st.st_mode))
+        {
+            dir->size += (uint64_t) st.st_blocks * 512;
+            continue;
+        }
+
+        uint64_t size = disk_usage (path);
+
+        dir->size += size;
+
+        // the cache of directory sizes is keyed by the time of the info file
+        if (stat ((dir->path + "/info/" + name + ".trashinfo").c_str(), &info_st) == 0)
+            sizes += to_string(size) + " " + to_string((long long) info_st.st_mtime) + " " + encode_path(name) + "\n";
+    }
+
+    dir->unsized.clear();
+
+    if (sizes.empty())
+        return;
+
+    int fd = open ((dir->path + "/directorysizes").c_str(), O_WRONLY|O_APPEND|O_CREAT|O_CLOEXEC, 0600);
+
+    if (fd < 0)
+        return;
+
+    // the cache is rebuilt next time
+    if (!write_all (fd, sizes.data(), sizes.size()))
+        dir->size_valid = false;
+
+    close (fd);
+}
+
+
+uint64_t GnomeCmd::Trash::get_size()
+{
+    uint64_t size = 0;
+
+    get_home_dir();
+
+    for (auto &dir : dirs)
+    {
+        if (!dir->size_valid)
+            load_size(dir.get());
+        else
+            if (!dir->unsized.empty())
+                add_sizes(dir.get());
+
+        size += dir->size;
+    }
+
+    return size;
+}
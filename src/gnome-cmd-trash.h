@@ -0,0 +1,122 @@
+/**
+ * @file gnome-cmd-trash.h
+ * @brief Moving local files to the trash as defined by the freedesktop.org
+ * trash specification.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gnome-cmd-file-io.h"
+
+namespace GnomeCmd
+{
+    /**
+     * Moves files into the trash directory of the volume they are on, i.e.
+     * with a plain rename. The home trash is used for files on the home volume
+     * and for volumes without a usable trash directory; files from such
+     * volumes are copied and then deleted.
+     *
+     * The .trashinfo files are written in batches: every batch reserves its
+     * names, renames its items and then syncs the info directory once, instead
+     * of once per file.
+     *
+     * The size of a trash directory is computed when it is first asked for,
+     * with the help of its "directorysizes" cache. From then on only the
+     * items trashed since are measured, the next time it is asked for.
+     */
+    class Trash
+    {
+      public:
+
+        typedef std::function<ErrorAction (const std::string &path, int error)> ErrorFunc;
+
+        enum
+        {
+            BATCH_SIZE = 256                /**< items per sync of the info directory */
+        };
+
+        /** A trash directory, i.e. the one holding "files" and "info" */
+        struct Dir
+        {
+            std::string path;
+            std::string topdir;             /**< for relative paths in the info files, empty for the home trash */
+            dev_t dev {0};
+            bool size_valid {false};
+            uint64_t size {0};              /**< disk space used by "files", valid if size_valid */
+            std::vector<std::string> unsized;   /**< names trashed since size was computed */
+        };
+
+      private:
+
+        std::string home_trash;
+        std::vector<std::unique_ptr<Dir>> dirs;
+        std::map<dev_t, Dir *> dev_dirs;    /**< trash directory per device, the home one if a volume has none */
+        Dir *home_dir {nullptr};
+
+        std::atomic<bool> cancelled {false};
+        bool aborted {false};
+
+        Dir *get_home_dir();
+        Dir *get_dir(const std::string &path, dev_t dev);
+        Dir *get_volume_dir(const std::string &topdir, dev_t dev);
+        void trash_batch(Dir *dir, const std::vector<size_t> &batch, const std::vector<std::string> &paths);
+        int reserve_name(Dir *dir, const std::string &path, std::string &name);
+        bool move_item(const std::string &path, const std::string &dest);
+        void load_size(Dir *dir);
+        void add_sizes(Dir *dir);
+        ErrorAction report(const std::string &path, int error);
+
+      public:
+
+        std::atomic<uint64_t> items_done {0};
+        std::vector<bool> trashed;          /**< per item, valid after run() */
+
+        ErrorFunc on_error;                 /**< asked on errors, the job is aborted if not set */
+
+        explicit Trash(const std::string &home=default_home_trash());
+
+        /** @returns $XDG_DATA_HOME/Trash, ~/.local/share/Trash by default */
+        static std::string default_home_trash();
+
+        /** @returns the value for the Path key of an info file, percent encoded */
+        static std::string encode_path(const std::string &path);
+
+        /**
+         * Moves all @a paths to the trash.
+         *
+         * @returns false if the job was aborted or cancelled
+         */
+        bool run(const std::vector<std::string> &paths);
+
+        /** @returns the disk space used by the home trash and all trash directories used so far */
+        uint64_t get_size();
+
+        void cancel()                       {  cancelled = true;  }
+        bool is_cancelled() const           {  return cancelled;  }
+    };
+}
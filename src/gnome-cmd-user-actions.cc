@@ -47,6 +47,7 @@
 #include "dialogs/gnome-cmd-manage-bookmarks-dialog.h"
 #include "dialogs/gnome-cmd-mkdir-dialog.h"
 #include "dialogs/gnome-cmd-search-dialog.h"
+#include "dialogs/gnome-cmd-duplicates-dialog.h"
 #include "dialogs/gnome-cmd-options-dialog.h"
 #include "dialogs/gnome-cmd-prepare-copy-dialog.h"
 #include "dialogs/gnome-cmd-prepare-move-dialog.h"
@@ -226,6 +227,7 @@ static UserActionData user_actions_data[] = {
                                              {file_edit, "file.edit", N_("Edit file")},
                                              {file_edit_new_doc, "file.edit_new_doc", N_("Edit a new file")},
                                              {file_exit, "file.exit", N_("Quit")},
+                                             {file_find_duplicates, "file.find_duplicates", N_("Find duplicate files")},
                                              {file_external_view, "file.external_view", N_("View with external viewer")},
                                              {file_internal_view, "file.internal_view", N_("View with internal viewer")},
                                              {file_mkdir, "file.mkdir", N_("Create directory")},
@@ -977,6 +979,32 @@ void file_diff (GtkMenuItem *menuitem, gpointer not_used)
 }
 
 
+void file_find_duplicates (GtkMenuItem *menuitem, gpointer not_used)
+{
+    GnomeCmdFileSelector *fs = get_fs (ACTIVE);
+
+    if (!fs->is_local())
+    {
+        gnome_cmd_show_message (*main_win, _("Operation not supported on remote file systems"));
+        return;
+    }
+
+    GList *sel_files = fs->file_list()->get_selected_files();
+    vector<string> paths;
+
+    for (GList *i = sel_files; i; i = i->next)
+        paths.push_back(stringify (GNOME_CMD_FILE (i->data)->get_real_path()));
+
+    g_list_free (sel_files);
+
+    // nothing selected, the whole directory
+    if (paths.empty())
+        paths.push_back(stringify (GNOME_CMD_FILE (fs->get_directory())->get_real_path()));
+
+    gnome_cmd_duplicates_dialog (*main_win, paths);
+}
+
+
 void file_sync_dirs (GtkMenuItem *menuitem, gpointer not_used)
 {
     GnomeCmdFileSelector *active_fs = get_fs (ACTIVE);
@@ -240,6 +240,7 @@ GNOME_CMD_USER_ACTION(file_mkdir);
 GNOME_CMD_USER_ACTION(file_properties);
 GNOME_CMD_USER_ACTION(file_diff);
 GNOME_CMD_USER_ACTION(file_sync_dirs);
+GNOME_CMD_USER_ACTION(file_find_duplicates);
 GNOME_CMD_USER_ACTION(file_rename);
 GNOME_CMD_USER_ACTION(file_create_symlink);
 GNOME_CMD_USER_ACTION(file_advrename);
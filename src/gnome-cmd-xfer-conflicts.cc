@@ -0,0 +1,93 @@
+/**
+ * @file gnome-cmd-xfer-conflicts.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <fnmatch.h>
+#include <sys/stat.h>
+
+#include "gnome-cmd-xfer-conflicts.h"
+
+using namespace std;
+
+
+GnomeCmd::XferConflictRules::Policy GnomeCmd::XferConflictRules::get_policy(const string &path) const
+{
+    string::size_type slash = path.rfind('/');
+    string name = slash==string::npos ? path : path.substr(slash+1);
+
+    for (auto &rule : rules)
+        if (!rule.pattern.empty() && fnmatch (rule.pattern.c_str(), name.c_str(), 0) == 0)
+            return rule.policy;
+
+    return default_policy;
+}
+
+
+GnomeCmd::XferConflictRules::Resolution GnomeCmd::XferConflictRules::resolve(const XferConflict &conflict) const
+{
+    switch (get_policy(conflict.dest))
+    {
+        case POLICY_REPLACE:
+            return RESOLUTION_REPLACE;
+
+        case POLICY_NEWER_WINS:
+            return conflict.src_mtime > conflict.dest_mtime ? RESOLUTION_REPLACE : RESOLUTION_SKIP;
+
+        case POLICY_LARGER_WINS:
+            return conflict.src_size > conflict.dest_size ? RESOLUTION_REPLACE : RESOLUTION_SKIP;
+
+        case POLICY_SKIP_IDENTICAL:
+            return conflict.is_identical() ? RESOLUTION_SKIP : RESOLUTION_REPLACE;
+
+        case POLICY_RENAME:
+            return RESOLUTION_RENAME;
+
+        default:
+            return RESOLUTION_SKIP;
+    }
+}
+
+
+string GnomeCmd::XferConflictRules::renamed(const string &path, unsigned n)
+{
+    string::size_type slash = path.rfind('/');
+    string::size_type name_start = slash==string::npos ? 0 : slash+1;
+    string::size_type dot = path.rfind('.');
+
+    // a leading dot marks a hidden file, not an extension
+    if (dot==string::npos || dot<=name_start)
+        dot = path.size();
+
+    return path.substr(0, dot) + " (" + to_string(n) + ")" + path.substr(dot);
+}
+
+
+string GnomeCmd::XferConflictRules::unused_name(const string &path)
+{
+    struct stat st;
+
+    for (unsigned n=1; ; ++n)
+    {
+        string name = renamed(path, n);
+
+        if (lstat (name.c_str(), &st) != 0)
+            return name;
+    }
+}
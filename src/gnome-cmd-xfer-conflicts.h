@@ -0,0 +1,98 @@
+/**
+ * @file gnome-cmd-xfer-conflicts.h
+ * @brief Rules deciding what happens with files which already exist in the
+ * destination of a transfer.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+namespace GnomeCmd
+{
+    /** A source file whose destination already exists */
+    struct XferConflict
+    {
+        std::string src;
+        std::string dest;
+        uint64_t src_size {0};
+        uint64_t dest_size {0};
+        time_t src_mtime {0};
+        time_t dest_mtime {0};
+
+        bool is_identical() const           {  return src_size==dest_size && src_mtime==dest_mtime;  }
+    };
+
+
+    /**
+     * Conflicts are collected before a transfer starts and the user decides
+     * once for all of them. The decision is a list of rules, the first rule
+     * whose pattern matches the file name wins. Conflicts not matched by any
+     * rule are resolved by the default policy.
+     */
+    class XferConflictRules
+    {
+      public:
+
+        /** Same order as the policies in the conflicts dialog */
+        enum Policy
+        {
+            POLICY_REPLACE,
+            POLICY_SKIP,
+            POLICY_NEWER_WINS,              /**< replace if the source is newer than the destination */
+            POLICY_LARGER_WINS,             /**< replace if the source is larger than the destination */
+            POLICY_SKIP_IDENTICAL,          /**< skip if size and time are the same, replace otherwise */
+            POLICY_RENAME,                  /**< keep the destination, copy under a new name */
+            NUM_POLICIES
+        };
+
+        enum Resolution
+        {
+            RESOLUTION_REPLACE,
+            RESOLUTION_SKIP,
+            RESOLUTION_RENAME
+        };
+
+        struct Rule
+        {
+            std::string pattern;            /**< shell pattern matched against the file name */
+            Policy policy;
+        };
+
+        std::vector<Rule> rules;
+        Policy default_policy {POLICY_SKIP};
+
+        /** @returns the policy for @a path, the directory part is ignored */
+        Policy get_policy(const std::string &path) const;
+
+        Resolution resolve(const XferConflict &conflict) const;
+
+        /**
+         * @returns @a path with " (n)" inserted before the extension of the
+         * file name, e.g. "dir/photo (2).jpg" for n=2
+         */
+        static std::string renamed(const std::string &path, unsigned n);
+
+        /** @returns the first renamed() path which does not exist yet */
+        static std::string unused_name(const std::string &path);
+    };
+}
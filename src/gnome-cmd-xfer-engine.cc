@@ -0,0 +1,1099 @@
+/**
+ * @file gnome-cmd-xfer-engine.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_FS_H
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+#include <algorithm>
+#include <memory>
+
+#include "gnome-cmd-xfer-engine.h"
+#include "gnome-cmd-xfer-journal.h"
+#include "gnome-cmd-xfer-uring.h"
+
+using namespace std;
+
+
+string GnomeCmd::XferProgress::get_current_file()
+{
+    ProgressEvents::Event event;
+
+    if (file_events.pop_latest(event))
+        shown_file = move (event.path);
+
+    return shown_file;
+}
+
+
+/**
+ * Number of bytes which are really allocated for a file. Files where this
+ * is less than the apparent size have holes.
+ */
+inline uint64_t allocated_size (const struct stat &st)
+{
+    return (uint64_t) st.st_blocks * 512;
+}
+
+
+inline bool has_holes (const struct stat &st)
+{
+    return S_ISREG (st.st_mode) && allocated_size (st) < (uint64_t) st.st_size;
+}
+
+
+/**
+ * Switches O_DIRECT on or off for an open file.
+ *
+ * @returns false if the file system does not support direct I/O
+ */
+static bool set_direct_io (int fd, bool on)
+{
+#ifdef O_DIRECT
+    int flags = fcntl (fd, F_GETFL);
+
+    if (flags < 0)
+        return false;
+
+    flags = on ? flags | O_DIRECT : flags & ~O_DIRECT;
+
+    return fcntl (fd, F_SETFL, flags) == 0;
+#else
+    return false;
+#endif
+}
+
+
+/**
+ * Waits until a written range is on disk and drops it from the page cache.
+ */
+static void drop_written_range (int fd, uint64_t offset, uint64_t len)
+{
+#ifdef SYNC_FILE_RANGE_WRITE
+    sync_file_range (fd, offset, len, SYNC_FILE_RANGE_WAIT_BEFORE|SYNC_FILE_RANGE_WRITE|SYNC_FILE_RANGE_WAIT_AFTER);
+#endif
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise (fd, offset, len, POSIX_FADV_DONTNEED);
+#endif
+}
+
+
+/**
+ * Makes @a dest_fd share all data blocks with @a src_fd, which only works
+ * within a copy-on-write file system like Btrfs or XFS.
+ */
+static bool clone_file (int src_fd, int dest_fd)
+{
+#ifdef FICLONE
+    return ioctl (dest_fd, FICLONE, src_fd) == 0;
+#else
+    return false;
+#endif
+}
+
+
+GnomeCmd::XferEngine::XferEngine(const Options &opts): options(opts)
+{
+}
+
+
+GnomeCmd::XferEngine::~XferEngine()
+{
+    free (bulk_buf);
+}
+
+
+void GnomeCmd::XferEngine::scan(const string &path)
+{
+    struct stat st;
+
+    if ((options.follow_links ? stat (path.c_str(), &st) : lstat (path.c_str(), &st)) != 0)
+        return;
+
+    if (S_ISDIR (st.st_mode))
+    {
+        vector<string> names;
+        int error;
+
+        if (list_directory (path, names, error))
+            for (auto &name : names)
+                scan(path + "/" + name);
+
+        return;
+    }
+
+    progress.files_total++;
+
+    // the data of hard linked files is copied only once
+    if (S_ISREG (st.st_mode) && options.preserve_hardlinks && st.st_nlink > 1 &&
+        !scanned_links.insert(make_pair(st.st_dev, st.st_ino)).second)
+        return;
+
+    if (S_ISREG (st.st_mode))
+    {
+        progress.bytes_total += st.st_size;
+        progress.physical_bytes_total += options.sparse ? min<uint64_t> (st.st_size, allocated_size (st)) : st.st_size;
+    }
+}
+
+
+GnomeCmd::ErrorAction GnomeCmd::XferEngine::report(const string &path, int error)
+{
+    ErrorAction action = on_error ? on_error (path, error) : ERROR_ACTION_ABORT;
+
+    if (action == ERROR_ACTION_ABORT)
+        aborted = true;
+
+    return action;
+}
+
+
+inline GnomeCmd::XferConflict make_conflict (const string &src, const string &dest, const struct stat &st, const struct stat &dest_st)
+{
+    GnomeCmd::XferConflict conflict;
+
+    conflict.src = src;
+    conflict.dest = dest;
+    conflict.src_size = S_ISREG (st.st_mode) ? st.st_size : 0;
+    conflict.dest_size = S_ISREG (dest_st.st_mode) ? dest_st.st_size : 0;
+    conflict.src_mtime = st.st_mtime;
+    conflict.dest_mtime = dest_st.st_mtime;
+
+    return conflict;
+}
+
+
+/**
+ * Decides what happens with an already existing destination.
+ *
+ * @returns false if the job has to be aborted, otherwise @a skip tells
+ * whether the current item has to be left alone
+ */
+bool GnomeCmd::XferEngine::may_replace(const string &src, const string &dest, bool &skip)
+{
+    skip = false;
+
+    if (replace_confirmed)
+        return true;
+
+    switch (options.overwrite_mode)
+    {
+        case OVERWRITE_MODE_REPLACE:
+            return true;
+
+        case OVERWRITE_MODE_SKIP:
+            skip = true;
+            return true;
+
+        case OVERWRITE_MODE_ABORT:
+            aborted = true;
+            return false;
+
+        default:
+            break;
+    }
+
+    switch (on_overwrite ? on_overwrite (src, dest) : OVERWRITE_ACTION_SKIP)
+    {
+        case OVERWRITE_ACTION_ABORT:
+            aborted = true;
+            return false;
+
+        case OVERWRITE_ACTION_REPLACE_ALL:
+            options.overwrite_mode = OVERWRITE_MODE_REPLACE;
+            return true;
+
+        case OVERWRITE_ACTION_SKIP:
+            skip = true;
+            return true;
+
+        case OVERWRITE_ACTION_SKIP_ALL:
+            options.overwrite_mode = OVERWRITE_MODE_SKIP;
+            skip = true;
+            return true;
+
+        default:
+            return true;
+    }
+}
+
+
+/**
+ * Copies @a len bytes at @a offset through io_uring.
+ *
+ * @returns 0, an errno value or ENOSYS if io_uring can't be used
+ */
+int GnomeCmd::XferEngine::copy_range_uring(int src_fd, int dest_fd, uint64_t offset, uint64_t len)
+{
+    if (uring_failed)
+        return ENOSYS;
+
+    if (!uring)
+    {
+        uring.reset(new XferUring(options.queue_depth));
+
+        if (uring->init() != 0)
+        {
+            uring.reset();
+            uring_failed = true;
+            return ENOSYS;
+        }
+    }
+
+    auto on_progress = [this] (uint64_t n, uint64_t done_up_to)
+    {
+        progress.bytes_done += n;
+        progress.physical_bytes_done += n;
+        progress.file_bytes_done += n;
+
+        // blocks complete out of order, only what lies before the oldest pending block is safe to resume from
+        if (journal && !cur_src.empty())
+            journal->update_partial(cur_src, cur_dest, done_up_to);
+    };
+
+    int error = uring->copy(src_fd, dest_fd, offset, len, on_progress, cancelled);
+
+    // blocks of the failed copy may still be in flight, don't reuse the ring for a retry or the next file
+    if (error && error != ECANCELED)
+    {
+        uring.reset();
+        uring_failed = true;
+    }
+
+    return error;
+}
+
+
+/**
+ * Copies @a len bytes at @a offset without leaving the data in the page cache.
+ * With O_DIRECT the cache is bypassed completely, only an unaligned tail is
+ * copied buffered. Without it every chunk is written back right away and
+ * dropped from the cache once it is on disk, one chunk behind, so that
+ * reading the next chunk overlaps with the write-back of the previous one.
+ *
+ * @returns 0 or an errno value
+ */
+int GnomeCmd::XferEngine::copy_range_bulk(int src_fd, int dest_fd, uint64_t offset, uint64_t len)
+{
+    if (!bulk_buf && posix_memalign ((void **) &bulk_buf, 4096, CHUNK_SIZE) != 0)
+    {
+        bulk_buf = nullptr;
+        return ENOMEM;
+    }
+
+    uint64_t prev_offset = offset;
+    uint64_t prev_len = 0;
+
+    while (len > 0)
+    {
+        if (cancelled)
+            return ECANCELED;
+
+        uint64_t n = min<uint64_t> (len, CHUNK_SIZE);
+
+        // O_DIRECT needs aligned offsets and sizes, so the tail of a file goes through the cache
+        if (direct_io && (offset % 4096 != 0 || n % 4096 != 0))
+        {
+            set_direct_io (src_fd, false);
+            set_direct_io (dest_fd, false);
+            direct_io = false;
+        }
+
+        ssize_t r = pread_all (src_fd, bulk_buf, n, offset);
+
+        if (r < 0)
+            return errno;
+
+        if (r == 0)
+            break;
+
+        if (!pwrite_all (dest_fd, bulk_buf, r, offset))
+            return errno;
+
+        if (!direct_io)
+        {
+#ifdef SYNC_FILE_RANGE_WRITE
+            sync_file_range (dest_fd, offset, r, SYNC_FILE_RANGE_WRITE);
+#endif
+#ifdef POSIX_FADV_DONTNEED
+            posix_fadvise (src_fd, offset, r, POSIX_FADV_DONTNEED);
+#endif
+            if (prev_len)
+                drop_written_range (dest_fd, prev_offset, prev_len);
+
+            prev_offset = offset;
+            prev_len = r;
+        }
+
+        offset += r;
+        len -= r;
+        progress.bytes_done += r;
+        progress.physical_bytes_done += r;
+        progress.file_bytes_done += r;
+
+        if (journal && !cur_src.empty())
+            journal->update_partial(cur_src, cur_dest, offset);
+    }
+
+    if (prev_len)
+        drop_written_range (dest_fd, prev_offset, prev_len);
+
+    return 0;
+}
+
+
+/**
+ * Copies @a len bytes at @a offset, in kernel space if possible.
+ *
+ * @returns 0 or an errno value
+ */
+int GnomeCmd::XferEngine::copy_range(int src_fd, int dest_fd, uint64_t offset, uint64_t len)
+{
+    if (bulk)
+        return copy_range_bulk(src_fd, dest_fd, offset, len);
+
+    if (options.backend == BACKEND_URING)
+    {
+        int error = copy_range_uring(src_fd, dest_fd, offset, len);
+
+        if (error != ENOSYS)
+            return error;
+    }
+
+#ifdef HAVE_COPY_FILE_RANGE
+    static atomic<bool> copy_file_range_works {true};
+
+    while (len > 0 && copy_file_range_works && options.backend != BACKEND_READ_WRITE)
+    {
+        if (cancelled)
+            return ECANCELED;
+
+        loff_t in_off = offset;
+        loff_t out_off = offset;
+        ssize_t n = copy_file_range (src_fd, &in_off, dest_fd, &out_off, min<uint64_t> (len, CHUNK_SIZE), 0);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            // not supported for this pair of files - do it by hand
+            if (errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)
+                break;
+
+            if (errno == ENOSYS)
+            {
+                copy_file_range_works = false;
+                break;
+            }
+
+            return errno;
+        }
+
+        if (n == 0)             // the source shrank meanwhile
+            return 0;
+
+        offset += n;
+        len -= n;
+        progress.bytes_done += n;
+        progress.physical_bytes_done += n;
+        progress.file_bytes_done += n;
+
+        if (journal && !cur_src.empty())
+            journal->update_partial(cur_src, cur_dest, offset);
+    }
+#endif
+
+    if (len == 0)
+        return 0;
+
+    unique_ptr<char[]> buf(new char[CHUNK_SIZE]);
+
+    while (len > 0)
+    {
+        if (cancelled)
+            return ECANCELED;
+
+        ssize_t n = pread_all (src_fd, buf.get(), min<uint64_t> (len, CHUNK_SIZE), offset);
+
+        if (n < 0)
+            return errno;
+
+        if (n == 0)
+            return 0;
+
+        if (!pwrite_all (dest_fd, buf.get(), n, offset))
+            return errno;
+
+        offset += n;
+        len -= n;
+        progress.bytes_done += n;
+        progress.physical_bytes_done += n;
+        progress.file_bytes_done += n;
+
+        if (journal && !cur_src.empty())
+            journal->update_partial(cur_src, cur_dest, offset);
+    }
+
+    return 0;
+}
+
+
+int GnomeCmd::XferEngine::copy_data(int src_fd, int dest_fd, const struct stat &st, uint64_t offset)
+{
+    uint64_t size = st.st_size;
+    bool sparse = options.sparse && has_holes (st);
+
+    while (offset < size)
+    {
+        if (cancelled)
+            return ECANCELED;
+
+        uint64_t data_start = offset;
+        uint64_t data_end = size;
+
+        if (sparse)
+        {
+            off_t pos = lseek (src_fd, offset, SEEK_DATA);
+
+            if (pos < 0)
+            {
+                if (errno == ENXIO)             // only a hole is left up to the end of the file
+                    data_start = size;
+                else
+                    sparse = false;             // SEEK_DATA is not supported, copy everything
+            }
+            else
+            {
+                data_start = pos;
+
+                pos = lseek (src_fd, data_start, SEEK_HOLE);
+                if (pos > 0)
+                    data_end = min<uint64_t> (pos, size);
+            }
+
+            // holes are not written, they only count for the logical progress
+            if (data_start > offset)
+            {
+                uint64_t hole = min (data_start, size) - offset;
+
+                progress.bytes_done += hole;
+                progress.file_bytes_done += hole;
+                offset = min (data_start, size);
+                continue;
+            }
+        }
+
+        int error = copy_range(src_fd, dest_fd, data_start, data_end-data_start);
+
+        if (error)
+            return error;
+
+        offset = data_end;
+    }
+
+    // the destination gets its final size even if it ends with a hole
+    if (ftruncate (dest_fd, size) != 0)
+        return errno;
+
+    return 0;
+}
+
+
+/**
+ * Continues a file which was copied partially by an earlier run. The end of
+ * what was copied already has to match the source, otherwise the file is
+ * copied from the start.
+ *
+ * @returns 0 or an errno value, @a pos is where copying continues
+ */
+int GnomeCmd::XferEngine::continue_partial(int src_fd, int dest_fd, const struct stat &st, uint64_t journal_offset, uint64_t &pos)
+{
+    struct stat dest_st;
+
+    pos = 0;
+
+    if (fstat (dest_fd, &dest_st) != 0)
+        return errno;
+
+    // Unlike for gnome-vfs transfers the size of the destination is not a candidate: blocks
+    // written through io_uring complete out of order, so there may be gaps before the end.
+    // The journal only records offsets up to which everything has been written.
+    uint64_t offset = journal_offset;
+
+    if (offset > 0 && offset <= (uint64_t) st.st_size && offset <= (uint64_t) dest_st.st_size)
+    {
+        uint64_t len = min<uint64_t> (offset, TAIL_BLOCK_SIZE);
+        unique_ptr<char[]> src_buf(new char[len]);
+        unique_ptr<char[]> dest_buf(new char[len]);
+
+        if (pread_all (src_fd, src_buf.get(), len, offset-len) == (ssize_t) len &&
+            pread_all (dest_fd, dest_buf.get(), len, offset-len) == (ssize_t) len &&
+            memcmp (src_buf.get(), dest_buf.get(), len) == 0)
+            pos = offset;
+    }
+
+    if (ftruncate (dest_fd, pos) != 0)
+        return errno;
+
+    return 0;
+}
+
+
+/**
+ * @returns true if @a src is the file the journal holds a partial record for
+ */
+bool GnomeCmd::XferEngine::is_partial(const string &src, uint64_t *offset)
+{
+    string partial_src, partial_dest;
+    uint64_t partial_offset;
+
+    if (!journal || !journal->get_partial(partial_src, partial_dest, partial_offset) || partial_src != src)
+        return false;
+
+    if (offset)
+        *offset = partial_offset;
+
+    return true;
+}
+
+
+bool GnomeCmd::XferEngine::copy_regular(const string &src, const string &dest, const struct stat &st, bool *created)
+{
+    uint64_t partial_offset = 0;
+    bool resume = is_partial(src, &partial_offset);
+
+    cur_src = src;
+    cur_dest = dest;
+
+    for (;;)
+    {
+        progress.file_bytes_done = 0;
+
+        int src_fd = open (src.c_str(), O_RDONLY|O_CLOEXEC);
+
+        if (src_fd < 0)
+        {
+            switch (report(src, errno))
+            {
+                case ERROR_ACTION_RETRY:    continue;
+                case ERROR_ACTION_SKIP:     return true;
+                default:                    return false;
+            }
+        }
+
+        int flags = O_WRONLY|O_CREAT|O_NOFOLLOW|O_CLOEXEC;
+
+        if (!resume)
+            flags |= O_EXCL;
+
+        int dest_fd = open (dest.c_str(), flags, 0600);
+
+        if (dest_fd < 0 && errno == EEXIST)
+        {
+            bool skip;
+
+            if (!may_replace(src, dest, skip) || skip)
+            {
+                close (src_fd);
+                return !aborted;
+            }
+
+            dest_fd = open_replacing (dest.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0600);
+        }
+
+        int error = dest_fd < 0 ? errno : 0;
+        uint64_t offset = 0;
+
+        if (!error && resume)
+        {
+            error = continue_partial(src_fd, dest_fd, st, partial_offset, offset);
+            resume = false;
+        }
+
+        if (!error)
+        {
+            progress.bytes_done += offset;
+            progress.physical_bytes_done += offset;
+            progress.file_bytes_done = offset;
+
+            // direct I/O is only used if both file systems support it
+            direct_io = bulk && set_direct_io (src_fd, true);
+
+            if (direct_io && !set_direct_io (dest_fd, true))
+            {
+                set_direct_io (src_fd, false);
+                direct_io = false;
+            }
+
+            if (options.reflink && offset == 0 && !direct_io && clone_file (src_fd, dest_fd))
+            {
+                progress.bytes_done += st.st_size;
+                progress.physical_bytes_done += options.sparse ? min<uint64_t> (st.st_size, allocated_size (st)) : st.st_size;
+                progress.file_bytes_done = st.st_size;
+            }
+            else
+                error = copy_data(src_fd, dest_fd, st, offset);
+        }
+
+        if (!error)
+        {
+            fchmod (dest_fd, st.st_mode & 07777);
+            copy_times (dest_fd, st);
+        }
+
+        close (src_fd);
+
+        if (dest_fd >= 0 && close (dest_fd) != 0 && !error)
+            error = errno;
+
+        if (!error)
+        {
+            if (created)
+                *created = true;
+            item_written = true;
+            return true;
+        }
+
+        if (error == ECANCELED)
+            return false;
+
+        // take back what was counted for the failed attempt
+        progress.bytes_done -= min<uint64_t> (progress.bytes_done, progress.file_bytes_done);
+        progress.physical_bytes_done -= min<uint64_t> (progress.physical_bytes_done, progress.file_bytes_done);
+
+        switch (report(dest_fd < 0 ? dest : src, error))
+        {
+            case ERROR_ACTION_RETRY:    continue;
+            case ERROR_ACTION_SKIP:     return true;
+            default:                    return false;
+        }
+    }
+}
+
+
+/**
+ * Links @a dest to @a existing, the copy of another link to the inode of @a src.
+ *
+ * @a linked is false if the file system can't do it, the file has to be copied then.
+ */
+bool GnomeCmd::XferEngine::copy_hardlink(const string &src, const string &existing, const string &dest, bool &linked)
+{
+    linked = false;
+
+    for (;;)
+    {
+        if (link (existing.c_str(), dest.c_str()) == 0)
+        {
+            linked = true;
+            item_written = true;
+            return true;
+        }
+
+        if (errno != EEXIST)
+            return true;            // EXDEV, EMLINK, EPERM and the like
+
+        bool skip;
+
+        if (!may_replace(src, dest, skip) || skip)
+        {
+            linked = true;
+            return !aborted;
+        }
+
+        while (unlink (dest.c_str()) != 0 && errno != ENOENT)
+            switch (report(dest, errno))
+            {
+                case ERROR_ACTION_RETRY:    continue;
+                case ERROR_ACTION_SKIP:     linked = true;  return true;
+                default:                    return false;
+            }
+    }
+}
+
+
+bool GnomeCmd::XferEngine::copy_symlink(const string &src, const string &dest)
+{
+    char target[PATH_MAX+1];
+
+    for (;;)
+    {
+        ssize_t len = readlink (src.c_str(), target, PATH_MAX);
+
+        if (len >= 0)
+        {
+            target[len] = '\0';
+
+            if (symlink (target, dest.c_str()) == 0)
+                return item_written = true;
+
+            if (errno == EEXIST)
+            {
+                bool skip;
+
+                if (!may_replace(src, dest, skip) || skip)
+                    return !aborted;
+
+                if (unlink (dest.c_str()) == 0 && symlink (target, dest.c_str()) == 0)
+                    return item_written = true;
+            }
+        }
+
+        switch (report(src, errno))
+        {
+            case ERROR_ACTION_RETRY:    continue;
+            case ERROR_ACTION_SKIP:     return true;
+            default:                    return false;
+        }
+    }
+}
+
+
+bool GnomeCmd::XferEngine::copy_special(const string &src, const string &dest, const struct stat &st)
+{
+    for (;;)
+    {
+        if (mknod (dest.c_str(), st.st_mode, st.st_rdev) == 0)
+            return item_written = true;
+
+        if (errno == EEXIST)
+        {
+            bool skip;
+
+            if (!may_replace(src, dest, skip) || skip)
+                return !aborted;
+
+            if (unlink (dest.c_str()) == 0 && mknod (dest.c_str(), st.st_mode, st.st_rdev) == 0)
+                return item_written = true;
+        }
+
+        switch (report(dest, errno))
+        {
+            case ERROR_ACTION_RETRY:    continue;
+            case ERROR_ACTION_SKIP:     return true;
+            default:                    return false;
+        }
+    }
+}
+
+
+bool GnomeCmd::XferEngine::copy_directory(const string &src, string &dest, const struct stat &st)
+{
+    // an existing directory is merged with the source, anything else in the way is replaced
+    while (mkdir (dest.c_str(), 0700) != 0)
+    {
+        int error = errno;
+        struct stat dest_st;
+
+        if (error == EEXIST && lstat (dest.c_str(), &dest_st) == 0)
+        {
+            if (S_ISDIR (dest_st.st_mode))
+                break;
+
+            bool skip = false;
+
+            if (conflict_rules && options.overwrite_mode == OVERWRITE_MODE_QUERY)
+                switch (conflict_rules->resolve(make_conflict (src, dest, st, dest_st)))
+                {
+                    case XferConflictRules::RESOLUTION_REPLACE:
+                        break;
+
+                    case XferConflictRules::RESOLUTION_RENAME:
+                        dest = XferConflictRules::unused_name(dest);
+                        continue;
+
+                    default:
+                        skip = true;
+                        break;
+                }
+            else
+                if (!may_replace(src, dest, skip))
+                    return false;
+
+            if (skip)
+                return true;
+
+            if (unlink (dest.c_str()) == 0 || errno == ENOENT)
+                continue;
+
+            error = errno;
+        }
+
+        switch (report(dest, error))
+        {
+            case ERROR_ACTION_RETRY:    continue;
+            case ERROR_ACTION_SKIP:     return true;
+            default:                    return false;
+        }
+    }
+
+    vector<string> names;
+    int error;
+
+    while (!list_directory (src, names, error))
+        switch (report(src, error))
+        {
+            case ERROR_ACTION_RETRY:    continue;
+            case ERROR_ACTION_SKIP:     return true;
+            default:                    return false;
+        }
+
+    for (auto &name : names)
+        if (!copy_item(src + "/" + name, dest + "/" + name))
+            return false;
+
+    // permissions and times are set at the end, the directory might be read only
+    chmod (dest.c_str(), st.st_mode & 07777);
+
+    struct timespec times[2];
+
+    times[0] = st.st_atim;
+    times[1] = st.st_mtim;
+
+    utimensat (AT_FDCWD, dest.c_str(), times, 0);
+
+    item_written = true;
+
+    return true;
+}
+
+
+bool GnomeCmd::XferEngine::copy_item(const string &src, const string &dest)
+{
+    if (cancelled || aborted)
+        return false;
+
+    struct stat st;
+
+    while ((options.follow_links ? stat (src.c_str(), &st) : lstat (src.c_str(), &st)) != 0)
+        switch (report(src, errno))
+        {
+            case ERROR_ACTION_RETRY:    continue;
+            case ERROR_ACTION_SKIP:     return true;
+            default:                    return false;
+        }
+
+    if (S_ISDIR (st.st_mode))
+    {
+        string target = dest;
+
+        item_written = false;
+
+        if (!copy_directory(src, target, st))
+            return false;
+
+        if (item_written && on_copied && !cancelled && !aborted)
+            on_copied(src, target);
+
+        return true;
+    }
+
+    Inode inode = make_pair(st.st_dev, st.st_ino);
+    bool linkable = options.preserve_hardlinks && S_ISREG (st.st_mode) && st.st_nlink > 1;
+
+    // scan() has counted the data of the first link only, the others find it gone
+    bool duplicate = linkable && scanned_links.erase(inode) == 0;
+
+    progress.set_current_file(src);
+    progress.file_size = S_ISREG (st.st_mode) ? st.st_size : 0;
+    progress.file_bytes_done = 0;
+
+    if (journal && journal->is_done(src))
+    {
+        if (!duplicate)
+        {
+            progress.bytes_done += progress.file_size;
+            progress.physical_bytes_done += options.sparse ? min<uint64_t> (st.st_size, allocated_size (st)) : progress.file_size.load();
+        }
+
+        if (linkable && !links.count(inode))
+            links[inode] = dest;
+
+        progress.files_done++;
+
+        if (on_copied)
+            on_copied(src, dest);
+
+        return true;
+    }
+
+    string target = dest;
+    struct stat dest_st;
+    bool skip = false;
+
+    replace_confirmed = false;
+    item_written = false;
+
+    if (conflict_rules && options.overwrite_mode == OVERWRITE_MODE_QUERY && !is_partial(src) &&
+        lstat (dest.c_str(), &dest_st) == 0 && !S_ISDIR (dest_st.st_mode))
+    {
+        switch (conflict_rules->resolve(make_conflict (src, dest, st, dest_st)))
+        {
+            case XferConflictRules::RESOLUTION_REPLACE:
+                replace_confirmed = true;
+                break;
+
+            case XferConflictRules::RESOLUTION_RENAME:
+                target = XferConflictRules::unused_name(dest);
+                break;
+
+            default:
+                skip = true;
+                break;
+        }
+    }
+
+    bool ok = true;
+    bool linked = false;
+
+    if (!skip && duplicate && links.count(inode))
+    {
+        ok = copy_hardlink(src, links[inode], target, linked);
+
+        // to be copied after all, so its data counts now
+        if (ok && !linked)
+        {
+            progress.bytes_total += st.st_size;
+            progress.physical_bytes_total += options.sparse ? min<uint64_t> (st.st_size, allocated_size (st)) : st.st_size;
+            duplicate = false;
+        }
+    }
+
+    if (skip)
+    {
+        if (!duplicate)
+        {
+            progress.bytes_done += progress.file_size;
+            progress.physical_bytes_done += options.sparse ? min<uint64_t> (st.st_size, allocated_size (st)) : progress.file_size.load();
+        }
+    }
+    else
+        if (ok && !linked)
+        {
+            if (S_ISLNK (st.st_mode))
+                ok = copy_symlink(src, target);
+            else
+                if (S_ISREG (st.st_mode))
+                {
+                    bool created = false;
+
+                    ok = copy_regular(src, target, st, &created);
+
+                    if (created && linkable && !links.count(inode))
+                        links[inode] = target;
+                }
+                else
+                    ok = copy_special(src, target, st);
+        }
+
+    replace_confirmed = false;
+
+    if (!ok)
+        return false;
+
+    progress.files_done++;
+
+    if (journal)
+        journal->mark_done(src);
+
+    if (item_written && on_copied)
+        on_copied(src, target);
+
+    return !aborted;
+}
+
+
+void GnomeCmd::XferEngine::find_conflicts(const string &src, const string &dest, vector<XferConflict> &conflicts)
+{
+    struct stat st, dest_st;
+
+    if ((options.follow_links ? stat (src.c_str(), &st) : lstat (src.c_str(), &st)) != 0 ||
+        lstat (dest.c_str(), &dest_st) != 0)
+        return;
+
+    if (S_ISDIR (st.st_mode))
+    {
+        vector<string> names;
+        int error;
+
+        // an existing directory is merged, only its contents can conflict
+        if (S_ISDIR (dest_st.st_mode))
+        {
+            if (list_directory (src, names, error))
+                for (auto &name : names)
+                    find_conflicts(src + "/" + name, dest + "/" + name, conflicts);
+
+            return;
+        }
+    }
+    else
+        if (S_ISDIR (dest_st.st_mode) || (journal && journal->is_done(src)))
+            return;
+
+    conflicts.push_back(make_conflict (src, dest, st, dest_st));
+}
+
+
+vector<GnomeCmd::XferConflict> GnomeCmd::XferEngine::find_conflicts(const vector<Item> &items)
+{
+    vector<XferConflict> conflicts;
+
+    for (auto &item : items)
+        find_conflicts(item.first, item.second, conflicts);
+
+    // the partially copied file is continued, not replaced
+    conflicts.erase(remove_if (conflicts.begin(), conflicts.end(), [this] (const XferConflict &c) { return is_partial(c.src); }),
+                    conflicts.end());
+
+    return conflicts;
+}
+
+
+bool GnomeCmd::XferEngine::run(const vector<Item> &items)
+{
+    for (auto &item : items)
+        scan(item.first);
+
+    if (on_preflight && !on_preflight(progress.physical_bytes_total, progress.files_total))
+    {
+        aborted = true;
+        return false;
+    }
+
+    bulk = options.bulk_mode == BULK_ON ||
+           (options.bulk_mode == BULK_AUTO && options.bulk_threshold > 0 && progress.bytes_total >= options.bulk_threshold);
+
+    for (auto &item : items)
+        if (!copy_item(item.first, item.second))
+            return false;
+
+    return !cancelled && !aborted;
+}
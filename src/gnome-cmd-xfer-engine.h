@@ -0,0 +1,223 @@
+/**
+ * @file gnome-cmd-xfer-engine.h
+ * @brief Native transfer engine for copying between local file systems.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gnome-cmd-file-io.h"
+#include "gnome-cmd-progress.h"
+#include "gnome-cmd-xfer-conflicts.h"
+
+namespace GnomeCmd
+{
+    class XferJournal;
+    class XferUring;
+
+    /**
+     * Progress of a transfer, written by the engine thread and read by the GUI.
+     *
+     * Logical bytes are the file sizes as seen by the user, holes included.
+     * Physical bytes are the bytes really read and written, for sparse files
+     * these can be a small fraction of the logical ones.
+     */
+    struct XferProgress
+    {
+        std::atomic<uint64_t> files_total {0};
+        std::atomic<uint64_t> files_done {0};
+        std::atomic<uint64_t> bytes_total {0};
+        std::atomic<uint64_t> bytes_done {0};
+        std::atomic<uint64_t> physical_bytes_total {0};
+        std::atomic<uint64_t> physical_bytes_done {0};
+        std::atomic<uint64_t> file_size {0};
+        std::atomic<uint64_t> file_bytes_done {0};
+
+        /** Called by the engine thread */
+        void set_current_file(const std::string &path)      {  file_events.push(path);  }
+
+        /** Called by the GUI thread */
+        std::string get_current_file();
+
+      private:
+
+        ProgressEvents file_events;
+        std::string shown_file;             /**< belongs to the GUI thread */
+    };
+
+
+    class XferEngine
+    {
+      public:
+
+        /** Same order as GnomeVFSXferOverwriteMode */
+        enum OverwriteMode
+        {
+            OVERWRITE_MODE_ABORT,
+            OVERWRITE_MODE_QUERY,
+            OVERWRITE_MODE_REPLACE,
+            OVERWRITE_MODE_SKIP
+        };
+
+        /** Same order as GnomeVFSXferOverwriteAction and the buttons of the overwrite dialog */
+        enum OverwriteAction
+        {
+            OVERWRITE_ACTION_ABORT,
+            OVERWRITE_ACTION_REPLACE,
+            OVERWRITE_ACTION_REPLACE_ALL,
+            OVERWRITE_ACTION_SKIP,
+            OVERWRITE_ACTION_SKIP_ALL
+        };
+
+        /** How file data is moved from the source to the destination */
+        enum Backend
+        {
+            BACKEND_AUTO,                   /**< copy_file_range where supported, read/write otherwise */
+            BACKEND_READ_WRITE,
+            BACKEND_COPY_FILE_RANGE,
+            BACKEND_URING                   /**< falls back to BACKEND_AUTO if io_uring is not available */
+        };
+
+        /** Bulk mode keeps large jobs from evicting everything else from the page cache */
+        enum BulkMode
+        {
+            BULK_OFF,
+            BULK_ON,
+            BULK_AUTO                       /**< on for jobs of bulk_threshold bytes and more */
+        };
+
+        struct Options
+        {
+            OverwriteMode overwrite_mode {OVERWRITE_MODE_QUERY};
+            bool follow_links {false};
+            bool sparse {true};             /**< copy only the data extents of files with holes */
+            Backend backend {BACKEND_AUTO};
+            unsigned queue_depth {32};      /**< blocks in flight for BACKEND_URING */
+            BulkMode bulk_mode {BULK_OFF};
+            uint64_t bulk_threshold {0};    /**< 0 means that BULK_AUTO never switches bulk mode on */
+            bool preserve_hardlinks {false};    /**< files linked in the source are linked in the destination, too */
+            bool reflink {false};           /**< share the data blocks with the source on copy-on-write file systems */
+        };
+
+        typedef std::pair<std::string,std::string> Item;        /**< source and destination path */
+
+        typedef std::function<ErrorAction (const std::string &path, int error)> ErrorFunc;
+        typedef std::function<OverwriteAction (const std::string &src, const std::string &dest)> OverwriteFunc;
+        typedef std::function<void (const std::string &src, const std::string &dest)> CopiedFunc;
+        typedef std::function<bool (uint64_t bytes, uint64_t files)> PreflightFunc;
+
+        enum
+        {
+            CHUNK_SIZE = 1 << 20,           /**< granularity of progress updates and cancellation checks */
+            TAIL_BLOCK_SIZE = 1 << 16       /**< compared before a partially copied file is continued */
+        };
+
+      private:
+
+        std::atomic<bool> cancelled {false};
+        bool aborted {false};
+
+        std::string cur_src;                /**< regular file being copied, for the journal */
+        std::string cur_dest;
+
+        std::unique_ptr<XferUring> uring;   /**< created on first use */
+        bool uring_failed {false};
+
+        bool bulk {false};                  /**< bulk mode is on for this job */
+        bool direct_io {false};             /**< the files being copied are open with O_DIRECT */
+        char *bulk_buf {nullptr};           /**< aligned for O_DIRECT */
+
+        bool replace_confirmed {false};     /**< the conflict rules decided to replace the current item */
+        bool item_written {false};          /**< the current item has been copied, not skipped */
+
+        typedef std::pair<dev_t,ino_t> Inode;
+
+        std::set<Inode> scanned_links;      /**< hard linked files counted by scan(), each one once */
+        std::map<Inode,std::string> links;  /**< where hard linked files have been copied to */
+
+        void scan(const std::string &path);
+        void find_conflicts(const std::string &src, const std::string &dest, std::vector<XferConflict> &conflicts);
+        bool copy_item(const std::string &src, const std::string &dest);
+        bool copy_directory(const std::string &src, std::string &dest, const struct stat &st);
+        bool copy_symlink(const std::string &src, const std::string &dest);
+        bool copy_regular(const std::string &src, const std::string &dest, const struct stat &st, bool *created=nullptr);
+        bool copy_hardlink(const std::string &src, const std::string &existing, const std::string &dest, bool &linked);
+        bool copy_special(const std::string &src, const std::string &dest, const struct stat &st);
+        bool may_replace(const std::string &src, const std::string &dest, bool &skip);
+        bool is_partial(const std::string &src, uint64_t *offset=nullptr);
+        int continue_partial(int src_fd, int dest_fd, const struct stat &st, uint64_t journal_offset, uint64_t &pos);
+        int copy_range(int src_fd, int dest_fd, uint64_t offset, uint64_t len);
+        int copy_range_uring(int src_fd, int dest_fd, uint64_t offset, uint64_t len);
+        int copy_range_bulk(int src_fd, int dest_fd, uint64_t offset, uint64_t len);
+        ErrorAction report(const std::string &path, int error);
+
+      public:
+
+        Options options;
+        XferProgress progress;
+        XferJournal *journal {nullptr};     /**< optional, used to resume interrupted jobs */
+
+        ErrorFunc on_error;                 /**< asked on errors, the job is aborted if not set */
+        OverwriteFunc on_overwrite;         /**< asked for OVERWRITE_MODE_QUERY, files are skipped if not set */
+        const XferConflictRules *conflict_rules {nullptr};  /**< used instead of on_overwrite if set */
+        CopiedFunc on_copied;               /**< called for every item copied completely, for directories after their contents */
+        PreflightFunc on_preflight;         /**< called with the size of the job before copying, nothing is copied if it returns false */
+
+        explicit XferEngine(const Options &opts);
+        ~XferEngine();
+
+        /**
+         * Copies all items, recursing into directories.
+         *
+         * @returns false if the job was aborted or cancelled
+         */
+        bool run(const std::vector<Item> &items);
+
+        /**
+         * Looks for files which already exist in the destination, without
+         * copying anything. Files finished according to the journal are left
+         * out, they are not going to be copied again.
+         */
+        std::vector<XferConflict> find_conflicts(const std::vector<Item> &items);
+
+        bool is_bulk() const                {  return bulk;  }
+
+        void cancel()                       {  cancelled = true;  }
+        bool is_cancelled() const           {  return cancelled;  }
+
+        /**
+         * Copies the contents of @a src_fd from @a offset on to @a dest_fd. Holes in
+         * the source are skipped if sparse copying is enabled, the size of the
+         * destination is set to the size of the source at the end.
+         *
+         * @returns 0 or an errno value
+         */
+        int copy_data(int src_fd, int dest_fd, const struct stat &st, uint64_t offset=0);
+    };
+}
@@ -0,0 +1,546 @@
+/**
+ * @file gnome-cmd-xfer-fanout.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "gnome-cmd-xfer-fanout.h"
+
+using namespace std;
+
+
+/** The blocks of the file being copied, shared by the reader and the writers */
+struct GnomeCmd::XferFanout::Ring
+{
+    std::mutex mutex;
+    condition_variable cond;
+
+    char *slots;                            /**< RING_SLOTS blocks of BLOCK_SIZE */
+    size_t lens[RING_SLOTS];
+    uint64_t produced {0};                  /**< blocks read so far */
+    bool eof {false};                       /**< nothing more is going to be read */
+
+    vector<uint64_t> consumed;              /**< blocks written, per writer */
+    vector<bool> active;                    /**< the writer is still running */
+
+    Ring(char *buf, size_t n_writers): slots(buf), consumed(n_writers, 0), active(n_writers, true)  {}
+
+    /** The slowest running writer decides whether the oldest slot can be reused */
+    bool has_free_slot() const
+    {
+        uint64_t oldest = produced;
+
+        for (size_t w=0; w<consumed.size(); ++w)
+            if (active[w])
+                oldest = min (oldest, consumed[w]);
+
+        return produced - oldest < RING_SLOTS;
+    }
+
+    bool has_writers() const
+    {
+        return find (active.begin(), active.end(), true) != active.end();
+    }
+};
+
+
+GnomeCmd::XferFanout::XferFanout(const Options &opts, const vector<string> &dest_dirs): options(opts)
+{
+    for (auto &dir : dest_dirs)
+        destinations.emplace_back(new Destination(dir));
+}
+
+
+string GnomeCmd::XferFanout::get_current_file()
+{
+    ProgressEvents::Event event;
+
+    if (file_events.pop_latest(event))
+        shown_file = move (event.path);
+
+    return shown_file;
+}
+
+
+GnomeCmd::ErrorAction GnomeCmd::XferFanout::report(const string &path, int error)
+{
+    ErrorAction action = on_error ? on_error (path, error) : ERROR_ACTION_ABORT;
+
+    if (action == ERROR_ACTION_ABORT)
+        aborted = true;
+
+    return action;
+}
+
+
+void GnomeCmd::XferFanout::scan(const string &path)
+{
+    struct stat st;
+
+    if ((options.follow_links ? stat (path.c_str(), &st) : lstat (path.c_str(), &st)) != 0)
+        return;
+
+    if (S_ISDIR (st.st_mode))
+    {
+        vector<string> names;
+        int error;
+
+        if (list_directory (path, names, error))
+            for (auto &name : names)
+                scan(path + "/" + name);
+
+        return;
+    }
+
+    files_total++;
+
+    if (S_ISREG (st.st_mode))
+        bytes_total += st.st_size;
+}
+
+
+/**
+ * Counts a file as done for a destination where it is not going to be written,
+ * so that the progress of every destination ends at the total.
+ */
+void GnomeCmd::XferFanout::count_done(size_t target, const struct stat &st)
+{
+    destinations[target]->files_done++;
+
+    if (S_ISREG (st.st_mode))
+        destinations[target]->bytes_done += st.st_size;
+}
+
+
+void GnomeCmd::XferFanout::writer(Ring &ring, size_t w, int fd, size_t target, int &error)
+{
+    unique_lock<std::mutex> lock(ring.mutex);
+
+    for (;;)
+    {
+        while (!cancelled && !ring.eof && ring.consumed[w] == ring.produced)
+            ring.cond.wait_for(lock, chrono::milliseconds(100));
+
+        if (cancelled || ring.consumed[w] == ring.produced)
+            break;
+
+        uint64_t block = ring.consumed[w];
+        size_t slot = block % RING_SLOTS;
+        size_t len = ring.lens[slot];
+
+        lock.unlock();
+        bool ok = pwrite_all (fd, ring.slots + slot * BLOCK_SIZE, len, block * BLOCK_SIZE);
+        int write_error = errno;
+        lock.lock();
+
+        if (!ok)
+        {
+            error = write_error ? write_error : EIO;
+            break;
+        }
+
+        ring.consumed[w]++;
+        destinations[target]->bytes_done += len;
+        ring.cond.notify_all();
+    }
+
+    ring.active[w] = false;
+    ring.cond.notify_all();
+}
+
+
+/**
+ * Reads @a size bytes from @a src_fd once and writes them to all @a fds.
+ * The errors of the writers are returned in @a errors.
+ */
+void GnomeCmd::XferFanout::stream(int src_fd, uint64_t size, const vector<int> &fds, const Targets &targets, vector<int> &errors, int &read_error)
+{
+    if (fds.empty())
+        return;
+
+    if (!buffer)
+        buffer.reset(new char[(size_t) RING_SLOTS * BLOCK_SIZE]);
+
+    // a file of one block does not need any threads
+    if (size <= BLOCK_SIZE)
+    {
+        ssize_t n = pread_all (src_fd, buffer.get(), size, 0);
+
+        if (n != (ssize_t) size)
+        {
+            read_error = n < 0 ? errno : EIO;
+            return;
+        }
+
+        for (size_t i=0; i<fds.size(); ++i)
+            if (pwrite_all (fds[i], buffer.get(), size, 0))
+                destinations[targets[i]]->bytes_done += size;
+            else
+                errors[i] = errno ? errno : EIO;
+
+        return;
+    }
+
+    Ring ring(buffer.get(), fds.size());
+    vector<thread> writers;
+
+    for (size_t i=0; i<fds.size(); ++i)
+        writers.emplace_back(&XferFanout::writer, this, ref(ring), i, fds[i], targets[i], ref(errors[i]));
+
+    for (uint64_t offset=0; offset<size; offset+=BLOCK_SIZE)
+    {
+        unique_lock<std::mutex> lock(ring.mutex);
+
+        while (!cancelled && ring.has_writers() && !ring.has_free_slot())
+            ring.cond.wait_for(lock, chrono::milliseconds(100));
+
+        if (cancelled || !ring.has_writers())
+            break;
+
+        size_t slot = ring.produced % RING_SLOTS;
+        size_t len = min<uint64_t> (BLOCK_SIZE, size - offset);
+
+        // the slot is not used by any writer until produced is increased
+        lock.unlock();
+        ssize_t n = pread_all (src_fd, ring.slots + slot * BLOCK_SIZE, len, offset);
+        int error = errno;
+        lock.lock();
+
+        if (n != (ssize_t) len)
+        {
+            read_error = n < 0 ? error : EIO;
+            break;
+        }
+
+        ring.lens[slot] = len;
+        ring.produced++;
+        ring.cond.notify_all();
+    }
+
+    {
+        lock_guard<std::mutex> lock(ring.mutex);
+        ring.eof = true;
+        ring.cond.notify_all();
+    }
+
+    for (auto &t : writers)
+        t.join();
+}
+
+
+bool GnomeCmd::XferFanout::copy_regular(const string &src, const string &rel, const struct stat &st, const Targets &all_targets)
+{
+    Targets targets = all_targets;
+
+    while (!targets.empty())
+    {
+        int src_fd = open (src.c_str(), O_RDONLY|O_CLOEXEC);
+
+        if (src_fd < 0)
+        {
+            switch (report(src, errno))
+            {
+                case ERROR_ACTION_RETRY:
+                    continue;
+
+                case ERROR_ACTION_SKIP:
+                    for (size_t t : targets)
+                        count_done(t, st);
+                    return true;
+
+                default:
+                    return false;
+            }
+        }
+
+        vector<int> fds;
+        Targets open_targets;
+        vector<pair<size_t,int>> failed;
+        vector<uint64_t> bytes_before;
+
+        for (size_t t : targets)
+        {
+            string dest = dest_path(t, rel);
+            int fd = open_replacing (dest.c_str(), O_WRONLY|O_CREAT|O_CLOEXEC|(options.replace ? O_TRUNC : O_EXCL), 0600);
+
+            if (fd >= 0)
+            {
+                fds.push_back(fd);
+                open_targets.push_back(t);
+                bytes_before.push_back(destinations[t]->bytes_done);
+            }
+            else
+                if (errno == EEXIST)
+                    count_done(t, st);          // the existing file is kept
+                else
+                    failed.push_back(make_pair(t, errno));
+        }
+
+        vector<int> errors(fds.size(), 0);
+        int read_error = 0;
+
+        stream(src_fd, st.st_size, fds, open_targets, errors, read_error);
+
+        close (src_fd);
+
+        Targets incomplete;
+
+        for (size_t i=0; i<fds.size(); ++i)
+        {
+            size_t t = open_targets[i];
+            bool ok = !errors[i] && !read_error && !cancelled;
+
+            if (ok)
+            {
+                fchmod (fds[i], st.st_mode & 07777);
+                copy_times (fds[i], st);
+            }
+
+            if (close (fds[i]) != 0 && ok)
+            {
+                errors[i] = errno;
+                ok = false;
+            }
+
+            if (ok)
+            {
+                destinations[t]->files_done++;
+                continue;
+            }
+
+            // take back what was counted for the incomplete copy
+            unlink (dest_path(t, rel).c_str());
+            destinations[t]->bytes_done = bytes_before[i];
+
+            if (errors[i])
+                failed.push_back(make_pair(t, errors[i]));
+            else
+                incomplete.push_back(t);
+        }
+
+        if (cancelled)
+            return false;
+
+        targets.clear();
+
+        if (read_error)
+            switch (report(src, read_error))
+            {
+                case ERROR_ACTION_RETRY:
+                    targets = incomplete;
+                    break;
+
+                case ERROR_ACTION_SKIP:
+                    for (size_t t : incomplete)
+                        count_done(t, st);
+                    break;
+
+                default:
+                    return false;
+            }
+
+        for (auto &f : failed)
+            switch (report(dest_path(f.first, rel), f.second))
+            {
+                case ERROR_ACTION_RETRY:
+                    targets.push_back(f.first);
+                    break;
+
+                case ERROR_ACTION_SKIP:
+                    count_done(f.first, st);
+                    break;
+
+                default:
+                    return false;
+            }
+    }
+
+    return true;
+}
+
+
+bool GnomeCmd::XferFanout::copy_symlink(const string &src, const string &rel, const Targets &targets)
+{
+    char target[PATH_MAX+1];
+    ssize_t len;
+
+    while ((len = readlink (src.c_str(), target, PATH_MAX)) < 0)
+        switch (report(src, errno))
+        {
+            case ERROR_ACTION_RETRY:    continue;
+            case ERROR_ACTION_SKIP:     return true;
+            default:                    return false;
+        }
+
+    target[len] = '\0';
+
+    for (size_t t : targets)
+    {
+        string dest = dest_path(t, rel);
+
+        for (;;)
+        {
+            if (symlink (target, dest.c_str()) == 0 || (errno == EEXIST && !options.replace))
+                break;
+
+            if (errno == EEXIST && unlink (dest.c_str()) == 0 && symlink (target, dest.c_str()) == 0)
+                break;
+
+            ErrorAction action = report(dest, errno);
+
+            if (action == ERROR_ACTION_RETRY)
+                continue;
+
+            if (action == ERROR_ACTION_ABORT)
+                return false;
+
+            break;
+        }
+
+        destinations[t]->files_done++;
+    }
+
+    return true;
+}
+
+
+bool GnomeCmd::XferFanout::copy_directory(const string &src, const string &rel, const struct stat &st, const Targets &all_targets)
+{
+    Targets targets;
+
+    for (size_t t : all_targets)
+    {
+        string dest = dest_path(t, rel);
+        struct stat dest_st;
+
+        for (;;)
+        {
+            // an existing directory is merged
+            if (mkdir (dest.c_str(), 0700) == 0 || (errno == EEXIST && stat (dest.c_str(), &dest_st) == 0 && S_ISDIR (dest_st.st_mode)))
+            {
+                targets.push_back(t);
+                break;
+            }
+
+            ErrorAction action = report(dest, errno == EEXIST ? ENOTDIR : errno);
+
+            if (action == ERROR_ACTION_RETRY)
+                continue;
+
+            if (action == ERROR_ACTION_ABORT)
+                return false;
+
+            break;
+        }
+    }
+
+    // everything below goes to the destinations where the directory could be created
+    if (!targets.empty())
+    {
+        vector<string> names;
+        int error;
+
+        while (!list_directory (src, names, error))
+            switch (report(src, error))
+            {
+                case ERROR_ACTION_RETRY:    continue;
+                case ERROR_ACTION_SKIP:     return true;
+                default:                    return false;
+            }
+
+        for (auto &name : names)
+            if (!copy_item(src + "/" + name, rel + "/" + name, targets))
+                return false;
+    }
+
+    for (size_t t : targets)
+        chmod (dest_path(t, rel).c_str(), st.st_mode & 07777);
+
+    return !cancelled && !aborted;
+}
+
+
+bool GnomeCmd::XferFanout::copy_item(const string &src, const string &rel, const Targets &targets)
+{
+    if (cancelled || aborted)
+        return false;
+
+    struct stat st;
+
+    while ((options.follow_links ? stat (src.c_str(), &st) : lstat (src.c_str(), &st)) != 0)
+        switch (report(src, errno))
+        {
+            case ERROR_ACTION_RETRY:    continue;
+            case ERROR_ACTION_SKIP:     return true;
+            default:                    return false;
+        }
+
+    if (S_ISDIR (st.st_mode))
+        return copy_directory(src, rel, st, targets);
+
+    file_events.push(src);
+
+    bool ok = true;
+
+    if (S_ISREG (st.st_mode))
+        ok = copy_regular(src, rel, st, targets);
+    else
+        if (S_ISLNK (st.st_mode))
+            ok = copy_symlink(src, rel, targets);
+        else
+        {
+            // devices and pipes are not worth a fan-out copy
+            ok = report(src, ENOTSUP) != ERROR_ACTION_ABORT;
+
+            for (size_t t : targets)
+                count_done(t, st);
+        }
+
+    return ok && !aborted;
+}
+
+
+bool GnomeCmd::XferFanout::run(const vector<Item> &items)
+{
+    for (auto &item : items)
+        scan(item.first);
+
+    Targets targets;
+
+    for (size_t t=0; t<destinations.size(); ++t)
+        targets.push_back(t);
+
+    for (auto &item : items)
+        if (!copy_item(item.first, item.second, targets))
+            return false;
+
+    return !cancelled && !aborted;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file gnome-cmd-xfer-fanout.h
+ * @brief Copying local files to several destinations at once, reading
+ * them only once.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gnome-cmd-file-io.h"
+#include "gnome-cmd-progress.h"
+
+namespace GnomeCmd
+{
+    /**
+     * Copies files and directory trees into several destination directories.
+     *
+     * Every block of a file is read once into a ring buffer of RING_SLOTS
+     * blocks, from which one writer thread per destination writes it out. The
+     * reader waits for the slowest writer before it reuses a slot, so a slow
+     * USB stick sets the pace without the others having to read the source
+     * again. A destination which fails is dropped for the current file only,
+     * the others carry on.
+     */
+    class XferFanout
+    {
+      public:
+
+        typedef std::function<ErrorAction (const std::string &path, int error)> ErrorFunc;
+
+        typedef std::pair<std::string,std::string> Item;        /**< source path and the name in the destination directories */
+
+        enum
+        {
+            BLOCK_SIZE = 1 << 20,
+            RING_SLOTS = 8
+        };
+
+        struct Options
+        {
+            bool replace {false};           /**< existing files are replaced, otherwise they are kept */
+            bool follow_links {false};
+        };
+
+        /** A destination directory and how far it is */
+        struct Destination
+        {
+            std::string dir;
+            std::atomic<uint64_t> files_done {0};
+            std::atomic<uint64_t> bytes_done {0};
+
+            explicit Destination(const std::string &path): dir(path)   {}
+        };
+
+      private:
+
+        struct Ring;
+
+        typedef std::vector<size_t> Targets;    /**< indices into destinations */
+
+        std::atomic<bool> cancelled {false};
+        bool aborted {false};
+
+        std::unique_ptr<char[]> buffer;     /**< the slots of the ring, allocated for the first large file */
+
+        ProgressEvents file_events;
+        std::string shown_file;             /**< belongs to the GUI thread */
+
+        std::string dest_path(size_t target, const std::string &rel) const  {  return destinations[target]->dir + "/" + rel;  }
+
+        void scan(const std::string &path);
+        bool copy_item(const std::string &src, const std::string &rel, const Targets &targets);
+        bool copy_directory(const std::string &src, const std::string &rel, const struct stat &st, const Targets &targets);
+        bool copy_symlink(const std::string &src, const std::string &rel, const Targets &targets);
+        bool copy_regular(const std::string &src, const std::string &rel, const struct stat &st, const Targets &targets);
+        void stream(int src_fd, uint64_t size, const std::vector<int> &fds, const Targets &targets, std::vector<int> &errors, int &read_error);
+        void writer(Ring &ring, size_t w, int fd, size_t target, int &error);
+        void count_done(size_t target, const struct stat &st);
+        ErrorAction report(const std::string &path, int error);
+
+      public:
+
+        Options options;
+        std::vector<std::unique_ptr<Destination>> destinations;
+
+        std::atomic<uint64_t> files_total {0};
+        std::atomic<uint64_t> bytes_total {0};  /**< per destination */
+
+        ErrorFunc on_error;                 /**< asked on errors, the job is aborted if not set */
+
+        XferFanout(const Options &opts, const std::vector<std::string> &dest_dirs);
+
+        /**
+         * Copies all items into every destination directory, recursing into directories.
+         *
+         * @returns false if the job was aborted or cancelled
+         */
+        bool run(const std::vector<Item> &items);
+
+        /** Called by the GUI thread */
+        std::string get_current_file();
+
+        void cancel()                       {  cancelled = true;  }
+        bool is_cancelled() const           {  return cancelled;  }
+    };
+}
@@ -0,0 +1,329 @@
+/**
+ * @file gnome-cmd-xfer-journal.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+
+#include <glib.h>
+
+#include "gnome-cmd-file-io.h"
+#include "gnome-cmd-xfer-journal.h"
+
+using namespace std;
+
+
+#define JOURNAL_MAGIC    "gcmd-xfer-journal"
+#define JOURNAL_VERSION  1
+
+
+/**
+ * URIs handed to the journal are escaped already, but make sure a stray
+ * separator never breaks the line based format.
+ */
+inline bool is_storable (const string &s)
+{
+    return !s.empty() && s.find_first_of("\t\n") == string::npos;
+}
+
+
+GnomeCmd::XferJournal::XferJournal(const string &dir, const string &job_key)
+{
+    if (mkdir (dir.c_str(), 0700) != 0 && errno != EEXIST)
+        g_warning ("Failed to create transfer journal directory %s: %s", dir.c_str(), strerror (errno));
+
+    path = dir + "/" + job_key + ".journal";
+}
+
+
+GnomeCmd::XferJournal::~XferJournal()
+{
+    close();
+}
+
+
+string GnomeCmd::XferJournal::make_job_key(const vector<string> &src_uris, const vector<string> &dest_uris)
+{
+    // 64 bit FNV-1a over all URIs, separated so that ("ab","c") != ("a","bc")
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    auto feed = [&h] (const string &s)
+    {
+        for (unsigned char c : s)
+        {
+            h ^= c;
+            h *= 0x100000001b3ULL;
+        }
+        h ^= 0xff;
+        h *= 0x100000001b3ULL;
+    };
+
+    for (auto &s : src_uris)
+        feed (s);
+
+    feed (string());
+
+    for (auto &s : dest_uris)
+        feed (s);
+
+    char buf[17];
+    snprintf (buf, sizeof(buf), "%016llx", (unsigned long long) h);
+
+    return buf;
+}
+
+
+bool GnomeCmd::XferJournal::exists() const
+{
+    struct stat buf;
+
+    return stat (path.c_str(), &buf) == 0 && S_ISREG (buf.st_mode);
+}
+
+
+bool GnomeCmd::XferJournal::load()
+{
+    ifstream f(path.c_str());
+
+    if (!f)
+        return false;
+
+    string line;
+
+    if (!getline (f, line))
+        return false;
+
+    unsigned version, opts, mode;
+    char magic[32];
+
+    if (sscanf (line.c_str(), "%31s %u %u %u", magic, &version, &opts, &mode) != 4 ||
+        strcmp (magic, JOURNAL_MAGIC) != 0 || version != JOURNAL_VERSION)
+        return false;
+
+    options = opts;
+    overwrite_mode = mode;
+    done.clear();
+    partial_src.clear();
+    partial_dest.clear();
+    partial_offset = 0;
+
+    while (getline (f, line))
+    {
+        // a record cut short by a crash has no trailing newline - ignore it
+        if (f.eof())
+            break;
+
+        size_t tab = line.find('\t');
+
+        if (tab == string::npos)
+            continue;
+
+        if (line.compare(0, tab, "done") == 0)
+        {
+            string src = line.substr(tab+1);
+
+            done.insert(src);
+            if (src == partial_src)
+            {
+                partial_src.clear();
+                partial_dest.clear();
+                partial_offset = 0;
+            }
+        }
+        else
+            if (line.compare(0, tab, "partial") == 0)
+            {
+                size_t tab2 = line.find('\t', tab+1);
+                size_t tab3 = tab2==string::npos ? string::npos : line.find('\t', tab2+1);
+
+                if (tab3 == string::npos)
+                    continue;
+
+                partial_offset = strtoull (line.c_str()+tab+1, nullptr, 10);
+                partial_src = line.substr(tab2+1, tab3-tab2-1);
+                partial_dest = line.substr(tab3+1);
+            }
+    }
+
+    return true;
+}
+
+
+bool GnomeCmd::XferJournal::append(const string &record, bool sync)
+{
+    if (fd < 0)
+        return false;
+
+    if (!write_all (fd, record.data(), record.size()))
+    {
+        g_warning ("Failed to write transfer journal %s: %s", path.c_str(), strerror (errno));
+        return false;
+    }
+
+    if (sync)
+        fdatasync (fd);
+
+    return true;
+}
+
+
+/**
+ * Replaces the journal by a compact copy of the current state. The new
+ * file is written next to the old one and renamed over it, so there is
+ * always a consistent journal on disk.
+ */
+bool GnomeCmd::XferJournal::rewrite()
+{
+    string tmp_path = path + ".tmp";
+    int tmp_fd = open (tmp_path.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0600);
+
+    if (tmp_fd < 0)
+        return false;
+
+    char header[64];
+    snprintf (header, sizeof(header), "%s %u %u %u\n", JOURNAL_MAGIC, JOURNAL_VERSION, options, overwrite_mode);
+
+    string buf = header;
+
+    for (auto &s : done)
+        buf += "done\t" + s + "\n";
+
+    if (!partial_src.empty())
+        buf += "partial\t" + to_string(partial_offset) + "\t" + partial_src + "\t" + partial_dest + "\n";
+
+    if (!write_all (tmp_fd, buf.data(), buf.size()) || fdatasync (tmp_fd) != 0 || rename (tmp_path.c_str(), path.c_str()) != 0)
+    {
+        ::close (tmp_fd);
+        unlink (tmp_path.c_str());
+        return false;
+    }
+
+    close();
+
+    fd = tmp_fd;
+    lseek (fd, 0, SEEK_END);
+    partial_records = 0;
+
+    return true;
+}
+
+
+bool GnomeCmd::XferJournal::start(unsigned xfer_options, unsigned xfer_overwrite_mode)
+{
+    options = xfer_options;
+    overwrite_mode = xfer_overwrite_mode;
+    done.clear();
+    partial_src.clear();
+    partial_dest.clear();
+    partial_offset = flushed_offset = 0;
+
+    return rewrite();
+}
+
+
+bool GnomeCmd::XferJournal::resume()
+{
+    flushed_offset = partial_offset;
+
+    return rewrite();
+}
+
+
+void GnomeCmd::XferJournal::close()
+{
+    if (fd >= 0)
+        ::close (fd);
+
+    fd = -1;
+}
+
+
+void GnomeCmd::XferJournal::remove()
+{
+    close();
+    unlink (path.c_str());
+    done.clear();
+    partial_src.clear();
+}
+
+
+bool GnomeCmd::XferJournal::get_partial(string &src_uri, string &dest_uri, uint64_t &offset) const
+{
+    if (partial_src.empty())
+        return false;
+
+    src_uri = partial_src;
+    dest_uri = partial_dest;
+    offset = partial_offset;
+
+    return true;
+}
+
+
+void GnomeCmd::XferJournal::mark_done(const string &src_uri)
+{
+    if (!is_storable (src_uri) || !done.insert(src_uri).second)
+        return;
+
+    if (src_uri == partial_src)
+    {
+        partial_src.clear();
+        partial_dest.clear();
+        partial_offset = flushed_offset = 0;
+    }
+
+    append ("done\t" + src_uri + "\n", false);
+}
+
+
+void GnomeCmd::XferJournal::update_partial(const string &src_uri, const string &dest_uri, uint64_t offset, bool force)
+{
+    if (!is_storable (src_uri) || !is_storable (dest_uri) || is_done (src_uri))
+        return;
+
+    bool same_file = src_uri == partial_src;
+
+    partial_src = src_uri;
+    partial_dest = dest_uri;
+    partial_offset = offset;
+
+    if (!same_file)
+        flushed_offset = 0;
+
+    time_t now = time (nullptr);
+
+    // throttle writes: the offset only needs to be roughly right, the tail
+    // block check on resume finds the exact position
+    if (!force && same_file && offset - flushed_offset < FLUSH_BYTES && now - flushed_time < FLUSH_SECONDS)
+        return;
+
+    flushed_offset = offset;
+    flushed_time = now;
+
+    if (++partial_records > MAX_PARTIAL_RECORDS)
+        rewrite();
+    else
+        append ("partial\t" + to_string(offset) + "\t" + src_uri + "\t" + dest_uri + "\n", true);
+}
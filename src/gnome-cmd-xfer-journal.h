@@ -0,0 +1,100 @@
+/**
+ * @file gnome-cmd-xfer-journal.h
+ * @brief Persistent state of a running transfer, used to resume it after
+ * it was cancelled or the application crashed.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace GnomeCmd
+{
+    /**
+     * A transfer journal is a small text file which is appended to while a
+     * transfer job runs:
+     *
+     *  - a header identifying the job and the options it was started with,
+     *  - one "done" record per completely transferred file,
+     *  - "partial" records holding the byte offset reached in the file
+     *    currently being transferred (only the last one counts).
+     *
+     * The journal is removed when the job completes. If it is still present
+     * when the same job (same sources, same destinations) is started again,
+     * finished files can be skipped and the partial one continued.
+     */
+    class XferJournal
+    {
+        std::string path;
+        int fd {-1};
+
+        unsigned options {0};
+        unsigned overwrite_mode {0};
+
+        std::set<std::string> done;
+        std::string partial_src;
+        std::string partial_dest;
+        uint64_t partial_offset {0};
+
+        uint64_t flushed_offset {0};
+        time_t flushed_time {0};
+        unsigned partial_records {0};
+
+        bool append(const std::string &record, bool sync);
+        bool rewrite();
+
+      public:
+
+        enum
+        {
+            FLUSH_BYTES    = 16 << 20,      /**< write a partial record at least every 16 MiB ... */
+            FLUSH_SECONDS  = 1,             /**< ... or every second, whatever comes first */
+            MAX_PARTIAL_RECORDS = 1024      /**< compact the journal when there are more partial records */
+        };
+
+        XferJournal(const std::string &dir, const std::string &job_key);
+        ~XferJournal();
+
+        /** Builds a key which identifies a job by the list of its source and destination URIs. */
+        static std::string make_job_key(const std::vector<std::string> &src_uris, const std::vector<std::string> &dest_uris);
+
+        const std::string &get_path() const                 {  return path;  }
+
+        bool exists() const;
+        bool load();
+        bool start(unsigned xfer_options, unsigned xfer_overwrite_mode);
+        bool resume();
+        void close();
+        void remove();
+
+        unsigned get_options() const                        {  return options;  }
+        unsigned get_overwrite_mode() const                 {  return overwrite_mode;  }
+
+        bool is_done(const std::string &src_uri) const      {  return done.find(src_uri)!=done.end();  }
+        size_t done_count() const                           {  return done.size();  }
+        bool get_partial(std::string &src_uri, std::string &dest_uri, uint64_t &offset) const;
+
+        void mark_done(const std::string &src_uri);
+        void update_partial(const std::string &src_uri, const std::string &dest_uri, uint64_t offset, bool force=false);
+    };
+}
@@ -0,0 +1,275 @@
+/**
+ * @file gnome-cmd-xfer-move.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <set>
+#include <thread>
+
+#include "gnome-cmd-xfer-move.h"
+
+using namespace std;
+
+
+/**
+ * Writes @a path to disk. If it can't be opened, e.g. a copy of a file
+ * nobody may read, the whole file system it is on is synced instead.
+ */
+static bool sync_path (const string &path, bool is_dir)
+{
+    int fd = open (path.c_str(), O_RDONLY|O_NOFOLLOW|O_CLOEXEC|(is_dir ? O_DIRECTORY : 0));
+
+    if (fd < 0 && errno == EACCES)
+    {
+        string parent = path.substr(0, path.rfind('/'));
+        int dir_fd = open (parent.empty() ? "/" : parent.c_str(), O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+
+        if (dir_fd < 0)
+            return false;
+
+        bool ok = syncfs (dir_fd) == 0;
+        close (dir_fd);
+
+        return ok;
+    }
+
+    if (fd < 0)
+        return false;
+
+    // some file systems can't sync directories, they don't need to
+    bool ok = (is_dir ? fsync (fd) : fdatasync (fd)) == 0 || errno == EINVAL;
+
+    close (fd);
+
+    return ok;
+}
+
+
+/**
+ * @returns 0 or an errno value, directories which are not empty are kept without an error
+ */
+static int remove_path (const string &path)
+{
+    struct stat st;
+
+    if (lstat (path.c_str(), &st) != 0)
+        return errno == ENOENT ? 0 : errno;
+
+    if (S_ISDIR (st.st_mode))
+    {
+        // what is left in it has been skipped
+        if (rmdir (path.c_str()) != 0 && errno != ENOTEMPTY && errno != EEXIST)
+            return errno;
+
+        return 0;
+    }
+
+    return unlink (path.c_str()) == 0 || errno == ENOENT ? 0 : errno;
+}
+
+
+int GnomeCmd::XferMove::rename_noreplace(const string &src, const string &dest)
+{
+#ifdef HAVE_RENAMEAT2
+    if (renameat2 (AT_FDCWD, src.c_str(), AT_FDCWD, dest.c_str(), RENAME_NOREPLACE) == 0)
+        return 0;
+
+    // file systems which can't do it check first
+    if (errno != EINVAL && errno != ENOSYS)
+        return errno;
+#endif
+
+    struct stat st;
+
+    if (lstat (dest.c_str(), &st) == 0)
+        return EEXIST;
+
+    return rename (src.c_str(), dest.c_str()) == 0 ? 0 : errno;
+}
+
+
+bool GnomeCmd::XferMove::run(const vector<Item> &items)
+{
+    vector<Item> copies;
+
+    // errors like a missing source are left to the engine, which reports them
+    for (auto &item : items)
+    {
+        if (engine.is_cancelled())
+            return false;
+
+        int error = rename_noreplace(item.first, item.second);
+        struct stat st;
+
+        if (error == 0)
+            renamed++;
+        else
+            // renamed before a resumed job was interrupted, renames are not journaled
+            if (error == ENOENT && engine.journal && lstat (item.second.c_str(), &st) == 0)
+                renamed++;
+            else
+                copies.push_back(item);
+    }
+
+    if (copies.empty())
+        return true;
+
+    closed = false;
+
+    thread remover(&XferMove::remove_sources, this);
+
+    engine.on_copied = [this] (const string &src, const string &dest) { enqueue(src, dest); };
+
+    bool ok = engine.run(copies);
+
+    // the files copied before a cancel are complete, their sources are removed, too
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        closed = true;
+    }
+
+    queue_cond.notify_all();
+    remover.join();
+
+    engine.on_copied = nullptr;
+
+    return ok && report_failed();
+}
+
+
+void GnomeCmd::XferMove::enqueue(const string &src, const string &dest)
+{
+    unique_lock<mutex> lock(queue_mutex);
+
+    // the engine waits for the sources to be removed rather than running ahead
+    queue_cond.wait(lock, [this] { return queue.size() < BACKLOG; });
+    queue.push_back({src, dest});
+    queue_cond.notify_all();
+}
+
+
+void GnomeCmd::XferMove::remove_sources()
+{
+    unique_lock<mutex> lock(queue_mutex);
+
+    for (;;)
+    {
+        queue_cond.wait(lock, [this] { return !queue.empty() || closed; });
+
+        if (queue.empty())
+            return;
+
+        vector<Copied> batch;
+
+        while (!queue.empty() && batch.size() < BATCH)
+        {
+            batch.push_back(move (queue.front()));
+            queue.pop_front();
+        }
+
+        queue_cond.notify_all();
+
+        lock.unlock();
+        remove_batch(batch);
+        lock.lock();
+    }
+}
+
+
+/**
+ * Syncs the copies of a batch and the directories they are in, and then
+ * removes their sources. A copy which is missing or has another size than
+ * its source, which changed while it was copied, keeps its source.
+ */
+void GnomeCmd::XferMove::remove_batch(vector<Copied> &batch)
+{
+    vector<bool> verified(batch.size());
+    set<string> parents;
+
+    for (size_t i=0; i<batch.size(); ++i)
+    {
+        struct stat src_st, dest_st;
+
+        if (lstat (batch[i].src.c_str(), &src_st) != 0 || lstat (batch[i].dest.c_str(), &dest_st) != 0)
+            continue;
+
+        if ((src_st.st_mode & S_IFMT) != (dest_st.st_mode & S_IFMT))
+            continue;
+
+        if (S_ISREG (src_st.st_mode) && src_st.st_size != dest_st.st_size)
+            continue;
+
+        if ((S_ISREG (dest_st.st_mode) || S_ISDIR (dest_st.st_mode)) && !sync_path (batch[i].dest, S_ISDIR (dest_st.st_mode)))
+            continue;
+
+        parents.insert(batch[i].dest.substr(0, batch[i].dest.rfind('/')));
+        verified[i] = true;
+    }
+
+    for (auto &parent : parents)
+        sync_path (parent.empty() ? "/" : parent, true);
+
+    for (size_t i=0; i<batch.size(); ++i)
+    {
+        if (!verified[i])
+            continue;
+
+        int error = remove_path (batch[i].src);
+
+        if (error)
+            failed.push_back(make_pair(batch[i].src, error));
+        else
+            removed++;
+    }
+}
+
+
+bool GnomeCmd::XferMove::report_failed()
+{
+    for (auto &f : failed)
+        for (int error = f.second; error; )
+        {
+            if (!engine.on_error)
+                return false;
+
+            switch (engine.on_error(f.first, error))
+            {
+                case GnomeCmd::ERROR_ACTION_RETRY:
+                    error = remove_path (f.first);
+                    break;
+
+                case GnomeCmd::ERROR_ACTION_SKIP:
+                    error = 0;
+                    break;
+
+                default:
+                    return false;
+            }
+        }
+
+    failed.clear();
+
+    return true;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file gnome-cmd-xfer-move.h
+ * @brief Moving local files, renaming what can be renamed.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gnome-cmd-xfer-engine.h"
+
+namespace GnomeCmd
+{
+    /**
+     * Moves local files.
+     *
+     * All items are renamed first, in one pass, which takes no time whatever
+     * their size. Those on another file system than their destination, or
+     * whose destination exists already, are copied by the XferEngine. Every
+     * file it has copied is handed to a second thread, which makes the copy
+     * durable and compares its size before it removes the source, while the
+     * engine goes on with the next file.
+     *
+     * The queue between the two is bounded, so a crash leaves at most
+     * BACKLOG files existing twice and never loses one. Sources which can't
+     * be removed are reported through the on_error function of the engine
+     * at the end.
+     */
+    class XferMove
+    {
+      public:
+
+        typedef XferEngine::Item Item;
+
+        enum
+        {
+            BACKLOG = 256,                  /**< copied files waiting for their source to be removed */
+            BATCH = 64                      /**< files synced before their sources are removed */
+        };
+
+      private:
+
+        struct Copied
+        {
+            std::string src;
+            std::string dest;
+        };
+
+        std::mutex queue_mutex;
+        std::condition_variable queue_cond; /**< signalled when the queue changes or is closed */
+        std::deque<Copied> queue;
+        bool closed {false};
+
+        std::vector<std::pair<std::string,int>> failed;     /**< sources which could not be removed, with errno */
+
+        void enqueue(const std::string &src, const std::string &dest);
+        void remove_sources();
+        void remove_batch(std::vector<Copied> &batch);
+        bool report_failed();
+
+      public:
+
+        XferEngine &engine;
+
+        std::atomic<uint64_t> renamed {0};  /**< items moved by renaming them */
+        std::atomic<uint64_t> removed {0};  /**< sources removed after copying them */
+
+        explicit XferMove(XferEngine &e): engine(e)     {}
+
+        /**
+         * Moves all items. Existing destinations are merged with or
+         * replaced by the source according to the options of the engine.
+         *
+         * @returns false if the job was aborted or cancelled
+         */
+        bool run(const std::vector<Item> &items);
+
+        /**
+         * Renames @a src to @a dest unless @a dest exists.
+         *
+         * @returns 0 or an errno value, EXDEV if they are on different file systems
+         */
+        static int rename_noreplace(const std::string &src, const std::string &dest);
+    };
+}
@@ -21,8 +21,11 @@
 
 #include <config.h>
 
+#include <vector>
+
 #include "gnome-cmd-includes.h"
 #include "gnome-cmd-xfer-progress-win.h"
+#include "gnome-cmd-progress.h"
 #include "gnome-cmd-data.h"
 #include "utils.h"
 
@@ -44,12 +47,64 @@ static void on_cancel (GtkButton *btn, GnomeCmdXferProgressWin *win)
 }
 
 
+/**
+ * Draws the bytes per second of the last minutes, scaled to the fastest
+ * second, with the newest one on the right.
+ */
+static gboolean on_graph_expose (GtkWidget *widget, GdkEventExpose *event, GnomeCmdXferProgressWin *win)
+{
+    const deque<double> &history = win->throughput->get_history();
+    gint width = widget->allocation.width;
+    gint height = widget->allocation.height;
+
+    cairo_t *cr = gdk_cairo_create (gtk_widget_get_window (widget));
+
+    gdk_cairo_region (cr, event->region);
+    cairo_clip (cr);
+
+    gdk_cairo_set_source_color (cr, &widget->style->base[GTK_STATE_NORMAL]);
+    cairo_rectangle (cr, 0, 0, width, height);
+    cairo_fill (cr);
+
+    double max = win->throughput->get_history_max();
+
+    if (history.size() > 1 && max > 0)
+    {
+        double step = (double) width / (GnomeCmd::Throughput::HISTORY - 1);
+        double x = width - (history.size() - 1) * step;
+
+        cairo_move_to (cr, x, height);
+
+        for (auto rate : history)
+        {
+            cairo_line_to (cr, x, height - rate / max * (height - 1));
+            x += step;
+        }
+
+        cairo_line_to (cr, width, height);
+        cairo_close_path (cr);
+
+        gdk_cairo_set_source_color (cr, &widget->style->bg[GTK_STATE_SELECTED]);
+        cairo_fill (cr);
+    }
+
+    cairo_destroy (cr);
+
+    return TRUE;
+}
+
+
 /*******************************
  * Gtk class implementation
  *******************************/
 
 static void destroy (GtkObject *object)
 {
+    GnomeCmdXferProgressWin *win = GNOME_CMD_XFER_PROGRESS_WIN (object);
+
+    delete win->throughput;
+    win->throughput = nullptr;
+
     if (GTK_OBJECT_CLASS (parent_class)->destroy)
         (*GTK_OBJECT_CLASS (parent_class)->destroy) (object);
 }
@@ -81,6 +136,7 @@ static void init (GnomeCmdXferProgressWin *win)
     GtkWidget *w = GTK_WIDGET (win);
 
     win->cancel_pressed = FALSE;
+    win->throughput = new GnomeCmd::Throughput;
 
     gtk_window_set_title (GTK_WINDOW (win), _("Progress"));
     gtk_window_set_policy (GTK_WINDOW (win), FALSE, FALSE, FALSE);
@@ -97,12 +153,31 @@ static void init (GnomeCmdXferProgressWin *win)
     win->fileprog_label = create_label (w, "");
     gtk_container_add (GTK_CONTAINER (vbox), win->fileprog_label);
 
+    // only shown for transfers where less data is read than the size of the files, e.g. sparse files
+    win->data_label = create_label (w, "");
+    gtk_widget_set_no_show_all (win->data_label, TRUE);
+    gtk_widget_hide (win->data_label);
+    gtk_container_add (GTK_CONTAINER (vbox), win->data_label);
+
     win->totalprog = create_progress_bar (w);
     gtk_container_add (GTK_CONTAINER (vbox), win->totalprog);
 
     win->fileprog = create_progress_bar (w);
     gtk_container_add (GTK_CONTAINER (vbox), win->fileprog);
 
+    // the rates are shown once the transfer has started
+    win->rate_label = create_label (w, "");
+    gtk_widget_set_no_show_all (win->rate_label, TRUE);
+    gtk_widget_hide (win->rate_label);
+    gtk_container_add (GTK_CONTAINER (vbox), win->rate_label);
+
+    win->graph = gtk_drawing_area_new ();
+    gtk_widget_set_size_request (win->graph, -1, 48);
+    gtk_widget_set_no_show_all (win->graph, TRUE);
+    gtk_widget_hide (win->graph);
+    g_signal_connect (win->graph, "expose-event", G_CALLBACK (on_graph_expose), win);
+    gtk_container_add (GTK_CONTAINER (vbox), win->graph);
+
     bbox = create_hbuttonbox (w);
     gtk_container_add (GTK_CONTAINER (vbox), bbox);
 
@@ -187,6 +262,67 @@ void gnome_cmd_xfer_progress_win_set_total_progress (GnomeCmdXferProgressWin *wi
 }
 
 
+/**
+ * Shows how many bytes really had to be read and written, as opposed to the
+ * logical sizes passed to gnome_cmd_xfer_progress_win_set_total_progress().
+ */
+void gnome_cmd_xfer_progress_win_set_data_progress (GnomeCmdXferProgressWin *win,
+                                                    guint64 data_copied,
+                                                    guint64 data_total)
+{
+    gchar *data_total_str = g_strdup (size2string (data_total, gnome_cmd_data.options.size_disp_mode));
+    const gchar *data_copied_str = size2string (data_copied, gnome_cmd_data.options.size_disp_mode);
+
+    gchar text[128];
+
+    g_snprintf (text, sizeof (text), _("%s of %s data written, holes skipped"), data_copied_str, data_total_str);
+
+    gtk_label_set_text (GTK_LABEL (win->data_label), text);
+    gtk_widget_show (win->data_label);
+
+    g_free (data_total_str);
+}
+
+
+/**
+ * Feeds the counters of the job into the rates and the graph of the window,
+ * called once per update of the progress.
+ */
+void gnome_cmd_xfer_progress_win_add_sample (GnomeCmdXferProgressWin *win,
+                                             guint64 bytes_done,
+                                             guint64 files_done)
+{
+    GnomeCmd::Throughput *throughput = win->throughput;
+
+    throughput->add(g_get_monotonic_time () / (gdouble) G_USEC_PER_SEC, bytes_done, files_done);
+
+    gchar *rate_str = g_strdup (size2string ((guint64) throughput->bytes_per_second(), gnome_cmd_data.options.size_disp_mode));
+    const gchar *average_str = size2string ((guint64) throughput->average_bytes_per_second(), gnome_cmd_data.options.size_disp_mode);
+
+    gchar text[256];
+
+    g_snprintf (text, sizeof (text), _("%s/s, %.0f files/s (average %s/s, %.0f files/s)"),
+                rate_str, throughput->files_per_second(), average_str, throughput->average_files_per_second());
+
+    gtk_label_set_text (GTK_LABEL (win->rate_label), text);
+    gtk_widget_show (win->rate_label);
+    gtk_widget_show (win->graph);
+    gtk_widget_queue_draw (win->graph);
+
+    g_free (rate_str);
+}
+
+
+/**
+ * Shows how far each destination of a copy to several directories is.
+ */
+void gnome_cmd_xfer_progress_win_set_dest_progress (GnomeCmdXferProgressWin *win, const gchar *string)
+{
+    gtk_label_set_text (GTK_LABEL (win->data_label), string);
+    gtk_widget_show (win->data_label);
+}
+
+
 void gnome_cmd_xfer_progress_win_set_msg (GnomeCmdXferProgressWin *win, const gchar *string)
 {
     gtk_label_set_text (GTK_LABEL (win->msg_label), string);
@@ -197,3 +333,90 @@ void gnome_cmd_xfer_progress_win_set_action (GnomeCmdXferProgressWin *win, const
 {
     gtk_window_set_title (GTK_WINDOW (win), string);
 }
+
+
+/***********************************
+ * Progress updates
+ ***********************************/
+
+/**
+ * The progress of all running jobs is updated from a single timer, which
+ * calls their update functions in turn. Once the time of a frame is used up,
+ * the remaining jobs wait for the next tick, so that many parallel transfers
+ * can't starve the main loop.
+ *
+ * An update function may run a dialog and so the main loop, which can call
+ * the timer again; the job is skipped then, and jobs are removed by the
+ * outermost call only.
+ */
+struct ProgressJob
+{
+    GSourceFunc update_func;
+    gpointer data;
+    gboolean busy;
+    gboolean finished;
+};
+
+static vector<ProgressJob *> progress_jobs;
+static size_t next_progress_job = 0;
+static guint progress_timeout = 0;
+static gint progress_depth = 0;
+
+
+static gboolean update_progress_jobs (gpointer)
+{
+    gint64 deadline = g_get_monotonic_time () + gnome_cmd_data.gui_update_rate * 1000 / 2;
+    vector<ProgressJob *> jobs = progress_jobs;
+
+    ++progress_depth;
+
+    for (size_t i=0; i<jobs.size(); ++i)
+    {
+        ProgressJob *job = jobs[(next_progress_job + i) % jobs.size()];
+
+        if (job->busy || job->finished)
+            continue;
+
+        if (i > 0 && g_get_monotonic_time () > deadline)
+        {
+            next_progress_job += i;
+            break;
+        }
+
+        job->busy = TRUE;
+        job->finished = !job->update_func (job->data);
+        job->busy = FALSE;
+    }
+
+    if (--progress_depth > 0)
+        return TRUE;
+
+    for (auto it=progress_jobs.begin(); it!=progress_jobs.end(); )
+        if ((*it)->finished)
+        {
+            delete *it;
+            it = progress_jobs.erase(it);
+        }
+        else
+            ++it;
+
+    if (!progress_jobs.empty())
+        return TRUE;
+
+    next_progress_job = 0;
+    progress_timeout = 0;
+
+    return FALSE;
+}
+
+
+/**
+ * Calls @a update_func with @a data at the GUI update rate until it returns FALSE.
+ */
+void gnome_cmd_progress_add_job (GSourceFunc update_func, gpointer data)
+{
+    progress_jobs.push_back(new ProgressJob {update_func, data, FALSE, FALSE});
+
+    if (!progress_timeout)
+        progress_timeout = g_timeout_add (gnome_cmd_data.gui_update_rate, update_progress_jobs, nullptr);
+}
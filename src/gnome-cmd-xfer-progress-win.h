@@ -21,6 +21,11 @@
 
 #pragma once
 
+namespace GnomeCmd
+{
+    class Throughput;
+}
+
 #define GNOME_CMD_TYPE_XFER_PROGRESS_WIN              (gnome_cmd_xfer_progress_win_get_type ())
 #define GNOME_CMD_XFER_PROGRESS_WIN(obj)              (G_TYPE_CHECK_INSTANCE_CAST((obj), GNOME_CMD_TYPE_XFER_PROGRESS_WIN, GnomeCmdXferProgressWin))
 #define GNOME_CMD_XFER_PROGRESS_WIN_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST((klass), GNOME_CMD_TYPE_XFER_PROGRESS_WIN, GnomeCmdXferProgressWinClass))
@@ -37,6 +42,11 @@ struct GnomeCmdXferProgressWin
     GtkWidget *fileprog;
     GtkWidget *msg_label;
     GtkWidget *fileprog_label;
+    GtkWidget *data_label;
+    GtkWidget *rate_label;
+    GtkWidget *graph;
+
+    GnomeCmd::Throughput *throughput;
 
     gboolean cancel_pressed;
 };
@@ -58,6 +68,18 @@ void gnome_cmd_xfer_progress_win_set_total_progress (GnomeCmdXferProgressWin *wi
                                                      GnomeVFSFileSize bytes_copied,
                                                      GnomeVFSFileSize bytes_total);
 
+void gnome_cmd_xfer_progress_win_set_data_progress (GnomeCmdXferProgressWin *win,
+                                                    guint64 data_copied,
+                                                    guint64 data_total);
+
+void gnome_cmd_xfer_progress_win_add_sample (GnomeCmdXferProgressWin *win,
+                                             guint64 bytes_done,
+                                             guint64 files_done);
+
+void gnome_cmd_xfer_progress_win_set_dest_progress (GnomeCmdXferProgressWin *win, const gchar *string);
+
 void gnome_cmd_xfer_progress_win_set_msg (GnomeCmdXferProgressWin *win, const gchar *string);
 
 void gnome_cmd_xfer_progress_win_set_action (GnomeCmdXferProgressWin *win, const gchar *string);
+
+void gnome_cmd_progress_add_job (GSourceFunc update_func, gpointer data);
@@ -0,0 +1,464 @@
+/**
+ * @file gnome-cmd-xfer-segments.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+#include "gnome-cmd-xfer-segments.h"
+#include "gnome-cmd-xfer-journal.h"
+
+using namespace std;
+
+
+/** A range of the file fetched by one connection */
+struct GnomeCmd::SegmentedDownload::Segment
+{
+    uint64_t start {0};
+    uint64_t end {0};
+    uint64_t done {0};                      /**< bytes written from start on */
+    uint64_t saved {0};                     /**< done when the state was last written */
+};
+
+
+GnomeCmd::SegmentedDownload::SegmentedDownload(const Options &opts, const OpenFunc &open_func): options(opts), open(open_func)
+{
+}
+
+
+unsigned GnomeCmd::SegmentedDownload::count_segments(uint64_t size) const
+{
+    if (options.segments <= 1 || options.min_segment_size == 0)
+        return 1;
+
+    return (unsigned) max<uint64_t> (1, min<uint64_t> (options.segments, size / options.min_segment_size));
+}
+
+
+bool GnomeCmd::SegmentedDownload::has_state(const string &dest)
+{
+    return access (state_path(dest).c_str(), F_OK) == 0;
+}
+
+
+string GnomeCmd::SegmentedDownload::get_current_file()
+{
+    ProgressEvents::Event event;
+
+    if (file_events.pop_latest(event))
+        shown_file = move (event.path);
+
+    return shown_file;
+}
+
+
+void GnomeCmd::SegmentedDownload::fail(const Item &item, const string &message)
+{
+    lock_guard<std::mutex> lock(error_mutex);
+
+    // the first error counts, the other segments usually fail for the same reason
+    if (error.empty())
+    {
+        error = message;
+        error_file = item.src;
+    }
+}
+
+
+/**
+ * Gives the completed destination the permissions and the modification time
+ * of the source. Like gnome-vfs, a file system which can't store them keeps
+ * the file anyway.
+ */
+static void apply_attributes (int fd, const GnomeCmd::SegmentedDownload::Item &item)
+{
+    if (item.mode)
+        fchmod (fd, item.mode & 07777);
+
+    if (item.mtime)
+    {
+        struct timespec times[2];
+
+        times[0].tv_sec = 0;
+        times[0].tv_nsec = UTIME_NOW;
+        times[1].tv_sec = item.mtime;
+        times[1].tv_nsec = 0;
+
+        futimens (fd, times);
+    }
+}
+
+
+bool GnomeCmd::SegmentedDownload::run(const vector<Item> &items)
+{
+    files_total = items.size();
+    files_done = 0;
+    bytes_total = bytes_done = 0;
+    error.clear();
+    error_file.clear();
+
+    for (auto &item : items)
+        bytes_total += item.size;
+
+    for (auto &item : items)
+    {
+        // finished before the job was interrupted
+        if (journal && journal->is_done(item.src))
+        {
+            bytes_done += item.size;
+            files_done++;
+            continue;
+        }
+
+        uint64_t before = bytes_done;
+        bool ok;
+
+        while (!(ok = download (item)))
+        {
+            if (cancelled)
+                return false;
+
+            ErrorAction action = on_error ? on_error (error_file, error) : ERROR_ACTION_ABORT;
+
+            if (action == ERROR_ACTION_ABORT)
+                return false;
+
+            error.clear();
+            error_file.clear();
+
+            // a retry resumes from the state, which counts the fetched part again
+            bytes_done = action == ERROR_ACTION_RETRY ? before : before + item.size;
+
+            if (action == ERROR_ACTION_SKIP)
+            {
+                // the destination has its full size but is incomplete, keep nothing of it
+                if (has_state (item.dest))
+                {
+                    unlink (item.dest.c_str());
+                    unlink (state_path (item.dest).c_str());
+                }
+                break;
+            }
+        }
+
+        if (ok && journal)
+            journal->mark_done(item.src);
+
+        if (cancelled)
+            return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Opens the destination and its state file, continuing an interrupted
+ * download if the state matches the item, or starting over otherwise.
+ */
+bool GnomeCmd::SegmentedDownload::prepare(const Item &item, int &fd, int &state_fd, vector<Segment> &segments)
+{
+    unsigned n = count_segments (item.size);
+    string state = state_path (item.dest);
+
+    segments.assign(n, Segment());
+
+    state_fd = ::open (state.c_str(), O_RDWR | O_CLOEXEC);
+
+    if (state_fd >= 0)
+    {
+        vector<char> text((n + 1) * STATE_LINE + 1, '\0');
+        struct stat st;
+        bool valid = pread (state_fd, text.data(), text.size() - 1, 0) == (ssize_t) (text.size() - 1) &&
+                     stat (item.dest.c_str(), &st) == 0 && (uint64_t) st.st_size == item.size;
+
+        unsigned long long size = 0;
+        unsigned long long mtime = 0;
+        unsigned count = 0;
+
+        // a source which changed meanwhile is fetched again
+        valid = valid && sscanf (text.data(), "GCMD-SEGMENTS %llu %u %llu", &size, &count, &mtime) == 3 &&
+                size == item.size && count == n && mtime == item.mtime;
+
+        for (unsigned i=0; valid && i<n; ++i)
+        {
+            unsigned long long start, end, done;
+
+            valid = sscanf (text.data() + (i + 1) * STATE_LINE, "%llu %llu %llu", &start, &end, &done) == 3 &&
+                    start <= end && end <= item.size && done <= end - start;
+
+            segments[i].start = start;
+            segments[i].end = end;
+            segments[i].done = segments[i].saved = done;
+        }
+
+        if (valid && (fd = ::open (item.dest.c_str(), O_WRONLY | O_NOFOLLOW | O_CLOEXEC)) >= 0)
+            return true;
+
+        close (state_fd);
+    }
+
+    // a new download, the file gets its full size right away so that the segments can be written anywhere
+    segments.assign(n, Segment());
+
+    for (unsigned i=0; i<n; ++i)
+    {
+        segments[i].start = item.size / n * i;
+        segments[i].end = i + 1 < n ? item.size / n * (i + 1) : item.size;
+    }
+
+    fd = open_replacing (item.dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+    {
+        fail (item, strerror (errno));
+        return false;
+    }
+
+    // without a state, nothing could be continued, so the truncated file is not kept
+    if (posix_fallocate (fd, 0, item.size) != 0 && ftruncate (fd, item.size) != 0)
+    {
+        fail (item, strerror (errno));
+        close (fd);
+        unlink (item.dest.c_str());
+        return false;
+    }
+
+    state_fd = open_replacing (state.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (state_fd < 0)
+    {
+        fail (item, strerror (errno));
+        close (fd);
+        unlink (item.dest.c_str());
+        return false;
+    }
+
+    char header[STATE_LINE + 1];
+
+    snprintf (header, sizeof(header), "GCMD-SEGMENTS %llu %u %llu", (unsigned long long) item.size, n, (unsigned long long) item.mtime);
+    memset (header + strlen (header), ' ', STATE_LINE - strlen (header));
+    header[STATE_LINE - 1] = '\n';
+
+    pwrite_all (state_fd, header, STATE_LINE, 0);
+
+    for (unsigned i=0; i<n; ++i)
+        save_segment (-1, state_fd, segments[i], i);
+
+    return true;
+}
+
+
+/**
+ * Records how far @a segment got, after the data written so far has reached
+ * the disk. Without a state file, as for a file which is not split, there is
+ * nothing to record.
+ */
+void GnomeCmd::SegmentedDownload::save_segment(int fd, int state_fd, const Segment &segment, size_t index)
+{
+    if (state_fd < 0)
+        return;
+
+    if (fd >= 0)
+        fdatasync (fd);
+
+    char line[STATE_LINE + 1];
+
+    snprintf (line, sizeof(line), "%020llu %020llu %020llu", (unsigned long long) segment.start, (unsigned long long) segment.end, (unsigned long long) segment.done);
+    memset (line + strlen (line), ' ', STATE_LINE - strlen (line));
+    line[STATE_LINE - 1] = '\n';
+
+    // every segment has a line of its own, so the threads don't need to synchronize
+    pwrite_all (state_fd, line, STATE_LINE, (index + 1) * STATE_LINE);
+}
+
+
+void GnomeCmd::SegmentedDownload::fetch(const Item &item, int fd, int state_fd, Segment &segment, size_t index, atomic<bool> &failed)
+{
+    unique_ptr<Reader> reader;
+    unique_ptr<char[]> buf(new char[BLOCK_SIZE]);
+    uint64_t len = segment.end - segment.start;
+    unsigned retries = 0;
+    string message;
+
+    while (segment.done < len && !cancelled && !failed)
+    {
+        if (!reader)
+        {
+            reader.reset(open (item.src, message));
+
+            if (!reader)
+            {
+                if (++retries > RETRIES)
+                {
+                    fail (item, message);
+                    failed = true;
+                }
+                continue;
+            }
+        }
+
+        size_t want = min<uint64_t> (BLOCK_SIZE, len - segment.done);
+        size_t n = 0;
+
+        if (!reader->read(segment.start + segment.done, buf.get(), want, n, message) || n == 0)
+        {
+            if (n == 0 && message.empty())
+                message = "The file is shorter than expected";
+
+            // the connection may have been dropped, try again with a new one
+            reader.reset();
+
+            if (++retries > RETRIES)
+            {
+                fail (item, message);
+                failed = true;
+            }
+            continue;
+        }
+
+        if (!pwrite_all (fd, buf.get(), n, segment.start + segment.done))
+        {
+            fail (item, strerror (errno));
+            failed = true;
+            break;
+        }
+
+        retries = 0;
+        message.clear();
+        segment.done += n;
+        bytes_done += n;
+
+        if (segment.done - segment.saved >= STATE_FLUSH_BYTES)
+        {
+            save_segment (fd, state_fd, segment, index);
+            segment.saved = segment.done;
+        }
+    }
+
+    if (segment.done != segment.saved)
+        save_segment (fd, state_fd, segment, index);
+}
+
+
+/**
+ * Fetches a file which is not split over a single connection. There is no
+ * state to continue from, so a failed download leaves nothing behind.
+ */
+bool GnomeCmd::SegmentedDownload::download_whole(const Item &item)
+{
+    // an interrupted download with more segments, which can't be continued this way
+    unlink (state_path (item.dest).c_str());
+
+    int fd = open_replacing (item.dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+    {
+        fail (item, strerror (errno));
+        return false;
+    }
+
+    Segment segment;
+    atomic<bool> failed {false};
+
+    segment.end = item.size;
+
+    fetch (item, fd, -1, segment, 0, failed);
+
+    bool ok = !failed && !cancelled;
+
+    if (ok)
+        apply_attributes (fd, item);
+
+    if (close (fd) != 0 && ok)
+    {
+        fail (item, strerror (errno));
+        ok = false;
+    }
+
+    if (!ok)
+    {
+        unlink (item.dest.c_str());
+        return false;
+    }
+
+    files_done++;
+
+    return true;
+}
+
+
+bool GnomeCmd::SegmentedDownload::download(const Item &item)
+{
+    file_events.push(item.src);
+
+    if (count_segments (item.size) < 2)
+        return download_whole (item);
+
+    vector<Segment> segments;
+    int fd, state_fd;
+
+    if (!prepare (item, fd, state_fd, segments))
+        return false;
+
+    // what a previous run has fetched counts as done
+    for (auto &segment : segments)
+        bytes_done += segment.done;
+
+    atomic<bool> failed {false};
+    vector<thread> threads;
+
+    for (size_t i=1; i<segments.size(); ++i)
+        threads.emplace_back(&SegmentedDownload::fetch, this, cref(item), fd, state_fd, ref(segments[i]), i, ref(failed));
+
+    fetch (item, fd, state_fd, segments[0], 0, failed);
+
+    for (auto &t : threads)
+        t.join();
+
+    bool ok = !failed && !cancelled;
+
+    if (ok)
+        apply_attributes (fd, item);
+
+    if (close (fd) != 0 && ok)
+    {
+        fail (item, strerror (errno));
+        ok = false;
+    }
+
+    close (state_fd);
+
+    if (!ok)
+        return false;
+
+    unlink (state_path (item.dest).c_str());
+    files_done++;
+
+    return true;
+}
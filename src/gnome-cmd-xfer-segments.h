@@ -0,0 +1,162 @@
+/**
+ * @file gnome-cmd-xfer-segments.h
+ * @brief Downloading large remote files in several segments at once.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gnome-cmd-file-io.h"
+#include "gnome-cmd-progress.h"
+
+namespace GnomeCmd
+{
+    class XferJournal;
+
+    /**
+     * Downloads files by splitting them into segments which are fetched over
+     * separate connections at the same time, each one written with pwrite()
+     * into its place of the preallocated destination file.
+     *
+     * A single stream over a link with a high latency rarely fills the
+     * bandwidth, several of them do. How far every segment got is kept in a
+     * small state file next to the destination, so that an interrupted
+     * download continues where each segment stopped when it is started
+     * again. The connections are opened by a callback, which keeps this class
+     * independent of gnome-vfs.
+     */
+    class SegmentedDownload
+    {
+      public:
+
+        /** Remote errors come as messages, not as errno values */
+        typedef std::function<ErrorAction (const std::string &src, const std::string &error)> ErrorFunc;
+
+        /** A connection to the remote file, used by one segment at a time */
+        class Reader
+        {
+          public:
+
+            virtual ~Reader()   {}
+
+            /**
+             * Reads up to @a len bytes at @a offset.
+             *
+             * @returns false on errors, with @a error describing it
+             */
+            virtual bool read(uint64_t offset, char *buf, size_t len, size_t &n, std::string &error) = 0;
+        };
+
+        /** @returns a new connection to @a src, or nullptr with @a error set */
+        typedef std::function<Reader *(const std::string &src, std::string &error)> OpenFunc;
+
+        struct Item
+        {
+            std::string src;                /**< passed to the OpenFunc */
+            std::string dest;               /**< local path */
+            uint64_t size;
+            uint64_t mtime;                 /**< of the source, an interrupted download is continued only if it did not change */
+            uint32_t mode;                  /**< permissions of the source, 0 if unknown */
+        };
+
+        enum
+        {
+            BLOCK_SIZE = 1 << 20,           /**< read by a segment at a time */
+            RETRIES = 3,                    /**< reconnects per segment before the download fails */
+            STATE_FLUSH_BYTES = 16 << 20,   /**< update the state of a segment at least this often */
+            STATE_LINE = 64                 /**< every line of the state file has this length */
+        };
+
+        struct Options
+        {
+            unsigned segments {4};          /**< maximum number of connections per file */
+            uint64_t min_segment_size {8 << 20};
+        };
+
+      private:
+
+        struct Segment;
+
+        std::atomic<bool> cancelled {false};
+
+        std::mutex error_mutex;
+
+        ProgressEvents file_events;
+        std::string shown_file;             /**< belongs to the GUI thread */
+
+        bool download(const Item &item);
+        bool download_whole(const Item &item);
+        bool prepare(const Item &item, int &fd, int &state_fd, std::vector<Segment> &segments);
+        void fetch(const Item &item, int fd, int state_fd, Segment &segment, size_t index, std::atomic<bool> &failed);
+        void save_segment(int fd, int state_fd, const Segment &segment, size_t index);
+        void fail(const Item &item, const std::string &message);
+
+      public:
+
+        Options options;
+        OpenFunc open;
+
+        std::atomic<uint64_t> files_total {0};
+        std::atomic<uint64_t> files_done {0};
+        std::atomic<uint64_t> bytes_total {0};
+        std::atomic<uint64_t> bytes_done {0};
+
+        std::string error;                  /**< why the download failed */
+        std::string error_file;             /**< the source which failed */
+
+        ErrorFunc on_error;                 /**< asked when a file fails, the job is aborted if not set */
+        XferJournal *journal {nullptr};     /**< optional, records the finished files of the job */
+
+        SegmentedDownload(const Options &opts, const OpenFunc &open_func);
+
+        /** @returns the number of segments a file of @a size is split into */
+        unsigned count_segments(uint64_t size) const;
+
+        /**
+         * Downloads all items, replacing their destinations unless they were
+         * interrupted before, which are continued. Retrying a failed file
+         * continues it as well, skipping it removes what has been fetched.
+         * A file which is not split is fetched in one go, without a state.
+         * Files the journal has as finished are left out.
+         *
+         * @returns false if the job was aborted or cancelled, the state of
+         * the failed file is kept for resuming it
+         */
+        bool run(const std::vector<Item> &items);
+
+        /** Called by the GUI thread */
+        std::string get_current_file();
+
+        void cancel()                       {  cancelled = true;  }
+        bool is_cancelled() const           {  return cancelled;  }
+
+        /** @returns the path of the file recording the segments of @a dest */
+        static std::string state_path(const std::string &dest)     {  return dest + ".gcmd-segments";  }
+
+        /** @returns true if there is an interrupted download of @a dest to continue */
+        static bool has_state(const std::string &dest);
+    };
+}
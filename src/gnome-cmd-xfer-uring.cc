@@ -0,0 +1,510 @@
+/**
+ * @file gnome-cmd-xfer-uring.cc
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include "gnome-cmd-xfer-uring.h"
+
+using namespace std;
+
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+struct GnomeCmd::XferUring::Ring
+{
+    int fd {-1};
+
+    void *sq_ptr {MAP_FAILED};
+    size_t sq_len {0};
+    void *cq_ptr {MAP_FAILED};
+    size_t cq_len {0};
+    struct io_uring_sqe *sqes {(struct io_uring_sqe *) MAP_FAILED};
+    size_t sqes_len {0};
+
+    unsigned *sq_head {nullptr};
+    unsigned *sq_tail {nullptr};
+    unsigned *sq_mask {nullptr};
+    unsigned *sq_array {nullptr};
+    unsigned sq_entries {0};
+    unsigned sqe_tail {0};          /**< next free SQE, published to the kernel on submit */
+    unsigned to_submit {0};
+
+    unsigned *cq_head {nullptr};
+    unsigned *cq_tail {nullptr};
+    unsigned *cq_mask {nullptr};
+    struct io_uring_cqe *cqes {nullptr};
+
+    ~Ring();
+
+    int setup(unsigned entries);
+    unsigned free_sqes();
+    struct io_uring_sqe *get_sqe();
+    int enter(unsigned min_complete);
+};
+
+
+GnomeCmd::XferUring::Ring::~Ring()
+{
+    if (sqes != MAP_FAILED)
+        munmap (sqes, sqes_len);
+
+    if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+        munmap (cq_ptr, cq_len);
+
+    if (sq_ptr != MAP_FAILED)
+        munmap (sq_ptr, sq_len);
+
+    if (fd >= 0)
+        close (fd);
+}
+
+
+int GnomeCmd::XferUring::Ring::setup(unsigned entries)
+{
+    struct io_uring_params p;
+
+    memset (&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CLAMP;
+
+    fd = syscall (__NR_io_uring_setup, entries, &p);
+
+    if (fd < 0)
+        return errno;
+
+    sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        sq_len = cq_len = max (sq_len, cq_len);
+
+    sq_ptr = mmap (nullptr, sq_len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+    if (sq_ptr == MAP_FAILED)
+        return errno;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        cq_ptr = sq_ptr;
+    else
+    {
+        cq_ptr = mmap (nullptr, cq_len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+
+        if (cq_ptr == MAP_FAILED)
+            return errno;
+    }
+
+    sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = (struct io_uring_sqe *) mmap (nullptr, sqes_len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+
+    if (sqes == MAP_FAILED)
+        return errno;
+
+    char *sq = (char *) sq_ptr;
+    char *cq = (char *) cq_ptr;
+
+    sq_head = (unsigned *) (sq + p.sq_off.head);
+    sq_tail = (unsigned *) (sq + p.sq_off.tail);
+    sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+    sq_array = (unsigned *) (sq + p.sq_off.array);
+    sq_entries = p.sq_entries;
+    sqe_tail = *sq_tail;
+
+    cq_head = (unsigned *) (cq + p.cq_off.head);
+    cq_tail = (unsigned *) (cq + p.cq_off.tail);
+    cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+    return 0;
+}
+
+
+unsigned GnomeCmd::XferUring::Ring::free_sqes()
+{
+    return sq_entries - (sqe_tail - __atomic_load_n (sq_head, __ATOMIC_ACQUIRE));
+}
+
+
+struct io_uring_sqe *GnomeCmd::XferUring::Ring::get_sqe()
+{
+    if (free_sqes() == 0)
+        return nullptr;
+
+    unsigned index = sqe_tail & *sq_mask;
+    struct io_uring_sqe *sqe = &sqes[index];
+
+    memset (sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    ++sqe_tail;
+    ++to_submit;
+
+    return sqe;
+}
+
+
+/**
+ * Hands all prepared SQEs to the kernel and waits for @a min_complete completions.
+ *
+ * @returns 0 or an errno value
+ */
+int GnomeCmd::XferUring::Ring::enter(unsigned min_complete)
+{
+    __atomic_store_n (sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+    for (;;)
+    {
+        int ret = syscall (__NR_io_uring_enter, fd, to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+
+        if (ret >= 0)
+        {
+            to_submit -= min<unsigned> (ret, to_submit);
+            return 0;
+        }
+
+        if (errno != EINTR)
+            return errno;
+    }
+}
+
+#else
+
+struct GnomeCmd::XferUring::Ring
+{
+};
+
+#endif
+
+
+GnomeCmd::XferUring::XferUring(unsigned depth, unsigned block)
+{
+    queue_depth = min<unsigned> (max<unsigned> (depth, 1), MAX_QUEUE_DEPTH);
+    // O_DIRECT friendly, and a multiple of any sane page size
+    block_size = max<unsigned> (block & ~4095U, 4096);
+}
+
+
+GnomeCmd::XferUring::~XferUring()
+{
+    // the kernel may still read into or write from the buffers of blocks in flight, rather leak them then
+    bool drained = drain();
+
+    delete ring;
+
+    if (drained)
+        free (buffers);
+}
+
+
+int GnomeCmd::XferUring::init()
+{
+#ifdef HAVE_LINUX_IO_URING_H
+    if (ring)
+        return 0;
+
+    ring = new Ring;
+
+    // every block needs two SQEs, the read and the linked write
+    int error = ring->setup(queue_depth * 2);
+
+    if (!error && ring->sq_entries < 2)
+        error = EINVAL;
+
+    if (error)
+    {
+        delete ring;
+        ring = nullptr;
+        return error;
+    }
+
+    queue_depth = min (queue_depth, ring->sq_entries / 2);
+
+    if (posix_memalign ((void **) &buffers, 4096, (size_t) queue_depth * block_size) != 0)
+    {
+        delete ring;
+        ring = nullptr;
+        buffers = nullptr;
+        return ENOMEM;
+    }
+
+    slots.assign(queue_depth, Slot());
+
+    vector<struct iovec> iovs(queue_depth);
+
+    for (unsigned i=0; i<queue_depth; ++i)
+    {
+        iovs[i].iov_base = buffers + (size_t) i * block_size;
+        iovs[i].iov_len = block_size;
+    }
+
+    // registering pins the buffers, which may exceed RLIMIT_MEMLOCK - plain reads and writes work as well
+    fixed_buffers = syscall (__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, iovs.data(), queue_depth) == 0;
+
+    return 0;
+#else
+    return ENOSYS;
+#endif
+}
+
+
+bool GnomeCmd::XferUring::available()
+{
+    static int result = -1;
+
+    if (result < 0)
+    {
+        XferUring probe(1, 4096);
+
+        result = probe.init() == 0;
+    }
+
+    return result;
+}
+
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+bool GnomeCmd::XferUring::queue_slot(unsigned index, int src_fd, int dest_fd)
+{
+    Slot &slot = slots[index];
+    char *buf = buffers + (size_t) index * block_size;
+
+    if (ring->free_sqes() < 2)
+        return false;
+
+    struct io_uring_sqe *read_sqe = ring->get_sqe();
+    struct io_uring_sqe *write_sqe = ring->get_sqe();
+
+    read_sqe->opcode = fixed_buffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    read_sqe->fd = src_fd;
+    read_sqe->off = slot.offset;
+    read_sqe->addr = (uint64_t) (uintptr_t) buf;
+    read_sqe->len = slot.len;
+    read_sqe->buf_index = index;
+    read_sqe->flags = IOSQE_IO_LINK;
+    read_sqe->user_data = (uint64_t) index << 1;
+
+    write_sqe->opcode = fixed_buffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    write_sqe->fd = dest_fd;
+    write_sqe->off = slot.offset;
+    write_sqe->addr = (uint64_t) (uintptr_t) buf;
+    write_sqe->len = slot.len;
+    write_sqe->buf_index = index;
+    write_sqe->user_data = ((uint64_t) index << 1) | 1;
+
+    slot.pending = 2;
+
+    return true;
+}
+
+
+/**
+ * Checks the results of a completed slot. A short read breaks the link and
+ * cancels the write, a short write leaves a gap - both are rare, the rest of
+ * the block is copied synchronously then.
+ *
+ * @returns 0 or an errno value
+ */
+int GnomeCmd::XferUring::finish_slot(Slot &slot, int src_fd, int dest_fd, char *buf)
+{
+    if (slot.read_res < 0)
+        return -slot.read_res;
+
+    if (slot.write_res < 0 && slot.write_res != -ECANCELED)
+        return -slot.write_res;
+
+    if (slot.read_res == (int) slot.len && slot.write_res == (int) slot.len)
+        return 0;
+
+    uint32_t done = slot.write_res > 0 ? slot.write_res : 0;
+
+    while (done < slot.len)
+    {
+        ssize_t n = pread (src_fd, buf, slot.len-done, slot.offset+done);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n < 0)
+            return errno;
+
+        if (n == 0)                 // the source shrank meanwhile
+            return 0;
+
+        for (ssize_t written = 0; written < n; )
+        {
+            ssize_t w = pwrite (dest_fd, buf+written, n-written, slot.offset+done+written);
+
+            if (w < 0 && errno == EINTR)
+                continue;
+
+            if (w < 0)
+                return errno;
+
+            written += w;
+        }
+
+        done += n;
+    }
+
+    return 0;
+}
+
+#endif
+
+
+/**
+ * Waits for the completions of all blocks still in flight and discards them.
+ *
+ * @returns false if the ring failed meanwhile, the buffers may still be in use then
+ */
+bool GnomeCmd::XferUring::drain()
+{
+#ifdef HAVE_LINUX_IO_URING_H
+    if (!ring)
+        return true;
+
+    for (;;)
+    {
+        bool pending = false;
+
+        for (auto &slot : slots)
+            pending = pending || slot.pending;
+
+        if (!pending)
+            return true;
+
+        if (ring->enter(1))
+            return false;
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n (ring->cq_tail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; ++head)
+        {
+            Slot &slot = slots[ring->cqes[head & *ring->cq_mask].user_data >> 1];
+
+            if (slot.pending)
+                --slot.pending;
+        }
+
+        __atomic_store_n (ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+#else
+    return true;
+#endif
+}
+
+
+int GnomeCmd::XferUring::copy(int src_fd, int dest_fd, uint64_t offset, uint64_t len,
+                              const ProgressFunc &on_progress, const atomic<bool> &cancelled)
+{
+#ifdef HAVE_LINUX_IO_URING_H
+    if (!ring)
+        return ENOSYS;
+
+    uint64_t next = offset;
+    uint64_t end = offset + len;
+    unsigned in_flight = 0;
+    int error = 0;
+
+    while ((next < end && !error) || in_flight > 0)
+    {
+        if (cancelled && !error)
+            error = ECANCELED;
+
+        // keep the queue full
+        for (unsigned i=0; i<queue_depth && next<end && !error; ++i)
+        {
+            if (slots[i].pending)
+                continue;
+
+            slots[i].offset = next;
+            slots[i].len = min<uint64_t> (block_size, end-next);
+
+            if (!queue_slot(i, src_fd, dest_fd))
+                break;
+
+            next += slots[i].len;
+            ++in_flight;
+        }
+
+        if (in_flight == 0)
+            break;
+
+        int ret = ring->enter(1);
+
+        if (ret)
+            return ret;         // the state of the ring is unknown, don't touch the buffers any more
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n (ring->cq_tail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; ++head)
+        {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            unsigned index = cqe->user_data >> 1;
+            Slot &slot = slots[index];
+
+            if (cqe->user_data & 1)
+                slot.write_res = cqe->res;
+            else
+                slot.read_res = cqe->res;
+
+            if (--slot.pending)
+                continue;
+
+            --in_flight;
+
+            int slot_error = finish_slot(slot, src_fd, dest_fd, buffers + (size_t) index * block_size);
+
+            if (slot_error && !error)
+                error = slot_error;
+
+            if (!slot_error && on_progress)
+            {
+                uint64_t done_up_to = next;
+
+                for (auto &s : slots)
+                    if (s.pending)
+                        done_up_to = min (done_up_to, s.offset);
+
+                on_progress (slot.len, done_up_to);
+            }
+        }
+
+        __atomic_store_n (ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return error;
+#else
+    return ENOSYS;
+#endif
+}
@@ -0,0 +1,107 @@
+/**
+ * @file gnome-cmd-xfer-uring.h
+ * @brief Asynchronous file data copying with io_uring.
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+namespace GnomeCmd
+{
+    /**
+     * Copies file data through an io_uring instance. Up to queue_depth blocks
+     * are in flight at the same time, each one as a fixed buffer read linked
+     * to the write of the same buffer, so the kernel starts the write as soon
+     * as the read has completed without a round trip to user space.
+     *
+     * The ring is talked to with the raw system calls, there is no dependency
+     * on liburing. If the kernel (or a seccomp filter) does not allow io_uring,
+     * init() fails and the caller has to use another way to copy.
+     */
+    class XferUring
+    {
+        struct Ring;
+
+        /** One block in flight: a read into the buffer of the slot and the linked write from it */
+        struct Slot
+        {
+            uint64_t offset {0};
+            uint32_t len {0};
+            int read_res {0};
+            int write_res {0};
+            unsigned pending {0};               /**< completions still to come, the slot is free at 0 */
+        };
+
+        Ring *ring {nullptr};
+        std::vector<Slot> slots;
+        unsigned queue_depth;
+        unsigned block_size;
+        char *buffers {nullptr};
+        bool fixed_buffers {false};             /**< buffers could be registered with the ring */
+
+        bool queue_slot(unsigned slot, int src_fd, int dest_fd);
+        int finish_slot(Slot &slot, int src_fd, int dest_fd, char *buf);
+        bool drain();
+
+      public:
+
+        enum
+        {
+            DEFAULT_QUEUE_DEPTH = 32,
+            MAX_QUEUE_DEPTH = 1024,
+            DEFAULT_BLOCK_SIZE = 1 << 20
+        };
+
+        /** Gets the size of a completed block and the offset up to which all blocks are complete */
+        typedef std::function<void (uint64_t bytes, uint64_t done_up_to)> ProgressFunc;
+
+        explicit XferUring(unsigned depth=DEFAULT_QUEUE_DEPTH, unsigned block=DEFAULT_BLOCK_SIZE);
+        ~XferUring();
+
+        /**
+         * Sets up the ring and registers the buffers.
+         *
+         * @returns 0 or an errno value, ENOSYS and EPERM mean that io_uring can't be used at all
+         */
+        int init();
+
+        /** Checks once per process whether io_uring can be set up. */
+        static bool available();
+
+        unsigned get_queue_depth() const        {  return queue_depth;  }
+        unsigned get_block_size() const         {  return block_size;  }
+
+        /**
+         * Copies @a len bytes at @a offset from @a src_fd to the same offset in
+         * @a dest_fd. @a on_progress is called for every completed block, blocks
+         * may complete out of order.
+         *
+         * After any error but ECANCELED blocks may still be in flight, the ring
+         * must not be used for another copy then.
+         *
+         * @returns 0 or an errno value, ECANCELED if @a cancelled was set
+         */
+        int copy(int src_fd, int dest_fd, uint64_t offset, uint64_t len,
+                 const ProgressFunc &on_progress, const std::atomic<bool> &cancelled);
+    };
+}
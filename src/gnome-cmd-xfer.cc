@@ -21,9 +21,18 @@
 
 #include <config.h>
 #include <unistd.h>
+#include <algorithm>
 
 #include "gnome-cmd-includes.h"
+#include "gnome-cmd-batch.h"
 #include "gnome-cmd-xfer.h"
+#include "gnome-cmd-xfer-journal.h"
+#include "gnome-cmd-xfer-engine.h"
+#include "gnome-cmd-xfer-fanout.h"
+#include "gnome-cmd-tar-upload.h"
+#include "gnome-cmd-xfer-segments.h"
+#include "gnome-cmd-xfer-move.h"
+#include "gnome-cmd-free-space.h"
 #include "gnome-cmd-file-selector.h"
 #include "gnome-cmd-file-list.h"
 #include "gnome-cmd-dir.h"
@@ -31,16 +40,22 @@
 #include "gnome-cmd-main-win.h"
 #include "gnome-cmd-data.h"
 #include "utils.h"
+#include "dialogs/gnome-cmd-xfer-conflicts-dialog.h"
 
 using namespace std;
 
 
 #define XFER_PRIORITY GNOME_VFS_PRIORITY_DEFAULT
 
+#define RESUME_TAIL_BLOCK_SIZE  65536U
+#define RESUME_BUFFER_SIZE      (1024U * 1024U)
+
 
 struct XferData
 {
     GnomeVFSXferOptions xferOptions;
+    GnomeVFSXferOverwriteMode xferOverwriteMode;
+    GnomeCmdXferFlags xferFlags;
     GnomeVFSAsyncHandle *handle;
 
     // Source and target uri's. The first src_uri should be transfered to the first dest_uri and so on...
@@ -74,6 +89,32 @@ struct XferData
     gboolean done;
     gboolean aborted;
 
+    // Used for resuming an interrupted transfer
+    GnomeCmd::XferJournal *journal;
+    gint resuming;              // the partially copied file is continued, the xfer has not been started yet
+    gint resume_done;
+    gint resume_claimed;        // set by whichever comes first, the end of resume_partial_file or a cancel
+    gboolean interrupted;       // the transfer was aborted on an error, keep the journal
+
+    // Used for copies between local file systems, which bypass gnome-vfs
+    GnomeCmd::XferEngine *engine;
+
+    // Used for local moves, wraps engine
+    GnomeCmd::XferMove *move;
+
+    // Used for copies into several local directories at once, instead of engine
+    GnomeCmd::XferFanout *fanout;
+
+    // Used for uploads to SSH servers, packed into a tar stream
+    GnomeCmd::TarUpload *tar_upload;
+
+    // Used for downloads of large remote files over several connections
+    GnomeCmd::SegmentedDownload *download;
+
+    gboolean vfs_fallback;      // tar_upload or download can't be used for the job, continue with gnome-vfs
+
+    // Set when the overwrite conflicts have been resolved before the transfer started
+    GnomeCmd::XferConflictRules *conflict_rules;
 };
 
 
@@ -92,6 +133,13 @@ inline void free_xfer_data (XferData *data)
     }
 
     g_list_free (data->dest_uri_list);
+    delete data->move;
+    delete data->engine;
+    delete data->fanout;
+    delete data->tar_upload;
+    delete data->download;
+    delete data->conflict_rules;
+    delete data->journal;
     g_free (data);
 }
 
@@ -123,6 +171,18 @@ create_xfer_data (GnomeVFSXferOptions xferOptions, GList *src_uri_list, GList *d
     data->on_completed_data = on_completed_data;
     data->done = FALSE;
     data->aborted = FALSE;
+    data->journal = nullptr;
+    data->resuming = FALSE;
+    data->resume_done = FALSE;
+    data->resume_claimed = FALSE;
+    data->interrupted = FALSE;
+    data->engine = nullptr;
+    data->move = nullptr;
+    data->fanout = nullptr;
+    data->tar_upload = nullptr;
+    data->download = nullptr;
+    data->vfs_fallback = FALSE;
+    data->conflict_rules = nullptr;
 
     //ToDo: Fix this to complete migration from gnome-vfs to gvfs
     // If this is a move-operation, determine totals
@@ -156,6 +216,145 @@ inline gchar *file_details(const gchar *text_uri)
 }
 
 
+/**
+ * Asks whether @a target_name is to be overwritten, must be called with the GDK lock held.
+ *
+ * @returns the chosen GnomeVFSXferOverwriteAction
+ */
+static gint run_overwrite_dialog (XferData *data, const gchar *source_name, const gchar *target_name)
+{
+    gchar *s = nullptr;
+    // Check if the src uri is from local ('file:///...'). If not, just use the base name.
+    if ( !(s = gnome_vfs_get_local_path_from_uri (source_name) )) s = str_uri_basename (source_name);
+    gchar *t = gnome_cmd_dir_is_local (data->to_dir) ? gnome_vfs_get_local_path_from_uri (target_name) : str_uri_basename (target_name);
+
+    gchar *source_filename = get_utf8 (s);
+    gchar *target_filename = get_utf8 (t);
+
+    g_free (s);
+    g_free (t);
+
+    gchar *source_details = file_details (source_name);
+    gchar *target_details = file_details (target_name);
+
+    gchar *text = g_strdup_printf (_("Overwrite file:\n\n<b>%s</b>\n<span color='dimgray' size='smaller'>%s</span>\n\nWith:\n\n<b>%s</b>\n<span color='dimgray' size='smaller'>%s</span>"), target_filename, target_details, source_filename, source_details);
+
+    g_free (source_filename);
+    g_free (target_filename);
+    g_free (source_details);
+    g_free (target_details);
+
+    gint ret = run_simple_dialog (*main_win, FALSE, GTK_MESSAGE_QUESTION, text, " ",
+                     1, _("Abort"), _("Replace"), _("Replace All"), _("Skip"), _("Skip All"), nullptr);
+    g_free(text);
+
+    return ret==-1 ? 0 : ret;
+}
+
+
+/**
+ * Reports a failed transfer of @a target_name, must be called with the GDK lock held.
+ *
+ * @returns the chosen GnomeVFSXferErrorAction
+ */
+static gint run_xfer_error_dialog (XferData *data, const gchar *target_name, const gchar *error)
+{
+    gchar *t = gnome_cmd_dir_is_local (data->to_dir) ? gnome_vfs_get_local_path_from_uri (target_name) :
+                                                       str_uri_basename (target_name);
+    gchar *fn = get_utf8 (t);
+    gchar *msg = g_strdup_printf (_("Error while copying to %s\n\n%s"), fn, error);
+
+    gint ret = run_simple_dialog (*main_win, FALSE, GTK_MESSAGE_ERROR, msg, _("Transfer problem"),
+                                  -1, _("Abort"), _("Retry"), _("Skip"), nullptr);
+    g_free (msg);
+    g_free (fn);
+    g_free (t);
+    // an aborted transfer can be resumed later on
+    if (ret <= 0)
+        data->interrupted = TRUE;
+    return ret==-1 ? 0 : ret;
+}
+
+
+inline string uri_for_display (GnomeVFSURI *uri)
+{
+    gchar *s = gnome_vfs_uri_to_string (uri, GNOME_VFS_URI_HIDE_PASSWORD);
+    gchar *display = gnome_vfs_format_uri_for_display (s);
+
+    g_free (s);
+
+    return stringify (display);
+}
+
+
+/**
+ * Fills @a conflict if @a dest_uri already exists. Two directories are
+ * no conflict, they are merged.
+ */
+static gboolean get_vfs_conflict (GnomeVFSURI *src_uri, GnomeVFSURI *dest_uri, GnomeCmd::XferConflict &conflict)
+{
+    GnomeVFSFileInfo *src_info = gnome_vfs_file_info_new ();
+    GnomeVFSFileInfo *dest_info = gnome_vfs_file_info_new ();
+
+    gboolean ret = gnome_vfs_get_file_info_uri (dest_uri, dest_info, GNOME_VFS_FILE_INFO_DEFAULT) == GNOME_VFS_OK &&
+                   gnome_vfs_get_file_info_uri (src_uri, src_info, GNOME_VFS_FILE_INFO_FOLLOW_LINKS) == GNOME_VFS_OK &&
+                   !(src_info->type == GNOME_VFS_FILE_TYPE_DIRECTORY && dest_info->type == GNOME_VFS_FILE_TYPE_DIRECTORY);
+
+    if (ret)
+    {
+        conflict.src = uri_for_display (src_uri);
+        conflict.dest = uri_for_display (dest_uri);
+        conflict.src_size = src_info->size;
+        conflict.dest_size = dest_info->size;
+        conflict.src_mtime = src_info->mtime;
+        conflict.dest_mtime = dest_info->mtime;
+    }
+
+    gnome_vfs_file_info_unref (src_info);
+    gnome_vfs_file_info_unref (dest_info);
+
+    return ret;
+}
+
+
+/**
+ * Applies the conflict rules of the job to an overwrite query of gnome-vfs.
+ *
+ * @returns the GnomeVFSXferOverwriteAction, or -1 if the user has to be asked
+ */
+static gint resolve_vfs_conflict (XferData *data, const gchar *source_name, const gchar *target_name)
+{
+    GnomeVFSURI *src_uri = gnome_vfs_uri_new (source_name);
+    GnomeVFSURI *dest_uri = gnome_vfs_uri_new (target_name);
+    GnomeCmd::XferConflict conflict;
+    gint ret = -1;
+
+    if (src_uri && dest_uri && get_vfs_conflict (src_uri, dest_uri, conflict))
+        switch (data->conflict_rules->resolve(conflict))
+        {
+            case GnomeCmd::XferConflictRules::RESOLUTION_REPLACE:
+                ret = GNOME_VFS_XFER_OVERWRITE_ACTION_REPLACE;
+                break;
+
+            case GnomeCmd::XferConflictRules::RESOLUTION_SKIP:
+                ret = GNOME_VFS_XFER_OVERWRITE_ACTION_SKIP;
+                break;
+
+            default:
+                // gnome-vfs can't give nested files a new name, only top level ones are renamed up front
+                break;
+        }
+
+    if (src_uri)
+        gnome_vfs_uri_unref (src_uri);
+
+    if (dest_uri)
+        gnome_vfs_uri_unref (dest_uri);
+
+    return ret;
+}
+
+
 static gint async_xfer_callback (GnomeVFSAsyncHandle *handle, GnomeVFSXferProgressInfo *info, XferData *data)
 {
     data->cur_phase = info->phase;
@@ -182,78 +381,997 @@ static gint async_xfer_callback (GnomeVFSAsyncHandle *handle, GnomeVFSXferProgre
             data->cur_file_name = g_strdup (info->source_name);
     }
 
+    if (data->journal && info->status == GNOME_VFS_XFER_PROGRESS_STATUS_OK)
+    {
+        if (info->phase == GNOME_VFS_XFER_PHASE_FILECOMPLETED && data->cur_file_name)
+            data->journal->mark_done (data->cur_file_name);
+        else
+            if (info->phase == GNOME_VFS_XFER_PHASE_COPYING && info->source_name && info->target_name)
+                data->journal->update_partial (info->source_name, info->target_name, info->bytes_copied);
+    }
+
+    // A resumed transfer runs in query mode: files finished before the interruption are skipped
+    // without asking, for all others the overwrite mode chosen by the user is applied
+    if (info->status == GNOME_VFS_XFER_PROGRESS_STATUS_OVERWRITE && data->journal)
+    {
+        string partial_src, partial_dest;
+        guint64 partial_offset;
+
+        if (data->journal->is_done (info->source_name))
+            return GNOME_VFS_XFER_OVERWRITE_ACTION_SKIP;
+
+        if (data->journal->get_partial (partial_src, partial_dest, partial_offset) && partial_src == info->source_name)
+            return GNOME_VFS_XFER_OVERWRITE_ACTION_REPLACE;
+
+        switch (data->xferOverwriteMode)
+        {
+            case GNOME_VFS_XFER_OVERWRITE_MODE_REPLACE:
+                return GNOME_VFS_XFER_OVERWRITE_ACTION_REPLACE;
+
+            case GNOME_VFS_XFER_OVERWRITE_MODE_SKIP:
+                return GNOME_VFS_XFER_OVERWRITE_ACTION_SKIP;
+
+            default:
+                break;
+        }
+    }
+
+    if (info->status == GNOME_VFS_XFER_PROGRESS_STATUS_OVERWRITE && data->conflict_rules)
+    {
+        gint ret = resolve_vfs_conflict (data, info->source_name, info->target_name);
+
+        if (ret >= 0)
+            return ret;
+    }
+
     if (info->status == GNOME_VFS_XFER_PROGRESS_STATUS_OVERWRITE)
     {
-    gchar *s = nullptr;
-    // Check if the src uri is from local ('file:///...'). If not, just use the base name.
-    if ( !(s = gnome_vfs_get_local_path_from_uri (info->source_name) )) s = str_uri_basename (info->source_name);
-        gchar *t = gnome_cmd_dir_is_local (data->to_dir) ? gnome_vfs_get_local_path_from_uri (info->target_name) : str_uri_basename (info->target_name);
+        gdk_threads_enter ();
+        gint ret = run_overwrite_dialog (data, info->source_name, info->target_name);
+        data->prev_status = GNOME_VFS_XFER_PROGRESS_STATUS_OVERWRITE;
+        gdk_threads_leave ();
+        return ret;
+    }
+
+    if (info->status == GNOME_VFS_XFER_PROGRESS_STATUS_VFSERROR
+        && data->prev_status != GNOME_VFS_XFER_PROGRESS_STATUS_OVERWRITE)
+    {
+        gdk_threads_enter ();
+        gint ret = run_xfer_error_dialog (data, info->target_name, gnome_vfs_result_to_string (info->vfs_status));
+        data->prev_status = GNOME_VFS_XFER_PROGRESS_STATUS_VFSERROR;
+        gdk_threads_leave ();
+        return ret;
+    }
+
+    if (info->phase == GNOME_VFS_XFER_PHASE_COMPLETED)
+    {
+        main_win->focus_file_lists();
+        data->done = TRUE;
+    }
+
+    data->prev_status = info->status;
+
+    return 1;
+}
+
+
+static void start_async_xfer (XferData *data, GnomeVFSXferOverwriteMode xferOverwriteMode)
+{
+    // errors abort temporary downloads, they have no target directory to ask about
+    gnome_vfs_async_xfer (&data->handle, data->src_uri_list, data->dest_uri_list,
+                          data->xferOptions, data->to_dir ? GNOME_VFS_XFER_ERROR_MODE_QUERY : GNOME_VFS_XFER_ERROR_MODE_ABORT, xferOverwriteMode,
+                          XFER_PRIORITY,
+                          (GnomeVFSAsyncXferProgressCallback) async_xfer_callback, data,
+                          nullptr, nullptr);
+}
+
+
+/**
+ * Builds the list of items for the native engine if all sources and
+ * destinations are local files and the job is a plain copy or move.
+ *
+ * @returns FALSE if the job has to be run by gnome-vfs
+ */
+static gboolean get_local_xfer_items (XferData *data, vector<GnomeCmd::XferEngine::Item> &items)
+{
+    if (data->xferOptions & (GNOME_VFS_XFER_LINK_ITEMS | GNOME_VFS_XFER_USE_UNIQUE_NAMES))
+        return FALSE;
+
+    GList *dest = data->dest_uri_list;
+
+    for (GList *src = data->src_uri_list; src; src = src->next, dest = dest->next)
+    {
+        if (!dest)
+            return FALSE;
+
+        auto src_uri = (GnomeVFSURI *) src->data;
+        auto dest_uri = (GnomeVFSURI *) dest->data;
+
+        if (strcmp (gnome_vfs_uri_get_scheme (src_uri), "file") != 0 || strcmp (gnome_vfs_uri_get_scheme (dest_uri), "file") != 0)
+            return FALSE;
+
+        gchar *src_path = gnome_vfs_unescape_string (gnome_vfs_uri_get_path (src_uri), nullptr);
+        gchar *dest_path = gnome_vfs_unescape_string (gnome_vfs_uri_get_path (dest_uri), nullptr);
+
+        items.push_back (make_pair (stringify (src_path), stringify (dest_path)));
+    }
+
+    return TRUE;
+}
+
+
+/**
+ * @returns a native engine configured from the options of the job, or nullptr if it has to be run by gnome-vfs
+ */
+static GnomeCmd::XferEngine *create_native_engine (XferData *data)
+{
+    vector<GnomeCmd::XferEngine::Item> items;
+
+    if (!get_local_xfer_items (data, items))
+        return nullptr;
+
+    GnomeCmd::XferEngine::Options options;
+
+    options.overwrite_mode = (GnomeCmd::XferEngine::OverwriteMode) data->xferOverwriteMode;
+    options.follow_links = (data->xferOptions & GNOME_VFS_XFER_FOLLOW_LINKS) != 0;
+    options.sparse = gnome_cmd_data.options.sparse_copy;
+    options.preserve_hardlinks = (data->xferFlags & GNOME_CMD_XFER_HARDLINKS) != 0;
+    options.reflink = (data->xferFlags & GNOME_CMD_XFER_REFLINK) != 0;
+
+    if (gnome_cmd_data.options.use_io_uring)
+    {
+        options.backend = GnomeCmd::XferEngine::BACKEND_URING;
+        options.queue_depth = gnome_cmd_data.options.io_uring_queue_depth;
+    }
+
+    if (data->xferFlags & GNOME_CMD_XFER_BULK)
+        options.bulk_mode = GnomeCmd::XferEngine::BULK_ON;
+    else
+        if (!(data->xferFlags & GNOME_CMD_XFER_NO_BULK))
+        {
+            options.bulk_mode = GnomeCmd::XferEngine::BULK_AUTO;
+            options.bulk_threshold = (guint64) gnome_cmd_data.options.bulk_copy_threshold << 20;
+        }
+
+    auto engine = new GnomeCmd::XferEngine(options);
+
+    if (data->xferOptions & GNOME_VFS_XFER_REMOVESOURCE)
+        data->move = new GnomeCmd::XferMove(*engine);
+
+    return engine;
+}
+
+
+static GnomeCmd::XferEngine::OverwriteAction on_native_overwrite (XferData *data, const string &src, const string &dest)
+{
+    gchar *src_uri = gnome_vfs_get_uri_from_local_path (src.c_str());
+    gchar *dest_uri = gnome_vfs_get_uri_from_local_path (dest.c_str());
+
+    gdk_threads_enter ();
+    gint ret = run_overwrite_dialog (data, src_uri, dest_uri);
+    gdk_threads_leave ();
+
+    g_free (src_uri);
+    g_free (dest_uri);
+
+    return (GnomeCmd::XferEngine::OverwriteAction) ret;
+}
+
+
+static GnomeCmd::ErrorAction on_native_error (XferData *data, const string &path, int error)
+{
+    gchar *uri = gnome_vfs_get_uri_from_local_path (path.c_str());
+
+    gdk_threads_enter ();
+    gint ret = run_xfer_error_dialog (data, uri, g_strerror (error));
+    gdk_threads_leave ();
+
+    g_free (uri);
+
+    return (GnomeCmd::ErrorAction) ret;
+}
+
+
+/**
+ * Checks before anything is copied whether the job fits into @a dest_dir, called by the engine thread.
+ *
+ * @returns false if the transfer is not to be started
+ */
+static bool on_native_preflight (XferData *data, const string &dest_dir, guint64 bytes, guint64 files)
+{
+    GnomeCmd::FreeSpace::Space space;
+
+    // the transfer itself finds out about volumes which can't be asked
+    if (!GnomeCmd::FreeSpace::get_default().get(dest_dir, space, true))
+        return true;
+
+    GnomeCmd::FreeSpace::Verdict verdict = GnomeCmd::FreeSpace::check(space, bytes, files);
+
+    if (verdict == GnomeCmd::FreeSpace::FITS)
+        return true;
+
+    gchar *dir = get_utf8 (dest_dir.c_str());
+    gchar *msg;
+
+    switch (verdict)
+    {
+        case GnomeCmd::FreeSpace::READ_ONLY:
+            msg = g_strdup_printf (_("%s is on a read-only volume."), dir);
+            break;
+
+        case GnomeCmd::FreeSpace::TOO_FEW_INODES:
+            msg = g_strdup_printf (_("There is room for %" G_GUINT64_FORMAT " more files in %s, %" G_GUINT64_FORMAT " are to be copied."),
+                                   space.files_avail, dir, files);
+            break;
+
+        default:
+            {
+                gchar *needed = gnome_vfs_format_file_size_for_display (bytes);
+                gchar *avail = gnome_vfs_format_file_size_for_display (space.avail);
+                msg = g_strdup_printf (_("There is %s free in %s, %s are to be copied."), avail, dir, needed);
+                g_free (needed);
+                g_free (avail);
+            }
+            break;
+    }
+
+    gboolean start = FALSE;
+
+    gdk_threads_enter ();
+    if (verdict == GnomeCmd::FreeSpace::READ_ONLY)
+        run_simple_dialog (*main_win, FALSE, GTK_MESSAGE_ERROR, msg, _("Transfer problem"), -1, _("OK"), nullptr);
+    else
+        // files which are replaced free their space, so the user may know better
+        start = run_simple_dialog (*main_win, FALSE, GTK_MESSAGE_WARNING, msg, _("Not Enough Space"), 0, _("Cancel"), _("Copy Anyway"), nullptr) == 1;
+    gdk_threads_leave ();
+
+    g_free (msg);
+    g_free (dir);
+
+    return start;
+}
+
+
+static gpointer native_xfer_thread (XferData *data)
+{
+    vector<GnomeCmd::XferEngine::Item> items;
+
+    get_local_xfer_items (data, items);
+
+    data->engine->journal = data->journal;
+
+    // temporary downloads have no target directory, they are not asked about
+    if (data->to_dir)
+    {
+        data->engine->on_overwrite = [data] (const string &src, const string &dest) { return on_native_overwrite (data, src, dest); };
+        data->engine->on_error = [data] (const string &path, int error) { return on_native_error (data, path, error); };
+    }
+
+    // all conflicts are resolved up front, so that the copy runs without further questions
+    if (data->to_dir && data->xferOverwriteMode == GNOME_VFS_XFER_OVERWRITE_MODE_QUERY)
+    {
+        vector<GnomeCmd::XferConflict> conflicts = data->engine->find_conflicts(items);
+
+        if (!conflicts.empty())
+        {
+            data->conflict_rules = new GnomeCmd::XferConflictRules;
+
+            gdk_threads_enter ();
+            gboolean ok = gnome_cmd_xfer_conflicts_dialog (*main_win, conflicts, *data->conflict_rules);
+            if (!ok)
+                data->win->cancel_pressed = TRUE;
+            gdk_threads_leave ();
+
+            if (!ok)
+            {
+                // nothing has been copied, unless an interrupted job was resumed
+                if (data->journal)
+                {
+                    if (g_atomic_int_get (&data->resuming))
+                        data->journal->close();
+                    else
+                        data->journal->remove();
+                }
+                return nullptr;
+            }
+
+            data->engine->conflict_rules = data->conflict_rules;
+        }
+    }
+
+    string dest_dir;
+
+    if (data->to_dir && !items.empty())
+    {
+        dest_dir = stringify (g_path_get_dirname (items.front().second.c_str()));
+        data->engine->on_preflight = [data, &dest_dir] (guint64 bytes, guint64 files) { return on_native_preflight (data, dest_dir, bytes, files); };
+    }
+
+    if (data->move)
+        data->move->run(items);
+    else
+        data->engine->run(items);
+
+    // the volume label shows the space left after the transfer
+    if (!dest_dir.empty())
+        GnomeCmd::FreeSpace::get_default().invalidate(dest_dir);
+
+    // a cancelled transfer keeps its journal, so that it can be resumed later on
+    if (data->engine->is_cancelled())
+    {
+        if (data->journal)
+            data->journal->close();
+        return nullptr;
+    }
+
+    data->done = TRUE;
+
+    return nullptr;
+}
+
+
+/**
+ * @returns an engine copying the job into the target directory and all @a fanout_dirs,
+ * or nullptr if that is not possible
+ */
+static GnomeCmd::XferFanout *create_fanout (XferData *data, GList *fanout_dirs)
+{
+    vector<GnomeCmd::XferEngine::Item> items;
+
+    if (data->xferOptions & GNOME_VFS_XFER_REMOVESOURCE)
+        return nullptr;
+
+    if (!get_local_xfer_items (data, items) || items.empty())
+        return nullptr;
+
+    gchar *to_path = g_path_get_dirname (items.front().second.c_str());
+    vector<string> dirs {stringify (to_path)};
+
+    for (GList *i = fanout_dirs; i; i = i->next)
+    {
+        auto path = (const gchar *) i->data;
+
+        if (!g_path_is_absolute (path) || !g_file_test (path, G_FILE_TEST_IS_DIR))
+            return nullptr;
+
+        dirs.push_back (path);
+    }
+
+    GnomeCmd::XferFanout::Options options;
+
+    options.replace = data->xferOverwriteMode == GNOME_VFS_XFER_OVERWRITE_MODE_REPLACE;
+    options.follow_links = (data->xferOptions & GNOME_VFS_XFER_FOLLOW_LINKS) != 0;
+
+    return new GnomeCmd::XferFanout(options, dirs);
+}
+
+
+static gpointer fanout_xfer_thread (XferData *data)
+{
+    vector<GnomeCmd::XferEngine::Item> items;
+    vector<GnomeCmd::XferFanout::Item> fanout_items;
+
+    get_local_xfer_items (data, items);
+
+    for (auto &item : items)
+    {
+        gchar *name = g_path_get_basename (item.second.c_str());
+        fanout_items.push_back (make_pair (item.first, stringify (name)));
+    }
+
+    data->fanout->on_error = [data] (const string &path, int error) { return on_native_error (data, path, error); };
+    data->fanout->run(fanout_items);
+
+    if (!data->fanout->is_cancelled())
+        data->done = TRUE;
+
+    return nullptr;
+}
+
+
+/**
+ * Fills the fields of async_xfer_callback with the progress of the slowest
+ * destination, which sets the pace, and lists all destinations below.
+ */
+static void sync_fanout_progress (XferData *data)
+{
+    GnomeCmd::XferFanout *fanout = data->fanout;
+    string cur_file = fanout->get_current_file();
+
+    if (cur_file.empty())
+        return;
+
+    guint64 files_done = G_MAXUINT64;
+    guint64 bytes_done = G_MAXUINT64;
+    GString *status = g_string_new (nullptr);
+
+    for (auto &dest : fanout->destinations)
+    {
+        files_done = MIN (files_done, dest->files_done.load());
+        bytes_done = MIN (bytes_done, dest->bytes_done.load());
+
+        gchar *name = g_filename_display_basename (dest->dir.c_str());
+        guint percent = fanout->bytes_total > 0 ? (guint) (100.0 * dest->bytes_done / fanout->bytes_total) : 0;
+
+        g_string_append_printf (status, "%s%s: %u%%", status->len ? "    " : "", name, percent);
+        g_free (name);
+    }
+
+    data->cur_phase = GNOME_VFS_XFER_PHASE_COPYING;
+    data->files_total = fanout->files_total;
+    data->cur_file = MIN (files_done + 1, data->files_total);
+    data->file_size = 0;
+    data->bytes_copied = 0;
+    data->bytes_total = fanout->bytes_total;
+    data->total_bytes_copied = bytes_done;
+
+    g_free (data->cur_file_name);
+    data->cur_file_name = gnome_vfs_get_uri_from_local_path (cur_file.c_str());
+
+    if (data->win)
+        gnome_cmd_xfer_progress_win_set_dest_progress (data->win, status->str);
+
+    g_string_free (status, TRUE);
+}
+
+
+/**
+ * Builds the list of items for a tar upload if all sources are local files
+ * and all destinations are in the same directory on an SSH server.
+ *
+ * @returns FALSE if the job has to be run by gnome-vfs
+ */
+static gboolean get_tar_upload_items (XferData *data, vector<GnomeCmd::TarUpload::Item> &items, string &dest_dir)
+{
+    if (data->xferOptions & (GNOME_VFS_XFER_REMOVESOURCE | GNOME_VFS_XFER_LINK_ITEMS | GNOME_VFS_XFER_USE_UNIQUE_NAMES))
+        return FALSE;
+
+    GList *dest = data->dest_uri_list;
+
+    for (GList *src = data->src_uri_list; src; src = src->next, dest = dest->next)
+    {
+        if (!dest)
+            return FALSE;
+
+        auto src_uri = (GnomeVFSURI *) src->data;
+        auto dest_uri = (GnomeVFSURI *) dest->data;
+        const gchar *scheme = gnome_vfs_uri_get_scheme (dest_uri);
+
+        if (strcmp (gnome_vfs_uri_get_scheme (src_uri), "file") != 0 || (strcmp (scheme, "sftp") != 0 && strcmp (scheme, "ssh") != 0))
+            return FALSE;
+
+        gchar *src_path = gnome_vfs_unescape_string (gnome_vfs_uri_get_path (src_uri), nullptr);
+        gchar *dest_path = gnome_vfs_unescape_string (gnome_vfs_uri_get_path (dest_uri), nullptr);
+        gchar *dir = g_path_get_dirname (dest_path);
+        gchar *name = g_path_get_basename (dest_path);
+
+        g_free (dest_path);
+
+        if (items.empty())
+            dest_dir = dir;
+
+        gboolean same_dir = dest_dir == dir;
+
+        g_free (dir);
+        items.push_back (make_pair (stringify (src_path), stringify (name)));
+
+        if (!same_dir)
+            return FALSE;
+    }
+
+    return !items.empty();
+}
+
+
+/**
+ * @returns an uploader for the job through ssh, or nullptr if it has to be run by gnome-vfs
+ */
+static GnomeCmd::TarUpload *create_tar_upload (XferData *data)
+{
+    vector<GnomeCmd::TarUpload::Item> items;
+    string dest_dir;
+
+    // tar can replace or keep existing files, conflicts are found by probing the server first
+    if (data->xferOverwriteMode == GNOME_VFS_XFER_OVERWRITE_MODE_ABORT || !get_tar_upload_items (data, items, dest_dir))
+        return nullptr;
+
+    auto uri = (GnomeVFSURI *) data->dest_uri_list->data;
+    const gchar *host = gnome_vfs_uri_get_host_name (uri);
+    const gchar *user = gnome_vfs_uri_get_user_name (uri);
+
+    if (!host || !*host)
+        return nullptr;
+
+    GnomeCmd::TarUpload::Options options;
+
+    options.replace = data->xferOverwriteMode != GNOME_VFS_XFER_OVERWRITE_MODE_SKIP;
+    options.follow_links = (data->xferOptions & GNOME_VFS_XFER_FOLLOW_LINKS) != 0;
+
+    return new GnomeCmd::TarUpload(options, GnomeCmd::TarUpload::ssh_command (host, gnome_vfs_uri_get_host_port (uri), user ? user : ""), dest_dir);
+}
+
+
+/**
+ * Removes the items whose destination name is in @a existing from the job.
+ */
+static void drop_existing_items (XferData *data, const vector<string> &existing)
+{
+    GList *src = data->src_uri_list;
+    GList *dest = data->dest_uri_list;
+
+    while (src && dest)
+    {
+        GList *next_src = src->next;
+        GList *next_dest = dest->next;
+        gchar *name = gnome_vfs_uri_extract_short_name ((GnomeVFSURI *) dest->data);
+
+        if (find (existing.begin(), existing.end(), name) != existing.end())
+        {
+            gnome_vfs_uri_unref ((GnomeVFSURI *) dest->data);
+            data->src_uri_list = g_list_delete_link (data->src_uri_list, src);
+            data->dest_uri_list = g_list_delete_link (data->dest_uri_list, dest);
+        }
+
+        g_free (name);
+        src = next_src;
+        dest = next_dest;
+    }
+}
+
+
+static gpointer tar_upload_thread (XferData *data)
+{
+    vector<GnomeCmd::TarUpload::Item> items;
+    vector<string> existing;
+    string dest_dir;
+
+    get_tar_upload_items (data, items, dest_dir);
+
+    // without a shell and tar on the server, or with conflicts to ask about, gnome-vfs takes over
+    gboolean usable = data->tar_upload->probe(existing);
+
+    // with SKIP, tar would merge an existing directory file by file, which could not be
+    // told apart from what this job has written if the stream broke off
+    if (usable && data->xferOverwriteMode != GNOME_VFS_XFER_OVERWRITE_MODE_REPLACE)
+        for (auto &item : items)
+            if (find (existing.begin(), existing.end(), item.second) != existing.end())
+                if (data->xferOverwriteMode == GNOME_VFS_XFER_OVERWRITE_MODE_QUERY
+                    || (g_file_test (item.first.c_str(), G_FILE_TEST_IS_DIR) && !g_file_test (item.first.c_str(), G_FILE_TEST_IS_SYMLINK)))
+                {
+                    usable = FALSE;
+                    break;
+                }
+
+    if (!usable)
+    {
+        DEBUG ('x', "Uploading file by file: %s\n", data->tar_upload->remote_error.c_str());
+        data->vfs_fallback = TRUE;
+        return nullptr;
+    }
+
+    data->tar_upload->on_error = [data] (const string &path, int error) { return on_native_error (data, path, error); };
+
+    if (data->tar_upload->run(items))
+    {
+        data->done = TRUE;
+        return nullptr;
+    }
+
+    // a cancelled upload keeps its journal, so that gnome-vfs can resume it later on
+    if (data->tar_upload->is_cancelled())
+    {
+        if (data->journal)
+            data->journal->close();
+        return nullptr;
+    }
+
+    if (data->tar_upload->remote_error.empty())
+    {
+        // aborted on a local error
+        data->done = TRUE;
+        return nullptr;
+    }
+
+    // the stream broke off, whatever exists remotely now has been uploaded by this job
+    DEBUG ('x', "Tar upload failed, uploading file by file: %s\n", data->tar_upload->remote_error.c_str());
+
+    // the files which existed before have been skipped by tar and are left out, a
+    // truncated file of the others is replaced
+    if (data->xferOverwriteMode == GNOME_VFS_XFER_OVERWRITE_MODE_SKIP)
+    {
+        drop_existing_items (data, existing);
+
+        if (!data->src_uri_list)
+        {
+            data->done = TRUE;
+            return nullptr;
+        }
+    }
+
+    data->xferOverwriteMode = GNOME_VFS_XFER_OVERWRITE_MODE_REPLACE;
+    data->vfs_fallback = TRUE;
+
+    return nullptr;
+}
+
+
+static void sync_tar_progress (XferData *data)
+{
+    GnomeCmd::TarUpload *upload = data->tar_upload;
+    string cur_file = upload->get_current_file();
+
+    if (cur_file.empty())
+        return;
+
+    data->cur_phase = GNOME_VFS_XFER_PHASE_COPYING;
+    data->files_total = upload->files_total;
+    data->cur_file = MIN (upload->files_done + 1, data->files_total);
+    data->file_size = 0;
+    data->bytes_copied = 0;
+    data->bytes_total = upload->bytes_total;
+    data->total_bytes_copied = upload->bytes_done;
+
+    g_free (data->cur_file_name);
+    data->cur_file_name = gnome_vfs_get_uri_from_local_path (cur_file.c_str());
+}
+
+
+/** Reads ranges of a remote file, every segment of a download gets its own */
+class VfsRangeReader: public GnomeCmd::SegmentedDownload::Reader
+{
+    GnomeVFSHandle *handle;
+    guint64 pos {0};
+
+  public:
+
+    explicit VfsRangeReader(GnomeVFSHandle *h): handle(h)   {}
+    ~VfsRangeReader()                                       {  gnome_vfs_close (handle);  }
+
+    bool read(uint64_t offset, char *buf, size_t len, size_t &n, string &error) override
+    {
+        GnomeVFSResult result = GNOME_VFS_OK;
+        GnomeVFSFileSize bytes_read = 0;
+
+        // a segment reads on where it stopped, only its first read has to seek
+        if (offset != pos)
+            result = gnome_vfs_seek (handle, GNOME_VFS_SEEK_START, offset);
+
+        if (result == GNOME_VFS_OK)
+            result = gnome_vfs_read (handle, buf, len, &bytes_read);
+
+        if (result != GNOME_VFS_OK && result != GNOME_VFS_ERROR_EOF)
+        {
+            error = gnome_vfs_result_to_string (result);
+            pos = G_MAXUINT64;
+            return false;
+        }
+
+        pos = offset + bytes_read;
+        n = bytes_read;
+
+        return true;
+    }
+};
+
+
+static GnomeCmd::SegmentedDownload::Reader *open_vfs_reader (const string &src, string &error)
+{
+    GnomeVFSHandle *handle;
+    GnomeVFSResult result = gnome_vfs_open (&handle, src.c_str(), (GnomeVFSOpenMode) (GNOME_VFS_OPEN_READ | GNOME_VFS_OPEN_RANDOM));
+
+    if (result != GNOME_VFS_OK)
+    {
+        error = gnome_vfs_result_to_string (result);
+        return nullptr;
+    }
+
+    return new VfsRangeReader(handle);
+}
+
+
+/**
+ * Builds the list of items for a segmented download if all sources are
+ * remote and all destinations are local files. The sizes are filled in by
+ * probe_segmented_download, which runs outside of the GUI thread.
+ *
+ * @returns FALSE if the job has to be run by gnome-vfs
+ */
+static gboolean get_download_items (XferData *data, vector<GnomeCmd::SegmentedDownload::Item> &items)
+{
+    if (data->xferOptions & (GNOME_VFS_XFER_REMOVESOURCE | GNOME_VFS_XFER_LINK_ITEMS | GNOME_VFS_XFER_USE_UNIQUE_NAMES))
+        return FALSE;
+
+    GList *dest = data->dest_uri_list;
+
+    for (GList *src = data->src_uri_list; src; src = src->next, dest = dest->next)
+    {
+        if (!dest)
+            return FALSE;
+
+        auto src_uri = (GnomeVFSURI *) src->data;
+        auto dest_uri = (GnomeVFSURI *) dest->data;
+
+        if (gnome_vfs_uri_is_local (src_uri) || strcmp (gnome_vfs_uri_get_scheme (dest_uri), "file") != 0)
+            return FALSE;
+
+        gchar *dest_path = gnome_vfs_unescape_string (gnome_vfs_uri_get_path (dest_uri), nullptr);
+        GnomeCmd::SegmentedDownload::Item item {stringify (gnome_vfs_uri_to_string (src_uri, GNOME_VFS_URI_HIDE_NONE)), stringify (dest_path), 0, 0, 0};
+
+        items.push_back (item);
+    }
+
+    return !items.empty();
+}
+
+
+/**
+ * @returns a segmented download for the job, or nullptr if it has to be run by gnome-vfs
+ */
+static GnomeCmd::SegmentedDownload *create_segmented_download (XferData *data)
+{
+    vector<GnomeCmd::SegmentedDownload::Item> items;
+
+    if (gnome_cmd_data.options.download_segments <= 1 || data->xferOverwriteMode == GNOME_VFS_XFER_OVERWRITE_MODE_ABORT || !get_download_items (data, items))
+        return nullptr;
+
+    GnomeCmd::SegmentedDownload::Options options;
+
+    options.segments = gnome_cmd_data.options.download_segments;
+    options.min_segment_size = (guint64) gnome_cmd_data.options.download_min_segment_size << 20;
+
+    return new GnomeCmd::SegmentedDownload(options, open_vfs_reader);
+}
+
+
+/**
+ * Fills in the sizes, modification times and permissions of the items.
+ *
+ * @returns TRUE if every item is a regular file, at least one of them is large
+ * enough to be split and the server allows seeking in it
+ */
+static gboolean probe_segmented_download (GnomeCmd::SegmentedDownload *download, vector<GnomeCmd::SegmentedDownload::Item> &items)
+{
+    GnomeCmd::SegmentedDownload::Item *largest = nullptr;
+
+    for (auto &item : items)
+    {
+        GnomeVFSFileInfo *info = gnome_vfs_file_info_new ();
+        GnomeVFSResult result = gnome_vfs_get_file_info (item.src.c_str(), info, GNOME_VFS_FILE_INFO_FOLLOW_LINKS);
+        gboolean regular = result == GNOME_VFS_OK && info->type == GNOME_VFS_FILE_TYPE_REGULAR && (info->valid_fields & GNOME_VFS_FILE_INFO_FIELDS_SIZE);
+
+        item.size = info->size;
+        item.mtime = info->valid_fields & GNOME_VFS_FILE_INFO_FIELDS_MTIME ? info->mtime : 0;
+        // the access flags above the mode bits are not permissions
+        item.mode = info->valid_fields & GNOME_VFS_FILE_INFO_FIELDS_PERMISSIONS ? info->permissions & 07777 : 0;
+        gnome_vfs_file_info_unref (info);
+
+        if (!regular)
+            return FALSE;
+
+        if (!largest || item.size > largest->size)
+            largest = &item;
+    }
+
+    if (download->count_segments(largest->size) < 2)
+        return FALSE;
+
+    string error;
+    GnomeCmd::SegmentedDownload::Reader *reader = open_vfs_reader (largest->src, error);
+    char c;
+    size_t n = 0;
+    gboolean seekable = reader && reader->read(largest->size - 1, &c, 1, n, error) && n == 1;
+
+    delete reader;
+
+    return seekable;
+}
+
+
+/**
+ * Fills @a conflict if the destination of @a item already exists. Interrupted
+ * downloads are continued and files finished before are left out, neither is
+ * a conflict.
+ */
+static gboolean get_download_conflict (XferData *data, const GnomeCmd::SegmentedDownload::Item &item, GnomeCmd::XferConflict &conflict)
+{
+    struct stat st;
+
+    if (lstat (item.dest.c_str(), &st) != 0 || GnomeCmd::SegmentedDownload::has_state (item.dest) || (data->journal && data->journal->is_done(item.src)))
+        return FALSE;
+
+    GnomeVFSURI *src_uri = gnome_vfs_uri_new (item.src.c_str());
+
+    // the size and time of the source are known from the probe
+    conflict.src = src_uri ? uri_for_display (src_uri) : item.src;
+    conflict.dest = item.dest;
+    conflict.src_size = item.size;
+    conflict.dest_size = st.st_size;
+    conflict.src_mtime = item.mtime;
+    conflict.dest_mtime = st.st_mtime;
+
+    if (src_uri)
+        gnome_vfs_uri_unref (src_uri);
+
+    return TRUE;
+}
+
+
+static gpointer segmented_download_thread (XferData *data)
+{
+    vector<GnomeCmd::SegmentedDownload::Item> items;
+
+    get_download_items (data, items);
+
+    // directories, small files and servers which can't seek are left to gnome-vfs
+    if (!probe_segmented_download (data->download, items))
+    {
+        data->vfs_fallback = TRUE;
+        return nullptr;
+    }
+
+    // all conflicts are resolved up front, so that the download runs without further questions
+    vector<GnomeCmd::XferConflict> conflicts;
+    GnomeCmd::XferConflict conflict;
+
+    if (data->to_dir && data->xferOverwriteMode != GNOME_VFS_XFER_OVERWRITE_MODE_REPLACE)
+        for (auto &item : items)
+            if (get_download_conflict (data, item, conflict))
+                conflicts.push_back (conflict);
+
+    if (!conflicts.empty() && data->xferOverwriteMode == GNOME_VFS_XFER_OVERWRITE_MODE_QUERY)
+    {
+        data->conflict_rules = new GnomeCmd::XferConflictRules;
+
+        gdk_threads_enter ();
+        gboolean ok = gnome_cmd_xfer_conflicts_dialog (*main_win, conflicts, *data->conflict_rules);
+        if (!ok)
+            data->win->cancel_pressed = TRUE;
+        gdk_threads_leave ();
+
+        if (!ok)
+        {
+            // nothing has been downloaded, unless an interrupted job was resumed
+            if (data->journal)
+            {
+                if (g_atomic_int_get (&data->resuming))
+                    data->journal->close();
+                else
+                    data->journal->remove();
+            }
+            return nullptr;
+        }
+    }
+
+    vector<GnomeCmd::SegmentedDownload::Item> todo;
+
+    for (auto &item : items)
+    {
+        if (conflicts.empty() || !get_download_conflict (data, item, conflict))
+        {
+            todo.push_back (item);
+            continue;
+        }
+
+        // without rules the overwrite mode is SKIP
+        switch (data->conflict_rules ? data->conflict_rules->resolve(conflict) : GnomeCmd::XferConflictRules::RESOLUTION_SKIP)
+        {
+            case GnomeCmd::XferConflictRules::RESOLUTION_REPLACE:
+                todo.push_back (item);
+                break;
+
+            case GnomeCmd::XferConflictRules::RESOLUTION_RENAME:
+                todo.push_back (item);
+                todo.back().dest = GnomeCmd::XferConflictRules::unused_name(item.dest);
+                break;
+
+            default:
+                break;
+        }
+    }
 
-        gchar *source_filename = get_utf8 (s);
-        gchar *target_filename = get_utf8 (t);
+    // temporary downloads have no target directory, errors abort them
+    if (data->to_dir)
+        data->download->on_error = [data] (const string &src, const string &error)
+        {
+            gdk_threads_enter ();
+            gint ret = run_xfer_error_dialog (data, src.c_str(), error.c_str());
+            gdk_threads_leave ();
 
-        g_free (s);
-        g_free (t);
+            return (GnomeCmd::ErrorAction) ret;
+        };
 
-        gchar *source_details = file_details (info->source_name);
-        gchar *target_details = file_details (info->target_name);
+    data->download->journal = data->journal;
+    data->download->run(todo);
 
-        gchar *text = g_strdup_printf (_("Overwrite file:\n\n<b>%s</b>\n<span color='dimgray' size='smaller'>%s</span>\n\nWith:\n\n<b>%s</b>\n<span color='dimgray' size='smaller'>%s</span>"), target_filename, target_details, source_filename, source_details);
+    // a cancelled download keeps its journal and the states of its files, so that it can be resumed later on
+    if (data->download->is_cancelled())
+    {
+        if (data->journal)
+            data->journal->close();
+        return nullptr;
+    }
 
-        g_free (source_filename);
-        g_free (target_filename);
-        g_free (source_details);
-        g_free (target_details);
+    data->done = TRUE;
 
-        gdk_threads_enter ();
+    return nullptr;
+}
 
-        gint ret = run_simple_dialog (*main_win, FALSE, GTK_MESSAGE_QUESTION, text, " ",
-                         1, _("Abort"), _("Replace"), _("Replace All"), _("Skip"), _("Skip All"), nullptr);
-        g_free(text);
 
-        data->prev_status = GNOME_VFS_XFER_PROGRESS_STATUS_OVERWRITE;
-        gdk_threads_leave ();
-        return ret==-1 ? 0 : ret;
-    }
+static void sync_download_progress (XferData *data)
+{
+    GnomeCmd::SegmentedDownload *download = data->download;
+    string cur_file = download->get_current_file();
+
+    if (cur_file.empty())
+        return;
+
+    data->cur_phase = GNOME_VFS_XFER_PHASE_COPYING;
+    data->files_total = download->files_total;
+    data->cur_file = MIN (download->files_done + 1, data->files_total);
+    data->file_size = 0;
+    data->bytes_copied = 0;
+    data->bytes_total = download->bytes_total;
+    data->total_bytes_copied = download->bytes_done;
+
+    g_free (data->cur_file_name);
+    data->cur_file_name = g_strdup (cur_file.c_str());
+}
 
-    if (info->status == GNOME_VFS_XFER_PROGRESS_STATUS_VFSERROR
-        && data->prev_status != GNOME_VFS_XFER_PROGRESS_STATUS_OVERWRITE)
-    {
-        const gchar *error = gnome_vfs_result_to_string (info->vfs_status);
-        gchar *t = gnome_cmd_dir_is_local (data->to_dir) ? gnome_vfs_get_local_path_from_uri (info->target_name) :
-                                                           str_uri_basename (info->target_name);
-        gchar *fn = get_utf8 (t);
-        gchar *msg = g_strdup_printf (_("Error while copying to %s\n\n%s"), fn, error);
 
-        gdk_threads_enter ();
-        gint ret = run_simple_dialog (*main_win, FALSE, GTK_MESSAGE_ERROR, msg, _("Transfer problem"),
-                                      -1, _("Abort"), _("Retry"), _("Skip"), nullptr);
-        g_free (msg);
-        g_free (fn);
-        g_free (t);
-        data->prev_status = GNOME_VFS_XFER_PROGRESS_STATUS_VFSERROR;
-        gdk_threads_leave ();
-        return ret==-1 ? 0 : ret;
-    }
+/**
+ * Copies the progress of the native engine to the fields filled by async_xfer_callback for gnome-vfs jobs.
+ */
+static void sync_native_progress (XferData *data)
+{
+    GnomeCmd::XferProgress &progress = data->engine->progress;
+    string cur_file = progress.get_current_file();
 
-    if (info->phase == GNOME_VFS_XFER_PHASE_COMPLETED)
-    {
-        main_win->focus_file_lists();
-        data->done = TRUE;
-    }
+    if (cur_file.empty())
+        return;
 
-    data->prev_status = info->status;
+    data->cur_phase = GNOME_VFS_XFER_PHASE_COPYING;
+    data->files_total = progress.files_total;
+    data->cur_file = MIN (progress.files_done + 1, data->files_total);
+    data->file_size = progress.file_size;
+    data->bytes_copied = progress.file_bytes_done;
+    data->bytes_total = progress.bytes_total;
+    data->total_bytes_copied = progress.bytes_done;
 
-    return 1;
+    g_free (data->cur_file_name);
+    data->cur_file_name = gnome_vfs_get_uri_from_local_path (cur_file.c_str());
+
+    if (data->win && progress.physical_bytes_total < progress.bytes_total)
+        gnome_cmd_xfer_progress_win_set_data_progress (data->win, progress.physical_bytes_done, progress.physical_bytes_total);
 }
 
 
+static gpointer resume_partial_file (XferData *data);
+static gboolean prescan_vfs_conflicts (XferData *data);
+
+
 static gboolean update_xfer_gui_func (XferData *data)
 {
     if (data->win && data->win->cancel_pressed)
     {
         data->aborted = TRUE;
 
+        // keep the journal on disk, so that the transfer can be resumed later on
+        if (data->engine)
+            data->engine->cancel();
+        else
+            if (data->fanout)
+                data->fanout->cancel();
+            else
+                if (data->tar_upload)
+                    data->tar_upload->cancel();
+                else
+                    if (data->download)
+                        data->download->cancel();
+                    else
+                        // while the partial file is continued, resume_partial_file still writes to the journal and closes it itself
+                        if (data->journal && (!g_atomic_int_get (&data->resuming) || !g_atomic_int_compare_and_exchange (&data->resume_claimed, FALSE, TRUE)))
+                            data->journal->close();
+
         if (data->on_completed_func)
             data->on_completed_func (data->on_completed_data, nullptr);
 
@@ -261,6 +1379,59 @@ static gboolean update_xfer_gui_func (XferData *data)
         return FALSE;
     }
 
+    if (data->engine)
+        sync_native_progress (data);
+
+    if (data->fanout)
+        sync_fanout_progress (data);
+
+    if (data->vfs_fallback)
+    {
+        data->vfs_fallback = FALSE;
+        delete data->tar_upload;
+        data->tar_upload = nullptr;
+        delete data->download;
+        data->download = nullptr;
+        data->first_time = TRUE;
+
+        // the journal and the conflicts are taken care of as for any gnome-vfs job, a resumed
+        // one is started when the partially copied file has been completed
+        if (g_atomic_int_get (&data->resuming))
+            g_thread_unref (g_thread_new (nullptr, (GThreadFunc) resume_partial_file, data));
+        else
+        {
+            if (data->to_dir && data->xferOverwriteMode == GNOME_VFS_XFER_OVERWRITE_MODE_QUERY && !data->conflict_rules && !prescan_vfs_conflicts (data))
+            {
+                // nothing has been transferred yet
+                if (data->journal)
+                    data->journal->remove();
+
+                gtk_widget_destroy (GTK_WIDGET (data->win));
+                gnome_cmd_dir_unref (data->to_dir);
+                data->to_dir = nullptr;
+                free_xfer_data (data);
+                return FALSE;
+            }
+
+            start_async_xfer (data, data->xferOverwriteMode);
+        }
+    }
+
+    if (data->tar_upload)
+        sync_tar_progress (data);
+
+    if (data->download)
+        sync_download_progress (data);
+
+    if (g_atomic_int_get (&data->resuming) && g_atomic_int_get (&data->resume_done))
+    {
+        g_atomic_int_set (&data->resuming, FALSE);
+        data->first_time = TRUE;
+
+        // skipping finished files is done in async_xfer_callback, which requires query mode
+        start_async_xfer (data, GNOME_VFS_XFER_OVERWRITE_MODE_QUERY);
+    }
+
     if (data->cur_phase == GNOME_VFS_XFER_PHASE_COPYING)
     {
         if (data->prev_phase != GNOME_VFS_XFER_PHASE_COPYING)
@@ -293,14 +1464,17 @@ static gboolean update_xfer_gui_func (XferData *data)
             {
                 data->first_time = FALSE;
                 gnome_cmd_xfer_progress_win_set_total_progress (data->win, data->bytes_copied, data->file_size, data->total_bytes_copied, data->bytes_total);
-                while (gtk_events_pending ())
-                    gtk_main_iteration_do (FALSE);
             }
         }
+
+        gnome_cmd_xfer_progress_win_add_sample (data->win, data->total_bytes_copied, data->cur_file > 0 ? data->cur_file - 1 : 0);
     }
 
     if (data->done)
     {
+        if (data->journal && !data->interrupted)
+            data->journal->remove();
+
         // Remove files from the source file list when a move operation has finished
         if (data->xferOptions & GNOME_VFS_XFER_REMOVESOURCE)
             if (data->src_fl && data->src_files)
@@ -331,6 +1505,8 @@ static gboolean update_xfer_gui_func (XferData *data)
         if (data->to_dir)
         {
             gnome_cmd_dir_relist_files (data->to_dir, FALSE);
+            main_win->fs(LEFT)->update_vol_label();
+            main_win->fs(RIGHT)->update_vol_label();
             main_win->focus_file_lists();
             gnome_cmd_dir_unref (data->to_dir);
             data->to_dir = nullptr;
@@ -402,6 +1578,373 @@ inline gboolean file_is_already_in_dir (GnomeVFSURI *uri, GnomeCmdDir *dir)
 }
 
 
+static GnomeCmd::XferJournal *create_xfer_journal (GList *src_uri_list, GList *dest_uri_list)
+{
+    vector<string> src_uris, dest_uris;
+
+    for (GList *i = src_uri_list; i; i = i->next)
+        src_uris.push_back (stringify (gnome_vfs_uri_to_string ((GnomeVFSURI *) i->data, GNOME_VFS_URI_HIDE_PASSWORD)));
+
+    for (GList *i = dest_uri_list; i; i = i->next)
+        dest_uris.push_back (stringify (gnome_vfs_uri_to_string ((GnomeVFSURI *) i->data, GNOME_VFS_URI_HIDE_PASSWORD)));
+
+    gchar *config_dir = get_package_config_dir ();
+    gchar *journal_dir = g_build_filename (config_dir, "xfer-journal", nullptr);
+
+    auto journal = new GnomeCmd::XferJournal(journal_dir, GnomeCmd::XferJournal::make_job_key(src_uris, dest_uris));
+
+    g_free (journal_dir);
+    g_free (config_dir);
+
+    return journal;
+}
+
+
+/**
+ * Journal records carry URIs without passwords. Map such a string back to
+ * a real URI by finding the top level URI of the job it belongs to.
+ */
+static GnomeVFSURI *resolve_journal_uri (const string &uri_str, GList *uri_list)
+{
+    for (GList *i = uri_list; i; i = i->next)
+    {
+        auto uri = (GnomeVFSURI *) i->data;
+        gchar *s = gnome_vfs_uri_to_string (uri, GNOME_VFS_URI_HIDE_PASSWORD);
+        size_t len = strlen (s);
+        GnomeVFSURI *ret = nullptr;
+
+        if (uri_str.compare (0, len, s) == 0)
+        {
+            if (uri_str.size() == len)
+                ret = gnome_vfs_uri_ref (uri);
+            else
+                if (uri_str[len] == '/')
+                    ret = gnome_vfs_uri_append_string (uri, uri_str.c_str() + len + 1);
+        }
+
+        g_free (s);
+
+        if (ret)
+            return ret;
+    }
+
+    return nullptr;
+}
+
+
+static GnomeVFSResult read_block_at (GnomeVFSHandle *handle, GnomeVFSFileSize offset, gchar *buf, GnomeVFSFileSize len)
+{
+    GnomeVFSResult res = gnome_vfs_seek (handle, GNOME_VFS_SEEK_START, offset);
+
+    while (res == GNOME_VFS_OK && len > 0)
+    {
+        GnomeVFSFileSize n = 0;
+
+        res = gnome_vfs_read (handle, buf, len, &n);
+
+        if (res == GNOME_VFS_OK && n == 0)
+            res = GNOME_VFS_ERROR_EOF;
+
+        buf += n;
+        len -= n;
+    }
+
+    return res;
+}
+
+
+/**
+ * Checks if the block before @a offset is the same in source and destination,
+ * i.e. if a partially transferred file can be continued at this position.
+ */
+static gboolean tail_block_matches (GnomeVFSHandle *src, GnomeVFSHandle *dest, GnomeVFSFileSize offset)
+{
+    GnomeVFSFileSize len = MIN (offset, RESUME_TAIL_BLOCK_SIZE);
+
+    if (len == 0)
+        return TRUE;
+
+    gchar *src_block = g_new (gchar, len);
+    gchar *dest_block = g_new (gchar, len);
+
+    gboolean ret = read_block_at (src, offset-len, src_block, len) == GNOME_VFS_OK &&
+                   read_block_at (dest, offset-len, dest_block, len) == GNOME_VFS_OK &&
+                   memcmp (src_block, dest_block, len) == 0;
+
+    g_free (src_block);
+    g_free (dest_block);
+
+    return ret;
+}
+
+
+static GnomeVFSResult continue_partial_file (XferData *data, GnomeVFSURI *src_uri, GnomeVFSURI *dest_uri,
+                                             const string &src_str, const string &dest_str, GnomeVFSFileSize offset)
+{
+    GnomeVFSFileInfo *src_info = gnome_vfs_file_info_new ();
+    GnomeVFSFileInfo *dest_info = gnome_vfs_file_info_new ();
+    GnomeVFSHandle *src = nullptr;
+    GnomeVFSHandle *dest = nullptr;
+    GnomeVFSFileSize pos = 0;
+
+    GnomeVFSResult res = gnome_vfs_get_file_info_uri (src_uri, src_info, GNOME_VFS_FILE_INFO_FOLLOW_LINKS);
+
+    if (res == GNOME_VFS_OK)
+        res = gnome_vfs_get_file_info_uri (dest_uri, dest_info, GNOME_VFS_FILE_INFO_DEFAULT);
+
+    if (res == GNOME_VFS_OK)
+        res = gnome_vfs_open_uri (&src, src_uri, (GnomeVFSOpenMode) (GNOME_VFS_OPEN_READ | GNOME_VFS_OPEN_RANDOM));
+
+    if (res == GNOME_VFS_OK)
+        res = gnome_vfs_open_uri (&dest, dest_uri, (GnomeVFSOpenMode) (GNOME_VFS_OPEN_READ | GNOME_VFS_OPEN_WRITE | GNOME_VFS_OPEN_RANDOM));
+
+    if (res == GNOME_VFS_OK)
+    {
+        // the journal lags behind what has really been written, so try the size of the destination first
+        pos = MIN (dest_info->size, src_info->size);
+
+        if (!tail_block_matches (src, dest, pos))
+        {
+            pos = MIN (offset, pos);
+
+            if (!tail_block_matches (src, dest, pos))
+                res = GNOME_VFS_ERROR_CORRUPTED_DATA;
+        }
+    }
+
+    if (res == GNOME_VFS_OK && dest_info->size != pos)
+        res = gnome_vfs_truncate_handle (dest, pos);
+
+    if (res == GNOME_VFS_OK)
+        res = gnome_vfs_seek (src, GNOME_VFS_SEEK_START, pos);
+
+    if (res == GNOME_VFS_OK)
+        res = gnome_vfs_seek (dest, GNOME_VFS_SEEK_START, pos);
+
+    if (res == GNOME_VFS_OK)
+    {
+        DEBUG ('x', "Resuming %s at offset %llu\n", src_str.c_str(), (unsigned long long) pos);
+
+        data->cur_file_name = g_strdup (src_str.c_str());
+        data->cur_file = 1;
+        data->files_total = 1;
+        data->file_size = src_info->size;
+        data->bytes_total = src_info->size;
+        data->bytes_copied = data->total_bytes_copied = pos;
+        data->cur_phase = GNOME_VFS_XFER_PHASE_COPYING;
+
+        gchar *buf = g_new (gchar, RESUME_BUFFER_SIZE);
+
+        while (res == GNOME_VFS_OK && pos < src_info->size && !data->aborted)
+        {
+            GnomeVFSFileSize bytes_read = 0;
+            GnomeVFSFileSize bytes_written = 0;
+
+            res = gnome_vfs_read (src, buf, RESUME_BUFFER_SIZE, &bytes_read);
+
+            if (res == GNOME_VFS_OK && bytes_read == 0)
+                break;
+
+            for (GnomeVFSFileSize n = 0; res == GNOME_VFS_OK && n < bytes_read; n += bytes_written)
+                res = gnome_vfs_write (dest, buf + n, bytes_read - n, &bytes_written);
+
+            if (res == GNOME_VFS_OK)
+            {
+                pos += bytes_read;
+                data->bytes_copied = data->total_bytes_copied = pos;
+                data->journal->update_partial (src_str, dest_str, pos);
+            }
+        }
+
+        g_free (buf);
+
+        if (res == GNOME_VFS_ERROR_EOF)
+            res = GNOME_VFS_OK;
+
+        if (res == GNOME_VFS_OK && data->aborted)
+            res = GNOME_VFS_ERROR_INTERRUPTED;
+    }
+
+    if (src)
+        gnome_vfs_close (src);
+
+    if (dest)
+        gnome_vfs_close (dest);
+
+    gnome_vfs_file_info_unref (src_info);
+    gnome_vfs_file_info_unref (dest_info);
+
+    return res;
+}
+
+
+/**
+ * Work thread continuing the file which was being transferred when the job got interrupted.
+ * If this is not possible (the remote side does not support random access, the data
+ * written so far does not match the source, ...) the file is copied again by the xfer.
+ */
+static gpointer resume_partial_file (XferData *data)
+{
+    string src_str, dest_str;
+    guint64 offset;
+
+    if (data->journal->get_partial (src_str, dest_str, offset))
+    {
+        GnomeVFSURI *src_uri = resolve_journal_uri (src_str, data->src_uri_list);
+        GnomeVFSURI *dest_uri = resolve_journal_uri (dest_str, data->dest_uri_list);
+
+        if (src_uri && dest_uri)
+        {
+            GnomeVFSResult res = continue_partial_file (data, src_uri, dest_uri, src_str, dest_str, offset);
+
+            if (res == GNOME_VFS_OK)
+                data->journal->mark_done (src_str);
+            else
+                DEBUG ('x', "Could not resume %s: %s\n", src_str.c_str(), gnome_vfs_result_to_string (res));
+        }
+
+        if (src_uri)
+            gnome_vfs_uri_unref (src_uri);
+
+        if (dest_uri)
+            gnome_vfs_uri_unref (dest_uri);
+    }
+
+    // the job has been cancelled meanwhile, the journal is kept for a later resume
+    if (!g_atomic_int_compare_and_exchange (&data->resume_claimed, FALSE, TRUE))
+    {
+        data->journal->close();
+        return nullptr;
+    }
+
+    g_atomic_int_set (&data->resume_done, TRUE);
+
+    return nullptr;
+}
+
+
+/**
+ * Looks for the journal of an earlier, interrupted run of the same job and asks
+ * the user whether to continue it.
+ *
+ * @returns FALSE if the user cancelled the whole operation
+ */
+static gboolean prepare_xfer_journal (XferData *data)
+{
+    data->journal = create_xfer_journal (data->src_uri_list, data->dest_uri_list);
+
+    if (data->journal->exists() && data->journal->load() && data->journal->get_options()==(guint) data->xferOptions)
+    {
+        gint n = data->journal->done_count();
+        gchar *msg = g_strdup_printf (ngettext("An interrupted transfer of these files was found, %d file has already been transferred.\n\nDo you want to resume the transfer?",
+                                               "An interrupted transfer of these files was found, %d files have already been transferred.\n\nDo you want to resume the transfer?",
+                                               n),
+                                      n);
+        gint ret = run_simple_dialog (*main_win, FALSE, GTK_MESSAGE_QUESTION, msg, _("Resume Transfer"),
+                                      2, _("Cancel"), _("Start Over"), _("Resume"), nullptr);
+        g_free (msg);
+
+        switch (ret)
+        {
+            case 2:
+                g_atomic_int_set (&data->resuming, data->journal->resume());
+                if (g_atomic_int_get (&data->resuming))
+                {
+                    // tar can't leave out the files finished before, gnome-vfs continues the job
+                    delete data->tar_upload;
+                    data->tar_upload = nullptr;
+
+                    // the native engine continues the partial file on its own, a segmented download
+                    // from the states of its files - unless it falls back to gnome-vfs
+                    if (!data->engine && !data->download)
+                        g_thread_unref (g_thread_new (nullptr, (GThreadFunc) resume_partial_file, data));
+                    return TRUE;
+                }
+                break;
+
+            case 1:
+                break;
+
+            default:
+                return FALSE;
+        }
+    }
+
+    if (!data->journal->start(data->xferOptions, data->xferOverwriteMode))
+    {
+        DEBUG ('x', "Transfer journal %s could not be created, transfer can't be resumed\n", data->journal->get_path().c_str());
+        delete data->journal;
+        data->journal = nullptr;
+    }
+
+    return TRUE;
+}
+
+
+/**
+ * Resolves the conflicts of the top level items of a gnome-vfs job up front.
+ * Only the top level is checked, listing remote directories would take too
+ * long; the rules chosen here are applied to nested files by async_xfer_callback.
+ *
+ * @returns FALSE if the user cancelled the transfer
+ */
+static gboolean prescan_vfs_conflicts (XferData *data)
+{
+    vector<GnomeCmd::XferConflict> conflicts;
+    GList *dest = data->dest_uri_list;
+
+    for (GList *src = data->src_uri_list; src && dest; src = src->next, dest = dest->next)
+    {
+        GnomeCmd::XferConflict conflict;
+
+        if (!get_vfs_conflict ((GnomeVFSURI *) src->data, (GnomeVFSURI *) dest->data, conflict))
+            continue;
+
+        conflicts.push_back (conflict);
+    }
+
+    if (conflicts.empty())
+        return TRUE;
+
+    data->conflict_rules = new GnomeCmd::XferConflictRules;
+
+    if (!gnome_cmd_xfer_conflicts_dialog (*main_win, conflicts, *data->conflict_rules))
+        return FALSE;
+
+    // top level items to be renamed get a new destination
+    dest = data->dest_uri_list;
+
+    for (GList *src = data->src_uri_list; src && dest; src = src->next, dest = dest->next)
+    {
+        auto dest_uri = (GnomeVFSURI *) dest->data;
+        GnomeCmd::XferConflict conflict;
+
+        if (!get_vfs_conflict ((GnomeVFSURI *) src->data, dest_uri, conflict) ||
+            data->conflict_rules->resolve(conflict) != GnomeCmd::XferConflictRules::RESOLUTION_RENAME)
+            continue;
+
+        GnomeVFSURI *parent = gnome_vfs_uri_get_parent (dest_uri);
+        gchar *name = gnome_vfs_uri_extract_short_name (dest_uri);
+        GnomeVFSURI *new_uri = nullptr;
+
+        for (guint n=1; !new_uri || gnome_vfs_uri_exists (new_uri); ++n)
+        {
+            if (new_uri)
+                gnome_vfs_uri_unref (new_uri);
+            new_uri = gnome_vfs_uri_append_file_name (parent, GnomeCmd::XferConflictRules::renamed(name, n).c_str());
+        }
+
+        g_free (name);
+        gnome_vfs_uri_unref (parent);
+        gnome_vfs_uri_unref (dest_uri);
+
+        dest->data = new_uri;
+    }
+
+    return TRUE;
+}
+
+
 void
 gnome_cmd_xfer_uris_start (GList *src_uri_list,
                            GnomeCmdDir *to_dir,
@@ -411,7 +1954,9 @@ gnome_cmd_xfer_uris_start (GList *src_uri_list,
                            GnomeVFSXferOptions xferOptions,
                            GnomeVFSXferOverwriteMode xferOverwriteMode,
                            GtkSignalFunc on_completed_func,
-                           gpointer on_completed_data)
+                           gpointer on_completed_data,
+                           GnomeCmdXferFlags xferFlags,
+                           GList *fanout_dirs)
 {
     g_return_if_fail (src_uri_list != nullptr);
     g_return_if_fail (GNOME_CMD_IS_DIR (to_dir));
@@ -439,6 +1984,7 @@ gnome_cmd_xfer_uris_start (GList *src_uri_list,
                                        to_dir, src_fl, src_files,
                                        (GFunc) on_completed_func, on_completed_data);
 
+    // counted before the loop below walks src_uri_list to its end
     gint num_files = g_list_length (src_uri_list);
 
     if (num_files == 1 && dest_fn != nullptr)
@@ -449,6 +1995,8 @@ gnome_cmd_xfer_uris_start (GList *src_uri_list,
     }
     else
     {
+        GnomeCmd::Batch<GnomeVFSURI *> dest_uris;
+
         for (; src_uri_list; src_uri_list = src_uri_list->next)
         {
             src_uri = (GnomeVFSURI *) src_uri_list->data;
@@ -457,25 +2005,90 @@ gnome_cmd_xfer_uris_start (GList *src_uri_list,
             dest_uri = gnome_cmd_dir_get_child_uri (to_dir, basename);
             g_free (basename);
 
-            data->dest_uri_list = g_list_append (data->dest_uri_list, dest_uri);
+            dest_uris.add(dest_uri);
         }
+
+        data->dest_uri_list = dest_uris.get_list();
     }
 
     g_free (dest_fn);
 
+    data->xferOverwriteMode = xferOverwriteMode;
+    data->xferFlags = xferFlags;
+
+    // a copy to several directories has no journal and resolves no conflicts up front
+    if (fanout_dirs)
+    {
+        data->fanout = create_fanout (data, fanout_dirs);
+
+        if (!data->fanout)
+        {
+            gnome_cmd_show_message (*main_win, _("Copying to several directories at once works for local files and existing local directories only."),
+                                    _("The whole operation was cancelled."));
+            gnome_cmd_dir_unref (to_dir);
+            data->to_dir = nullptr;
+            free_xfer_data (data);
+            return;
+        }
+
+        data->win = GNOME_CMD_XFER_PROGRESS_WIN (gnome_cmd_xfer_progress_win_new (num_files));
+        gtk_widget_ref (GTK_WIDGET (data->win));
+        gtk_window_set_title (GTK_WINDOW (data->win), _("preparing…"));
+        gtk_widget_show (GTK_WIDGET (data->win));
+
+        g_thread_unref (g_thread_new (nullptr, (GThreadFunc) fanout_xfer_thread, data));
+        gnome_cmd_progress_add_job ((GSourceFunc) update_xfer_gui_func, data);
+        return;
+    }
+
+    data->engine = create_native_engine (data);
+
+    // uploads to SSH servers are streamed and large downloads split, the server is probed by
+    // their threads. The journal is set up first, it is needed as well if they fall back to gnome-vfs.
+    if (!data->engine && gnome_cmd_data.options.tar_upload)
+        data->tar_upload = create_tar_upload (data);
+
+    if (!data->engine && !data->tar_upload)
+        data->download = create_segmented_download (data);
+
+    if (!prepare_xfer_journal (data))
+    {
+        gnome_cmd_dir_unref (to_dir);
+        data->to_dir = nullptr;
+        free_xfer_data (data);
+        return;
+    }
+
+    // the native engine, a tar upload and a segmented download look for conflicts in their own threads,
+    // a resumed gnome-vfs job is already being worked on by resume_partial_file and asks per file
+    if (!data->engine && !data->tar_upload && !data->download && !g_atomic_int_get (&data->resuming) && xferOverwriteMode == GNOME_VFS_XFER_OVERWRITE_MODE_QUERY && !prescan_vfs_conflicts (data))
+    {
+        // nothing has been transferred yet
+        if (data->journal)
+            data->journal->remove();
+
+        gnome_cmd_dir_unref (to_dir);
+        data->to_dir = nullptr;
+        free_xfer_data (data);
+        return;
+    }
+
     data->win = GNOME_CMD_XFER_PROGRESS_WIN (gnome_cmd_xfer_progress_win_new (num_files));
     gtk_widget_ref (GTK_WIDGET (data->win));
-    gtk_window_set_title (GTK_WINDOW (data->win), _("preparing…"));
+    gtk_window_set_title (GTK_WINDOW (data->win), g_atomic_int_get (&data->resuming) ? _("resuming…") : _("preparing…"));
     gtk_widget_show (GTK_WIDGET (data->win));
 
-    //  start the transfer
-    gnome_vfs_async_xfer (&data->handle, data->src_uri_list, data->dest_uri_list,
-                          xferOptions, GNOME_VFS_XFER_ERROR_MODE_QUERY, xferOverwriteMode,
-                          XFER_PRIORITY,
-                          (GnomeVFSAsyncXferProgressCallback) async_xfer_callback, data,
-                          nullptr, nullptr);
+    //  start the transfer, a resumed one is started when the partially copied file has been completed
+    if (data->engine)
+        g_thread_unref (g_thread_new (nullptr, (GThreadFunc) native_xfer_thread, data));
+    else
+        if (data->tar_upload || data->download)
+            g_thread_unref (g_thread_new (nullptr, (GThreadFunc) (data->tar_upload ? tar_upload_thread : segmented_download_thread), data));
+        else
+            if (!g_atomic_int_get (&data->resuming))
+                start_async_xfer (data, xferOverwriteMode);
 
-    g_timeout_add (gnome_cmd_data.gui_update_rate, (GSourceFunc) update_xfer_gui_func, data);
+    gnome_cmd_progress_add_job ((GSourceFunc) update_xfer_gui_func, data);
 }
 
 
@@ -487,7 +2100,9 @@ gnome_cmd_xfer_start (GList *src_files,
                       GnomeVFSXferOptions xferOptions,
                       GnomeVFSXferOverwriteMode xferOverwriteMode,
                       GtkSignalFunc on_completed_func,
-                      gpointer on_completed_data)
+                      gpointer on_completed_data,
+                      GnomeCmdXferFlags xferFlags,
+                      GList *fanout_dirs)
 {
     g_return_if_fail (src_files != nullptr);
     g_return_if_fail (GNOME_CMD_IS_DIR (to_dir));
@@ -502,7 +2117,9 @@ gnome_cmd_xfer_start (GList *src_files,
                                xferOptions,
                                xferOverwriteMode,
                                on_completed_func,
-                               on_completed_data);
+                               on_completed_data,
+                               xferFlags,
+                               fanout_dirs);
 }
 
 
@@ -543,10 +2160,31 @@ gnome_cmd_xfer_tmp_download_multiple (GList *src_uri_list,
                              nullptr, nullptr, nullptr,
                              (GFunc) on_completed_func, on_completed_data);
 
+    data->xferOverwriteMode = xferOverwriteMode;
+
     data->win = GNOME_CMD_XFER_PROGRESS_WIN (gnome_cmd_xfer_progress_win_new (g_list_length (src_uri_list)));
     gtk_window_set_title (GTK_WINDOW (data->win), _("downloading to /tmp"));
     gtk_widget_show (GTK_WIDGET (data->win));
 
+    data->download = create_segmented_download (data);
+
+    if (data->download)
+    {
+        g_thread_unref (g_thread_new (nullptr, (GThreadFunc) segmented_download_thread, data));
+        gnome_cmd_progress_add_job ((GSourceFunc) update_xfer_gui_func, data);
+        return;
+    }
+
+    data->engine = create_native_engine (data);
+
+    if (data->engine)
+    {
+        // errors abort the download, like GNOME_VFS_XFER_ERROR_MODE_ABORT below
+        g_thread_unref (g_thread_new (nullptr, (GThreadFunc) native_xfer_thread, data));
+        gnome_cmd_progress_add_job ((GSourceFunc) update_xfer_gui_func, data);
+        return;
+    }
+
     //  start the transfer
     GnomeVFSResult result;
     result = gnome_vfs_async_xfer (&data->handle, data->src_uri_list, data->dest_uri_list,
@@ -559,5 +2197,5 @@ gnome_cmd_xfer_tmp_download_multiple (GList *src_uri_list,
         DEBUG ('x', "Downloading could not be started properly as of wrong arguments in gnome_vfs_async_xfer()\n");
     }
 
-    g_timeout_add (gnome_cmd_data.gui_update_rate, (GSourceFunc) update_xfer_gui_func, data);
+    gnome_cmd_progress_add_job ((GSourceFunc) update_xfer_gui_func, data);
 }
@@ -24,6 +24,19 @@
 #include "gnome-cmd-dir.h"
 #include "gnome-cmd-file-list.h"
 
+/**
+ * Options for copies between local file systems, which have no
+ * GnomeVFSXferOptions counterpart. They are ignored for gnome-vfs transfers.
+ */
+enum GnomeCmdXferFlags
+{
+    GNOME_CMD_XFER_DEFAULT  = 0,
+    GNOME_CMD_XFER_BULK      = 1 << 0,      // keep the data out of the page cache
+    GNOME_CMD_XFER_NO_BULK   = 1 << 1,      // never use bulk mode, not even for large jobs
+    GNOME_CMD_XFER_HARDLINKS = 1 << 2,      // recreate hard links instead of copying the data again
+    GNOME_CMD_XFER_REFLINK   = 1 << 3       // share the data blocks on copy-on-write file systems
+};
+
 void
 gnome_cmd_xfer_start (GList *src_files,
                       GnomeCmdDir *to,
@@ -32,7 +45,9 @@ gnome_cmd_xfer_start (GList *src_files,
                       GnomeVFSXferOptions xferOptions,
                       GnomeVFSXferOverwriteMode xferOverwriteMode,
                       GtkSignalFunc on_completed_func,
-                      gpointer on_completed_data);
+                      gpointer on_completed_data,
+                      GnomeCmdXferFlags xferFlags=GNOME_CMD_XFER_DEFAULT,
+                      GList *fanout_dirs=nullptr);
 
 
 void
@@ -44,7 +59,9 @@ gnome_cmd_xfer_uris_start (GList *src_uri_list,
                            GnomeVFSXferOptions xferOptions,
                            GnomeVFSXferOverwriteMode xferOverwriteMode,
                            GtkSignalFunc on_completed_func,
-                           gpointer on_completed_data);
+                           gpointer on_completed_data,
+                           GnomeCmdXferFlags xferFlags=GNOME_CMD_XFER_DEFAULT,
+                           GList *fanout_dirs=nullptr);
 
 void
 gnome_cmd_xfer_tmp_download (GnomeVFSURI *src_uri,
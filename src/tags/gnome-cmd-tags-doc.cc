@@ -343,25 +343,13 @@ void gcmd_tags_libgsf_shutdown()
 }
 
 
-void gcmd_tags_libgsf_load_metadata(GnomeCmdFile *f)
+void gcmd_tags_libgsf_load_metadata(GnomeCmdFileMetadata *metadata, const gchar *fname)
 {
-    g_return_if_fail (f != nullptr);
-    g_return_if_fail (f->info != nullptr);
+    g_return_if_fail (metadata != nullptr);
+    g_return_if_fail (fname != nullptr);
 
 #ifdef HAVE_GSF
-    if (f->metadata && f->metadata->is_accessed(TAG_DOC))  return;
-
-    if (!f->metadata)
-        f->metadata = new GnomeCmdFileMetadata;
-
-    if (!f->metadata)  return;
-
-    f->metadata->mark_as_accessed(TAG_DOC);
-
-    if (!f->is_local())  return;
-
     GError *err = nullptr;
-    gchar *fname = f->get_real_path();
 
     DEBUG('t', "Loading doc metadata for '%s'\n", fname);
 
@@ -374,19 +362,16 @@ void gcmd_tags_libgsf_load_metadata(GnomeCmdFile *f)
         g_return_if_fail (err != nullptr);
         g_warning ("'%s' error: %s", fname, err->message);
         g_error_free (err);
-        g_free (fname);
         return;
     }
 
-    g_free (fname);
-
     GsfInfile *infile = nullptr;
 
     if ((infile = gsf_infile_msole_new (input, nullptr)))
-        process_msole_infile(infile, f->metadata);
+        process_msole_infile(infile, metadata);
     else
         if ((infile = gsf_infile_zip_new (input, nullptr)))
-            process_opendoc_infile(infile, f->metadata);
+            process_opendoc_infile(infile, metadata);
 
     if (infile)
         g_object_unref (infile);
@@ -397,3 +382,29 @@ void gcmd_tags_libgsf_load_metadata(GnomeCmdFile *f)
     g_object_unref (input);
 #endif
 }
+
+
+void gcmd_tags_libgsf_load_metadata(GnomeCmdFile *f)
+{
+    g_return_if_fail (f != nullptr);
+    g_return_if_fail (f->info != nullptr);
+
+#ifdef HAVE_GSF
+    if (f->metadata && f->metadata->is_accessed(TAG_DOC))  return;
+
+    if (!f->metadata)
+        f->metadata = new GnomeCmdFileMetadata;
+
+    if (!f->metadata)  return;
+
+    f->metadata->mark_as_accessed(TAG_DOC);
+
+    if (!f->is_local())  return;
+
+    gchar *fname = f->get_real_path();
+
+    gcmd_tags_libgsf_load_metadata(f->metadata, fname);
+
+    g_free (fname);
+#endif
+}
@@ -28,3 +28,4 @@ void gcmd_tags_libgsf_init();
 void gcmd_tags_libgsf_shutdown();
 
 void gcmd_tags_libgsf_load_metadata(GnomeCmdFile *f);
+void gcmd_tags_libgsf_load_metadata(GnomeCmdFileMetadata *metadata, const gchar *fname);
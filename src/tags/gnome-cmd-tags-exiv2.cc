@@ -371,27 +371,10 @@ void gcmd_tags_exiv2_init()
 }
 
 
-void gcmd_tags_exiv2_load_metadata(GnomeCmdFile *f)
+void gcmd_tags_exiv2_load_metadata(GnomeCmdFileMetadata *metadata, const gchar *fname)
 {
-    g_return_if_fail (f != NULL);
-    g_return_if_fail (f->info != NULL);
-
-    if (f->metadata && f->metadata->is_accessed(TAG_IMAGE))  return;
-
-    if (!f->metadata)
-        f->metadata = new GnomeCmdFileMetadata;
-
-    if (!f->metadata)  return;
-
-    f->metadata->mark_as_accessed(TAG_IMAGE);
-#ifdef HAVE_EXIV2
-    f->metadata->mark_as_accessed(TAG_EXIF);
-    f->metadata->mark_as_accessed(TAG_IPTC);
-#endif
-
-    if (!f->is_local())  return;
-
-    gchar *fname = f->get_real_path();
+    g_return_if_fail (metadata != NULL);
+    g_return_if_fail (fname != NULL);
 
     DEBUG('t', "Loading image metadata for '%s'\n", fname);
 
@@ -402,8 +385,8 @@ void gcmd_tags_exiv2_load_metadata(GnomeCmdFile *f)
 
         image->readMetadata();
 
-        readTags(f->metadata, image->exifData());
-        readTags(f->metadata, image->iptcData());
+        readTags(metadata, image->exifData());
+        readTags(metadata, image->iptcData());
     }
 
     catch (AnyError &e)
@@ -414,11 +397,37 @@ void gcmd_tags_exiv2_load_metadata(GnomeCmdFile *f)
     gint width, height;
     GdkPixbufFormat *fmt = gdk_pixbuf_get_file_info (fname, &width, &height);
 
-    g_free (fname);
-
     if (!fmt)
         return;
 
-    f->metadata->addf (TAG_IMAGE_WIDTH, "%i", width);
-    f->metadata->addf (TAG_IMAGE_HEIGHT, "%i", height);
+    metadata->addf (TAG_IMAGE_WIDTH, "%i", width);
+    metadata->addf (TAG_IMAGE_HEIGHT, "%i", height);
+}
+
+
+void gcmd_tags_exiv2_load_metadata(GnomeCmdFile *f)
+{
+    g_return_if_fail (f != NULL);
+    g_return_if_fail (f->info != NULL);
+
+    if (f->metadata && f->metadata->is_accessed(TAG_IMAGE))  return;
+
+    if (!f->metadata)
+        f->metadata = new GnomeCmdFileMetadata;
+
+    if (!f->metadata)  return;
+
+    f->metadata->mark_as_accessed(TAG_IMAGE);
+#ifdef HAVE_EXIV2
+    f->metadata->mark_as_accessed(TAG_EXIF);
+    f->metadata->mark_as_accessed(TAG_IPTC);
+#endif
+
+    if (!f->is_local())  return;
+
+    gchar *fname = f->get_real_path();
+
+    gcmd_tags_exiv2_load_metadata(f->metadata, fname);
+
+    g_free (fname);
 }
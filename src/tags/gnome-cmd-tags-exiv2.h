@@ -28,3 +28,4 @@ void gcmd_tags_exiv2_init();
 inline void gcmd_tags_exiv2_shutdown()      {}
 
 void gcmd_tags_exiv2_load_metadata(GnomeCmdFile *f);
+void gcmd_tags_exiv2_load_metadata(GnomeCmdFileMetadata *metadata, const gchar *fname);
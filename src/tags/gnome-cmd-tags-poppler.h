@@ -24,3 +24,4 @@
 #include "gnome-cmd-file.h"
 
 void gcmd_tags_poppler_load_metadata(GnomeCmdFile *f);
+void gcmd_tags_poppler_load_metadata(GnomeCmdFileMetadata *metadata, const gchar *fname);
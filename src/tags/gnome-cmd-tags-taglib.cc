@@ -438,6 +438,25 @@ void gcmd_tags_taglib_init()
 }
 
 
+void gcmd_tags_taglib_load_metadata(GnomeCmdFileMetadata *metadata, const gchar *fname)
+{
+    g_return_if_fail (metadata != NULL);
+    g_return_if_fail (fname != NULL);
+
+#ifdef HAVE_ID3
+    DEBUG('t', "Loading audio metadata for '%s'\n", fname);
+
+    TagLib::FileRef f(fname, true, TagLib::AudioProperties::Accurate);
+
+    if (f.isNull())
+        return;
+
+    getAudioProperties(*metadata, f.audioProperties());
+    getTag(*metadata, f.file(), f.tag());
+#endif
+}
+
+
 void gcmd_tags_taglib_load_metadata(GnomeCmdFile *finfo)
 {
     g_return_if_fail (finfo != NULL);
@@ -459,16 +478,10 @@ void gcmd_tags_taglib_load_metadata(GnomeCmdFile *finfo)
 
     if (!finfo->is_local())  return;
 
-    const gchar *fname = finfo->get_real_path();
-
-    DEBUG('t', "Loading audio metadata for '%s'\n", fname);
-
-    TagLib::FileRef f(fname, true, TagLib::AudioProperties::Accurate);
+    gchar *fname = finfo->get_real_path();
 
-    if (f.isNull())
-        return;
+    gcmd_tags_taglib_load_metadata(finfo->metadata, fname);
 
-    getAudioProperties(*finfo->metadata, f.audioProperties());
-    getTag(*finfo->metadata, f.file(), f.tag());
+    g_free (fname);
 #endif
 }
@@ -27,3 +27,4 @@ void gcmd_tags_taglib_init();
 inline void gcmd_tags_taglib_shutdown()     {}
 
 void gcmd_tags_taglib_load_metadata(GnomeCmdFile *f);
+void gcmd_tags_taglib_load_metadata(GnomeCmdFileMetadata *metadata, const gchar *fname);
@@ -573,6 +573,39 @@ GnomeCmdFileMetadata *gcmd_tags_bulk_load(GnomeCmdFile *f)
 }
 
 
+void gcmd_tags_extract(GnomeCmd::TagQuery::Backend backend, const gchar *path, GnomeCmd::TagValues &values)
+{
+    g_return_if_fail (path != NULL);
+
+    GnomeCmdFileMetadata metadata;
+
+    switch (backend)
+    {
+        case GnomeCmd::TagQuery::BACKEND_IMAGE:
+            gcmd_tags_exiv2_load_metadata(&metadata, path);
+            break;
+
+        case GnomeCmd::TagQuery::BACKEND_AUDIO:
+            gcmd_tags_taglib_load_metadata(&metadata, path);
+            break;
+
+        case GnomeCmd::TagQuery::BACKEND_DOC:
+            gcmd_tags_libgsf_load_metadata(&metadata, path);
+            break;
+
+        case GnomeCmd::TagQuery::BACKEND_PDF:
+            gcmd_tags_poppler_load_metadata(&metadata, path);
+            break;
+
+        default:
+            break;
+    }
+
+    for (auto &tag : metadata)
+        values[gcmd_tags_get_name(tag.first)] = join(tag.second, ", ");
+}
+
+
 GnomeCmdTag gcmd_tags_get_tag_by_name(const gchar *tag_name, const GnomeCmdTagClass tag_class)
 {
     GnomeCmdTagName t;
@@ -27,6 +27,7 @@
 #include <sstream>
 
 #include "gnome-cmd-file.h"
+#include "gnome-cmd-tag-query.h"
 #include "utils.h"
 
 enum GnomeCmdTagClass
@@ -513,6 +514,13 @@ inline const gchar *gcmd_tags_get_value_by_name(GnomeCmdFile *f, const gchar *ta
     return gcmd_tags_get_value(f, gcmd_tags_get_tag_by_name(tag_name, tag_class));
 }
 
+/**
+ * gcmd_tags_extract() reads the tags of one backend from the local file
+ * path into values, by their fully qualified names (eg. ID3.Artist). It
+ * needs no GnomeCmdFile, so that the search threads can call it.
+ */
+void gcmd_tags_extract(GnomeCmd::TagQuery::Backend backend, const gchar *path, GnomeCmd::TagValues &values);
+
 
 class GnomeCmdFileMetadata
 {
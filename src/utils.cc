@@ -28,6 +28,7 @@
 #include <set>
 
 #include "gnome-cmd-includes.h"
+#include "gnome-cmd-batch.h"
 #include "utils.h"
 #include "gnome-cmd-data.h"
 #include "imageloader.h"
@@ -37,7 +38,6 @@ using namespace std;
 
 
 #define FIX_PW_HACK
-#define STRINGS_TO_URIS_CHUNK 1024
 
 static GdkCursor *cursor_busy = NULL;
 static gchar *tmp_file_dir = NULL;
@@ -425,27 +425,22 @@ void clear_event_key (GdkEventKey *event)
  */
 GList *strings_to_uris (gchar *data)
 {
-    GList *uri_list = NULL;
-    gchar **filenames = g_strsplit (data, "\r\n", STRINGS_TO_URIS_CHUNK);
+    GnomeCmd::Batch<GnomeVFSURI *> uris;
+    gchar **filenames = g_strsplit (data, "\r\n", -1);
 
     for (gint i=0; filenames[i] != NULL; i++)
     {
-        if (i == STRINGS_TO_URIS_CHUNK)
-        {
-            uri_list = g_list_concat (uri_list, strings_to_uris (filenames[i]));
-            break;
-        }
+        if (!*filenames[i])
+            continue;
 
-        gchar *fn = g_strdup (filenames[i]);
-        GnomeVFSURI *uri = gnome_vfs_uri_new (fn);
+        GnomeVFSURI *uri = gnome_vfs_uri_new (filenames[i]);
         fix_uri (uri);
         if (uri)
-            uri_list = g_list_append (uri_list, uri);
-        g_free (fn);
+            uris.add(uri);
     }
 
     g_strfreev (filenames);
-    return uri_list;
+    return uris.get_list();
 }
 
 GList *string_history_add (GList *in, const gchar *value, guint maxsize)
@@ -778,7 +773,7 @@ GdkColor *gdk_color_new (gushort r, gushort g, gushort b)
 
 GList *file_list_to_uri_list (GList *files)
 {
-    GList *uris = NULL;
+    GnomeCmd::Batch<GnomeVFSURI *> uris;
 
     for (; files; files = files->next)
     {
@@ -788,10 +783,10 @@ GList *file_list_to_uri_list (GList *files)
         if (!uri)
             g_warning ("NULL uri!!!");
         else
-            uris = g_list_append (uris, uri);
+            uris.add(uri);
     }
 
-    return uris;
+    return uris.get_list();
 }
 
 
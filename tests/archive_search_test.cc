@@ -0,0 +1,391 @@
+/**
+ * @file archive_search_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for searching the content of compressed files and archive members.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <gtest/gtest.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_BZIP2
+#include <bzlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "../src/gnome-cmd-archive-search.h"
+#include "../src/gnome-cmd-search-engine.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::ArchiveSearch;
+using GnomeCmd::ContentMatcher;
+using GnomeCmd::NameMatcher;
+using GnomeCmd::SearchEngine;
+
+
+class ArchiveSearchTest : public TempDirTest
+{
+  protected:
+
+    void make_file(const string &name, const string &content)
+    {
+        write_file(dir + '/' + name, content);
+    }
+
+    /**
+     * @returns the matching members of the file, sorted
+     */
+    vector<string> search(const string &name, const string &pattern)
+    {
+        ContentMatcher matcher(pattern, false);
+        vector<string> members;
+
+        ArchiveSearch::search(matcher, AT_FDCWD, (dir + '/' + name).c_str(),
+                              [&] (const string &member) { members.push_back(member); });
+
+        sort (members.begin(), members.end());
+
+        return members;
+    }
+
+    static void put_octal(char *field, size_t len, uint64_t value)
+    {
+        snprintf (field, len, "%0*llo", (int) len - 1, (unsigned long long) value);
+    }
+
+    static string tar_member(const string &name, const string &content, char type='0')
+    {
+        char header[512];
+
+        memset (header, 0, sizeof(header));
+        strncpy (header, name.c_str(), 100);
+        put_octal (header + 100, 8, 0644);
+        put_octal (header + 124, 12, content.size());
+        put_octal (header + 136, 12, 0);
+        header[156] = type;
+        memcpy (header + 257, "ustar\0" "00", 8);
+        memset (header + 148, ' ', 8);
+
+        unsigned sum = 0;
+
+        for (unsigned char c : header)
+            sum += c;
+
+        snprintf (header + 148, 8, "%06o", sum);
+
+        string member(header, sizeof(header));
+
+        member += content;
+        member.append((512 - content.size() % 512) % 512, '\0');
+
+        return member;
+    }
+
+    static string tar(const vector<pair<string,string>> &members)
+    {
+        string archive;
+
+        for (auto &m : members)
+            archive += tar_member(m.first, m.second);
+
+        return archive + string(1024, '\0');
+    }
+
+    static void put16(string &s, uint16_t v)    {  s += (char) v;  s += (char) (v >> 8);  }
+    static void put32(string &s, uint32_t v)    {  put16(s, v);  put16(s, v >> 16);  }
+
+    /**
+     * A zip archive, deflated members are given raw deflate data.
+     */
+    static string zip(const vector<pair<string,string>> &members, const vector<pair<string,string>> &deflated={})
+    {
+        string archive, directory;
+        uint16_t count = 0;
+
+        auto add = [&] (const string &name, const string &data, uint16_t method, uint32_t size)
+        {
+            uint32_t offset = archive.size();
+
+            put32(archive, 0x04034b50);
+            put16(archive, 20);
+            put16(archive, 0);
+            put16(archive, method);
+            put32(archive, 0);                  // time and date
+            put32(archive, 0);                  // the CRC is not checked
+            put32(archive, data.size());
+            put32(archive, size);
+            put16(archive, name.size());
+            put16(archive, 0);
+            archive += name + data;
+
+            put32(directory, 0x02014b50);
+            put16(directory, 20);
+            put16(directory, 20);
+            put16(directory, 0);
+            put16(directory, method);
+            put32(directory, 0);
+            put32(directory, 0);
+            put32(directory, data.size());
+            put32(directory, size);
+            put16(directory, name.size());
+            put16(directory, 0);
+            put16(directory, 0);
+            put16(directory, 0);
+            put16(directory, 0);
+            put32(directory, 0);
+            put32(directory, offset);
+            directory += name;
+
+            ++count;
+        };
+
+        for (auto &m : members)
+            add(m.first, m.second, 0, m.second.size());
+
+        for (auto &m : deflated)
+            add(m.first, m.second, 8, 0);
+
+        uint32_t dir_offset = archive.size();
+
+        archive += directory;
+        put32(archive, 0x06054b50);
+        put32(archive, 0);
+        put16(archive, count);
+        put16(archive, count);
+        put32(archive, directory.size());
+        put32(archive, dir_offset);
+        put16(archive, 0);
+
+        return archive;
+    }
+
+#ifdef HAVE_ZLIB
+    /**
+     * @param window_bits MAX_WBITS + 16 for gzip, -MAX_WBITS for raw deflate data
+     */
+    static string deflate_data(const string &data, int window_bits)
+    {
+        z_stream zs;
+        string out(compressBound (data.size()) + 32, '\0');
+
+        memset (&zs, 0, sizeof(zs));
+        deflateInit2 (&zs, Z_BEST_SPEED, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY);
+        zs.next_in = (Bytef *) data.data();
+        zs.avail_in = data.size();
+        zs.next_out = (Bytef *) &out[0];
+        zs.avail_out = out.size();
+        deflate (&zs, Z_FINISH);
+        out.resize(zs.total_out);
+        deflateEnd (&zs);
+
+        return out;
+    }
+
+    static string gzip(const string &data)      {  return deflate_data(data, MAX_WBITS + 16);  }
+#endif
+};
+
+
+TEST(ArchiveSearchFormatTest, DetectsByMagicBytes)
+{
+    EXPECT_EQ (ArchiveSearch::FORMAT_GZIP, ArchiveSearch::detect("\x1f\x8b\x08\x00", 4));
+    EXPECT_EQ (ArchiveSearch::FORMAT_BZIP2, ArchiveSearch::detect("BZh9", 4));
+    EXPECT_EQ (ArchiveSearch::FORMAT_PLAIN, ArchiveSearch::detect("BZh0", 4));
+    EXPECT_EQ (ArchiveSearch::FORMAT_XZ, ArchiveSearch::detect("\xfd" "7zXZ\0", 6));
+    EXPECT_EQ (ArchiveSearch::FORMAT_ZSTD, ArchiveSearch::detect("\x28\xb5\x2f\xfd", 4));
+    EXPECT_EQ (ArchiveSearch::FORMAT_ZIP, ArchiveSearch::detect("PK\3\4", 4));
+    EXPECT_EQ (ArchiveSearch::FORMAT_PLAIN, ArchiveSearch::detect("plain text", 10));
+    EXPECT_EQ (ArchiveSearch::FORMAT_PLAIN, ArchiveSearch::detect("", 0));
+}
+
+
+TEST_F(ArchiveSearchTest, SearchesPlainFiles)
+{
+    make_file("plain.txt", "a needle in a haystack\n");
+
+    EXPECT_EQ (vector<string> {""}, search("plain.txt", "needle"));
+    EXPECT_TRUE (search("plain.txt", "thread").empty());
+}
+
+
+TEST_F(ArchiveSearchTest, SearchesTarMembers)
+{
+    string archive = tar({{"dir/one.txt", "first needle\n"},
+                          {"dir/two.txt", string(3000, 'x') + "\nsecond needle\n"},
+                          {"dir/three.txt", "nothing\n"}});
+
+    // a long name, as GNU tar writes it
+    archive.insert(archive.size() - 1024, tar_member("././@LongLink", string(150, 'n') + "/four.txt", 'L') +
+                                          tar_member("truncated", "fourth needle\n"));
+    make_file("files.tar", archive);
+
+    EXPECT_EQ (ArchiveSearch::FORMAT_TAR, ArchiveSearch::detect(archive.data(), archive.size()));
+    EXPECT_EQ ((vector<string> {"dir/one.txt", "dir/two.txt", string(150, 'n') + "/four.txt"}), search("files.tar", "needle"));
+    EXPECT_EQ (vector<string> {"dir/three.txt"}, search("files.tar", "^nothing"));
+}
+
+
+TEST_F(ArchiveSearchTest, SearchesStoredZipMembers)
+{
+    make_file("files.zip", zip({{"a.txt", "apple needle"}, {"dir/", ""}, {"b.txt", "banana"}}));
+
+    EXPECT_EQ (vector<string> {"a.txt"}, search("files.zip", "needle"));
+    EXPECT_EQ (vector<string> {"b.txt"}, search("files.zip", "nan"));
+}
+
+
+#ifdef HAVE_ZLIB
+TEST_F(ArchiveSearchTest, SearchesGzipFiles)
+{
+    string text;
+
+    for (int i=0; i<20000; ++i)
+        text += "line " + to_string (i) + "\n";
+
+    // concatenated members, as with gzip -c a b
+    make_file("log.gz", gzip(text) + gzip("the needle at the end\n"));
+    make_file("broken.gz", gzip(text).substr(0, 200));
+
+    EXPECT_EQ (vector<string> {""}, search("log.gz", "^line 19999$"));
+    EXPECT_EQ (vector<string> {""}, search("log.gz", "needle"));
+    EXPECT_TRUE (search("log.gz", "line 20000").empty());
+    EXPECT_TRUE (search("broken.gz", "line 19999").empty());
+}
+
+
+TEST_F(ArchiveSearchTest, SearchesCompressedTarMembers)
+{
+    make_file("files.tar.gz", gzip(tar({{"a.txt", "alpha\n"}, {"b.txt", "beta needle\n"}})));
+
+    EXPECT_EQ (vector<string> {"b.txt"}, search("files.tar.gz", "needle"));
+}
+
+
+TEST_F(ArchiveSearchTest, SearchesDeflatedZipMembers)
+{
+    string text = string(100000, 'z') + "\ndeflated needle\n";
+
+    make_file("files.zip", zip({{"stored.txt", "stored"}}, {{"deflated.txt", deflate_data(text, -MAX_WBITS)}}));
+
+    EXPECT_EQ (vector<string> {"deflated.txt"}, search("files.zip", "needle"));
+    EXPECT_EQ (vector<string> {"stored.txt"}, search("files.zip", "^stored"));
+}
+
+
+TEST_F(ArchiveSearchTest, SkipsBinaryMembers)
+{
+    make_file("binary.gz", gzip(string("needle\0\1\2", 9)));
+
+    EXPECT_TRUE (search("binary.gz", "needle").empty());
+}
+
+
+TEST_F(ArchiveSearchTest, EngineReportsMembers)
+{
+    make_file("files.tar.gz", gzip(tar({{"a.txt", "alpha\n"}, {"b.txt", "beta needle\n"}})));
+    make_file("plain.txt", "plain needle\n");
+
+    NameMatcher name("*", NameMatcher::SYNTAX_FNMATCH, false);
+    ContentMatcher content("needle", false);
+    SearchEngine::Options options;
+
+    options.root = dir;
+    options.archives = true;
+
+    SearchEngine engine(options, name, &content);
+    vector<SearchEngine::Result> results;
+    vector<string> paths;
+
+    engine.run();
+    engine.take_results(results);
+
+    for (auto &r : results)
+        paths.push_back(r.full_path().substr(dir.size()));
+
+    sort (paths.begin(), paths.end());
+
+    EXPECT_EQ ((vector<string> {"/files.tar.gz#b.txt", "/plain.txt"}), paths);
+}
+#endif
+
+
+#ifdef HAVE_BZIP2
+TEST_F(ArchiveSearchTest, SearchesBzip2Files)
+{
+    string text = string(50000, 'b') + "\nbzip2 needle\n";
+    vector<char> out(text.size() + text.size() / 100 + 600);
+    unsigned len = out.size();
+
+    ASSERT_EQ (BZ_OK, BZ2_bzBuffToBuffCompress (out.data(), &len, (char *) text.data(), text.size(), 9, 0, 0));
+
+    string compressed(out.data(), len);
+
+    make_file("text.bz2", compressed + compressed);
+
+    EXPECT_EQ (vector<string> {""}, search("text.bz2", "bzip2 needle"));
+}
+#endif
+
+
+#ifdef HAVE_LZMA
+TEST_F(ArchiveSearchTest, SearchesXzFiles)
+{
+    string text = tar({{"x.txt", "xz needle\n"}});
+    vector<uint8_t> out(lzma_stream_buffer_bound (text.size()));
+    size_t len = 0;
+
+    ASSERT_EQ (LZMA_OK, lzma_easy_buffer_encode (1, LZMA_CHECK_CRC64, nullptr, (const uint8_t *) text.data(), text.size(),
+                                                 out.data(), &len, out.size()));
+    make_file("files.tar.xz", string((char *) out.data(), len));
+
+    EXPECT_EQ (vector<string> {"x.txt"}, search("files.tar.xz", "needle"));
+}
+#endif
+
+
+#ifdef HAVE_ZSTD
+TEST_F(ArchiveSearchTest, SearchesZstdFiles)
+{
+    string text = string(70000, 's') + "\nzstd needle\n";
+    string out(ZSTD_compressBound (text.size()), '\0');
+    size_t len = ZSTD_compress (&out[0], out.size(), text.data(), text.size(), 1);
+
+    ASSERT_FALSE (ZSTD_isError (len));
+    out.resize(len);
+    make_file("text.zst", out + out);
+
+    EXPECT_EQ (vector<string> {""}, search("text.zst", "zstd needle"));
+}
+#endif
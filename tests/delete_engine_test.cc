@@ -0,0 +1,159 @@
+/**
+ * @file delete_engine_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for the native delete engine.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-delete-engine.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::DeleteEngine;
+
+
+class DeleteEngineTest : public TempDirTest
+{
+  protected:
+
+    void make_file(const string &path)
+    {
+        write_file(path, path);
+    }
+
+    /** Creates a tree @a depth levels deep with @a width directories and files per level */
+    void make_tree(const string &path, int depth, int width)
+    {
+        ASSERT_EQ (0, mkdir (path.c_str(), 0755));
+
+        for (int i=0; i<width; ++i)
+        {
+            make_file (path + "/f" + to_string(i));
+
+            if (depth > 1)
+                make_tree (path + "/d" + to_string(i), depth-1, width);
+        }
+    }
+
+    bool exists(const string &path)
+    {
+        struct stat st;
+        return lstat (path.c_str(), &st) == 0;
+    }
+};
+
+
+TEST_F(DeleteEngineTest, DeletesTrees)
+{
+    make_tree (dir + "/a", 4, 5);
+    make_tree (dir + "/b", 2, 50);
+    make_file (dir + "/c");
+
+    DeleteEngine engine(4);
+
+    ASSERT_TRUE (engine.run({dir + "/a", dir + "/b", dir + "/c"}));
+
+    EXPECT_FALSE (exists (dir + "/a"));
+    EXPECT_FALSE (exists (dir + "/b"));
+    EXPECT_FALSE (exists (dir + "/c"));
+    EXPECT_EQ (vector<bool>(3, true), engine.removed);
+    EXPECT_EQ (3u, engine.items_done);
+
+    // a has 1+5+25+125 directories with 5 files each, b 1+50 with 50 files each, and c
+    EXPECT_EQ (156u * 6 + 51u * 51 + 1, engine.files_removed);
+}
+
+
+TEST_F(DeleteEngineTest, SymlinksAreNotFollowed)
+{
+    make_tree (dir + "/target", 2, 3);
+    ASSERT_EQ (0, mkdir ((dir + "/a").c_str(), 0755));
+    ASSERT_EQ (0, symlink ("../target", (dir + "/a/link").c_str()));
+    ASSERT_EQ (0, symlink ("target", (dir + "/link").c_str()));
+
+    DeleteEngine engine;
+
+    ASSERT_TRUE (engine.run({dir + "/a", dir + "/link"}));
+    EXPECT_FALSE (exists (dir + "/a"));
+    EXPECT_FALSE (exists (dir + "/link"));
+    EXPECT_TRUE (exists (dir + "/target/d2/f2"));
+}
+
+
+TEST_F(DeleteEngineTest, MissingItemCountsAsRemoved)
+{
+    DeleteEngine engine;
+
+    ASSERT_TRUE (engine.run({dir + "/missing"}));
+    EXPECT_TRUE (engine.removed[0]);
+}
+
+
+TEST_F(DeleteEngineTest, SkipKeepsParents)
+{
+    if (geteuid () == 0)
+    {
+        std::cout << "Permissions are not checked for root, skipping" << std::endl;
+        return;
+    }
+
+    make_tree (dir + "/a", 3, 3);
+    make_file (dir + "/b");
+    ASSERT_EQ (0, chmod ((dir + "/a/d1").c_str(), 0555));
+
+    DeleteEngine engine(2);
+    int errors = 0;
+
+    engine.on_error = [&] (const string &, int error) { ++errors; EXPECT_EQ (EACCES, error); return GnomeCmd::ERROR_ACTION_SKIP; };
+
+    ASSERT_TRUE (engine.run({dir + "/a", dir + "/b"}));
+
+    // the files and the emptied subdirectories of the read only directory
+    EXPECT_EQ (6, errors);
+    EXPECT_TRUE (exists (dir + "/a/d1/f0"));
+    EXPECT_FALSE (exists (dir + "/a/d1/d0/f0"));
+    EXPECT_FALSE (exists (dir + "/a/d0"));
+    EXPECT_FALSE (engine.removed[0]);
+    EXPECT_TRUE (engine.removed[1]);
+}
+
+
+TEST_F(DeleteEngineTest, AbortStops)
+{
+    if (geteuid () == 0)
+    {
+        std::cout << "Permissions are not checked for root, skipping" << std::endl;
+        return;
+    }
+
+    make_tree (dir + "/a", 2, 3);
+    ASSERT_EQ (0, chmod ((dir + "/a").c_str(), 0555));
+
+    DeleteEngine engine;
+    int errors = 0;
+
+    engine.on_error = [&] (const string &, int) { ++errors; return GnomeCmd::ERROR_ACTION_ABORT; };
+
+    EXPECT_FALSE (engine.run({dir + "/a"}));
+    EXPECT_EQ (1, errors);
+    EXPECT_FALSE (engine.removed[0]);
+}
@@ -0,0 +1,217 @@
+/**
+ * @file duplicate_finder_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for finding and resolving local files with the same content.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-duplicate-finder.h"
+#include "../src/gnome-cmd-file-io.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::ContentHash;
+using GnomeCmd::DuplicateFinder;
+
+
+class DuplicateFinderTest : public TempDirTest
+{
+  protected:
+
+    void make_dir(const string &path)
+    {
+        ASSERT_EQ (0, mkdir ((dir + path).c_str(), 0755));
+    }
+
+    void make_file(const string &path, const string &content)
+    {
+        write_file(dir + path, content);
+    }
+
+    string read_file(const string &path)
+    {
+        return ::read_file(dir + path);
+    }
+
+    ino_t inode(const string &path)
+    {
+        struct stat st;
+        return lstat ((dir + path).c_str(), &st) == 0 ? st.st_ino : 0;
+    }
+
+    /**
+     * @returns the groups with paths relative to dir
+     */
+    vector<vector<string>> groups(DuplicateFinder &finder)
+    {
+        vector<vector<string>> result;
+
+        for (auto &g : finder.get_groups())
+        {
+            vector<string> paths;
+
+            for (auto &p : g.paths)
+                paths.push_back(p.substr(dir.size()));
+
+            result.push_back(paths);
+        }
+
+        return result;
+    }
+};
+
+
+TEST(ContentHashTest, KnownValues)
+{
+    // the same as xxHash64 with seed 0
+    EXPECT_EQ (0xef46db3751d8e999ULL, ContentHash::of("", 0));
+    EXPECT_EQ (0x44bc2cf5ad770999ULL, ContentHash::of("abc", 3));
+}
+
+
+TEST(ContentHashTest, StreamsInPieces)
+{
+    string data;
+
+    for (int i=0; i<1000; ++i)
+        data += (char) (i * 7 + i / 13);
+
+    uint64_t whole = ContentHash::of(data.data(), data.size());
+
+    for (size_t split : {1u, 5u, 31u, 32u, 33u, 64u, 100u, 999u})
+    {
+        ContentHash h;
+
+        for (size_t pos=0; pos<data.size(); pos+=split)
+            h.update(data.data() + pos, min (split, data.size() - pos));
+
+        EXPECT_EQ (whole, h.digest()) << split;
+    }
+
+    EXPECT_NE (whole, ContentHash::of(data.data(), data.size() - 1));
+}
+
+
+TEST_F(DuplicateFinderTest, FindsGroups)
+{
+    string big(300 * 1024, 'x');
+    string big_other = big;
+
+    big_other[150 * 1024] = 'y';                // differs only where the partial hash doesn't look
+
+    make_dir("/a");
+    make_dir("/a/b");
+    make_file("/one", "same content\n");
+    make_file("/a/two", "same content\n");
+    make_file("/a/b/three", "same content\n");
+    make_file("/a/other", "else content\n");    // same size
+    make_file("/a/empty", "");
+    make_file("/a/b/empty", "");
+    make_file("/big1", big);
+    make_file("/a/big2", big);
+    make_file("/a/b/big3", big_other);
+    ASSERT_EQ (0, link ((dir + "/big1").c_str(), (dir + "/a/b/big1-link").c_str()));
+    ASSERT_EQ (0, symlink ((dir + "/one").c_str(), (dir + "/a/link").c_str()));
+
+    DuplicateFinder finder;
+
+    finder.add(dir);
+    finder.run();
+
+    EXPECT_EQ (DuplicateFinder::STAGE_DONE, finder.stage);
+
+    // the larger one first, big1 is listed under one of its names only
+    auto g = groups(finder);
+
+    ASSERT_EQ (2u, g.size());
+    EXPECT_EQ ((vector<string> {"/a/b/big1-link", "/a/big2"}), g[0]);
+    EXPECT_EQ ((vector<string> {"/a/b/three", "/a/two", "/one"}), g[1]);
+    EXPECT_EQ (big.size(), finder.get_groups()[0].wasted());
+
+    // all three big files are read in full once and partially once, the small ones once
+    EXPECT_EQ (4 * big.size() + 4 * 13, finder.bytes_total.load());
+    EXPECT_EQ (3 * big.size() + 3 * 2 * DuplicateFinder::PARTIAL_SIZE + 4 * 13, finder.bytes_read.load());
+}
+
+
+TEST_F(DuplicateFinderTest, SkipsUniqueSizes)
+{
+    make_file("/a", string(1000000, 'a'));
+    make_file("/b", string(1000001, 'a'));
+
+    DuplicateFinder finder;
+
+    finder.add(dir + "/a");
+    finder.add(dir + "/b");
+    finder.run();
+
+    EXPECT_TRUE (finder.get_groups().empty());
+    EXPECT_EQ (0u, finder.bytes_read.load());
+    EXPECT_EQ (2000001u, finder.bytes_total.load());
+}
+
+
+TEST_F(DuplicateFinderTest, Resolves)
+{
+    make_file("/keep", "duplicate\n");
+    make_file("/dup1", "duplicate\n");
+    make_file("/dup2", "duplicate\n");
+    make_file("/dup3", "duplicate\n");
+    make_file("/changed", "duplicatf\n");
+
+    EXPECT_TRUE (DuplicateFinder::same_content(dir + "/keep", dir + "/dup1"));
+    EXPECT_FALSE (DuplicateFinder::same_content(dir + "/keep", dir + "/changed"));
+    EXPECT_FALSE (DuplicateFinder::same_content(dir + "/keep", dir + "/missing"));
+
+    EXPECT_EQ (0, DuplicateFinder::resolve(dir + "/keep", dir + "/dup1", DuplicateFinder::ACTION_HARDLINK));
+    EXPECT_EQ (inode("/keep"), inode("/dup1"));
+    EXPECT_EQ (0, DuplicateFinder::resolve(dir + "/keep", dir + "/dup1", DuplicateFinder::ACTION_HARDLINK));
+
+    EXPECT_EQ (0, DuplicateFinder::resolve(dir + "/keep", dir + "/dup2", DuplicateFinder::ACTION_DELETE));
+    EXPECT_EQ (0u, inode("/dup2"));
+
+    // not every file system can share data blocks, the file must be unchanged then
+    ASSERT_EQ (0, chmod ((dir + "/dup3").c_str(), 0640));
+
+    int error = DuplicateFinder::resolve(dir + "/keep", dir + "/dup3", DuplicateFinder::ACTION_REFLINK);
+
+    EXPECT_EQ ("duplicate\n", read_file("/dup3"));
+    EXPECT_NE (inode("/keep"), inode("/dup3"));
+
+    if (error)
+    {
+        vector<string> names;
+        int list_error;
+
+        ASSERT_TRUE (GnomeCmd::list_directory(dir, names, list_error));
+        EXPECT_EQ (4u, names.size());                           // no temporary file left
+    }
+    else
+    {
+        struct stat st;
+
+        ASSERT_EQ (0, stat ((dir + "/dup3").c_str(), &st));
+        EXPECT_EQ (0640u, st.st_mode & 07777);
+    }
+
+    EXPECT_NE (0, DuplicateFinder::resolve(dir + "/keep", dir + "/missing", DuplicateFinder::ACTION_HARDLINK));
+}
@@ -0,0 +1,179 @@
+/**
+ * @file free_space_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for mapping paths to mounts and for the cached free
+ * space of local volumes.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-free-space.h"
+
+using namespace std;
+using GnomeCmd::FreeSpace;
+
+
+TEST(FreeSpaceTest, ParsesMountinfo)
+{
+    istringstream in("22 1 0:21 / /proc rw,nosuid shared:12 - proc proc rw\n"
+                     "36 22 98:0 / /mnt/with\\040space rw,noatime master:1 shared:2 - ext4 /dev/sda1 rw\n"
+                     "broken line\n"
+                     "40 22 0:45 / /run/user/1000 rw - tmpfs tmpfs rw,size=1024k\n");
+    vector<FreeSpace::Mount> mounts;
+
+    ASSERT_TRUE (FreeSpace::parse_mountinfo(in, mounts));
+    ASSERT_EQ (3u, mounts.size());
+
+    EXPECT_EQ ("/proc", mounts[0].mount_point);
+    EXPECT_EQ ("proc", mounts[0].fs_type);
+
+    EXPECT_EQ ("/mnt/with space", mounts[1].mount_point);
+    EXPECT_EQ ("ext4", mounts[1].fs_type);
+    EXPECT_EQ ("/dev/sda1", mounts[1].source);
+    EXPECT_EQ (98u, mounts[1].dev_major);
+    EXPECT_EQ (0u, mounts[1].dev_minor);
+
+    EXPECT_EQ ("/run/user/1000", mounts[2].mount_point);
+}
+
+
+TEST(FreeSpaceTest, FindsLongestMountPoint)
+{
+    char tmpl[] = "/tmp/gcmd-mountinfo-XXXXXX";
+    int fd = mkstemp (tmpl);
+    ASSERT_GE (fd, 0);
+    close (fd);
+
+    // devices which no real path is on, only the prefix counts
+    ofstream(tmpl) << "1 0 250:1 / / rw - ext4 /dev/root rw\n"
+                      "2 1 250:2 / /data rw - ext4 /dev/data rw\n"
+                      "3 2 250:3 / /data/sub rw - xfs /dev/sub rw\n";
+
+    FreeSpace free_space(chrono::milliseconds(2000), tmpl);
+    FreeSpace::Mount mount;
+
+    ASSERT_TRUE (free_space.lookup("/data/sub/file", mount));
+    EXPECT_EQ ("/data/sub", mount.mount_point);
+
+    ASSERT_TRUE (free_space.lookup("/data/subway", mount));
+    EXPECT_EQ ("/data", mount.mount_point);
+
+    ASSERT_TRUE (free_space.lookup("/etc", mount));
+    EXPECT_EQ ("/", mount.mount_point);
+
+    unlink (tmpl);
+}
+
+
+TEST(FreeSpaceTest, FindsRealMount)
+{
+    FreeSpace free_space;
+    FreeSpace::Mount mount;
+
+    ASSERT_TRUE (free_space.lookup("/proc/self", mount));
+    EXPECT_EQ ("/proc", mount.mount_point);
+    EXPECT_EQ ("proc", mount.fs_type);
+}
+
+
+TEST(FreeSpaceTest, RefreshesInBackground)
+{
+    FreeSpace free_space(chrono::milliseconds(0));
+    FreeSpace::Space space;
+
+    mutex m;
+    condition_variable cond;
+    int updates = 0;
+
+    free_space.on_updated = [&] (const string &)
+    {
+        lock_guard<mutex> lock(m);
+        updates++;
+        cond.notify_all();
+    };
+
+    // nothing is known at first, the result comes with on_updated
+    EXPECT_FALSE (free_space.get("/tmp", space));
+
+    {
+        unique_lock<mutex> lock(m);
+        ASSERT_TRUE (cond.wait_for(lock, chrono::seconds(5), [&] { return updates == 1; }));
+    }
+
+    // outdated at once, returned anyway and refreshed again
+    ASSERT_TRUE (free_space.get("/tmp", space));
+    EXPECT_GT (space.size, 0u);
+    EXPECT_GE (space.free, space.avail);
+
+    unique_lock<mutex> lock(m);
+    EXPECT_TRUE (cond.wait_for(lock, chrono::seconds(5), [&] { return updates == 2; }));
+}
+
+
+TEST(FreeSpaceTest, WaitsAndCaches)
+{
+    FreeSpace free_space(chrono::milliseconds(60000));
+    FreeSpace::Space space, cached;
+    int updates = 0;
+
+    free_space.on_updated = [&] (const string &) { updates++; };
+
+    ASSERT_TRUE (free_space.get("/tmp", space, true));
+    EXPECT_GT (space.size, 0u);
+    EXPECT_GT (space.block_size, 0u);
+
+    ASSERT_TRUE (free_space.get("/tmp/..", cached));
+    EXPECT_EQ (space.size, cached.size);
+    EXPECT_EQ (0, updates);
+
+    // a path on a known volume gets its result, whether it exists or not
+    EXPECT_TRUE (free_space.get("/tmp/does/not/exist", cached));
+
+    FreeSpace other;
+    EXPECT_FALSE (other.get("/does/not/exist", space, true));
+}
+
+
+TEST(FreeSpaceTest, ChecksSpaceAndInodes)
+{
+    FreeSpace::Space space;
+
+    space.avail = 100 * 4096;
+    space.block_size = 4096;
+    space.files = 1000;
+    space.files_avail = 10;
+
+    EXPECT_EQ (FreeSpace::FITS, FreeSpace::check(space, 50 * 4096, 10));
+    EXPECT_EQ (FreeSpace::TOO_LITTLE_SPACE, FreeSpace::check(space, 100 * 4096, 1));
+    EXPECT_EQ (FreeSpace::TOO_FEW_INODES, FreeSpace::check(space, 4096, 11));
+
+    // volumes like btrfs have no fixed number of inodes
+    space.files = 0;
+    space.files_avail = 0;
+    EXPECT_EQ (FreeSpace::FITS, FreeSpace::check(space, 4096, 11));
+
+    space.read_only = true;
+    EXPECT_EQ (FreeSpace::READ_ONLY, FreeSpace::check(space, 0, 0));
+}
@@ -0,0 +1,140 @@
+/**
+ * @file gcmd_tests_tmpdir.h
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details The temporary directory the file system tests work in.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#pragma once
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+
+
+/**
+ * Creates a directory named @a prefix followed by six random characters.
+ *
+ * @returns its path or an empty string on failure
+ */
+inline std::string make_temp_dir(const std::string &prefix="/tmp/gcmd-test-")
+{
+    std::string tmpl = prefix + "XXXXXX";
+
+    return mkdtemp (&tmpl[0]) ? tmpl : std::string();
+}
+
+
+/**
+ * Removes the entry @a name of the directory @a dir_fd and all it holds.
+ * Directories are made accessible first, the tests leave some read-only.
+ * Symbolic links are removed, never followed.
+ *
+ * @returns false if anything is left
+ */
+inline bool remove_tree(int dir_fd, const char *name)
+{
+    struct stat st;
+
+    if (fstatat (dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+        return errno == ENOENT;
+
+    if (!S_ISDIR (st.st_mode))
+        return unlinkat (dir_fd, name, 0) == 0 || errno == ENOENT;
+
+    bool removed = true;
+
+    if ((st.st_mode & S_IRWXU) != S_IRWXU)
+        fchmodat (dir_fd, name, st.st_mode | S_IRWXU, 0);
+
+    int fd = openat (dir_fd, name, O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC);
+
+    if (DIR *dir = fd < 0 ? nullptr : fdopendir (fd))
+    {
+        while (struct dirent *entry = readdir (dir))
+            if (strcmp (entry->d_name, ".") != 0 && strcmp (entry->d_name, "..") != 0)
+                removed = remove_tree(fd, entry->d_name) && removed;
+
+        closedir (dir);
+    }
+    else
+        if (fd >= 0)
+            close (fd);
+
+    return unlinkat (dir_fd, name, AT_REMOVEDIR) == 0 && removed;
+}
+
+
+/**
+ * Removes @a path and, if it is a directory, all it holds.
+ */
+inline bool remove_tree(const std::string &path)
+{
+    return remove_tree(AT_FDCWD, path.c_str());
+}
+
+
+inline void write_file(const std::string &path, const std::string &content)
+{
+    std::ofstream f(path.c_str(), std::ios::binary);
+    f << content;
+}
+
+
+inline std::string read_file(const std::string &path)
+{
+    std::ifstream f(path.c_str(), std::ios::binary);
+    std::stringstream s;
+    s << f.rdbuf();
+    return s.str();
+}
+
+
+/**
+ * A test working in the directory @a dir, which is created for each test
+ * and removed afterwards with all it holds.
+ */
+class TempDirTest : public ::testing::Test
+{
+  protected:
+
+    std::string dir;
+
+    void SetUp() override
+    {
+        dir = make_temp_dir();
+        ASSERT_FALSE (dir.empty());
+    }
+
+    void TearDown() override
+    {
+        if (!dir.empty())
+        {
+            EXPECT_TRUE (remove_tree(dir));
+        }
+    }
+};
@@ -0,0 +1,208 @@
+/**
+ * @file ignore_rules_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for pruning directory walks by exclude globs and ignore files.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-duplicate-finder.h"
+#include "../src/gnome-cmd-search-engine.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::DuplicateFinder;
+using GnomeCmd::IgnoreRules;
+using GnomeCmd::NameMatcher;
+using GnomeCmd::SearchEngine;
+
+
+class IgnoreRulesTest : public TempDirTest
+{
+  protected:
+
+    void SetUp() override
+    {
+        ASSERT_NO_FATAL_FAILURE (TempDirTest::SetUp());
+
+        // a work tree with a build directory, dependencies and a nested project
+        for (auto d : {"/.git", "/src", "/src/build", "/node_modules", "/node_modules/x", "/lib", "/lib/gen"})
+            make_dir(d);
+
+        make_file("/.git/config", "foo");
+        make_file("/.gitignore", "# generated\nbuild/\nnode_modules\n*.o\n!keep.o\n/TODO\n");
+        make_file("/TODO", "foo");
+        make_file("/src/TODO", "foo");
+        make_file("/src/a.c", "foo");
+        make_file("/src/a.o", "foo");
+        make_file("/src/keep.o", "foo");
+        make_file("/src/build/b.c", "foo");
+        make_file("/node_modules/x/c.c", "foo");
+        make_file("/lib/.ignore", "gen/\n!*.o\n");
+        make_file("/lib/gen/d.c", "foo");
+        make_file("/lib/e.o", "foo");
+    }
+
+    void make_dir(const string &path)
+    {
+        ASSERT_EQ (0, mkdir ((dir + path).c_str(), 0755));
+    }
+
+    void make_file(const string &path, const string &content)
+    {
+        write_file(dir + path, content);
+    }
+
+    /**
+     * @returns the paths below @a root found by searching for "*", relative to dir and sorted
+     */
+    vector<string> search(const IgnoreRules &rules, const string &root="", uint64_t *dirs_searched=nullptr)
+    {
+        NameMatcher name("*", NameMatcher::SYNTAX_FNMATCH, false);
+        SearchEngine::Options options;
+
+        options.root = dir + root;
+        options.threads = 2;
+        options.ignore = &rules;
+
+        SearchEngine engine(options, name, nullptr);
+        vector<SearchEngine::Result> results;
+        vector<string> paths;
+
+        engine.run();
+        engine.take_results(results);
+
+        for (auto &r : results)
+            paths.push_back(r.path.substr(dir.size()));
+
+        sort (paths.begin(), paths.end());
+
+        if (dirs_searched)
+            *dirs_searched = engine.dirs_searched;
+
+        return paths;
+    }
+};
+
+
+TEST(IgnoreRulesGlobTest, Matches)
+{
+    EXPECT_TRUE (IgnoreRules::glob_match("*.o", "a.o"));
+    EXPECT_FALSE (IgnoreRules::glob_match("*.o", "a.c"));
+    EXPECT_FALSE (IgnoreRules::glob_match("*.o", "x/a.o"));
+    EXPECT_TRUE (IgnoreRules::glob_match("a?c", "abc"));
+    EXPECT_FALSE (IgnoreRules::glob_match("a?c", "a/c"));
+    EXPECT_TRUE (IgnoreRules::glob_match("[a-c]x[!0-9]", "bxy"));
+    EXPECT_FALSE (IgnoreRules::glob_match("[a-c]x[!0-9]", "bx5"));
+    EXPECT_TRUE (IgnoreRules::glob_match("[]]", "]"));
+    EXPECT_TRUE (IgnoreRules::glob_match("a[", "a["));
+    EXPECT_TRUE (IgnoreRules::glob_match("\\*", "*"));
+    EXPECT_FALSE (IgnoreRules::glob_match("\\*", "a"));
+
+    // "**" crosses directories, "**/" also matches none
+    EXPECT_TRUE (IgnoreRules::glob_match("**/foo", "foo"));
+    EXPECT_TRUE (IgnoreRules::glob_match("**/foo", "a/b/foo"));
+    EXPECT_FALSE (IgnoreRules::glob_match("**/foo", "a/xfoo"));
+    EXPECT_TRUE (IgnoreRules::glob_match("doc/**/*.pdf", "doc/x.pdf"));
+    EXPECT_TRUE (IgnoreRules::glob_match("doc/**/*.pdf", "doc/a/b/x.pdf"));
+    EXPECT_TRUE (IgnoreRules::glob_match("out/**", "out/a/b"));
+    EXPECT_FALSE (IgnoreRules::glob_match("out/**", "out"));
+}
+
+
+TEST(IgnoreRulesGlobTest, ExcludeGlobs)
+{
+    IgnoreRules rules(" *.tmp ; cache/ ;/top;a/*/c;\nCore*;;", false);
+    auto frame = rules.enter_root("/r");
+
+    ASSERT_TRUE (rules.active());
+    EXPECT_TRUE (rules.excluded(frame.get(), "/r/x/y", "z.tmp", false));
+    EXPECT_TRUE (rules.excluded(frame.get(), "/r/x", "cache", true));
+    EXPECT_FALSE (rules.excluded(frame.get(), "/r/x", "cache", false));
+    EXPECT_TRUE (rules.excluded(frame.get(), "/r", "top", false));
+    EXPECT_FALSE (rules.excluded(frame.get(), "/r/x", "top", false));
+    EXPECT_TRUE (rules.excluded(frame.get(), "/r/a/b", "c", true));
+    EXPECT_FALSE (rules.excluded(frame.get(), "/r/x/a/b", "c", true));
+    EXPECT_TRUE (rules.excluded(frame.get(), "/r", "Core.1234", false));
+    EXPECT_FALSE (rules.excluded(frame.get(), "/r", ".git", true));
+
+    EXPECT_FALSE (IgnoreRules(" ; ", false).active());
+}
+
+
+TEST_F(IgnoreRulesTest, PrunesByIgnoreFiles)
+{
+    IgnoreRules rules("", true);
+    uint64_t dirs_searched;
+
+    EXPECT_EQ ((vector<string> {"/.gitignore", "/lib", "/lib/.ignore", "/lib/e.o", "/src", "/src/TODO", "/src/a.c", "/src/keep.o"}),
+               search(rules, "", &dirs_searched));
+
+    // neither .git nor the ignored directories have been listed
+    EXPECT_EQ (3u, dirs_searched);
+
+    // without them, everything is found
+    EXPECT_EQ (19u, search(IgnoreRules("", false)).size());
+}
+
+
+TEST_F(IgnoreRulesTest, GlobsAndIgnoreFiles)
+{
+    // the ignore files win over the globs, so keep.o is found
+    IgnoreRules rules("*.c;keep.o;.git*;lib/", true);
+
+    EXPECT_EQ ((vector<string> {"/src", "/src/TODO", "/src/keep.o"}), search(rules));
+}
+
+
+TEST_F(IgnoreRulesTest, AppliesAboveTheRoot)
+{
+    IgnoreRules rules("", true);
+
+    // the .gitignore at the top of the work tree, its anchored /TODO is no match here
+    EXPECT_EQ ((vector<string> {"/src/TODO", "/src/a.c", "/src/keep.o"}), search(rules, "/src"));
+
+    // outside of a work tree, the files above the root are not read
+    ASSERT_EQ (0, rename ((dir + "/.git").c_str(), (dir + "/git").c_str()));
+
+    EXPECT_EQ ((vector<string> {"/src/TODO", "/src/a.c", "/src/a.o", "/src/build", "/src/build/b.c", "/src/keep.o"}), search(rules, "/src"));
+}
+
+
+TEST_F(IgnoreRulesTest, DuplicateFinder)
+{
+    IgnoreRules rules("", true);
+    DuplicateFinder::Options options;
+
+    options.ignore = &rules;
+
+    DuplicateFinder finder(options);
+
+    finder.add(dir);
+    finder.run();
+
+    auto &groups = finder.get_groups();
+
+    // the ignored copies of "foo" are not among them
+    ASSERT_EQ (1u, groups.size());
+    EXPECT_EQ ((vector<string> {dir + "/lib/e.o", dir + "/src/TODO", dir + "/src/a.c", dir + "/src/keep.o"}), groups[0].paths);
+}
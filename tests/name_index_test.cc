@@ -0,0 +1,257 @@
+/**
+ * @file name_index_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for the file name index used by the search.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-name-index.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::NameIndex;
+using GnomeCmd::NameIndexSet;
+using GnomeCmd::NameMatcher;
+
+
+class NameIndexTest : public ::testing::Test
+{
+  protected:
+
+    string tmp;
+    string dir;                             /**< the indexed tree */
+    string cache;                           /**< for the index files */
+
+    void SetUp() override
+    {
+        tmp = make_temp_dir();
+        ASSERT_FALSE (tmp.empty());
+        dir = tmp + "/tree";
+        cache = tmp + "/cache";
+
+        ASSERT_EQ (0, mkdir (dir.c_str(), 0755));
+        ASSERT_EQ (0, mkdir (cache.c_str(), 0755));
+        make_dir ("/src");
+        make_dir ("/src/lib");
+        make_dir ("/src/lib/deep");
+        make_dir ("/doc");
+        make_file ("/src/main.cc");
+        make_file ("/src/lib/util.cc");
+        make_file ("/src/lib/deep/Util.H");
+        make_file ("/doc/README");
+        ASSERT_EQ (0, symlink ((dir + "/src").c_str(), (dir + "/doc/link").c_str()));
+
+        // directories changed later get a different mtime, however fast the test runs
+        for (auto d : {"", "/src", "/src/lib", "/src/lib/deep", "/doc"})
+            age((dir + d).c_str());
+    }
+
+    void TearDown() override
+    {
+        if (!tmp.empty())
+        {
+            EXPECT_TRUE (remove_tree(tmp));
+        }
+    }
+
+    void make_dir(const string &path)
+    {
+        ASSERT_EQ (0, mkdir ((dir + path).c_str(), 0755));
+    }
+
+    void make_file(const string &path)
+    {
+        write_file(dir + path, "");
+    }
+
+    static void age(const char *path)
+    {
+        struct timespec times[2] = {{946684800, 0}, {946684800, 0}};
+        utimensat (AT_FDCWD, path, times, 0);
+    }
+
+    /**
+     * @returns the matches relative to dir, sorted
+     */
+    vector<string> search(const NameIndex &index, const string &pattern, const string &below="", int max_depth=-1)
+    {
+        NameMatcher name(pattern, NameMatcher::SYNTAX_FNMATCH, false);
+        vector<NameIndex::Match> matches;
+        vector<string> paths;
+
+        EXPECT_TRUE (index.search(dir + below, max_depth, name, matches));
+
+        for (auto &m : matches)
+            paths.push_back(m.path.substr(dir.size()));
+
+        sort (paths.begin(), paths.end());
+
+        return paths;
+    }
+};
+
+
+TEST_F(NameIndexTest, FindsByName)
+{
+    NameIndex index(cache + "/tree.idx");
+
+    ASSERT_TRUE (index.build(dir + "/"));
+    EXPECT_EQ (dir, index.get_root());
+    EXPECT_EQ (9u, index.get_entries());
+
+    vector<string> expected {"/src/lib/deep/Util.H", "/src/lib/util.cc"};
+    EXPECT_EQ (expected, search(index, "*util*"));
+
+    // below the root and limited in depth, symlinks are not followed
+    EXPECT_EQ (vector<string> {"/src/lib/util.cc"}, search(index, "*util*", "/src/lib", 0));
+    EXPECT_EQ (vector<string> {"/doc/link"}, search(index, "li*", "/doc"));
+    expected = {"/doc", "/src"};
+    EXPECT_EQ (expected, search(index, "*", "", 0));
+
+    vector<NameIndex::Match> matches;
+    NameMatcher any("*", NameMatcher::SYNTAX_FNMATCH, false);
+
+    EXPECT_FALSE (index.search(dir + "/none", -1, any, matches));
+    EXPECT_FALSE (index.search(tmp, -1, any, matches));
+    EXPECT_FALSE (index.search(dir + "x", -1, any, matches));
+    EXPECT_TRUE (matches.empty());
+}
+
+
+TEST_F(NameIndexTest, RereadsOnlyChangedDirectories)
+{
+    NameIndex first(cache + "/1.idx");
+    NameIndex second(cache + "/2.idx");
+
+    ASSERT_TRUE (first.build(dir));
+    EXPECT_EQ (5u, first.dirs_read);
+
+    ASSERT_TRUE (second.build(dir, &first));
+    EXPECT_EQ (0u, second.dirs_read);
+    EXPECT_EQ (5u, second.dirs_reused);
+    EXPECT_EQ (first.get_entries(), second.get_entries());
+
+    make_file ("/src/lib/deep/new.cc");
+    make_dir ("/doc/more");
+    make_file ("/doc/more/util.txt");
+
+    ASSERT_TRUE (first.build(dir, &second));
+    EXPECT_EQ (3u, first.dirs_read);        // deep, doc and the new doc/more
+    EXPECT_EQ (3u, first.dirs_reused);
+
+    vector<string> expected {"/doc/more/util.txt", "/src/lib/deep/Util.H", "/src/lib/util.cc"};
+    EXPECT_EQ (expected, search(first, "*util*"));
+    EXPECT_EQ (vector<string> {"/src/lib/deep/new.cc"}, search(first, "new*"));
+}
+
+
+TEST_F(NameIndexTest, LoadsAndChecksTheFile)
+{
+    string file = cache + "/tree.idx";
+
+    {
+        NameIndex index(file);
+        ASSERT_TRUE (index.build(dir));
+    }
+
+    NameIndex index(file);
+
+    ASSERT_TRUE (index.load());
+    EXPECT_EQ (dir, index.get_root());
+    EXPECT_EQ (vector<string> {"/src/main.cc"}, search(index, "main*"));
+
+    struct stat st;
+    ASSERT_EQ (0, stat (file.c_str(), &st));
+
+    // the root directory's subtree ending far out of the table
+    string data;
+    {
+        ifstream in(file.c_str(), ios::binary);
+        data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+
+    size_t end_field = 40 + ((dir.size() + 7) & ~7) + 16;
+
+    data.replace(end_field, 4, "\xff\xff\xff\x7f", 4);
+    {
+        ofstream out(file.c_str(), ios::binary|ios::trunc);
+        out << data;
+    }
+    EXPECT_FALSE (index.load());
+
+    // too short
+    ASSERT_EQ (0, truncate (file.c_str(), st.st_size - 1));
+    EXPECT_FALSE (index.load());
+    EXPECT_FALSE (index.loaded());
+
+    ASSERT_EQ (0, truncate (file.c_str(), 0));
+    EXPECT_FALSE (index.load());
+}
+
+
+TEST_F(NameIndexTest, SetRefreshesInTheBackground)
+{
+    {
+        NameIndexSet set(cache);
+        bool changed = true;
+
+        EXPECT_EQ (nullptr, set.find(dir));
+
+        set.refresh(dir + "/src");
+        set.wait();
+
+        auto src = set.find(dir + "/src/lib", &changed);
+        ASSERT_NE (nullptr, src);
+        EXPECT_EQ (dir + "/src", src->get_root());
+        EXPECT_FALSE (changed);
+        EXPECT_EQ (nullptr, set.find(dir + "/doc"));
+
+        set.mark_changed(dir + "/src/lib");
+        set.find(dir + "/src", &changed);
+        EXPECT_TRUE (changed);
+
+        // the index above replaces the one below
+        set.refresh(dir);
+        set.wait();
+
+        auto all = set.find(dir + "/src/lib", &changed);
+        ASSERT_NE (nullptr, all);
+        EXPECT_EQ (dir, all->get_root());
+        EXPECT_FALSE (changed);
+        EXPECT_NE (0, access (src->get_file().c_str(), F_OK));
+
+        // a directory below is refreshed in the index of the root
+        set.refresh(dir + "/doc");
+        set.wait();
+        EXPECT_EQ (dir, set.find(dir + "/doc")->get_root());
+    }
+
+    // the indexes are kept on disk
+    NameIndexSet set(cache);
+    auto index = set.find(dir + "/doc");
+
+    ASSERT_NE (nullptr, index);
+    EXPECT_EQ (vector<string> {"/doc/README"}, search(*index, "readme"));
+}
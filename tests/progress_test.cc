@@ -0,0 +1,172 @@
+/**
+ * @file progress_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for handing progress from worker threads to the GUI and
+ * for the transfer rates shown in the progress window.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-progress.h"
+
+using namespace std;
+using GnomeCmd::ProgressEvents;
+using GnomeCmd::Throughput;
+
+
+TEST(ProgressEventsTest, KeepsOrder)
+{
+    ProgressEvents events;
+    ProgressEvents::Event event;
+
+    EXPECT_FALSE (events.pop(event));
+
+    EXPECT_TRUE (events.push("a", 1));
+    EXPECT_TRUE (events.push("b", 2));
+
+    ASSERT_TRUE (events.pop(event));
+    EXPECT_EQ ("a", event.path);
+    EXPECT_EQ (1u, event.size);
+
+    ASSERT_TRUE (events.pop(event));
+    EXPECT_EQ ("b", event.path);
+
+    EXPECT_FALSE (events.pop(event));
+}
+
+
+TEST(ProgressEventsTest, DropsWhenFull)
+{
+    ProgressEvents events;
+    ProgressEvents::Event event;
+
+    for (int i=0; i<ProgressEvents::SLOTS; ++i)
+        EXPECT_TRUE (events.push(to_string (i)));
+
+    EXPECT_FALSE (events.push("dropped"));
+    EXPECT_EQ (1u, events.dropped());
+
+    ASSERT_TRUE (events.pop_latest(event));
+    EXPECT_EQ (to_string (ProgressEvents::SLOTS - 1), event.path);
+
+    EXPECT_TRUE (events.push("next"));
+    ASSERT_TRUE (events.pop(event));
+    EXPECT_EQ ("next", event.path);
+}
+
+
+TEST(ProgressEventsTest, PassesEventsBetweenThreads)
+{
+    const int N = 100000;
+
+    ProgressEvents events;
+    int received = 0;
+    int last = -1;
+    bool ordered = true;
+
+    thread producer([&]
+    {
+        for (int i=0; i<N; ++i)
+            while (!events.push(to_string (i), i))
+                this_thread::yield();
+    });
+
+    while (received < N)
+    {
+        ProgressEvents::Event event;
+
+        if (!events.pop(event))
+        {
+            this_thread::yield();
+            continue;
+        }
+
+        int i = stoi (event.path);
+
+        ordered = ordered && i == last + 1 && event.size == (uint64_t) i;
+        last = i;
+        ++received;
+    }
+
+    producer.join();
+
+    EXPECT_TRUE (ordered);
+    EXPECT_EQ (N - 1, last);
+}
+
+
+TEST(ThroughputTest, Rates)
+{
+    Throughput throughput;
+
+    EXPECT_EQ (0, throughput.bytes_per_second());
+
+    // 1 MB and 10 files per second for 10 seconds, then nothing for 3 seconds
+    for (int i=0; i<=100; ++i)
+        throughput.add(i / 10.0, i * 100000, i);
+
+    EXPECT_NEAR (1000000, throughput.bytes_per_second(), 1);
+    EXPECT_NEAR (10, throughput.files_per_second(), 0.01);
+    EXPECT_NEAR (1000000, throughput.average_bytes_per_second(), 1);
+
+    for (int i=101; i<=130; ++i)
+        throughput.add(i / 10.0, 10000000, 100);
+
+    EXPECT_EQ (0, throughput.bytes_per_second());
+    EXPECT_EQ (0, throughput.files_per_second());
+    EXPECT_NEAR (10000000 / 13.0, throughput.average_bytes_per_second(), 1);
+    EXPECT_NEAR (100 / 13.0, throughput.average_files_per_second(), 0.01);
+}
+
+
+TEST(ThroughputTest, HistoryHasOneValuePerSecond)
+{
+    Throughput throughput;
+
+    for (int i=0; i<=50; ++i)
+        throughput.add(i / 10.0, i * 100000, 0);
+
+    ASSERT_EQ (5u, throughput.get_history().size());
+    EXPECT_NEAR (1000000, throughput.get_history().back(), 1);
+    EXPECT_NEAR (1000000, throughput.get_history_max(), 1);
+
+    // a stalled GUI catches up with the missing seconds, the history stays bounded
+    throughput.add(500, 5000000, 0);
+
+    EXPECT_EQ ((size_t) Throughput::HISTORY, throughput.get_history().size());
+}
+
+
+TEST(ThroughputTest, CountersGoingBack)
+{
+    Throughput throughput;
+
+    throughput.add(0, 5000000, 5);
+    throughput.add(0.5, 6000000, 6);
+
+    // a retry starts the failed file over
+    throughput.add(1, 1000000, 2);
+
+    EXPECT_EQ (0, throughput.bytes_per_second());
+    EXPECT_EQ (0, throughput.files_per_second());
+    EXPECT_EQ (0, throughput.average_bytes_per_second());
+    EXPECT_EQ (0, throughput.average_files_per_second());
+}
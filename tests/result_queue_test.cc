@@ -0,0 +1,92 @@
+/**
+ * @file result_queue_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for the queue which passes search results to the GUI.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-result-queue.h"
+
+using namespace std;
+using GnomeCmd::ResultQueue;
+
+
+TEST(ResultQueueTest, KeepsTheOrder)
+{
+    ResultQueue<string> queue;
+    vector<string> batch {"old"};
+
+    EXPECT_TRUE (queue.empty());
+
+    queue.push("a");
+    queue.push(string("b"));
+    queue.push("c");
+    EXPECT_FALSE (queue.empty());
+
+    queue.take(batch);
+
+    vector<string> expected {"old", "a", "b", "c"};
+    EXPECT_EQ (expected, batch);
+    EXPECT_TRUE (queue.empty());
+
+    batch.clear();
+    queue.take(batch);
+    EXPECT_TRUE (batch.empty());
+
+    queue.push("left");                 // freed by the destructor
+}
+
+
+TEST(ResultQueueTest, ManyProducers)
+{
+    const int PRODUCERS = 4;
+    const int ITEMS = 50000;
+
+    ResultQueue<pair<int,int>> queue;
+    atomic<int> running {PRODUCERS};
+    vector<thread> producers;
+    vector<pair<int,int>> items;
+
+    for (int p=0; p<PRODUCERS; ++p)
+        producers.emplace_back([&, p] {
+            for (int i=0; i<ITEMS; ++i)
+                queue.push(make_pair(p, i));
+            running--;
+        });
+
+    // taken while they are pushed
+    while (running > 0)
+        queue.take(items);
+
+    for (auto &t : producers)
+        t.join();
+
+    queue.take(items);
+
+    ASSERT_EQ ((size_t) PRODUCERS * ITEMS, items.size());
+
+    vector<int> next(PRODUCERS, 0);
+
+    for (auto &i : items)
+        ASSERT_EQ (next[i.first]++, i.second);
+}
@@ -0,0 +1,101 @@
+/**
+ * @file search_bench.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Measures how the local search scales with the number of
+ * threads, by name only and by content. Not run by 'make check', build it
+ * with 'make search_bench' and point it at a large source tree:
+ *
+ *   ./search_bench /usr/src/linux '*.c' 'EXPORT_SYMBOL_GPL'
+ *
+ * Every search is run once before it is timed, so that the tree is in the
+ * page cache and the numbers show the CPU work, not the disk.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../src/gnome-cmd-search-engine.h"
+
+using namespace std;
+using GnomeCmd::ContentMatcher;
+using GnomeCmd::NameMatcher;
+using GnomeCmd::SearchEngine;
+
+
+static double run (const char *root, const NameMatcher &name, const ContentMatcher *content, unsigned threads, uint64_t &matches, uint64_t &entries)
+{
+    SearchEngine::Options options;
+
+    options.root = root;
+    options.threads = threads;
+
+    SearchEngine engine(options, name, content);
+
+    auto start = chrono::steady_clock::now();
+    engine.run();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    matches = engine.matches;
+    entries = engine.files_searched;
+
+    return secs;
+}
+
+
+int main (int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf (stderr, "usage: %s DIR NAME_PATTERN [CONTENT_REGEX]\n", argv[0]);
+        return 1;
+    }
+
+    NameMatcher name(argv[2], NameMatcher::SYNTAX_FNMATCH, false);
+    ContentMatcher content(argc > 3 ? argv[3] : "", true);
+    unsigned max_threads = max (thread::hardware_concurrency(), 1u);
+
+    for (int pass=0; pass < (argc > 3 ? 2 : 1); ++pass)
+    {
+        const ContentMatcher *c = pass ? &content : nullptr;
+        uint64_t matches, entries;
+
+        run (argv[1], name, c, max_threads, matches, entries);
+
+        printf ("%s: %llu entries, %llu matches\n", pass ? "name and content" : "name", (unsigned long long) entries, (unsigned long long) matches);
+        printf ("%8s %10s %8s\n", "threads", "seconds", "speedup");
+
+        double single = 0;
+
+        for (unsigned n=1; n<=max_threads; n*=2)
+        {
+            double secs = run (argv[1], name, c, n, matches, entries);
+
+            if (n == 1)
+                single = secs;
+
+            printf ("%8u %10.3f %8.2f\n", n, secs, single / secs);
+        }
+    }
+
+    return 0;
+}
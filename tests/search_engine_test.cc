@@ -0,0 +1,341 @@
+/**
+ * @file search_engine_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for searching local directories by name and content.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-search-engine.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::ContentMatcher;
+using GnomeCmd::NameMatcher;
+using GnomeCmd::SearchEngine;
+using GnomeCmd::StatFilter;
+
+
+class SearchEngineTest : public TempDirTest
+{
+  protected:
+
+    void SetUp() override
+    {
+        ASSERT_NO_FATAL_FAILURE (TempDirTest::SetUp());
+
+        make_dir ("/src");
+        make_dir ("/src/lib");
+        make_dir ("/src/lib/deep");
+        make_dir ("/doc");
+        make_file ("/src/main.cc", "int main ()\n{\n    return 0;\n}\n");
+        make_file ("/src/lib/util.cc", "// helpers\nstatic int helper ()");
+        make_file ("/src/lib/deep/Util.H", "#pragma once\n");
+        make_file ("/doc/README", "read me\n");
+        ASSERT_EQ (0, symlink ((dir + "/src").c_str(), (dir + "/doc/link").c_str()));
+    }
+
+    void make_dir(const string &path)
+    {
+        ASSERT_EQ (0, mkdir ((dir + path).c_str(), 0755));
+    }
+
+    void make_file(const string &path, const string &content)
+    {
+        write_file(dir + path, content);
+    }
+
+    /**
+     * @returns the results relative to dir, sorted
+     */
+    vector<string> search(const string &pattern, NameMatcher::Syntax syntax, bool match_case=false,
+                          const ContentMatcher *content=nullptr, int max_depth=-1, unsigned threads=4,
+                          const StatFilter &filter=StatFilter())
+    {
+        NameMatcher name(pattern, syntax, match_case);
+        SearchEngine::Options options;
+
+        options.root = dir + "/";
+        options.max_depth = max_depth;
+        options.threads = threads;
+        options.filter = filter;
+
+        SearchEngine engine(options, name, content);
+        vector<SearchEngine::Result> results;
+        vector<string> paths;
+
+        engine.run();
+        engine.take_results(results);
+
+        for (auto &r : results)
+            paths.push_back(r.path.substr(dir.size()));
+
+        sort (paths.begin(), paths.end());
+
+        return paths;
+    }
+};
+
+
+TEST(NameMatcherTest, ShellPatterns)
+{
+    EXPECT_TRUE (NameMatcher("*", NameMatcher::SYNTAX_FNMATCH, false).match("anything"));
+    EXPECT_TRUE (NameMatcher("*til*", NameMatcher::SYNTAX_FNMATCH, false).match("UTIL.cc"));
+    EXPECT_FALSE (NameMatcher("*til*", NameMatcher::SYNTAX_FNMATCH, true).match("UTIL.cc"));
+    EXPECT_TRUE (NameMatcher("*.cc", NameMatcher::SYNTAX_FNMATCH, false).match("main.CC"));
+    EXPECT_FALSE (NameMatcher("*.cc", NameMatcher::SYNTAX_FNMATCH, false).match("cc"));
+    EXPECT_TRUE (NameMatcher("main*", NameMatcher::SYNTAX_FNMATCH, true).match("main.cc"));
+    EXPECT_FALSE (NameMatcher("main*", NameMatcher::SYNTAX_FNMATCH, true).match("mai"));
+    EXPECT_TRUE (NameMatcher("m?in.[ch]*", NameMatcher::SYNTAX_FNMATCH, true).match("main.cc"));
+    EXPECT_TRUE (NameMatcher("README", NameMatcher::SYNTAX_FNMATCH, true).match("README"));
+    EXPECT_FALSE (NameMatcher("README", NameMatcher::SYNTAX_FNMATCH, true).match("README.md"));
+}
+
+
+TEST(NameMatcherTest, RegularExpressions)
+{
+    EXPECT_TRUE (NameMatcher("til", NameMatcher::SYNTAX_REGEX, false).match("UTIL.cc"));
+    EXPECT_TRUE (NameMatcher("^(main|util)\\.cc$", NameMatcher::SYNTAX_REGEX, true).match("util.cc"));
+    EXPECT_FALSE (NameMatcher("^(main|util)\\.cc$", NameMatcher::SYNTAX_REGEX, true).match("util.cc~"));
+    EXPECT_FALSE (NameMatcher("(", NameMatcher::SYNTAX_REGEX, true).ok());
+}
+
+
+TEST(ContentMatcherTest, RequiredLiterals)
+{
+    typedef vector<string> L;
+
+    EXPECT_EQ (L {"needle"}, ContentMatcher::required_literals("needle"));
+    EXPECT_EQ (L {"#define "}, ContentMatcher::required_literals("^#define +[A-Z_]+"));
+    EXPECT_EQ (L {"int "}, ContentMatcher::required_literals("int +(main|helper)"));
+    EXPECT_EQ ((L {"int main", "helper"}), ContentMatcher::required_literals("int main|helper"));
+    EXPECT_EQ (L {"ab"}, ContentMatcher::required_literals("abc?d"));
+    EXPECT_EQ (L {"ab"}, ContentMatcher::required_literals("ab+c*"));
+    EXPECT_EQ (L {"a.b"}, ContentMatcher::required_literals("a\\.b\\w"));
+    EXPECT_EQ (L {"x"}, ContentMatcher::required_literals("[a-z]x{2}y{0,1}"));
+    EXPECT_EQ (L {"gr"}, ContentMatcher::required_literals("grü?n"));
+
+    // an interval repeats the atom before it, so the literal ends with that atom
+    EXPECT_EQ (L {"ab"}, ContentMatcher::required_literals("ab{2}c"));
+    EXPECT_EQ (L {"ab"}, ContentMatcher::required_literals("ab{1,}c"));
+    EXPECT_EQ (L {"ab"}, ContentMatcher::required_literals("ab{2,3}cd"));
+
+    // a match may have no literal at all
+    EXPECT_TRUE (ContentMatcher::required_literals("").empty());
+    EXPECT_TRUE (ContentMatcher::required_literals("a*").empty());
+    EXPECT_TRUE (ContentMatcher::required_literals("main|[0-9]+").empty());
+    EXPECT_TRUE (ContentMatcher::required_literals("(a|b)").empty());
+}
+
+
+TEST(ContentMatcherTest, FindsLiterals)
+{
+    string text;
+
+    for (int i=0; i<300; ++i)
+        text += (char) ('A' + i % 53);
+
+    // every position and length, compared with a plain search
+    for (size_t pos=0; pos<text.size(); pos+=7)
+        for (size_t len=1; len<40 && pos+len<=text.size(); len+=3)
+        {
+            string literal = text.substr(pos, len);
+            string lower = literal;
+
+            transform (lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+            ASSERT_EQ (text.find(literal), ContentMatcher::find_literal(text.data(), text.size(), literal, false));
+
+            size_t icase = ContentMatcher::find_literal(text.data(), text.size(), lower, true);
+
+            ASSERT_LE (icase, pos);
+            ASSERT_EQ (0, strncasecmp (text.data() + icase, literal.data(), len));
+        }
+
+    EXPECT_EQ (5u, ContentMatcher::find_literal("abcd", 5, "x", false));
+    EXPECT_EQ (3u, ContentMatcher::find_literal("abc", 3, "abcd", false));
+    EXPECT_EQ (2u, ContentMatcher::find_literal(string("\0\0{[@", 5).data(), 5, "{[@", true));
+}
+
+
+TEST(ContentMatcherTest, MatchesOnlyLinesWithCandidates)
+{
+    ContentMatcher content("foo.*bar", false);
+    string across = "foo\nbar\nbar foo\n";
+    string within = across + "xx FOO and BAR\n";
+
+    EXPECT_FALSE (content.match_lines(across.data(), across.size()));
+    EXPECT_TRUE (content.match_lines(within.data(), within.size()));
+}
+
+
+TEST(ContentMatcherTest, MatchesIntervals)
+{
+    string text = "xx abbc yy\n";
+
+    EXPECT_TRUE (ContentMatcher("ab{2}c", false).match_lines(text.data(), text.size()));
+    EXPECT_TRUE (ContentMatcher("ab{1,}c", false).match_lines(text.data(), text.size()));
+    EXPECT_FALSE (ContentMatcher("ab{3}c", false).match_lines(text.data(), text.size()));
+}
+
+
+TEST_F(SearchEngineTest, FindsByName)
+{
+    vector<string> expected {"/src/lib/deep/Util.H", "/src/lib/util.cc"};
+
+    EXPECT_EQ (expected, search("*util*", NameMatcher::SYNTAX_FNMATCH));
+    EXPECT_EQ (vector<string> {"/src/lib/util.cc"}, search("*util*", NameMatcher::SYNTAX_FNMATCH, true));
+
+    // directories match, too, symlinks are not followed
+    expected = {"/doc/link", "/src/lib"};
+    EXPECT_EQ (expected, search("^li", NameMatcher::SYNTAX_REGEX));
+}
+
+
+TEST_F(SearchEngineTest, LimitsDepth)
+{
+    vector<string> expected {"/doc", "/src"};
+
+    EXPECT_EQ (expected, search("*", NameMatcher::SYNTAX_FNMATCH, false, nullptr, 0));
+    EXPECT_EQ (6u, search("*", NameMatcher::SYNTAX_FNMATCH, false, nullptr, 1).size());
+    EXPECT_EQ (9u, search("*", NameMatcher::SYNTAX_FNMATCH, false, nullptr, -1).size());
+}
+
+
+TEST_F(SearchEngineTest, FindsByContent)
+{
+    ContentMatcher content("int +(main|helper)", true);
+    vector<string> expected {"/src/lib/util.cc", "/src/main.cc"};
+
+    ASSERT_TRUE (content.ok());
+    EXPECT_EQ (expected, search("*", NameMatcher::SYNTAX_FNMATCH, false, &content));
+
+    // lines are matched one by one, like grep
+    ContentMatcher across("main.*return", true);
+    EXPECT_TRUE (search("*", NameMatcher::SYNTAX_FNMATCH, false, &across).empty());
+
+    ContentMatcher anchored("^static", true);
+    EXPECT_EQ (vector<string> {"/src/lib/util.cc"}, search("*", NameMatcher::SYNTAX_FNMATCH, false, &anchored));
+}
+
+
+TEST_F(SearchEngineTest, SameResultsWithOneThread)
+{
+    EXPECT_EQ (search("*", NameMatcher::SYNTAX_FNMATCH, false, nullptr, -1, 1),
+               search("*", NameMatcher::SYNTAX_FNMATCH, false, nullptr, -1, 8));
+}
+
+
+TEST_F(SearchEngineTest, ContentAcrossChunks)
+{
+    // a match right after the first chunk, a line longer than a chunk and a NUL byte before a match
+    string text(ContentMatcher::CHUNK_SIZE - 3, 'x');
+    text += "\nneedle\n";
+    make_file ("/chunks", text);
+
+    make_file ("/long", string(ContentMatcher::CHUNK_SIZE * 3, 'y') + "needle");
+    make_file ("/binary", string("bin\0ary needle", 14));
+
+    ContentMatcher content("needle", true);
+    vector<string> expected {"/chunks", "/long"};
+
+    EXPECT_EQ (expected, search("*", NameMatcher::SYNTAX_FNMATCH, false, &content, 0));
+
+    // binary files are only searched if asked for
+    ContentMatcher binary("needle", true, false);
+    expected = {"/binary", "/chunks", "/long"};
+
+    EXPECT_EQ (expected, search("*", NameMatcher::SYNTAX_FNMATCH, false, &binary, 0));
+}
+
+
+TEST_F(SearchEngineTest, FiltersByAttributes)
+{
+    auto filtered = [this] (const StatFilter &filter, const ContentMatcher *content=nullptr) {
+        return search("*", NameMatcher::SYNTAX_FNMATCH, false, content, -1, 4, filter);
+    };
+
+    StatFilter filter;
+    vector<string> expected {"/doc/link"};
+
+    filter.type = StatFilter::TYPE_SYMLINK;
+    EXPECT_EQ (expected, filtered(filter));
+
+    filter.type = StatFilter::TYPE_DIRECTORY;
+    EXPECT_EQ (4u, filtered(filter).size());
+
+    // sizes of the regular files: util.cc 31, main.cc 30, Util.H 13, README 8
+    filter.type = StatFilter::TYPE_REGULAR;
+    filter.size_min = 13;
+    filter.size_max = 30;
+    expected = {"/src/lib/deep/Util.H", "/src/main.cc"};
+    EXPECT_EQ (expected, filtered(filter));
+
+    // content is only read from files which pass
+    ContentMatcher content("int", true);
+    EXPECT_EQ (vector<string> {"/src/main.cc"}, filtered(filter, &content));
+
+    // modified in a window
+    struct timespec old[2] = {{946684800, 0}, {946684800, 0}};
+    ASSERT_EQ (0, utimensat (AT_FDCWD, (dir + "/doc/README").c_str(), old, AT_SYMLINK_NOFOLLOW));
+
+    StatFilter by_time;
+    by_time.mtime_max = 946684800 + 3600;
+    EXPECT_EQ (vector<string> {"/doc/README"}, filtered(by_time));
+
+    by_time.mtime_max = 0;
+    by_time.atime_min = 946684800 + 3600;
+    EXPECT_EQ (8u, filtered(by_time).size());
+
+    // owner and permissions
+    StatFilter by_owner;
+    by_owner.uid = getuid();
+    EXPECT_EQ (9u, filtered(by_owner).size());
+    by_owner.uid = getuid() + 1;
+    EXPECT_TRUE (filtered(by_owner).empty());
+
+    ASSERT_EQ (0, chmod ((dir + "/src/main.cc").c_str(), 0750));
+
+    StatFilter by_mode;
+    by_mode.type = StatFilter::TYPE_REGULAR;
+    by_mode.perm_mask = 0110;
+    EXPECT_EQ (vector<string> {"/src/main.cc"}, filtered(by_mode));
+}
+
+
+TEST_F(SearchEngineTest, Stops)
+{
+    NameMatcher name("*", NameMatcher::SYNTAX_FNMATCH, false);
+    SearchEngine::Options options;
+    options.root = dir;
+
+    SearchEngine engine(options, name, nullptr);
+    vector<SearchEngine::Result> results;
+
+    engine.stop();
+    engine.run();
+    engine.take_results(results);
+
+    EXPECT_TRUE (results.empty());
+}
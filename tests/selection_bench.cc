@@ -0,0 +1,92 @@
+/**
+ * @file selection_bench.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Compares building the list of a selection with g_list_append,
+ * as copy, delete and drag and drop did, with collecting it in a
+ * GnomeCmd::Batch and converting it to a GList once. The time per item of
+ * the batch stays the same as the selection grows, the one of
+ * g_list_append grows with it. Not run by 'make check', build it with
+ * 'make selection_bench':
+ *
+ *   ./selection_bench 200000
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "../src/gnome-cmd-batch.h"
+
+using namespace std;
+
+
+static double ns_per_item (chrono::steady_clock::time_point start, size_t n)
+{
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / n;
+}
+
+
+int main (int argc, char **argv)
+{
+    size_t max_items = argc > 1 ? strtoul (argv[1], nullptr, 10) : 200000;
+
+    vector<int> items(max_items);
+
+    printf ("%10s %18s %18s\n", "items", "g_list_append", "Batch");
+
+    for (size_t n = max_items / 16 ? max_items / 16 : 1; n <= max_items; n *= 2)
+    {
+        auto start = chrono::steady_clock::now();
+        GList *list = NULL;
+
+        for (size_t i=0; i<n; ++i)
+            list = g_list_append (list, &items[i]);
+
+        double append = ns_per_item (start, n);
+
+        g_list_free (list);
+
+        start = chrono::steady_clock::now();
+
+        GnomeCmd::Batch<int *> batch;
+
+        for (size_t i=0; i<n; ++i)
+            batch.add(&items[i]);
+
+        list = batch.get_list();
+
+        double batched = ns_per_item (start, n);
+
+        // both have to give the same list
+        if (g_list_length (list) != n || g_list_last (list)->data != &items[n-1])
+        {
+            fprintf (stderr, "wrong list for %zu items\n", n);
+            return 1;
+        }
+
+        g_list_free (list);
+
+        printf ("%10zu %13.1f ns/item %13.1f ns/item\n", n, append, batched);
+    }
+
+    return 0;
+}
@@ -0,0 +1,235 @@
+/**
+ * @file tag_query_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for searching by meta tags and caching them.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-search-engine.h"
+#include "../src/gnome-cmd-tag-query.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::NameMatcher;
+using GnomeCmd::SearchEngine;
+using GnomeCmd::TagCache;
+using GnomeCmd::TagQuery;
+using GnomeCmd::TagValues;
+
+
+class TagQueryTest : public TempDirTest
+{
+  protected:
+    atomic<unsigned> extracted {0};
+
+    // the test files hold their tags as "Name=value" lines
+    TagQuery::Extractor extractor = [this] (TagQuery::Backend, const char *path, TagValues &values)
+    {
+        ifstream f(path);
+        string line;
+
+        extracted++;
+
+        while (getline (f, line))
+        {
+            size_t eq = line.find('=');
+
+            if (eq != string::npos)
+                values[line.substr(0, eq)] = line.substr(eq + 1);
+        }
+    };
+
+    void SetUp() override
+    {
+        ASSERT_NO_FATAL_FAILURE (TempDirTest::SetUp());
+
+        make_file("/a.jpg", "Exif.DateTimeOriginal=2024:05:03 12:00:00\nImage.Width=4000\n");
+        make_file("/b.JPG", "Exif.DateTimeOriginal=2019:01:01 08:30:00\nImage.Width=640\n");
+        make_file("/c.mp3", "ID3.Artist=Foo Fighters\nAudio.Bitrate=320\n");
+        make_file("/d.txt", "ID3.Artist=Foo\n");
+    }
+
+    void make_file(const string &path, const string &content)
+    {
+        write_file(dir + path, content);
+    }
+
+    bool match(const TagQuery &query, const string &path)
+    {
+        struct stat st;
+
+        return lstat ((dir + path).c_str(), &st) == 0 && query.match((dir + path).c_str(), st);
+    }
+
+    /**
+     * @returns the names of the files which match @a text
+     */
+    vector<string> matching(const string &text, TagCache *cache=nullptr)
+    {
+        TagQuery query(extractor, cache);
+        string error;
+        vector<string> names;
+
+        EXPECT_TRUE (query.parse(text, error)) << error;
+
+        for (auto name : {"/a.jpg", "/b.JPG", "/c.mp3", "/d.txt"})
+            if (match(query, name))
+                names.push_back(name);
+
+        return names;
+    }
+};
+
+
+TEST(TagQueryParseTest, Criteria)
+{
+    TagQuery query(nullptr, nullptr);
+    string error;
+
+    EXPECT_TRUE (query.parse("", error));
+    EXPECT_TRUE (query.empty());
+    EXPECT_TRUE (query.parse("Exif.DateTimeOriginal >= 2024; ID3.Artist~foo\n  PDF.Version = \"1.4\"  \n", error));
+    EXPECT_FALSE (query.empty());
+
+    for (auto bad : {"Exif.DateTimeOriginal", "Exif.DateTimeOriginal >", "Nope.Tag = 1", "Artist = 1", "Exif. = 1", "= 1"})
+    {
+        EXPECT_FALSE (query.parse(string("ID3.Artist ~ a; ") + bad, error)) << bad;
+        EXPECT_EQ (bad, error);
+    }
+
+    // a failed parse keeps the previous criteria
+    EXPECT_FALSE (query.empty());
+}
+
+
+TEST(TagQueryParseTest, Backends)
+{
+    EXPECT_EQ ((unsigned) TagQuery::BACKEND_IMAGE, TagQuery::backends_for_name("/x/photo.JPEG"));
+    EXPECT_EQ ((unsigned) TagQuery::BACKEND_AUDIO, TagQuery::backends_for_name("song.flac"));
+    EXPECT_EQ ((unsigned) TagQuery::BACKEND_PDF, TagQuery::backends_for_name("paper.pdf"));
+    EXPECT_EQ (0u, TagQuery::backends_for_name("/x.jpg/README"));
+    EXPECT_EQ (0u, TagQuery::backends_for_name("archive."));
+
+    EXPECT_EQ ((unsigned) (TagQuery::BACKEND_DOC | TagQuery::BACKEND_PDF), TagQuery::backends_for_class("Doc"));
+    EXPECT_EQ ((unsigned) TagQuery::BACKEND_AUDIO, TagQuery::backends_for_class("vorbis"));
+    EXPECT_EQ (0u, TagQuery::backends_for_class("File"));
+}
+
+
+TEST_F(TagQueryTest, Compares)
+{
+    // dates compare by prefix, numbers as numbers
+    EXPECT_EQ (vector<string> {"/a.jpg"}, matching("Exif.DateTimeOriginal > 2024"));
+    EXPECT_EQ (vector<string> {"/b.JPG"}, matching("Exif.DateTimeOriginal < 2020:06"));
+    EXPECT_EQ (vector<string> {"/b.JPG"}, matching("Image.Width < 1000"));
+    EXPECT_EQ (vector<string> {"/a.jpg"}, matching("Image.Width >= 1000"));
+    EXPECT_EQ (vector<string> {"/c.mp3"}, matching("Audio.Bitrate = 320.0"));
+
+    // the text file is not read, although its content would match
+    EXPECT_EQ (vector<string> {"/c.mp3"}, matching("id3.artist ~ FOO"));
+    EXPECT_EQ (vector<string> {"/c.mp3"}, matching("ID3.Artist = foo fighters"));
+    EXPECT_TRUE (matching("ID3.Artist != foo fighters").empty());
+
+    // all criteria must hold, a missing tag matches nothing
+    EXPECT_EQ (vector<string> {"/a.jpg"}, matching("Exif.DateTimeOriginal > 2020; Image.Width > 100"));
+    EXPECT_TRUE (matching("Exif.DateTimeOriginal > 2020; ID3.Artist ~ foo").empty());
+    EXPECT_TRUE (matching("Exif.Artist ~ a").empty());
+
+    // the names of exiv2
+    EXPECT_EQ (vector<string> {"/a.jpg"}, matching("Exif.Photo.DateTimeOriginal >= 2024"));
+}
+
+
+TEST_F(TagQueryTest, ReadsOnlyFittingFiles)
+{
+    matching("Exif.DateTimeOriginal > 2024");
+    EXPECT_EQ (2u, extracted.load());
+
+    extracted = 0;
+    matching("PDF.Version = 1.4");
+    EXPECT_EQ (0u, extracted.load());
+}
+
+
+TEST_F(TagQueryTest, Caches)
+{
+    TagCache cache(dir + "/cache/tags");
+
+    EXPECT_EQ (vector<string> {"/a.jpg"}, matching("Exif.DateTimeOriginal > 2024", &cache));
+    EXPECT_EQ (2u, extracted.load());
+    EXPECT_EQ (2u, cache.size());
+
+    // the second search reads no file
+    EXPECT_EQ (vector<string> {"/b.JPG"}, matching("Image.Width < 1000", &cache));
+    EXPECT_EQ (2u, extracted.load());
+
+    // nor does one after a restart
+    ASSERT_TRUE (cache.save());
+
+    TagCache loaded(dir + "/cache/tags");
+
+    ASSERT_TRUE (loaded.load());
+    EXPECT_EQ (2u, loaded.size());
+    EXPECT_EQ (vector<string> {"/b.JPG"}, matching("Image.Width < 1000", &loaded));
+    EXPECT_EQ (2u, extracted.load());
+
+    // a changed file is read again
+    make_file("/b.JPG", "Exif.DateTimeOriginal=2025:01:01 08:30:00\nImage.Width=6000\n");
+
+    struct timeval times[2] = {{1000000000, 0}, {1000000000, 0}};
+    ASSERT_EQ (0, utimes ((dir + "/b.JPG").c_str(), times));
+
+    EXPECT_TRUE (matching("Image.Width < 1000", &loaded).empty());
+    EXPECT_EQ (3u, extracted.load());
+
+    // a damaged file is not loaded
+    make_file("/cache/tags", "GCMDTAG\n garbage");
+    EXPECT_FALSE (loaded.load());
+}
+
+
+TEST_F(TagQueryTest, Searches)
+{
+    TagQuery query(extractor, nullptr);
+    NameMatcher name("*", NameMatcher::SYNTAX_FNMATCH, false);
+    SearchEngine::Options options;
+    string error;
+
+    ASSERT_TRUE (query.parse("Audio.Bitrate >= 256", error));
+
+    options.root = dir;
+    options.threads = 2;
+    options.tags = &query;
+
+    SearchEngine engine(options, name, nullptr);
+    vector<SearchEngine::Result> results;
+
+    engine.run();
+    engine.take_results(results);
+
+    ASSERT_EQ (1u, results.size());
+    EXPECT_EQ (dir + "/c.mp3", results[0].path);
+    EXPECT_EQ (1u, query.files_read.load());
+}
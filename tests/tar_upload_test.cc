@@ -0,0 +1,197 @@
+/**
+ * @file tar_upload_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for uploading files as a tar stream. A local shell stands
+ * in for the one reached through ssh.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-tar-upload.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::TarUpload;
+
+
+class TarUploadTest : public TempDirTest
+{
+  protected:
+
+    const vector<string> local_shell {"sh", "-c"};
+
+    string make_content(size_t size)
+    {
+        string content(size, '\0');
+
+        for (size_t i=0; i<size; ++i)
+            content[i] = 'a' + (i * 7 + i / 4096) % 26;
+
+        return content;
+    }
+};
+
+
+TEST_F(TarUploadTest, QuoteForShell)
+{
+    EXPECT_EQ ("'a b'", TarUpload::shell_quote("a b"));
+    EXPECT_EQ ("'it'\\''s'", TarUpload::shell_quote("it's"));
+
+    vector<string> ssh {"ssh", "-o", "BatchMode=yes", "-o", "ConnectTimeout=15", "-p", "2222", "-l", "joe", "--", "example.org"};
+
+    EXPECT_EQ (ssh, TarUpload::ssh_command("example.org", 2222, "joe"));
+}
+
+
+TEST_F(TarUploadTest, UploadsTree)
+{
+    string big = make_content (TarUpload::BUFFER_SIZE * 2 + 12345);
+    string small = make_content (1000);
+    string long_name = string(150, 'n') + ".txt";
+    string long_target = string(120, 'x');
+
+    ASSERT_EQ (0, mkdir ((dir + "/src").c_str(), 0755));
+    ASSERT_EQ (0, mkdir ((dir + "/src/sub").c_str(), 0755));
+    ASSERT_EQ (0, mkdir ((dir + "/src/empty dir").c_str(), 0700));
+    write_file (dir + "/src/big", big);
+    write_file (dir + "/src/sub/" + long_name, small);
+    write_file (dir + "/src/empty", "");
+    ASSERT_EQ (0, chmod ((dir + "/src/empty").c_str(), 0640));
+    ASSERT_EQ (0, symlink (long_target.c_str(), (dir + "/src/link").c_str()));
+
+    TarUpload upload(TarUpload::Options(), local_shell, dir + "/remote dir/it's here");
+
+    ASSERT_TRUE (upload.run({{dir + "/src", "copy"}})) << upload.remote_error;
+
+    EXPECT_EQ (4u, upload.files_total);
+    EXPECT_EQ (4u, upload.files_done);
+    EXPECT_EQ (big.size() + small.size(), upload.bytes_total);
+    EXPECT_EQ (upload.bytes_total, upload.bytes_done);
+
+    string dest = dir + "/remote dir/it's here/copy";
+
+    EXPECT_EQ (big, read_file (dest + "/big"));
+    EXPECT_EQ (small, read_file (dest + "/sub/" + long_name));
+    EXPECT_EQ ("", read_file (dest + "/empty"));
+
+    struct stat st;
+
+    ASSERT_EQ (0, stat ((dest + "/empty dir").c_str(), &st));
+    EXPECT_TRUE (S_ISDIR (st.st_mode));
+    ASSERT_EQ (0, stat ((dest + "/empty").c_str(), &st));
+    EXPECT_EQ (0640u, st.st_mode & 07777);
+
+    char target[PATH_MAX];
+    ssize_t len = readlink ((dest + "/link").c_str(), target, sizeof(target));
+
+    EXPECT_EQ (long_target, string(target, max<ssize_t> (len, 0)));
+}
+
+
+TEST_F(TarUploadTest, ProbeListsExistingNames)
+{
+    ASSERT_EQ (0, mkdir ((dir + "/remote").c_str(), 0755));
+    write_file (dir + "/remote/a", "");
+    write_file (dir + "/remote/.hidden", "");
+
+    TarUpload upload(TarUpload::Options(), local_shell, dir + "/remote");
+    vector<string> existing;
+
+    ASSERT_TRUE (upload.probe(existing));
+    sort (existing.begin(), existing.end());
+    EXPECT_EQ (vector<string>({".hidden", "a"}), existing);
+
+    // a directory which doesn't exist yet is created by run()
+    TarUpload missing(TarUpload::Options(), local_shell, dir + "/missing");
+
+    existing.clear();
+    EXPECT_TRUE (missing.probe(existing));
+    EXPECT_TRUE (existing.empty());
+}
+
+
+TEST_F(TarUploadTest, ProbeFailsWithoutShellOrTar)
+{
+    vector<string> existing;
+
+    TarUpload no_shell(TarUpload::Options(), {"gcmd-no-such-shell"}, dir);
+
+    EXPECT_FALSE (no_shell.probe(existing));
+    EXPECT_FALSE (no_shell.remote_error.empty());
+
+    // the script is passed as $0, run it with a PATH without tar
+    TarUpload no_tar(TarUpload::Options(), {"sh", "-c", "PATH=/nonexistent; eval \"$0\""}, dir);
+
+    EXPECT_FALSE (no_tar.probe(existing));
+    EXPECT_EQ ("tar is not available", no_tar.remote_error);
+}
+
+
+TEST_F(TarUploadTest, ExistingFilesAreKeptUnlessReplacing)
+{
+    write_file (dir + "/a", "new");
+    ASSERT_EQ (0, mkdir ((dir + "/remote").c_str(), 0755));
+    write_file (dir + "/remote/a", "old");
+
+    TarUpload::Options options;
+    options.replace = false;
+
+    TarUpload keep(options, local_shell, dir + "/remote");
+
+    ASSERT_TRUE (keep.run({{dir + "/a", "a"}})) << keep.remote_error;
+    EXPECT_EQ ("old", read_file (dir + "/remote/a"));
+
+    TarUpload replace(TarUpload::Options(), local_shell, dir + "/remote");
+
+    ASSERT_TRUE (replace.run({{dir + "/a", "a"}})) << replace.remote_error;
+    EXPECT_EQ ("new", read_file (dir + "/remote/a"));
+}
+
+
+TEST_F(TarUploadTest, RemoteFailureIsReported)
+{
+    write_file (dir + "/a", "data");
+    write_file (dir + "/file", "");
+
+    // the destination can't be created below a file
+    TarUpload upload(TarUpload::Options(), local_shell, dir + "/file/remote");
+
+    EXPECT_FALSE (upload.run({{dir + "/a", "a"}}));
+    EXPECT_FALSE (upload.remote_error.empty());
+    EXPECT_FALSE (upload.is_cancelled());
+}
+
+
+TEST_F(TarUploadTest, MissingSourceIsReported)
+{
+    write_file (dir + "/a", "data");
+
+    TarUpload upload(TarUpload::Options(), local_shell, dir + "/remote");
+    int errors = 0;
+
+    upload.on_error = [&] (const string &, int error) { ++errors; EXPECT_EQ (ENOENT, error); return GnomeCmd::ERROR_ACTION_SKIP; };
+
+    ASSERT_TRUE (upload.run({{dir + "/missing", "missing"}, {dir + "/a", "a"}})) << upload.remote_error;
+    EXPECT_EQ (1, errors);
+    EXPECT_EQ ("data", read_file (dir + "/remote/a"));
+}
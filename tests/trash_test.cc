@@ -0,0 +1,164 @@
+/**
+ * @file trash_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for moving files to the trash.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-trash.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::Trash;
+
+
+class TrashTest : public TempDirTest
+{
+  protected:
+
+    string home;
+
+    void SetUp() override
+    {
+        ASSERT_NO_FATAL_FAILURE (TempDirTest::SetUp());
+        home = dir + "/Trash";
+    }
+
+    void make_file(const string &path, size_t size=100)
+    {
+        write_file(path, string(size, 'x'));
+    }
+
+    bool exists(const string &path)
+    {
+        struct stat st;
+        return lstat (path.c_str(), &st) == 0;
+    }
+};
+
+
+TEST_F(TrashTest, EncodePath)
+{
+    EXPECT_EQ ("/home/a%20b/%C3%A4.txt", Trash::encode_path("/home/a b/\xc3\xa4.txt"));
+    EXPECT_EQ ("100%25", Trash::encode_path("100%"));
+}
+
+
+TEST_F(TrashTest, MovesFilesAndWritesInfo)
+{
+    make_file (dir + "/a");
+    ASSERT_EQ (0, mkdir ((dir + "/d").c_str(), 0755));
+    make_file (dir + "/d/f");
+
+    Trash trash(home);
+
+    ASSERT_TRUE (trash.run({dir + "/a", dir + "/d"}));
+    EXPECT_EQ (vector<bool>(2, true), trash.trashed);
+    EXPECT_EQ (2u, trash.items_done);
+
+    EXPECT_FALSE (exists (dir + "/a"));
+    EXPECT_TRUE (exists (home + "/files/a"));
+    EXPECT_TRUE (exists (home + "/files/d/f"));
+
+    string info = read_file (home + "/info/a.trashinfo");
+
+    EXPECT_EQ (0u, info.find("[Trash Info]\nPath=" + dir + "/a\nDeletionDate="));
+}
+
+
+TEST_F(TrashTest, NameClashesGetNumbers)
+{
+    Trash trash(home);
+
+    for (int i=0; i<3; ++i)
+    {
+        make_file (dir + "/a.txt");
+        ASSERT_TRUE (trash.run({dir + "/a.txt"}));
+    }
+
+    EXPECT_TRUE (exists (home + "/files/a.txt"));
+    EXPECT_TRUE (exists (home + "/files/a.2.txt"));
+    EXPECT_TRUE (exists (home + "/files/a.3.txt"));
+    EXPECT_TRUE (exists (home + "/info/a.3.txt.trashinfo"));
+}
+
+
+TEST_F(TrashTest, ManyFilesInBatches)
+{
+    vector<string> paths;
+
+    for (int i=0; i<Trash::BATCH_SIZE*2+10; ++i)
+    {
+        paths.push_back(dir + "/f" + to_string(i));
+        make_file (paths.back());
+    }
+
+    Trash trash(home);
+
+    ASSERT_TRUE (trash.run(paths));
+    EXPECT_EQ (vector<bool>(paths.size(), true), trash.trashed);
+
+    for (auto &path : paths)
+        EXPECT_FALSE (exists (path));
+}
+
+
+TEST_F(TrashTest, SizeIsUpdatedAndCached)
+{
+    ASSERT_EQ (0, mkdir ((dir + "/d").c_str(), 0755));
+    make_file (dir + "/d/f", 100000);
+    make_file (dir + "/a", 50000);
+
+    Trash trash(home);
+    uint64_t empty = trash.get_size();
+
+    ASSERT_TRUE (trash.run({dir + "/d", dir + "/a"}));
+
+    uint64_t size = trash.get_size();
+
+    EXPECT_GT (size, empty + 150000);
+
+    // a new instance gets the same result, the directory from the cache
+    string sizes = read_file (home + "/directorysizes");
+
+    EXPECT_NE (string::npos, sizes.find(" d\n"));
+
+    Trash other(home);
+
+    EXPECT_EQ (size, other.get_size());
+}
+
+
+TEST_F(TrashTest, MissingItemIsReported)
+{
+    make_file (dir + "/a");
+
+    Trash trash(home);
+    int errors = 0;
+
+    trash.on_error = [&] (const string &, int error) { ++errors; EXPECT_EQ (ENOENT, error); return GnomeCmd::ERROR_ACTION_SKIP; };
+
+    ASSERT_TRUE (trash.run({dir + "/missing", dir + "/a"}));
+    EXPECT_EQ (1, errors);
+    EXPECT_FALSE (trash.trashed[0]);
+    EXPECT_TRUE (trash.trashed[1]);
+}
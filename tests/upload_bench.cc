@@ -0,0 +1,169 @@
+/**
+ * @file upload_bench.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Compares uploading many small files one by one, with a round
+ * trip per file as SFTP does, with streaming them as a single tar archive.
+ * Not run by 'make check', build it with 'make upload_bench'. Without a
+ * host a local shell stands in for the server and the round trip time is
+ * simulated with sleep:
+ *
+ *   ./upload_bench /tmp 2000 4096 5
+ *   ./upload_bench /tmp 2000 4096 0 user@host
+ *
+ * The second form uploads into a temporary directory below /tmp on the host
+ * through ssh, which has to log in without a password.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../src/gnome-cmd-tar-upload.h"
+
+using namespace std;
+using GnomeCmd::TarUpload;
+
+extern char **environ;
+
+
+/** Runs @a shell with @a script, reading @a input */
+static bool run_shell (const vector<string> &shell, const string &script, const string &input)
+{
+    posix_spawn_file_actions_t actions;
+
+    posix_spawn_file_actions_init (&actions);
+    posix_spawn_file_actions_addopen (&actions, STDIN_FILENO, input.c_str(), O_RDONLY, 0);
+
+    vector<char *> argv;
+
+    for (auto &arg : shell)
+        argv.push_back(const_cast<char *> (arg.c_str()));
+
+    argv.push_back(const_cast<char *> (script.c_str()));
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    int ret = posix_spawnp (&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    int status = 1;
+
+    posix_spawn_file_actions_destroy (&actions);
+
+    if (ret == 0)
+        waitpid (pid, &status, 0);
+
+    return ret == 0 && status == 0;
+}
+
+
+static void report (const char *name, size_t n_files, size_t size, double secs, bool ok)
+{
+    printf ("%-12s %10.1f files/s %10.2f MB/s%s\n", name, n_files / secs, n_files * size / secs / 1e6, ok ? "" : "  FAILED");
+}
+
+
+int main (int argc, char **argv)
+{
+    string dir = argc > 1 ? argv[1] : "/tmp";
+    size_t n_files = argc > 2 ? strtoul (argv[2], nullptr, 10) : 2000;
+    size_t size = argc > 3 ? strtoul (argv[3], nullptr, 10) : 4096;
+    unsigned latency = argc > 4 ? strtoul (argv[4], nullptr, 10) : 0;
+    string host = argc > 5 ? argv[5] : "";
+
+    string src = dir + "/gcmd-upload-bench.src";
+    string remote = (host.empty() ? dir : "/tmp") + "/gcmd-upload-bench.dest";
+
+    if (mkdir (src.c_str(), 0755) != 0)
+    {
+        perror (src.c_str());
+        return 1;
+    }
+
+    string content(size, 'x');
+    vector<TarUpload::Item> items;
+
+    for (size_t i=0; i<n_files; ++i)
+    {
+        string name = "f" + to_string(i);
+
+        if (FILE *f = fopen ((src + "/" + name).c_str(), "w"))
+        {
+            fwrite (content.data(), 1, content.size(), f);
+            fclose (f);
+        }
+
+        items.push_back(make_pair (src + "/" + name, name));
+    }
+
+    // the stand-in server: a local shell which waits for the round trip before it runs the script
+    vector<string> shell;
+
+    if (host.empty())
+    {
+        char sleep[64];
+        snprintf (sleep, sizeof(sleep), "sleep %u.%03u; eval \"$0\"", latency / 1000, latency % 1000);
+        shell = {"sh", "-c", sleep};
+    }
+    else
+    {
+        size_t at = host.find('@');
+        shell = at == string::npos ? TarUpload::ssh_command(host) : TarUpload::ssh_command(host.substr(at + 1), 0, host.substr(0, at));
+    }
+
+    printf ("uploading %zu files of %zu bytes to %s, %s\n\n", n_files, size,
+            host.empty() ? "a local shell" : host.c_str(),
+            host.empty() ? (to_string(latency) + " ms per round trip").c_str() : "through ssh");
+
+    string cleanup = "rm -rf " + TarUpload::shell_quote(remote);
+
+    run_shell (shell, cleanup + " && mkdir -p " + TarUpload::shell_quote(remote), "/dev/null");
+
+    // one request per file, as gnome-vfs does
+    auto start = chrono::steady_clock::now();
+    bool ok = true;
+
+    for (auto &item : items)
+        ok = run_shell (shell, "cat > " + TarUpload::shell_quote(remote + "/" + item.second), item.first) && ok;
+
+    report ("per file", n_files, size, chrono::duration<double>(chrono::steady_clock::now() - start).count(), ok);
+
+    run_shell (shell, cleanup, "/dev/null");
+
+    TarUpload upload(TarUpload::Options(), shell, remote);
+
+    start = chrono::steady_clock::now();
+    ok = upload.run(items);
+
+    report ("tar stream", n_files, size, chrono::duration<double>(chrono::steady_clock::now() - start).count(), ok);
+
+    if (!ok)
+        printf ("%s\n", upload.remote_error.c_str());
+
+    run_shell (shell, cleanup, "/dev/null");
+    system (("rm -rf " + TarUpload::shell_quote(src)).c_str());
+
+    return 0;
+}
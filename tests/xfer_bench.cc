@@ -0,0 +1,168 @@
+/**
+ * @file xfer_bench.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Compares the data copy backends of the native transfer engine:
+ * read/write, copy_file_range and io_uring with different queue depths.
+ * Not run by 'make check', build it with 'make xfer_bench' and run it once
+ * on a tmpfs and once on a real disk:
+ *
+ *   ./xfer_bench /dev/shm 1024
+ *   ./xfer_bench /mnt/nvme 4096
+ *
+ * The page cache is not dropped between runs, so for disk numbers the file
+ * should be larger than the RAM, or run as root which makes the benchmark
+ * write 3 to /proc/sys/vm/drop_caches before every run.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../src/gnome-cmd-xfer-engine.h"
+#include "../src/gnome-cmd-xfer-uring.h"
+
+using namespace std;
+using GnomeCmd::XferEngine;
+
+
+static double cpu_seconds ()
+{
+    struct rusage ru;
+
+    getrusage (RUSAGE_SELF, &ru);
+
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+
+static void drop_caches ()
+{
+    sync ();
+
+    if (FILE *f = fopen ("/proc/sys/vm/drop_caches", "w"))
+    {
+        fputs ("3", f);
+        fclose (f);
+    }
+}
+
+
+static bool make_source (const string &path, uint64_t size)
+{
+    int fd = open (path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+
+    if (fd < 0)
+        return false;
+
+    vector<char> buf(1 << 20);
+
+    for (size_t i=0; i<buf.size(); ++i)
+        buf[i] = rand ();
+
+    for (uint64_t done=0; done<size; done+=buf.size())
+        if (write (fd, buf.data(), buf.size()) != (ssize_t) buf.size())
+        {
+            close (fd);
+            return false;
+        }
+
+    fsync (fd);
+    close (fd);
+
+    return true;
+}
+
+
+static void run (const char *name, const string &src, const string &dest, XferEngine::Backend backend, unsigned depth, uint64_t size)
+{
+    unlink (dest.c_str());
+    drop_caches ();
+
+    XferEngine::Options options;
+
+    options.overwrite_mode = XferEngine::OVERWRITE_MODE_REPLACE;
+    options.sparse = false;
+    options.backend = backend;
+    options.queue_depth = depth;
+
+    XferEngine engine(options);
+
+    double cpu = cpu_seconds ();
+    auto start = chrono::steady_clock::now();
+
+    bool ok = engine.run({{src, dest}});
+
+    // include writeback, otherwise the page cache is measured
+    int fd = open (dest.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        fsync (fd);
+        close (fd);
+    }
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cpu = cpu_seconds () - cpu;
+
+    printf ("%-22s %10.1f MB/s %8.2f s CPU %6.1f%%%s\n", name, size / secs / 1e6, cpu, 100.0 * cpu / secs, ok ? "" : "  FAILED");
+}
+
+
+int main (int argc, char **argv)
+{
+    string dir = argc > 1 ? argv[1] : ".";
+    uint64_t size = (argc > 2 ? strtoull (argv[2], nullptr, 10) : 512) << 20;
+
+    string src = dir + "/gcmd-xfer-bench.src";
+    string dest = dir + "/gcmd-xfer-bench.dest";
+
+    if (!make_source (src, size))
+    {
+        perror (src.c_str());
+        return 1;
+    }
+
+    printf ("copying %llu MiB in %s\n\n", (unsigned long long) (size >> 20), dir.c_str());
+
+    run ("read/write", src, dest, XferEngine::BACKEND_READ_WRITE, 0, size);
+    run ("copy_file_range", src, dest, XferEngine::BACKEND_COPY_FILE_RANGE, 0, size);
+
+    if (GnomeCmd::XferUring::available())
+        for (unsigned depth : {1, 4, 16, 64, 256})
+        {
+            char name[32];
+            snprintf (name, sizeof(name), "io_uring, depth %u", depth);
+            run (name, src, dest, XferEngine::BACKEND_URING, depth, size);
+        }
+    else
+        printf ("io_uring is not available\n");
+
+    unlink (src.c_str());
+    unlink (dest.c_str());
+
+    return 0;
+}
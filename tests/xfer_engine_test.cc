@@ -0,0 +1,541 @@
+/**
+ * @file xfer_engine_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for the native transfer engine, in particular for
+ * copying sparse files.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-xfer-engine.h"
+#include "../src/gnome-cmd-xfer-journal.h"
+#include "../src/gnome-cmd-xfer-uring.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::XferEngine;
+
+
+class XferEngineTest : public TempDirTest
+{
+  protected:
+
+    void SetUp() override
+    {
+        // not /tmp, which is often a tmpfs
+        dir = make_temp_dir("gcmd-xfer-engine-");
+        ASSERT_FALSE (dir.empty());
+    }
+
+    /**
+     * Creates a file of @a size bytes with @a extents data blocks of 64 KiB
+     * spread over it, the rest is left as holes.
+     */
+    void make_sparse_file(const string &path, off_t size, int extents)
+    {
+        int fd = open (path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+        ASSERT_LE (0, fd);
+        ASSERT_EQ (0, ftruncate (fd, size));
+
+        string block(65536, '\0');
+
+        for (int i=0; i<extents; ++i)
+        {
+            for (size_t j=0; j<block.size(); ++j)
+                block[j] = 'a' + (i+j) % 26;
+
+            off_t offset = (size / extents * i) & ~(off_t) 65535;
+            ASSERT_EQ ((ssize_t) block.size(), pwrite (fd, block.data(), block.size(), offset));
+        }
+
+        close (fd);
+    }
+
+    struct stat stat_file(const string &path)
+    {
+        struct stat st;
+        EXPECT_EQ (0, lstat (path.c_str(), &st));
+        return st;
+    }
+};
+
+
+TEST_F(XferEngineTest, SparseFileKeepsHoles)
+{
+    string src = dir + "/sparse";
+    string dest = dir + "/copy";
+
+    make_sparse_file (src, 64 << 20, 4);
+
+    struct stat src_st = stat_file (src);
+
+    if ((uint64_t) src_st.st_blocks * 512 >= (uint64_t) src_st.st_size)
+    {
+        std::cout << "File system does not support sparse files, skipping" << std::endl;
+        return;
+    }
+
+    XferEngine engine(XferEngine::Options{});
+
+    ASSERT_TRUE (engine.run({{src, dest}}));
+
+    struct stat dest_st = stat_file (dest);
+
+    EXPECT_EQ (src_st.st_size, dest_st.st_size);
+    EXPECT_LT (dest_st.st_blocks * 512, dest_st.st_size);
+    EXPECT_EQ (read_file (src), read_file (dest));
+
+    // holes count for the logical progress only
+    EXPECT_EQ ((uint64_t) src_st.st_size, engine.progress.bytes_done);
+    EXPECT_EQ (engine.progress.bytes_total, engine.progress.bytes_done);
+    EXPECT_EQ (4u * 65536, engine.progress.physical_bytes_done);
+}
+
+
+TEST_F(XferEngineTest, TrailingHoleSetsSize)
+{
+    string src = dir + "/sparse";
+    string dest = dir + "/copy";
+
+    int fd = open (src.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    ASSERT_LE (0, fd);
+    ASSERT_EQ (5, pwrite (fd, "hello", 5, 0));
+    ASSERT_EQ (0, ftruncate (fd, 16 << 20));
+    close (fd);
+
+    XferEngine engine(XferEngine::Options{});
+
+    ASSERT_TRUE (engine.run({{src, dest}}));
+
+    EXPECT_EQ (16 << 20, stat_file (dest).st_size);
+    EXPECT_EQ (read_file (src), read_file (dest));
+}
+
+
+TEST_F(XferEngineTest, DenseCopyWhenSparseIsOff)
+{
+    string src = dir + "/sparse";
+    string dest = dir + "/copy";
+
+    make_sparse_file (src, 8 << 20, 2);
+
+    XferEngine::Options options;
+    options.sparse = false;
+
+    XferEngine engine(options);
+
+    ASSERT_TRUE (engine.run({{src, dest}}));
+    EXPECT_EQ (read_file (src), read_file (dest));
+    EXPECT_EQ (engine.progress.bytes_done, engine.progress.physical_bytes_done);
+}
+
+
+TEST_F(XferEngineTest, CopiesTree)
+{
+    string src = dir + "/src";
+    string dest = dir + "/dest";
+
+    ASSERT_EQ (0, mkdir (src.c_str(), 0755));
+    ASSERT_EQ (0, mkdir ((src + "/sub").c_str(), 0750));
+    write_file (src + "/a", "first");
+    write_file (src + "/sub/b", "second");
+    ASSERT_EQ (0, symlink ("a", (src + "/link").c_str()));
+    ASSERT_EQ (0, chmod ((src + "/a").c_str(), 0640));
+
+    XferEngine engine(XferEngine::Options{});
+
+    ASSERT_TRUE (engine.run({{src, dest}}));
+
+    EXPECT_EQ ("first", read_file (dest + "/a"));
+    EXPECT_EQ ("second", read_file (dest + "/sub/b"));
+    EXPECT_TRUE (S_ISLNK (stat_file (dest + "/link").st_mode));
+    EXPECT_EQ (0640u, stat_file (dest + "/a").st_mode & 07777);
+    EXPECT_EQ (0750u, stat_file (dest + "/sub").st_mode & 07777);
+    EXPECT_EQ (stat_file (src + "/a").st_mtime, stat_file (dest + "/a").st_mtime);
+    EXPECT_EQ (3u, engine.progress.files_done);
+}
+
+
+TEST_F(XferEngineTest, OverwriteQuery)
+{
+    string src = dir + "/src";
+    string dest = dir + "/dest";
+
+    write_file (src, "new");
+    write_file (dest, "old");
+
+    XferEngine engine(XferEngine::Options{});
+    int asked = 0;
+
+    engine.on_overwrite = [&] (const string &, const string &) { ++asked; return XferEngine::OVERWRITE_ACTION_SKIP; };
+    ASSERT_TRUE (engine.run({{src, dest}}));
+    EXPECT_EQ (1, asked);
+    EXPECT_EQ ("old", read_file (dest));
+
+    engine.on_overwrite = [&] (const string &, const string &) { ++asked; return XferEngine::OVERWRITE_ACTION_REPLACE; };
+    ASSERT_TRUE (engine.run({{src, dest}}));
+    EXPECT_EQ (2, asked);
+    EXPECT_EQ ("new", read_file (dest));
+}
+
+
+TEST_F(XferEngineTest, ReplacesSymlinkNotItsTarget)
+{
+    string src = dir + "/src";
+    string dest = dir + "/dest";
+    string target = dir + "/target";
+
+    write_file (src, "new");
+    write_file (target, "keep");
+    ASSERT_EQ (0, symlink ("target", dest.c_str()));
+
+    XferEngine engine(XferEngine::Options{});
+
+    engine.on_overwrite = [&] (const string &, const string &) { return XferEngine::OVERWRITE_ACTION_REPLACE; };
+    ASSERT_TRUE (engine.run({{src, dest}}));
+    EXPECT_TRUE (S_ISREG (stat_file (dest).st_mode));
+    EXPECT_EQ ("new", read_file (dest));
+    EXPECT_EQ ("keep", read_file (target));
+}
+
+
+TEST_F(XferEngineTest, DirectoryReplacesWhatIsInTheWay)
+{
+    string src = dir + "/src";
+    string file = dir + "/file";
+    string link = dir + "/link";
+    string target = dir + "/target";
+
+    ASSERT_EQ (0, mkdir (src.c_str(), 0750));
+    write_file (src + "/a", "a");
+    write_file (file, "old");
+    ASSERT_EQ (0, mkdir (target.c_str(), 0755));
+    ASSERT_EQ (0, symlink ("target", link.c_str()));
+
+    XferEngine engine(XferEngine::Options{});
+    int asked = 0;
+
+    // skipped, the file stays as it is and nothing is reported
+    engine.on_overwrite = [&] (const string &, const string &) { ++asked; return XferEngine::OVERWRITE_ACTION_SKIP; };
+    ASSERT_TRUE (engine.run({{src, file}}));
+    EXPECT_EQ (1, asked);
+    EXPECT_EQ ("old", read_file (file));
+
+    // the link is replaced, the directory it points to is not written into
+    engine.on_overwrite = [&] (const string &, const string &) { ++asked; return XferEngine::OVERWRITE_ACTION_REPLACE; };
+    ASSERT_TRUE (engine.run({{src, file}, {src, link}}));
+    EXPECT_EQ (3, asked);
+    EXPECT_EQ ("a", read_file (file + "/a"));
+    EXPECT_TRUE (S_ISDIR (stat_file (link).st_mode));
+    EXPECT_EQ ("a", read_file (link + "/a"));
+    EXPECT_NE (0, access ((target + "/a").c_str(), F_OK));
+    EXPECT_EQ (0755u, stat_file (target).st_mode & 07777);
+}
+
+
+TEST_F(XferEngineTest, ErrorSkipContinues)
+{
+    string dest = dir + "/dest";
+
+    ASSERT_EQ (0, mkdir (dest.c_str(), 0755));
+    write_file (dir + "/b", "b");
+
+    XferEngine engine(XferEngine::Options{});
+    int errors = 0;
+
+    engine.on_error = [&] (const string &, int) { ++errors; return GnomeCmd::ERROR_ACTION_SKIP; };
+
+    ASSERT_TRUE (engine.run({{dir + "/missing", dest + "/missing"}, {dir + "/b", dest + "/b"}}));
+    EXPECT_EQ (1, errors);
+    EXPECT_EQ ("b", read_file (dest + "/b"));
+}
+
+
+TEST_F(XferEngineTest, PreflightCanRefuse)
+{
+    string src = dir + "/src";
+
+    ASSERT_EQ (0, mkdir (src.c_str(), 0755));
+    write_file (src + "/a", "first");
+    write_file (src + "/b", "second");
+
+    XferEngine engine(XferEngine::Options{});
+    uint64_t bytes = 0, files = 0;
+
+    engine.on_preflight = [&] (uint64_t b, uint64_t f) { bytes = b; files = f; return false; };
+
+    EXPECT_FALSE (engine.run({{src, dir + "/dest"}}));
+    EXPECT_EQ (11u, bytes);
+    EXPECT_EQ (2u, files);
+    EXPECT_NE (0, access ((dir + "/dest").c_str(), F_OK));
+}
+
+
+TEST_F(XferEngineTest, ResumesPartialFile)
+{
+    string src = dir + "/src";
+    string dest = dir + "/dest";
+    string content(3 << 20, 'x');
+
+    for (size_t i=0; i<content.size(); ++i)
+        content[i] = 'a' + i % 23;
+
+    write_file (src, content);
+    write_file (dest, content.substr(0, 1 << 20) + "garbage beyond the journal");
+
+    GnomeCmd::XferJournal journal(dir + "/journal", "job");
+    ASSERT_TRUE (journal.start(0, 0));
+    journal.update_partial(src, dest, 1 << 20, true);
+
+    XferEngine engine(XferEngine::Options{});
+    engine.journal = &journal;
+
+    ASSERT_TRUE (engine.run({{src, dest}}));
+    EXPECT_EQ (content, read_file (dest));
+    EXPECT_EQ (content.size(), engine.progress.bytes_done);
+    EXPECT_TRUE (journal.is_done(src));
+}
+
+
+TEST_F(XferEngineTest, UringBackendCopiesData)
+{
+    if (!GnomeCmd::XferUring::available())
+    {
+        std::cout << "io_uring is not available, skipping" << std::endl;
+        return;
+    }
+
+    string src = dir + "/src";
+    string content((5 << 20) + 12345, 'x');
+
+    for (size_t i=0; i<content.size(); ++i)
+        content[i] = 'a' + i % 19;
+
+    write_file (src, content);
+
+    for (unsigned depth : {1, 4, 64})
+    {
+        string dest = dir + "/dest" + to_string(depth);
+
+        XferEngine::Options options;
+        options.backend = XferEngine::BACKEND_URING;
+        options.queue_depth = depth;
+
+        XferEngine engine(options);
+
+        ASSERT_TRUE (engine.run({{src, dest}}));
+        EXPECT_EQ (content, read_file (dest));
+        EXPECT_EQ (content.size(), engine.progress.bytes_done);
+    }
+}
+
+
+TEST_F(XferEngineTest, UringBackendKeepsHoles)
+{
+    string src = dir + "/sparse";
+    string dest = dir + "/copy";
+
+    make_sparse_file (src, 32 << 20, 3);
+
+    XferEngine::Options options;
+    options.backend = XferEngine::BACKEND_URING;
+
+    // works with and without io_uring, the engine falls back silently
+    XferEngine engine(options);
+
+    ASSERT_TRUE (engine.run({{src, dest}}));
+    EXPECT_EQ (read_file (src), read_file (dest));
+}
+
+
+TEST_F(XferEngineTest, BulkModeCopiesData)
+{
+    string src = dir + "/src";
+    string content((3 << 20) + 777, 'x');
+
+    for (size_t i=0; i<content.size(); ++i)
+        content[i] = 'a' + i % 17;
+
+    write_file (src, content);
+
+    XferEngine::Options options;
+    options.bulk_mode = XferEngine::BULK_ON;
+
+    XferEngine engine(options);
+
+    ASSERT_TRUE (engine.run({{src, dir + "/dest"}}));
+    EXPECT_TRUE (engine.is_bulk());
+    EXPECT_EQ (content, read_file (dir + "/dest"));
+}
+
+
+TEST_F(XferEngineTest, BulkModeSwitchesOnBySize)
+{
+    write_file (dir + "/a", string(5000, 'a'));
+    write_file (dir + "/b", string(5000, 'b'));
+
+    XferEngine::Options options;
+    options.bulk_mode = XferEngine::BULK_AUTO;
+    options.bulk_threshold = 10000;
+
+    XferEngine engine(options);
+
+    ASSERT_TRUE (engine.run({{dir + "/a", dir + "/a2"}, {dir + "/b", dir + "/b2"}}));
+    EXPECT_TRUE (engine.is_bulk());
+
+    options.bulk_threshold = 10001;
+
+    XferEngine small(options);
+
+    ASSERT_TRUE (small.run({{dir + "/a", dir + "/a3"}, {dir + "/b", dir + "/b3"}}));
+    EXPECT_FALSE (small.is_bulk());
+    EXPECT_EQ (string(5000, 'b'), read_file (dir + "/b3"));
+}
+
+
+TEST_F(XferEngineTest, HardlinksArePreserved)
+{
+    ASSERT_EQ (0, mkdir ((dir + "/src").c_str(), 0755));
+    ASSERT_EQ (0, mkdir ((dir + "/src/sub").c_str(), 0755));
+    write_file (dir + "/src/a", string(10000, 'a'));
+    write_file (dir + "/src/single", "single");
+    ASSERT_EQ (0, link ((dir + "/src/a").c_str(), (dir + "/src/b").c_str()));
+    ASSERT_EQ (0, link ((dir + "/src/a").c_str(), (dir + "/src/sub/c").c_str()));
+
+    XferEngine::Options options;
+    options.preserve_hardlinks = true;
+
+    XferEngine engine(options);
+
+    ASSERT_TRUE (engine.run({{dir + "/src", dir + "/dest"}}));
+
+    struct stat a = stat_file (dir + "/dest/a");
+    struct stat b = stat_file (dir + "/dest/b");
+    struct stat c = stat_file (dir + "/dest/sub/c");
+
+    EXPECT_EQ (a.st_ino, b.st_ino);
+    EXPECT_EQ (a.st_ino, c.st_ino);
+    EXPECT_EQ (3u, a.st_nlink);
+    EXPECT_EQ (1u, stat_file (dir + "/dest/single").st_nlink);
+    EXPECT_EQ (string(10000, 'a'), read_file (dir + "/dest/sub/c"));
+
+    // the data is counted once
+    EXPECT_EQ (4u, engine.progress.files_done);
+    EXPECT_EQ (10006u, engine.progress.bytes_total);
+    EXPECT_EQ (10006u, engine.progress.bytes_done);
+
+    // without the option every link becomes a file of its own
+    XferEngine plain(XferEngine::Options{});
+
+    ASSERT_TRUE (plain.run({{dir + "/src", dir + "/plain"}}));
+    EXPECT_NE (stat_file (dir + "/plain/a").st_ino, stat_file (dir + "/plain/b").st_ino);
+    EXPECT_EQ (30006u, plain.progress.bytes_done);
+}
+
+
+TEST_F(XferEngineTest, ReflinkCopiesData)
+{
+    string content(300000, 'r');
+
+    write_file (dir + "/src", content);
+
+    XferEngine::Options options;
+    options.reflink = true;
+
+    XferEngine engine(options);
+
+    // file systems without FICLONE copy the data instead
+    ASSERT_TRUE (engine.run({{dir + "/src", dir + "/dest"}}));
+    EXPECT_EQ (content, read_file (dir + "/dest"));
+    EXPECT_EQ (content.size(), engine.progress.bytes_done);
+}
+
+
+TEST(XferConflictRulesTest, FirstMatchingRuleWins)
+{
+    GnomeCmd::XferConflictRules rules;
+    GnomeCmd::XferConflict conflict;
+
+    rules.rules.push_back({"*.log", GnomeCmd::XferConflictRules::POLICY_REPLACE});
+    rules.rules.push_back({"*.*", GnomeCmd::XferConflictRules::POLICY_RENAME});
+
+    EXPECT_EQ (GnomeCmd::XferConflictRules::POLICY_REPLACE, rules.get_policy("/a.b/x.log"));
+    EXPECT_EQ (GnomeCmd::XferConflictRules::POLICY_RENAME, rules.get_policy("/a/x.txt"));
+    EXPECT_EQ (GnomeCmd::XferConflictRules::POLICY_SKIP, rules.get_policy("/a.b/x"));
+
+    rules.rules.clear();
+    rules.default_policy = GnomeCmd::XferConflictRules::POLICY_NEWER_WINS;
+    conflict.src_mtime = 200;
+    conflict.dest_mtime = 100;
+    EXPECT_EQ (GnomeCmd::XferConflictRules::RESOLUTION_REPLACE, rules.resolve(conflict));
+    conflict.src_mtime = 100;
+    EXPECT_EQ (GnomeCmd::XferConflictRules::RESOLUTION_SKIP, rules.resolve(conflict));
+
+    rules.default_policy = GnomeCmd::XferConflictRules::POLICY_SKIP_IDENTICAL;
+    EXPECT_EQ (GnomeCmd::XferConflictRules::RESOLUTION_SKIP, rules.resolve(conflict));
+    conflict.src_size = 1;
+    EXPECT_EQ (GnomeCmd::XferConflictRules::RESOLUTION_REPLACE, rules.resolve(conflict));
+}
+
+
+TEST(XferConflictRulesTest, RenameKeepsExtension)
+{
+    EXPECT_EQ ("dir/photo (2).jpg", GnomeCmd::XferConflictRules::renamed("dir/photo.jpg", 2));
+    EXPECT_EQ ("dir.d/readme (1)", GnomeCmd::XferConflictRules::renamed("dir.d/readme", 1));
+    EXPECT_EQ ("/home/.bashrc (1)", GnomeCmd::XferConflictRules::renamed("/home/.bashrc", 1));
+}
+
+
+TEST_F(XferEngineTest, ConflictRulesResolveWithoutAsking)
+{
+    string src = dir + "/src";
+    string dest = dir + "/dest";
+
+    ASSERT_EQ (0, mkdir (src.c_str(), 0755));
+    ASSERT_EQ (0, mkdir (dest.c_str(), 0755));
+    write_file (src + "/new", "new");
+    write_file (src + "/a.txt", "a");
+    write_file (dest + "/a.txt", "old a");
+    write_file (src + "/b.dat", "b");
+    write_file (dest + "/b.dat", "old b");
+
+    XferEngine engine(XferEngine::Options{});
+    vector<XferEngine::Item> items = {{src, dest}};
+
+    auto conflicts = engine.find_conflicts(items);
+    ASSERT_EQ (2u, conflicts.size());
+
+    GnomeCmd::XferConflictRules rules;
+    rules.rules.push_back({"*.txt", GnomeCmd::XferConflictRules::POLICY_RENAME});
+    rules.default_policy = GnomeCmd::XferConflictRules::POLICY_REPLACE;
+
+    int asked = 0;
+    engine.on_overwrite = [&] (const string &, const string &) { ++asked; return XferEngine::OVERWRITE_ACTION_SKIP; };
+    engine.conflict_rules = &rules;
+
+    ASSERT_TRUE (engine.run(items));
+    EXPECT_EQ (0, asked);
+    EXPECT_EQ ("new", read_file (dest + "/new"));
+    EXPECT_EQ ("old a", read_file (dest + "/a.txt"));
+    EXPECT_EQ ("a", read_file (dest + "/a (1).txt"));
+    EXPECT_EQ ("b", read_file (dest + "/b.dat"));
+}
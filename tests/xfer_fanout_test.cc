@@ -0,0 +1,171 @@
+/**
+ * @file xfer_fanout_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for copying to several destinations at once.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-xfer-fanout.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::XferFanout;
+
+
+class XferFanoutTest : public TempDirTest
+{
+  protected:
+
+    string make_content(size_t size)
+    {
+        string content(size, '\0');
+
+        for (size_t i=0; i<size; ++i)
+            content[i] = 'a' + (i * 7 + i / 4096) % 26;
+
+        return content;
+    }
+
+    vector<string> make_dests(int n)
+    {
+        vector<string> dests;
+
+        for (int i=0; i<n; ++i)
+        {
+            dests.push_back(dir + "/dest" + to_string(i));
+            EXPECT_EQ (0, mkdir (dests.back().c_str(), 0755));
+        }
+
+        return dests;
+    }
+};
+
+
+TEST_F(XferFanoutTest, CopiesTreeToAllDestinations)
+{
+    // larger than the ring, so that the writers have to wait for each other
+    string big = make_content (XferFanout::BLOCK_SIZE * XferFanout::RING_SLOTS * 2 + 12345);
+    string small = make_content (1000);
+
+    ASSERT_EQ (0, mkdir ((dir + "/src").c_str(), 0755));
+    ASSERT_EQ (0, mkdir ((dir + "/src/sub").c_str(), 0755));
+    write_file (dir + "/src/big", big);
+    write_file (dir + "/src/sub/small", small);
+    write_file (dir + "/src/empty", "");
+    ASSERT_EQ (0, symlink ("sub/small", (dir + "/src/link").c_str()));
+
+    vector<string> dests = make_dests (3);
+    XferFanout fanout(XferFanout::Options(), dests);
+
+    ASSERT_TRUE (fanout.run({{dir + "/src", "copy"}}));
+
+    EXPECT_EQ (4u, fanout.files_total);
+    EXPECT_EQ (big.size() + small.size(), fanout.bytes_total);
+
+    for (size_t i=0; i<dests.size(); ++i)
+    {
+        EXPECT_EQ (big, read_file (dests[i] + "/copy/big"));
+        EXPECT_EQ (small, read_file (dests[i] + "/copy/sub/small"));
+        EXPECT_EQ ("", read_file (dests[i] + "/copy/empty"));
+        EXPECT_EQ (small, read_file (dests[i] + "/copy/link"));
+        EXPECT_EQ (4u, fanout.destinations[i]->files_done);
+        EXPECT_EQ (fanout.bytes_total, fanout.destinations[i]->bytes_done);
+    }
+}
+
+
+TEST_F(XferFanoutTest, ExistingFilesAreKeptUnlessReplacing)
+{
+    write_file (dir + "/a", "new");
+
+    vector<string> dests = make_dests (2);
+
+    write_file (dests[0] + "/a", "old");
+
+    XferFanout keep(XferFanout::Options(), dests);
+
+    ASSERT_TRUE (keep.run({{dir + "/a", "a"}}));
+    EXPECT_EQ ("old", read_file (dests[0] + "/a"));
+    EXPECT_EQ ("new", read_file (dests[1] + "/a"));
+
+    XferFanout::Options options;
+    options.replace = true;
+
+    XferFanout replace(options, dests);
+
+    ASSERT_TRUE (replace.run({{dir + "/a", "a"}}));
+    EXPECT_EQ ("new", read_file (dests[0] + "/a"));
+
+    // a symlink is replaced, the file it points to is left alone
+    write_file (dir + "/target", "old");
+    ASSERT_EQ (0, unlink ((dests[1] + "/a").c_str()));
+    ASSERT_EQ (0, symlink ((dir + "/target").c_str(), (dests[1] + "/a").c_str()));
+
+    XferFanout replace_link(options, dests);
+
+    ASSERT_TRUE (replace_link.run({{dir + "/a", "a"}}));
+    EXPECT_EQ ("new", read_file (dests[1] + "/a"));
+    EXPECT_EQ ("old", read_file (dir + "/target"));
+}
+
+
+TEST_F(XferFanoutTest, FailingDestinationIsSkipped)
+{
+    if (geteuid () == 0)
+    {
+        std::cout << "Permissions are not checked for root, skipping" << std::endl;
+        return;
+    }
+
+    string big = make_content (XferFanout::BLOCK_SIZE * 3);
+
+    write_file (dir + "/big", big);
+
+    vector<string> dests = make_dests (3);
+
+    ASSERT_EQ (0, chmod (dests[1].c_str(), 0555));
+
+    XferFanout fanout(XferFanout::Options(), dests);
+    int errors = 0;
+
+    fanout.on_error = [&] (const string &path, int error)
+    {
+        ++errors;
+        EXPECT_EQ (dests[1] + "/big", path);
+        EXPECT_EQ (EACCES, error);
+        return GnomeCmd::ERROR_ACTION_SKIP;
+    };
+
+    ASSERT_TRUE (fanout.run({{dir + "/big", "big"}}));
+    EXPECT_EQ (1, errors);
+    EXPECT_EQ (big, read_file (dests[0] + "/big"));
+    EXPECT_EQ (big, read_file (dests[2] + "/big"));
+}
+
+
+TEST_F(XferFanoutTest, MissingSourceAborts)
+{
+    vector<string> dests = make_dests (2);
+    XferFanout fanout(XferFanout::Options(), dests);
+
+    EXPECT_FALSE (fanout.run({{dir + "/missing", "missing"}}));
+}
@@ -0,0 +1,165 @@
+/**
+ * @file xfer_journal_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for the transfer journal which allows resuming
+ * interrupted copy operations.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-xfer-journal.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::XferJournal;
+
+
+class XferJournalTest : public TempDirTest
+{
+};
+
+
+TEST_F(XferJournalTest, JobKeyDependsOnAllUris)
+{
+    string k1 = XferJournal::make_job_key({"file:///a", "file:///b"}, {"sftp://h/a", "sftp://h/b"});
+    string k2 = XferJournal::make_job_key({"file:///a", "file:///b"}, {"sftp://h/a", "sftp://h/c"});
+    string k3 = XferJournal::make_job_key({"file:///ab"}, {"file:///c"});
+    string k4 = XferJournal::make_job_key({"file:///a"}, {"bfile:///c"});
+
+    EXPECT_EQ (16u, k1.size());
+    EXPECT_EQ (k1, XferJournal::make_job_key({"file:///a", "file:///b"}, {"sftp://h/a", "sftp://h/b"}));
+    EXPECT_NE (k1, k2);
+    EXPECT_NE (k3, k4);
+}
+
+
+TEST_F(XferJournalTest, RecordsSurviveReload)
+{
+    {
+        XferJournal j(dir, "job");
+        ASSERT_TRUE (j.start(5, 2));
+        j.mark_done("file:///src/a");
+        j.mark_done("file:///src/b");
+        j.update_partial("file:///src/c", "sftp://host/dst/c", 4096, true);
+        // the journal is left behind, just like after a crash
+    }
+
+    XferJournal j(dir, "job");
+    ASSERT_TRUE (j.exists());
+    ASSERT_TRUE (j.load());
+
+    EXPECT_EQ (5u, j.get_options());
+    EXPECT_EQ (2u, j.get_overwrite_mode());
+    EXPECT_TRUE (j.is_done("file:///src/a"));
+    EXPECT_TRUE (j.is_done("file:///src/b"));
+    EXPECT_FALSE (j.is_done("file:///src/c"));
+
+    string src, dest;
+    uint64_t offset;
+
+    ASSERT_TRUE (j.get_partial(src, dest, offset));
+    EXPECT_EQ ("file:///src/c", src);
+    EXPECT_EQ ("sftp://host/dst/c", dest);
+    EXPECT_EQ (4096u, offset);
+}
+
+
+TEST_F(XferJournalTest, CompletedFileClearsPartial)
+{
+    {
+        XferJournal j(dir, "job");
+        ASSERT_TRUE (j.start(0, 0));
+        j.update_partial("file:///src/a", "file:///dst/a", 100, true);
+        j.mark_done("file:///src/a");
+    }
+
+    XferJournal j(dir, "job");
+    ASSERT_TRUE (j.load());
+
+    string src, dest;
+    uint64_t offset;
+
+    EXPECT_TRUE (j.is_done("file:///src/a"));
+    EXPECT_FALSE (j.get_partial(src, dest, offset));
+}
+
+
+TEST_F(XferJournalTest, PartialUpdatesAreThrottled)
+{
+    {
+        XferJournal j(dir, "job");
+        ASSERT_TRUE (j.start(0, 0));
+        j.update_partial("file:///src/a", "file:///dst/a", 10);
+        j.update_partial("file:///src/a", "file:///dst/a", 20);
+    }
+
+    XferJournal j(dir, "job");
+    ASSERT_TRUE (j.load());
+
+    string src, dest;
+    uint64_t offset;
+
+    // the first record of a file is always written, the second one is not due yet
+    ASSERT_TRUE (j.get_partial(src, dest, offset));
+    EXPECT_EQ (10u, offset);
+}
+
+
+TEST_F(XferJournalTest, TruncatedLastRecordIsIgnored)
+{
+    {
+        XferJournal j(dir, "job");
+        ASSERT_TRUE (j.start(0, 0));
+        j.mark_done("file:///src/a");
+    }
+
+    FILE *f = fopen ((dir + "/job.journal").c_str(), "a");
+    ASSERT_NE (nullptr, f);
+    fputs ("done\tfile:///src/b", f);
+    fclose (f);
+
+    XferJournal j(dir, "job");
+    ASSERT_TRUE (j.load());
+    EXPECT_TRUE (j.is_done("file:///src/a"));
+    EXPECT_FALSE (j.is_done("file:///src/b"));
+}
+
+
+TEST_F(XferJournalTest, ResumeCompactsAndRemoveDeletes)
+{
+    {
+        XferJournal j(dir, "job");
+        ASSERT_TRUE (j.start(0, 0));
+        j.mark_done("file:///src/a");
+    }
+
+    XferJournal j(dir, "job");
+    ASSERT_TRUE (j.load());
+    ASSERT_TRUE (j.resume());
+    j.mark_done("file:///src/b");
+
+    XferJournal k(dir, "job");
+    ASSERT_TRUE (k.load());
+    EXPECT_EQ (2u, k.done_count());
+
+    j.remove();
+    EXPECT_FALSE (j.exists());
+    EXPECT_FALSE (k.load());
+}
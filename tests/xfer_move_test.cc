@@ -0,0 +1,223 @@
+/**
+ * @file xfer_move_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for moving local files. Files are moved across file
+ * systems between /tmp and /dev/shm where these differ; a destination
+ * which exists already takes the same path on a single file system.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-xfer-move.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::XferEngine;
+using GnomeCmd::XferMove;
+
+
+class XferMoveTest : public TempDirTest
+{
+  protected:
+
+    string other_dir;           // on another file system, empty if there is none
+
+    void SetUp() override
+    {
+        ASSERT_NO_FATAL_FAILURE (TempDirTest::SetUp());
+
+        struct stat st, shm_st;
+
+        if (stat ("/dev/shm", &shm_st) == 0 && stat (dir.c_str(), &st) == 0 && st.st_dev != shm_st.st_dev)
+            other_dir = make_temp_dir("/dev/shm/gcmd-move-");
+    }
+
+    void TearDown() override
+    {
+        TempDirTest::TearDown();
+
+        if (!other_dir.empty())
+        {
+            EXPECT_TRUE (remove_tree(other_dir));
+        }
+    }
+
+    bool exists(const string &path)
+    {
+        struct stat st;
+        return lstat (path.c_str(), &st) == 0;
+    }
+
+    void make_tree(const string &path)
+    {
+        ASSERT_EQ (0, mkdir (path.c_str(), 0755));
+        ASSERT_EQ (0, mkdir ((path + "/sub").c_str(), 0755));
+        write_file (path + "/a", "a");
+        write_file (path + "/sub/b", string(300000, 'b'));
+        ASSERT_EQ (0, symlink ("a", (path + "/link").c_str()));
+    }
+
+    void expect_tree(const string &path)
+    {
+        EXPECT_EQ ("a", read_file (path + "/a"));
+        EXPECT_EQ (string(300000, 'b'), read_file (path + "/sub/b"));
+
+        char target[16] = {};
+        EXPECT_EQ (1, readlink ((path + "/link").c_str(), target, sizeof(target)-1));
+        EXPECT_STREQ ("a", target);
+    }
+};
+
+
+TEST_F(XferMoveTest, RenamesOnTheSameFileSystem)
+{
+    make_tree (dir + "/tree");
+    write_file (dir + "/file", "file");
+    ASSERT_EQ (0, mkdir ((dir + "/dest").c_str(), 0755));
+
+    XferEngine engine{XferEngine::Options()};
+    XferMove move(engine);
+
+    ASSERT_TRUE (move.run({{dir + "/tree", dir + "/dest/tree"}, {dir + "/file", dir + "/dest/file"}}));
+
+    expect_tree (dir + "/dest/tree");
+    EXPECT_EQ ("file", read_file (dir + "/dest/file"));
+    EXPECT_FALSE (exists (dir + "/tree"));
+    EXPECT_FALSE (exists (dir + "/file"));
+    EXPECT_EQ (2u, move.renamed);
+    EXPECT_EQ (0u, engine.progress.files_total);
+}
+
+
+TEST_F(XferMoveTest, CopiesAndRemovesAcrossFileSystems)
+{
+    if (other_dir.empty())
+    {
+        std::cout << "/tmp and /dev/shm are on the same file system, skipping" << std::endl;
+        return;
+    }
+
+    make_tree (dir + "/tree");
+    make_tree (dir + "/renamed");
+
+    XferEngine engine{XferEngine::Options()};
+    XferMove move(engine);
+
+    ASSERT_TRUE (move.run({{dir + "/tree", other_dir + "/tree"}, {dir + "/renamed", dir + "/renamed2"}}));
+
+    expect_tree (other_dir + "/tree");
+    expect_tree (dir + "/renamed2");
+    EXPECT_FALSE (exists (dir + "/tree"));
+    EXPECT_FALSE (exists (dir + "/renamed"));
+    EXPECT_EQ (1u, move.renamed);
+    EXPECT_EQ (5u, move.removed);   // three files and two directories
+}
+
+
+TEST_F(XferMoveTest, MergesExistingDirectory)
+{
+    make_tree (dir + "/tree");
+    ASSERT_EQ (0, mkdir ((dir + "/dest").c_str(), 0755));
+    ASSERT_EQ (0, mkdir ((dir + "/dest/tree").c_str(), 0755));
+    write_file (dir + "/dest/tree/old", "old");
+
+    XferEngine engine{XferEngine::Options()};
+    XferMove move(engine);
+
+    ASSERT_TRUE (move.run({{dir + "/tree", dir + "/dest/tree"}}));
+
+    expect_tree (dir + "/dest/tree");
+    EXPECT_EQ ("old", read_file (dir + "/dest/tree/old"));
+    EXPECT_FALSE (exists (dir + "/tree"));
+    EXPECT_EQ (0u, move.renamed);
+}
+
+
+TEST_F(XferMoveTest, SkippedFilesKeepTheirSource)
+{
+    make_tree (dir + "/tree");
+    ASSERT_EQ (0, mkdir ((dir + "/dest").c_str(), 0755));
+    ASSERT_EQ (0, mkdir ((dir + "/dest/tree").c_str(), 0755));
+    write_file (dir + "/dest/tree/a", "existing");
+
+    XferEngine::Options options;
+    options.overwrite_mode = XferEngine::OVERWRITE_MODE_SKIP;
+
+    XferEngine engine(options);
+    XferMove move(engine);
+
+    ASSERT_TRUE (move.run({{dir + "/tree", dir + "/dest/tree"}}));
+
+    EXPECT_EQ ("existing", read_file (dir + "/dest/tree/a"));
+    EXPECT_EQ (string(300000, 'b'), read_file (dir + "/dest/tree/sub/b"));
+
+    // the skipped file and the directory it is in stay where they are
+    EXPECT_EQ ("a", read_file (dir + "/tree/a"));
+    EXPECT_FALSE (exists (dir + "/tree/sub"));
+    EXPECT_FALSE (exists (dir + "/tree/link"));
+}
+
+
+TEST_F(XferMoveTest, ReportsSourcesWhichCantBeRemoved)
+{
+    if (geteuid () == 0)
+    {
+        std::cout << "Permissions are not checked for root, skipping" << std::endl;
+        return;
+    }
+
+    make_tree (dir + "/tree");
+    ASSERT_EQ (0, mkdir ((dir + "/dest").c_str(), 0755));
+    ASSERT_EQ (0, mkdir ((dir + "/dest/tree").c_str(), 0755));
+    ASSERT_EQ (0, chmod ((dir + "/tree/sub").c_str(), 0555));
+
+    XferEngine engine{XferEngine::Options()};
+    XferMove move(engine);
+    vector<string> errors;
+
+    engine.on_error = [&] (const string &path, int error)
+    {
+        errors.push_back(path);
+        EXPECT_EQ (EACCES, error);
+        return GnomeCmd::ERROR_ACTION_SKIP;
+    };
+
+    ASSERT_TRUE (move.run({{dir + "/tree", dir + "/dest/tree"}}));
+
+    expect_tree (dir + "/dest/tree");
+    ASSERT_EQ (1u, errors.size());
+    EXPECT_EQ (dir + "/tree/sub/b", errors[0]);
+    EXPECT_TRUE (exists (dir + "/tree/sub/b"));
+    EXPECT_FALSE (exists (dir + "/tree/a"));
+}
+
+
+TEST_F(XferMoveTest, RenameDoesNotReplace)
+{
+    write_file (dir + "/a", "a");
+    write_file (dir + "/b", "b");
+
+    EXPECT_EQ (EEXIST, XferMove::rename_noreplace(dir + "/a", dir + "/b"));
+    EXPECT_EQ ("b", read_file (dir + "/b"));
+    EXPECT_EQ (0, XferMove::rename_noreplace(dir + "/a", dir + "/c"));
+    EXPECT_EQ ("a", read_file (dir + "/c"));
+}
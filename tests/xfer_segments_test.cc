@@ -0,0 +1,418 @@
+/**
+ * @file xfer_segments_test.cc
+ * @brief Part of GNOME Commander - A GNOME based file manager
+ *
+ * @details Tests for downloading files in several segments. Local files
+ * read with pread stand in for the remote connections.
+ *
+ * @copyright (C) 2013-2021 Uwe Scholz\n
+ *
+ * @copyright This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * @copyright This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * @copyright You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <gtest/gtest.h>
+#include "../src/gnome-cmd-xfer-segments.h"
+#include "../src/gnome-cmd-xfer-journal.h"
+#include "gcmd_tests_tmpdir.h"
+
+using namespace std;
+using GnomeCmd::SegmentedDownload;
+
+
+/** Reads a local file, failing once it has read @a limit bytes over all connections */
+class LocalReader: public SegmentedDownload::Reader
+{
+    int fd;
+    atomic<uint64_t> &bytes_read;
+    uint64_t limit;
+    uint64_t fail_after;        // bytes read by this connection before it drops
+
+  public:
+
+    LocalReader(int f, atomic<uint64_t> &counter, uint64_t lim, uint64_t drop): fd(f), bytes_read(counter), limit(lim), fail_after(drop)  {}
+    ~LocalReader()      {  close (fd);  }
+
+    bool read(uint64_t offset, char *buf, size_t len, size_t &n, string &error) override
+    {
+        if (bytes_read >= limit || fail_after == 0)
+        {
+            error = "connection lost";
+            return false;
+        }
+
+        len = min<uint64_t> (len, fail_after);
+
+        ssize_t r = pread (fd, buf, len, offset);
+
+        if (r < 0)
+        {
+            error = strerror (errno);
+            return false;
+        }
+
+        n = r;
+        bytes_read += n;
+        fail_after -= n;
+
+        return true;
+    }
+};
+
+
+class XferSegmentsTest : public TempDirTest
+{
+  protected:
+
+    atomic<int> opens {0};
+    atomic<uint64_t> bytes_read {0};
+    uint64_t limit {UINT64_MAX};
+    uint64_t fail_after {UINT64_MAX};
+
+    SegmentedDownload::OpenFunc opener()
+    {
+        return [this] (const string &src, string &error) -> SegmentedDownload::Reader *
+        {
+            int fd = open (src.c_str(), O_RDONLY);
+
+            if (fd < 0)
+            {
+                error = strerror (errno);
+                return nullptr;
+            }
+
+            ++opens;
+
+            return new LocalReader(fd, bytes_read, limit, fail_after);
+        };
+    }
+
+    string make_content(size_t size)
+    {
+        string content(size, '\0');
+
+        for (size_t i=0; i<size; ++i)
+            content[i] = 'a' + (i * 7 + i / 4096) % 26;
+
+        return content;
+    }
+
+    SegmentedDownload::Options options()
+    {
+        SegmentedDownload::Options opts;
+
+        opts.segments = 4;
+        opts.min_segment_size = 1 << 20;
+
+        return opts;
+    }
+};
+
+
+TEST_F(XferSegmentsTest, CountSegments)
+{
+    SegmentedDownload download(options(), opener());
+
+    EXPECT_EQ (1u, download.count_segments(1000));
+    EXPECT_EQ (2u, download.count_segments(2 << 20));
+    EXPECT_EQ (4u, download.count_segments(100 << 20));
+
+    download.options.segments = 1;
+
+    EXPECT_EQ (1u, download.count_segments(100 << 20));
+}
+
+
+TEST_F(XferSegmentsTest, DownloadsInSegments)
+{
+    string big = make_content ((5 << 20) + 12345);
+    string small = make_content (1000);
+
+    write_file (dir + "/big", big);
+    write_file (dir + "/small", small);
+    write_file (dir + "/empty", "");
+
+    SegmentedDownload download(options(), opener());
+
+    ASSERT_TRUE (download.run({{dir + "/big", dir + "/big.copy", big.size(), 0, 0644},
+                               {dir + "/small", dir + "/small.copy", small.size(), 0, 0644},
+                               {dir + "/empty", dir + "/empty.copy", 0, 0, 0644}})) << download.error;
+
+    EXPECT_EQ (big, read_file (dir + "/big.copy"));
+    EXPECT_EQ (small, read_file (dir + "/small.copy"));
+    EXPECT_EQ ("", read_file (dir + "/empty.copy"));
+    EXPECT_EQ (5, opens);
+    EXPECT_EQ (3u, download.files_done);
+    EXPECT_EQ (big.size() + small.size(), download.bytes_done);
+    EXPECT_FALSE (SegmentedDownload::has_state(dir + "/big.copy"));
+}
+
+
+TEST_F(XferSegmentsTest, ReconnectsAfterDroppedConnections)
+{
+    string big = make_content (3 << 20);
+
+    write_file (dir + "/big", big);
+
+    // every connection drops after half a MiB
+    fail_after = 1 << 19;
+
+    SegmentedDownload download(options(), opener());
+
+    ASSERT_TRUE (download.run({{dir + "/big", dir + "/big.copy", big.size(), 0, 0644}})) << download.error;
+    EXPECT_EQ (big, read_file (dir + "/big.copy"));
+    EXPECT_GT (opens, 3);
+}
+
+
+TEST_F(XferSegmentsTest, ResumesInterruptedDownload)
+{
+    string big = make_content ((4 << 20) + 777);
+
+    write_file (dir + "/big", big);
+
+    limit = 3 << 20;
+
+    SegmentedDownload broken(options(), opener());
+
+    EXPECT_FALSE (broken.run({{dir + "/big", dir + "/big.copy", big.size(), 0, 0644}}));
+    EXPECT_EQ ("connection lost", broken.error);
+    EXPECT_EQ (dir + "/big", broken.error_file);
+    EXPECT_TRUE (SegmentedDownload::has_state(dir + "/big.copy"));
+
+    uint64_t first = bytes_read;
+
+    limit = UINT64_MAX;
+    bytes_read = 0;
+
+    SegmentedDownload resumed(options(), opener());
+
+    ASSERT_TRUE (resumed.run({{dir + "/big", dir + "/big.copy", big.size(), 0, 0644}})) << resumed.error;
+    EXPECT_EQ (big, read_file (dir + "/big.copy"));
+    EXPECT_EQ (big.size() - first, bytes_read);
+    EXPECT_EQ (big.size(), resumed.bytes_done);
+    EXPECT_FALSE (SegmentedDownload::has_state(dir + "/big.copy"));
+}
+
+
+TEST_F(XferSegmentsTest, MismatchingStateStartsOver)
+{
+    string big = make_content (2 << 20);
+
+    write_file (dir + "/big", big);
+    write_file (dir + "/big.copy", "old");
+    write_file (SegmentedDownload::state_path(dir + "/big.copy"), "GCMD-SEGMENTS 3 1\n");
+
+    SegmentedDownload download(options(), opener());
+
+    ASSERT_TRUE (download.run({{dir + "/big", dir + "/big.copy", big.size(), 0, 0644}})) << download.error;
+    EXPECT_EQ (big, read_file (dir + "/big.copy"));
+    EXPECT_EQ (big.size(), bytes_read);
+}
+
+
+TEST_F(XferSegmentsTest, AppliesModeAndTime)
+{
+    string big = make_content (2 << 20);
+
+    write_file (dir + "/big", big);
+    write_file (dir + "/small", "small");
+
+    SegmentedDownload download(options(), opener());
+
+    ASSERT_TRUE (download.run({{dir + "/big", dir + "/big.copy", big.size(), 1000000, 0755},
+                               {dir + "/small", dir + "/small.copy", 5, 2000000, 0700}})) << download.error;
+
+    struct stat st;
+
+    ASSERT_EQ (0, stat ((dir + "/big.copy").c_str(), &st));
+    EXPECT_EQ (0755u, st.st_mode & 07777);
+    EXPECT_EQ (1000000, st.st_mtime);
+
+    ASSERT_EQ (0, stat ((dir + "/small.copy").c_str(), &st));
+    EXPECT_EQ (0700u, st.st_mode & 07777);
+    EXPECT_EQ (2000000, st.st_mtime);
+}
+
+
+TEST_F(XferSegmentsTest, SmallFileHasNoState)
+{
+    write_file (dir + "/small", "small");
+
+    fail_after = 0;
+
+    SegmentedDownload download(options(), opener());
+
+    EXPECT_FALSE (download.run({{dir + "/small", dir + "/small.copy", 5, 0, 0644}}));
+    EXPECT_FALSE (SegmentedDownload::has_state(dir + "/small.copy"));
+    EXPECT_NE (0, access ((dir + "/small.copy").c_str(), F_OK));
+}
+
+
+TEST_F(XferSegmentsTest, ReplacesSymlinkInTheWay)
+{
+    string big = make_content (2 << 20);
+
+    write_file (dir + "/big", big);
+    write_file (dir + "/small", "small");
+    write_file (dir + "/target", "target");
+
+    ASSERT_EQ (0, symlink ((dir + "/target").c_str(), (dir + "/big.copy").c_str()));
+    ASSERT_EQ (0, symlink ((dir + "/target").c_str(), (dir + "/small.copy").c_str()));
+
+    SegmentedDownload download(options(), opener());
+
+    ASSERT_TRUE (download.run({{dir + "/big", dir + "/big.copy", big.size(), 0, 0644},
+                               {dir + "/small", dir + "/small.copy", 5, 0, 0644}})) << download.error;
+
+    struct stat st;
+
+    ASSERT_EQ (0, lstat ((dir + "/big.copy").c_str(), &st));
+    EXPECT_TRUE (S_ISREG (st.st_mode));
+    ASSERT_EQ (0, lstat ((dir + "/small.copy").c_str(), &st));
+    EXPECT_TRUE (S_ISREG (st.st_mode));
+    EXPECT_EQ ("target", read_file (dir + "/target"));
+    EXPECT_EQ (big, read_file (dir + "/big.copy"));
+}
+
+
+TEST_F(XferSegmentsTest, JournalSkipsFinishedFiles)
+{
+    string big = make_content (2 << 20);
+
+    write_file (dir + "/big", big);
+    write_file (dir + "/small", "small");
+    write_file (dir + "/small.copy", "done before");
+
+    GnomeCmd::XferJournal journal(dir + "/journal", "job");
+    ASSERT_TRUE (journal.start(0, 0));
+    journal.mark_done(dir + "/small");
+
+    SegmentedDownload download(options(), opener());
+
+    download.journal = &journal;
+
+    ASSERT_TRUE (download.run({{dir + "/small", dir + "/small.copy", 5, 0, 0644},
+                               {dir + "/big", dir + "/big.copy", big.size(), 0, 0644}})) << download.error;
+
+    EXPECT_EQ ("done before", read_file (dir + "/small.copy"));
+    EXPECT_EQ (big, read_file (dir + "/big.copy"));
+    EXPECT_EQ (big.size(), bytes_read);
+    EXPECT_EQ (2u, download.files_done);
+    EXPECT_EQ (big.size() + 5, download.bytes_done);
+    EXPECT_TRUE (journal.is_done(dir + "/big"));
+}
+
+
+TEST_F(XferSegmentsTest, MissingSourceFails)
+{
+    SegmentedDownload download(options(), opener());
+
+    EXPECT_FALSE (download.run({{dir + "/missing", dir + "/copy", 100, 0, 0644}}));
+    EXPECT_EQ (strerror (ENOENT), download.error);
+}
+
+
+TEST_F(XferSegmentsTest, RetryContinuesFailedFile)
+{
+    string big = make_content (3 << 20);
+
+    write_file (dir + "/big", big);
+    write_file (dir + "/small", "small");
+
+    // two connections, which fail after their first block
+    limit = 1;
+
+    SegmentedDownload download(options(), opener());
+    int errors = 0;
+
+    download.options.segments = 2;
+
+    download.on_error = [&] (const string &src, const string &error)
+    {
+        ++errors;
+        EXPECT_EQ (dir + "/big", src);
+        EXPECT_EQ ("connection lost", error);
+        limit = UINT64_MAX;
+        return GnomeCmd::ERROR_ACTION_RETRY;
+    };
+
+    ASSERT_TRUE (download.run({{dir + "/big", dir + "/big.copy", big.size(), 0, 0644},
+                               {dir + "/small", dir + "/small.copy", 5, 0, 0644}})) << download.error;
+
+    EXPECT_EQ (1, errors);
+    EXPECT_EQ (big, read_file (dir + "/big.copy"));
+    EXPECT_EQ ("small", read_file (dir + "/small.copy"));
+    EXPECT_EQ (big.size() + 5, download.bytes_done);
+    EXPECT_EQ (big.size() + 5, bytes_read);
+}
+
+
+TEST_F(XferSegmentsTest, ChangedSourceStartsOver)
+{
+    string big = make_content (2 << 20);
+
+    write_file (dir + "/big", big);
+
+    limit = 1 << 20;
+
+    SegmentedDownload broken(options(), opener());
+
+    EXPECT_FALSE (broken.run({{dir + "/big", dir + "/big.copy", big.size(), 1000, 0644}}));
+    EXPECT_TRUE (SegmentedDownload::has_state(dir + "/big.copy"));
+
+    limit = UINT64_MAX;
+    bytes_read = 0;
+
+    // same size, but modified since the interruption
+    SegmentedDownload download(options(), opener());
+
+    ASSERT_TRUE (download.run({{dir + "/big", dir + "/big.copy", big.size(), 2000, 0644}})) << download.error;
+    EXPECT_EQ (big, read_file (dir + "/big.copy"));
+    EXPECT_EQ (big.size(), bytes_read);
+}
+
+
+TEST_F(XferSegmentsTest, SkipRemovesFailedFile)
+{
+    string big = make_content (3 << 20);
+
+    write_file (dir + "/big", big);
+    write_file (dir + "/small", "small");
+
+    limit = 1;
+
+    SegmentedDownload download(options(), opener());
+
+    download.options.segments = 2;
+
+    download.on_error = [&] (const string &, const string &)
+    {
+        limit = UINT64_MAX;
+        return GnomeCmd::ERROR_ACTION_SKIP;
+    };
+
+    ASSERT_TRUE (download.run({{dir + "/big", dir + "/big.copy", big.size(), 0, 0644},
+                               {dir + "/small", dir + "/small.copy", 5, 0, 0644}})) << download.error;
+
+    // neither the zero-filled destination nor its state are left behind
+    EXPECT_NE (0, access ((dir + "/big.copy").c_str(), F_OK));
+    EXPECT_FALSE (SegmentedDownload::has_state(dir + "/big.copy"));
+    EXPECT_EQ ("small", read_file (dir + "/small.copy"));
+    EXPECT_EQ (big.size() + 5, download.bytes_done);
+}